@@ -198,6 +198,9 @@ if [ ${NEED_PACKAGE} == "true" ]; then
     else
         mkdir -p ${TARGET}/bin
         cp -a vktrace/vktracedump${BINARY_SUFFIX} ${TARGET}/bin/vktracedump
+        if [ ${TARGET} != "arm_32" ] && [ ${TARGET} != "x86" ]; then
+            cp -a vktrace/vktraceconvert${BINARY_SUFFIX} ${TARGET}/bin/vktraceconvert
+        fi
         cp -a vktrace/vkreplay${BINARY_SUFFIX} ${TARGET}/bin/vkreplay
         cp -a vktrace/vktrace${BINARY_SUFFIX} ${TARGET}/bin/vktrace
         cp -a vktrace/vktrace_layer/staging-json/VkLayer_vktrace_layer.json ${TARGET}/bin/
@@ -23,7 +23,7 @@
 #include <iostream>
 #include <iomanip>
 
-class ApiVersionWarning : public layer_factory {
+class ApiVersionWarning : public layer_interceptor<ApiVersionWarning> {
    public:
     // Constructor for interceptor
     ApiVersionWarning(){};
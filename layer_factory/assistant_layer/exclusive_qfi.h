@@ -24,7 +24,7 @@
 
 // This interceptor will warn if the user specifies a queuFamilyIndexCount > 1 while specifying a sharingMode of EXCLUSIVE.
 
-class ExclusiveQfiCheck : public layer_factory {
+class ExclusiveQfiCheck : public layer_interceptor<ExclusiveQfiCheck> {
    public:
     // Constructor for interceptor
     ExclusiveQfiCheck(){};
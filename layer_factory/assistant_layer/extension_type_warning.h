@@ -23,7 +23,7 @@
 #include <sstream>
 #include <algorithm>
 
-class ExtensionTypeWarning : public layer_factory {
+class ExtensionTypeWarning : public layer_interceptor<ExtensionTypeWarning> {
    public:
     // Constructor for interceptor
     ExtensionTypeWarning(){};
@@ -23,7 +23,7 @@
 #include "string"
 #include <algorithm>
 
-class LoadAndUndefined : public layer_factory {
+class LoadAndUndefined : public layer_interceptor<LoadAndUndefined> {
    public:
     // Constructor for interceptor
     LoadAndUndefined(){};
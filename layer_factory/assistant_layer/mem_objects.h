@@ -25,7 +25,7 @@
 
 static const uint32_t kMemoryObjectWarningLimit = 250;
 
-class TooManyMemObjects : public layer_factory {
+class TooManyMemObjects : public layer_interceptor<TooManyMemObjects> {
    public:
     // Constructor for interceptor
     TooManyMemObjects() : number_mem_objects_(0){};
@@ -22,7 +22,7 @@
 #include <string>
 #include <sstream>
 
-class PipelineCacheWarning : public layer_factory {
+class PipelineCacheWarning : public layer_interceptor<PipelineCacheWarning> {
    public:
     // Constructor for interceptor
     PipelineCacheWarning(){};
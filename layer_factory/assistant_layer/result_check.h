@@ -20,7 +20,7 @@
 #include <string>
 #include <sstream>
 
-class ResultCheck : public layer_factory {
+class ResultCheck : public layer_interceptor<ResultCheck> {
    public:
     // Constructor for interceptor
     ResultCheck(){};
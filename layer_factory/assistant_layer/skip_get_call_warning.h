@@ -25,7 +25,7 @@ struct PHYSICAL_DEVICE_STATE {
     CALL_STATE vkGetImageMemoryRequirementsState = UNCALLED;
 };
 
-class SkipGetCallWarning : public layer_factory {
+class SkipGetCallWarning : public layer_interceptor<SkipGetCallWarning> {
    public:
     // Constructor for state_tracker
     SkipGetCallWarning(){};
@@ -19,7 +19,7 @@
 
 #pragma once
 
-class WarnOnPipelineStageAll : public layer_factory {
+class WarnOnPipelineStageAll : public layer_interceptor<WarnOnPipelineStageAll> {
    public:
     // Constructor for interceptor
     WarnOnPipelineStageAll(){};
@@ -23,7 +23,7 @@
 #include "string"
 #include <algorithm>
 
-class ZeroCounts : public layer_factory {
+class ZeroCounts : public layer_interceptor<ZeroCounts> {
    public:
     // Constructor for interceptor
     ZeroCounts(){};
@@ -24,7 +24,7 @@
 #include "vk_layer_logging.h"
 #include "layer_factory.h"
 
-class MemDemo : public layer_factory {
+class MemDemo : public layer_interceptor<MemDemo> {
    public:
     // Constructor for state_tracker
     MemDemo() : number_mem_objects_(0), total_memory_(0), present_count_(0){};
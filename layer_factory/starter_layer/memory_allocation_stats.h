@@ -24,7 +24,7 @@
 
 static uint32_t display_rate = 60;
 
-class MemAllocLevel : public layer_factory {
+class MemAllocLevel : public layer_interceptor<MemAllocLevel> {
    public:
     // Constructor for interceptor
     MemAllocLevel() : number_mem_objects_(0), total_memory_(0), present_count_(0){};
@@ -17,7 +17,7 @@
 
 #pragma once
 
-#include <sys/time.h>
+#include <time.h>
 #include <pthread.h>
 #include <fstream>
 #include <string>
@@ -25,6 +25,9 @@
 #include <climits>
 #include <algorithm>
 #include <map>
+#include <atomic>
+#include <mutex>
+#include <vector>
 #if defined(__ANDROID__)
 #include <android/log.h>
 #endif
@@ -49,17 +52,101 @@ enum class ApiCostFormat {
     Csv,
 };
 
+// Latency histograms have 4 buckets per power of two, the last one holds everything above 2^40 ns
+#define API_COST_HISTOGRAM_BUCKETS 160
+
+// Names of the entrypoints, indexed by the IDs generated in api_cost.cpp
+extern const char *const kApiCostNames[];
+extern const uint32_t kApiCostCount;
+
+static inline uint32_t apiCostBucket(uint64_t cost) {
+    if (cost < 4) return static_cast<uint32_t>(cost);
+    uint32_t msb = 63 - __builtin_clzll(cost);
+    uint32_t bucket = 4 * (msb - 1) + ((cost >> (msb - 2)) & 3);
+    return std::min(bucket, static_cast<uint32_t>(API_COST_HISTOGRAM_BUCKETS - 1));
+}
+
+// Largest cost which falls in 'bucket'
+static inline uint64_t apiCostBucketLimit(uint32_t bucket) {
+    if (bucket < 4) return bucket;
+    uint32_t msb = bucket / 4 + 1;
+    return (static_cast<uint64_t>(4 + bucket % 4 + 1) << (msb - 2)) - 1;
+}
+
 typedef struct ApiStatInfo_ {
     uint64_t callcount = 0;
     uint64_t costsum = 0;
+    uint64_t costmax = 0;
+    uint64_t histogram[API_COST_HISTOGRAM_BUCKETS] = {};
 } ApiStatInfo;
 
+/* Counters of one entrypoint on one thread. Only the owning thread writes them, with plain loads and stores, so no
+ * locked instruction is needed. The merge at frame boundaries reads them from the present thread, and only adds what
+ * was counted since the previous merge, which it keeps in 'merged'.
+ */
+struct ApiCostCounter {
+    ApiCostCounter() {
+        callcount.store(0, std::memory_order_relaxed);
+        costsum.store(0, std::memory_order_relaxed);
+        costmax.store(0, std::memory_order_relaxed);
+        for (auto &bucket : histogram) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    static inline void add(std::atomic<uint64_t> &value, uint64_t n) {
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    inline void record(uint64_t cost) {
+        add(callcount, 1);
+        add(costsum, cost);
+        if (cost > costmax.load(std::memory_order_relaxed)) {
+            costmax.store(cost, std::memory_order_relaxed);
+        }
+        add(histogram[apiCostBucket(cost)], 1);
+    }
+
+    std::atomic<uint64_t> callcount;
+    std::atomic<uint64_t> costsum;
+    std::atomic<uint64_t> costmax;
+    std::atomic<uint64_t> histogram[API_COST_HISTOGRAM_BUCKETS];
+    ApiStatInfo merged;  // the counts already in func_stat, only used under s_cost_mutex
+};
+
+// Per-thread counters, allocated the first time the thread calls an entrypoint
+struct ApiCostShard {
+    explicit ApiCostShard(uint32_t count) : counters(count) {
+        for (auto &counter : counters) {
+            counter.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~ApiCostShard() {
+        for (auto &counter : counters) {
+            delete counter.load(std::memory_order_relaxed);
+        }
+    }
+
+    inline ApiCostCounter *counter(uint32_t id) {
+        ApiCostCounter *result = counters[id].load(std::memory_order_relaxed);
+        if (result == nullptr) {
+            result = new ApiCostCounter();
+            counters[id].store(result, std::memory_order_release);
+        }
+        return result;
+    }
+
+    std::vector<std::atomic<ApiCostCounter *>> counters;
+};
+
 /* the api_cost ouput file is vk_apicost.txt */
 class ApiCostInstance {
 private:
     inline ApiCostInstance() {
         getPlatformEnvVar(API_COST_ENV_VAR);
         pthread_mutex_init(&s_cost_mutex,nullptr);
+        frame_count.store(0);
         func_stat.clear();
         std::string filePath = "";
         if (output_format == ApiCostFormat::Csv) {
@@ -171,20 +258,11 @@ private:
     }
 
     inline ~ApiCostInstance() {
+        // Threads of the application may still be calling the layer
+        pthread_mutex_lock(&s_cost_mutex);
         if (output_stream.rdstate() == std::ifstream::goodbit) {
             if (output_format == ApiCostFormat::Csv) {
-                char costinfo[256] = {0};
-                sprintf(costinfo,"function,count,time(us),avg. time\r\n");
-                cost_string = cost_string + costinfo;
-                for(auto e: func_stat) {
-                    memset(costinfo,0,sizeof(costinfo));
-                    sprintf(costinfo,"%s,%lu,%lu,%f\r\n", e.first.c_str(),
-                            static_cast<unsigned long>(e.second.callcount),
-                            static_cast<unsigned long>(e.second.costsum),
-                            static_cast<float>(e.second.costsum) / static_cast<unsigned long>(e.second.callcount));
-                    cost_string = cost_string + costinfo;
-                }
-                output_stream.write(cost_string.c_str(),cost_string.size());
+                writeCsvFile();
             } else if (output_format == ApiCostFormat::Text) {
                 output_stream.write(cost_string.c_str(),cost_string.size());
             } else {
@@ -194,6 +272,8 @@ private:
             output_stream.close();
         }
         func_stat.clear();
+        pthread_mutex_unlock(&s_cost_mutex);
+        // The shards are not freed: threads of the application may still be running while the layer is unloaded
         pthread_mutex_destroy(&s_cost_mutex);
     }
 
@@ -207,17 +287,105 @@ private:
         return lower_value;
     }
 
-    void writeCsv(std::string& functionname,uint64_t& cost) {
-        if (frame_count >= frame_range[0] && frame_count <= frame_range[1]) {
-            apiStat(functionname,cost);
+    inline bool inFrameRange(uint64_t frame) const {
+        return frame >= frame_range[0] && frame <= frame_range[1];
+    }
+
+    ApiCostShard *shard() {
+        static thread_local ApiCostShard *t_shard = nullptr;
+        if (t_shard == nullptr) {
+            t_shard = new ApiCostShard(kApiCostCount);
+            std::lock_guard<std::mutex> lock(shards_mutex);
+            shards.push_back(t_shard);
+        }
+        return t_shard;
+    }
+
+    // Add what the threads counted since the previous merge to func_stat. Called under s_cost_mutex.
+    void mergeShards() {
+        if (func_stat.empty()) {
+            func_stat.assign(kApiCostCount, ApiStatInfo());
+        }
+        std::lock_guard<std::mutex> lock(shards_mutex);
+        for (ApiCostShard *threadShard : shards) {
+            for (uint32_t id = 0; id < kApiCostCount; id++) {
+                ApiCostCounter *counter = threadShard->counters[id].load(std::memory_order_acquire);
+                if (counter == nullptr) {
+                    continue;
+                }
+                ApiStatInfo &stat = func_stat[id];
+                ApiStatInfo &merged = counter->merged;
+                uint64_t value = counter->callcount.load(std::memory_order_relaxed);
+                stat.callcount += value - merged.callcount;
+                merged.callcount = value;
+                value = counter->costsum.load(std::memory_order_relaxed);
+                stat.costsum += value - merged.costsum;
+                merged.costsum = value;
+                stat.costmax = std::max(stat.costmax, counter->costmax.load(std::memory_order_relaxed));
+                for (uint32_t bucket = 0; bucket < API_COST_HISTOGRAM_BUCKETS; bucket++) {
+                    value = counter->histogram[bucket].load(std::memory_order_relaxed);
+                    stat.histogram[bucket] += value - merged.histogram[bucket];
+                    merged.histogram[bucket] = value;
+                }
+            }
+        }
+    }
+
+    // Upper bound of the bucket holding the given fraction of the calls, capped by the maximum cost
+    static uint64_t percentile(const ApiStatInfo &stat, double fraction) {
+        uint64_t rank = static_cast<uint64_t>(fraction * stat.callcount);
+        uint64_t seen = 0;
+        for (uint32_t bucket = 0; bucket < API_COST_HISTOGRAM_BUCKETS; bucket++) {
+            seen += stat.histogram[bucket];
+            if (seen > rank) {
+                return std::min(apiCostBucketLimit(bucket), stat.costmax);
+            }
+        }
+        return stat.costmax;
+    }
+
+    // Write the statistics of the entrypoints called in the frame range, sorted by name. Called once under
+    // s_cost_mutex, when the range ends or when the layer is unloaded.
+    void writeCsvFile() {
+        if (csv_written) {
+            return;
+        }
+        csv_written = true;
+        mergeShards();
+        std::vector<uint32_t> ids;
+        for (uint32_t id = 0; id < kApiCostCount; id++) {
+            if (func_stat[id].callcount > 0) {
+                ids.push_back(id);
+            }
+        }
+        std::sort(ids.begin(), ids.end(), [](uint32_t a, uint32_t b) { return strcmp(kApiCostNames[a], kApiCostNames[b]) < 0; });
+
+        char costinfo[256] = {0};
+        sprintf(costinfo,"function,count,time(ns),avg. time(ns),p50(ns),p99(ns),max(ns)\r\n");
+        cost_string = cost_string + costinfo;
+        for (uint32_t id : ids) {
+            const ApiStatInfo &stat = func_stat[id];
+            memset(costinfo,0,sizeof(costinfo));
+            snprintf(costinfo,sizeof(costinfo),"%s,%llu,%llu,%.1f,%llu,%llu,%llu\r\n", kApiCostNames[id],
+                     static_cast<unsigned long long>(stat.callcount),
+                     static_cast<unsigned long long>(stat.costsum),
+                     static_cast<double>(stat.costsum) / stat.callcount,
+                     static_cast<unsigned long long>(percentile(stat, 0.5)),
+                     static_cast<unsigned long long>(percentile(stat, 0.99)),
+                     static_cast<unsigned long long>(stat.costmax));
+            cost_string = cost_string + costinfo;
         }
+        output_stream.write(cost_string.c_str(),cost_string.size());
+        output_stream.flush();
+        cost_string = "";
     }
 
-    void writeTxt(uint32_t& threadid,std::string& functionname,uint64_t& cost) {
-        if (frame_count >= frame_range[0] && frame_count <= frame_range[1]) {
+    void writeTxt(uint32_t& threadid,const char *functionname,uint64_t& cost) {
+        uint64_t frame = frame_count.load(std::memory_order_relaxed);
+        if (inFrameRange(frame)) {
             char costinfo[256] = {0};
-            sprintf(costinfo,"frameid = %-7lu threadid = %-12u funcname = %-48s cost = %-6lu us \r\n",\
-                static_cast<unsigned long>(frame_count), threadid,functionname.c_str(),static_cast<unsigned long>(cost));
+            sprintf(costinfo,"frameid = %-7lu threadid = %-12u funcname = %-48s cost = %-9lu ns \r\n",\
+                static_cast<unsigned long>(frame), threadid,functionname,static_cast<unsigned long>(cost));
             cost_string = cost_string + costinfo;
         }
         if (cost_string.size() >= OUTPUT_LENGTH) {
@@ -226,12 +394,13 @@ private:
         }
     }
 
-    void writeHtml(uint32_t& threadid,std::string& functionname,uint64_t& cost) {
+    void writeHtml(uint32_t& threadid,const char *functionname,uint64_t& cost) {
         // <summary><div class='var'>frameid = 0 threadid = 0 funcname = vkWaitForFences cost = 0</div></summary>
-        if (frame_count >= frame_range[0] && frame_count <= frame_range[1]) {
+        uint64_t frame = frame_count.load(std::memory_order_relaxed);
+        if (inFrameRange(frame)) {
             stream() << "<summary><div class='var'>";
-            stream() << "frameid = " << frame_count << "    threadid = " << threadid << "    funcname = " \
-                << functionname << "    cost = " << cost << "    us \r\n";
+            stream() << "frameid = " << frame << "    threadid = " << threadid << "    funcname = " \
+                << functionname << "    cost = " << cost << "    ns \r\n";
             stream() << "</div></summary>";
         }
         long pos = stream().tellp();
@@ -240,37 +409,14 @@ private:
         }
     }
 
-    void inline apiStat(std::string& functionname,uint64_t& cost) {
-        func_stat[functionname].callcount++;
-        func_stat[functionname].costsum += cost;
-    }
-
-public:
-    uint64_t getCurrentTime() {
-        pthread_mutex_lock(&s_cost_mutex);
-        struct timeval time = {};
-        gettimeofday(&time,nullptr);
-        uint64_t elapse = time.tv_sec * 1000000 + time.tv_usec;
-        pthread_mutex_unlock(&s_cost_mutex);
-        return elapse;
-    }
-
-    void nextFrame() {
-        pthread_mutex_lock(&s_cost_mutex);
-        frame_count++;
-        pthread_mutex_unlock(&s_cost_mutex);
-    }
-
-    void writeFile(std::string functionname,uint64_t cost) {
+    void writeFile(const char *functionname,uint64_t cost) {
         pthread_mutex_lock(&s_cost_mutex);
         if (output_stream.rdstate() != std::ifstream::goodbit) {
             pthread_mutex_unlock(&s_cost_mutex);
             return ;
         }
         uint32_t threadid = static_cast<uint32_t>(pthread_self());
-        if (output_format == ApiCostFormat::Csv) {
-            writeCsv(functionname,cost);
-        } else if (output_format == ApiCostFormat::Text) {
+        if (output_format == ApiCostFormat::Text) {
             writeTxt(threadid,functionname,cost);
         } else {
             writeHtml(threadid,functionname,cost);
@@ -278,6 +424,40 @@ public:
         pthread_mutex_unlock(&s_cost_mutex);
     }
 
+public:
+    // Monotonic time in nanoseconds, read from the vDSO without any lock
+    uint64_t getCurrentTime() {
+        struct timespec time = {};
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        return static_cast<uint64_t>(time.tv_sec) * 1000000000ull + time.tv_nsec;
+    }
+
+    // Count a call of the entrypoint 'id' which took 'cost' ns. The CSV statistics are kept in per-thread counters
+    // without any lock, the Text and Html formats log every call to the file.
+    inline void record(uint32_t id, uint64_t cost) {
+        if (output_format != ApiCostFormat::Csv) {
+            writeFile(kApiCostNames[id], cost);
+            return;
+        }
+        if (inFrameRange(frame_count.load(std::memory_order_relaxed))) {
+            shard()->counter(id)->record(cost);
+        }
+    }
+
+    // Called at each present. The counters of all threads are merged at each frame of the range, and written when
+    // the range ends.
+    void nextFrame() {
+        uint64_t frame = frame_count.fetch_add(1, std::memory_order_relaxed);
+        if (output_format == ApiCostFormat::Csv && inFrameRange(frame)) {
+            pthread_mutex_lock(&s_cost_mutex);
+            mergeShards();
+            if (frame == frame_range[1] && output_stream.rdstate() == std::ifstream::goodbit) {
+                writeCsvFile();
+            }
+            pthread_mutex_unlock(&s_cost_mutex);
+        }
+    }
+
     void getPlatformEnvVar(const std::string &varName) {
         /*get output file directory,format,frame range,for example
         * APICOST = path=d:/test/,format=Text,range=1,1000000
@@ -376,15 +556,17 @@ public:
 private:
     static ApiCostInstance s_cost_instance;
     static pthread_mutex_t s_cost_mutex;
-    std::map<std::string,ApiStatInfo> api_statinfo;
     std::string output_dir = "./";
     std::string file_name = "vk_apicost";
     ApiCostFormat output_format = ApiCostFormat::Csv;
     std::string cost_string = "";
     std::ofstream output_stream;
-    std::map<std::string,ApiStatInfo> func_stat;
+    std::vector<ApiStatInfo> func_stat;
+    std::mutex shards_mutex;  // only taken when a thread makes its first call and when merging
+    std::vector<ApiCostShard *> shards;
+    bool csv_written = false;
     uint64_t frame_range[2] = {0,ULONG_MAX};
-    uint64_t frame_count = 0;
+    std::atomic<uint64_t> frame_count;
 };
 
 ApiCostInstance ApiCostInstance::s_cost_instance;
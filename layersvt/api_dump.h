@@ -35,7 +35,9 @@
 #include "vk_layer_utils.h"
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <fstream>
 #include <mutex>
 #include <iomanip>
@@ -46,6 +48,7 @@
 #include <string>
 #include <type_traits>
 #include <map>
+#include <memory>
 #include <thread>
 #include <unordered_map>
 #include <vector>
@@ -81,6 +84,7 @@ enum class ApiDumpFormat {
     Text,
     Html,
     Json,
+    Binary,
 };
 
 static const uint64_t OUTPUT_RANGE_UNLIMITED = 0;
@@ -233,10 +237,348 @@ class ConditionalFrameOutput {
     }
 };
 
+//==================================== Binary Backend Helpers ====================================//
+
+// The binary output is a file header followed by records. Each record is the raw bytes of the parameters of one call,
+// with a copy of everything they point to, and is formatted later by api_dump_decode with the same printers as the
+// other formats. The records are buffered by each thread and written by a background thread, so they are not in the
+// order of the calls in the file: the decoder sorts them by their sequence number.
+#define API_DUMP_BINARY_MAGIC "VKAPIDMP"
+#define API_DUMP_BINARY_VERSION 2
+
+// The function of the record which ends a frame, the other records use the hash of the name of their function.
+static const uint32_t API_DUMP_BINARY_FRAME = 0;
+
+struct ApiDumpBinaryFileHeader {
+    char magic[8];              // API_DUMP_BINARY_MAGIC
+    uint32_t version;           // API_DUMP_BINARY_VERSION
+    uint32_t pointer_size;      // sizeof(void*) of the layer, the decoder must have the same
+    uint32_t header_version;    // VK_HEADER_VERSION of the layer, the struct layouts are the ones of these headers
+    uint32_t reserved;
+};
+
+struct ApiDumpBinaryRecordHeader {
+    uint32_t size;           // Size of the whole record with this header, a multiple of 8
+    uint32_t function;       // Hash of the name of the function, API_DUMP_BINARY_FRAME at the end of a frame
+    uint64_t sequence;       // Order of the call among the calls of all threads
+    uint64_t thread;         // Thread index, as printed by the other formats
+    int64_t time;            // Microseconds since the start when the call was made
+    uint32_t data_size;      // Size of the parameters and their data, following this header
+    uint32_t pointer_count;  // Number of ApiDumpBinaryPointer following the data, one per pointer in the data
+};
+
+// A pointer in the data of a record, the decoder checks that what it points to is in the data before relocating it
+struct ApiDumpBinaryPointer {
+    uint32_t field;  // Offset of the pointer in the data
+    uint32_t size;   // Size of the bytes it points to
+};
+
+class ApiDumpBinaryEncoder;
+class ApiDumpBinaryWriter;
+
+// Copies what 'object' points to into the record. The copy of 'object' is at 'offset' in the record. Nothing to do
+// for scalars and handles, the generated api_dump_binary.h has an overload for each struct and union.
+template <typename T, typename... Args>
+inline void encode_binary(ApiDumpBinaryEncoder &enc, const T &object, uint64_t offset, Args... args) {}
+
+inline void encode_binary(ApiDumpBinaryEncoder &enc, const char *const &object, uint64_t offset);
+
+// Builds the records of one thread. Pointers in a record are offsets from the start of its data, 0 for NULL, and the
+// decoder turns them back into pointers. Offsets are only valid until the next append(), which can move the buffer.
+class ApiDumpBinaryEncoder {
+   public:
+    ApiDumpBinaryEncoder(ApiDumpBinaryWriter *writer) : writer(writer) {}
+
+    // The writer takes the records of the buffer under 'mutex', which the thread holds from begin() to end()
+    inline void begin(uint32_t function, uint64_t sequence, uint64_t thread, int64_t time) {
+        mutex.lock();
+        record_start = buffer.size();
+        ApiDumpBinaryRecordHeader header = {0, function, sequence, thread, time, 0, 0};
+        buffer.resize(record_start + sizeof(header));
+        memcpy(&buffer[record_start], &header, sizeof(header));
+        data_start = buffer.size();
+        relocated.clear();
+    }
+
+    // Ends the record and hands the buffer to the writer once it is large enough
+    inline void end();
+
+    // Adds 'size' bytes to the data, aligned to 8, and returns their offset
+    inline uint64_t append(const void *data, size_t size) {
+        uint64_t offset = (buffer.size() - data_start + 7) & ~uint64_t(7);
+        buffer.resize(data_start + offset + size);
+        if (size > 0) memcpy(&buffer[data_start + offset], data, size);
+        return offset;
+    }
+
+    template <typename T>
+    inline T &at(uint64_t offset) {
+        return *(T *)&buffer[data_start + offset];
+    }
+
+    // Makes the pointer at 'field' point to the 'size' bytes of data at 'target'
+    inline void relocate(uint64_t field, uint64_t target, uint64_t size) {
+        uintptr_t value = (uintptr_t)target;
+        memcpy(&buffer[data_start + field], &value, sizeof(value));
+        relocated.push_back({(uint32_t)field, (uint32_t)size});
+    }
+
+    // Where the pointer at 'field' was relocated to, 0 if it was not
+    inline uint64_t target(uint64_t field) const {
+        uintptr_t value;
+        memcpy(&value, &buffer[data_start + field], sizeof(value));
+        return value;
+    }
+
+    // Copies the 'count' T at 'data' and relocates 'field' to them, without what they point to
+    template <typename T>
+    inline uint64_t copy(uint64_t field, const T *data, uint64_t count = 1) {
+        if (data == NULL) return 0;
+        uint64_t offset = append(data, sizeof(T) * count);
+        relocate(field, offset, sizeof(T) * count);
+        return offset;
+    }
+
+    // Copies the 'count' T at 'data' with what they point to, and relocates 'field' to them
+    template <typename T, typename... Args>
+    inline uint64_t array(uint64_t field, const T *data, uint64_t count, Args... args) {
+        uint64_t offset = copy(field, data, count);
+        for (uint64_t i = 0; data != NULL && i < count; ++i) {
+            encode_binary(*this, data[i], offset + i * sizeof(T), args...);
+        }
+        return offset;
+    }
+
+    template <typename T, typename... Args>
+    inline uint64_t pointer(uint64_t field, const T *data, Args... args) {
+        return array(field, data, 1, args...);
+    }
+
+    // An array of 'count' pointers to one T each
+    template <typename T, typename... Args>
+    inline uint64_t pointers(uint64_t field, const T *const *data, uint64_t count, Args... args) {
+        uint64_t offset = copy(field, data, count);
+        for (uint64_t i = 0; data != NULL && i < count; ++i) {
+            pointer(offset + i * sizeof(T *), data[i], args...);
+        }
+        return offset;
+    }
+
+    // Hands the records left in the buffer to the writer when the thread exits
+    inline void release();
+
+   private:
+    friend class ApiDumpBinaryWriter;
+
+    std::mutex mutex;
+    ApiDumpBinaryWriter *writer;  // NULL once the writer took the last records
+    std::vector<uint8_t> buffer;
+    size_t complete = 0;  // Size of the records which are ended in the buffer
+    size_t record_start = 0;
+    size_t data_start = 0;
+    std::vector<ApiDumpBinaryPointer> relocated;
+};
+
+inline void encode_binary(ApiDumpBinaryEncoder &enc, const char *const &object, uint64_t offset) {
+    if (object != NULL) enc.copy(offset, object, strlen(object) + 1);
+}
+
+// Writes the buffers of the encoders to the output on a background thread. Each thread has its own encoder, the
+// threads only meet when one of them hands over a full buffer.
+class ApiDumpBinaryWriter {
+   public:
+    ApiDumpBinaryWriter(std::ostream &stream) : stream(stream), id(++last_id) {
+        ApiDumpBinaryFileHeader header = {};
+        memcpy(header.magic, API_DUMP_BINARY_MAGIC, sizeof(header.magic));
+        header.version = API_DUMP_BINARY_VERSION;
+        header.pointer_size = sizeof(void *);
+        header.header_version = VK_HEADER_VERSION;
+        stream.write((const char *)&header, sizeof(header));
+        flush_thread = std::thread(&ApiDumpBinaryWriter::run, this);
+    }
+
+    // Writes what the threads have left in their buffers, after the records which they are building
+    ~ApiDumpBinaryWriter() {
+        flush(true);
+        {
+            std::lock_guard<std::mutex> lg(queue_mutex);
+            stopping = true;
+        }
+        queue_cv.notify_one();
+        flush_thread.join();
+        stream.flush();
+    }
+
+    // The encoder of the calling thread. It is owned by the thread and the writer, and its buffer freed when the thread
+    // exits.
+    inline ApiDumpBinaryEncoder &encoder() {
+        struct ThreadEncoder {
+            uint64_t writer_id = 0;
+            std::shared_ptr<ApiDumpBinaryEncoder> encoder;
+            ~ThreadEncoder() {
+                if (encoder) encoder->release();
+            }
+        };
+        static thread_local ThreadEncoder local;
+        if (local.writer_id != id) {
+            if (local.encoder) local.encoder->release();
+            local.encoder = std::make_shared<ApiDumpBinaryEncoder>(this);
+            local.encoder->buffer.reserve(BUFFER_SIZE + BUFFER_SIZE / 4);
+            local.writer_id = id;
+            std::lock_guard<std::mutex> lg(encoders_mutex);
+            encoders.push_back(local.encoder);
+        }
+        return *local.encoder;
+    }
+
+    // Takes the buffer of 'enc' once it holds BUFFER_SIZE bytes of records and gives it an empty one
+    inline void commit(ApiDumpBinaryEncoder &enc) {
+        enc.complete = enc.buffer.size();
+        if (enc.complete < BUFFER_SIZE) return;
+        std::vector<uint8_t> empty;
+        {
+            std::lock_guard<std::mutex> lg(queue_mutex);
+            queue.push_back(std::move(enc.buffer));
+            if (!spare.empty()) {
+                empty = std::move(spare.back());
+                spare.pop_back();
+            }
+        }
+        queue_cv.notify_one();
+        if (empty.capacity() == 0) empty.reserve(BUFFER_SIZE + BUFFER_SIZE / 4);
+        enc.buffer = std::move(empty);
+        enc.complete = 0;
+    }
+
+    // Queues the records of all the threads, at the end of a frame and before the writer is destroyed, so that no more
+    // than a frame is lost if the application exits abnormally. With 'closing', the encoders stop writing.
+    inline void flush(bool closing) {
+        std::vector<std::shared_ptr<ApiDumpBinaryEncoder> > current;
+        {
+            std::lock_guard<std::mutex> lg(encoders_mutex);
+            current = encoders;
+            if (closing) encoders.clear();
+        }
+        for (auto &enc : current) {
+            std::lock_guard<std::mutex> lg(enc->mutex);
+            if (enc->writer == NULL) continue;
+            take(*enc);
+            if (closing) enc->writer = NULL;
+        }
+        queue_cv.notify_one();
+    }
+
+    // Called with the mutex of 'enc' held, when its thread exits
+    inline void remove(ApiDumpBinaryEncoder &enc) {
+        take(enc);
+        queue_cv.notify_one();
+        std::lock_guard<std::mutex> lg(encoders_mutex);
+        for (auto it = encoders.begin(); it != encoders.end(); ++it) {
+            if (it->get() == &enc) {
+                encoders.erase(it);
+                break;
+            }
+        }
+    }
+
+   private:
+    // Queues a copy of the records of 'enc', of which the mutex is held. The encoder keeps its buffer.
+    inline void take(ApiDumpBinaryEncoder &enc) {
+        if (enc.complete == 0) return;
+        std::lock_guard<std::mutex> lg(queue_mutex);
+        queue.emplace_back(enc.buffer.begin(), enc.buffer.begin() + enc.complete);
+        enc.buffer.erase(enc.buffer.begin(), enc.buffer.begin() + enc.complete);
+        enc.complete = 0;
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        while (true) {
+            queue_cv.wait(lock, [this] { return !queue.empty() || stopping; });
+            if (queue.empty()) break;
+            std::vector<std::vector<uint8_t> > buffers;
+            buffers.swap(queue);
+            lock.unlock();
+            for (auto &buffer : buffers) {
+                stream.write((const char *)buffer.data(), buffer.size());
+                buffer.clear();
+            }
+            lock.lock();
+            for (auto &buffer : buffers) {
+                // The copies of flush() are too small to be reused
+                if (spare.size() < MAX_SPARE_BUFFERS && buffer.capacity() >= BUFFER_SIZE) {
+                    spare.push_back(std::move(buffer));
+                }
+            }
+        }
+    }
+
+    static const size_t BUFFER_SIZE = 1024 * 1024;
+    static const size_t MAX_SPARE_BUFFERS = 4;
+    static std::atomic<uint64_t> last_id;
+
+    std::ostream &stream;
+    const uint64_t id;  // Tells the encoders of a previous writer from the ones of this one
+
+    std::mutex encoders_mutex;
+    std::vector<std::shared_ptr<ApiDumpBinaryEncoder> > encoders;
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::vector<std::vector<uint8_t> > queue;
+    std::vector<std::vector<uint8_t> > spare;
+    bool stopping = false;
+    std::thread flush_thread;
+};
+
+std::atomic<uint64_t> ApiDumpBinaryWriter::last_id(0);
+
+inline void ApiDumpBinaryEncoder::end() {
+    uint64_t data_size = buffer.size() - data_start;
+    if (!relocated.empty()) {
+        size_t start = buffer.size();
+        buffer.resize(start + relocated.size() * sizeof(ApiDumpBinaryPointer));
+        memcpy(&buffer[start], relocated.data(), relocated.size() * sizeof(ApiDumpBinaryPointer));
+    }
+    buffer.resize((buffer.size() + 7) & ~size_t(7));
+    ApiDumpBinaryRecordHeader *header = (ApiDumpBinaryRecordHeader *)&buffer[record_start];
+    header->size = (uint32_t)(buffer.size() - record_start);
+    header->data_size = (uint32_t)data_size;
+    header->pointer_count = (uint32_t)relocated.size();
+    if (writer != NULL) {
+        writer->commit(*this);
+    } else {
+        buffer.clear();
+    }
+    mutex.unlock();
+}
+
+inline void ApiDumpBinaryEncoder::release() {
+    std::lock_guard<std::mutex> lg(mutex);
+    if (writer != NULL) writer->remove(*this);
+    writer = NULL;
+}
+
 class ApiDumpSettings {
    public:
     ApiDumpSettings() {
         std::string filename_string = "";
+        std::string env_value;
+
+        output_format = readFormatOption("lunarg_api_dump.output_format", ApiDumpFormat::Text);
+        env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_OUTPUT_FMT);
+        if (!env_value.empty()) {
+            if (ToLowerString(env_value) == "html") {
+                output_format = ApiDumpFormat::Html;
+            } else if (ToLowerString(env_value) == "json") {
+                output_format = ApiDumpFormat::Json;
+            } else if (ToLowerString(env_value) == "binary") {
+                output_format = ApiDumpFormat::Binary;
+            } else {
+                output_format = ApiDumpFormat::Text;
+            }
+        }
+
         // If the layer settings file has a flag indicating to output to a file,
         // do so, to the appropriate filename.
         const char *file_option = getLayerOption("lunarg_api_dump.file");
@@ -247,21 +589,31 @@ class ApiDumpSettings {
                 if (filename_option != NULL && strcmp(filename_option, "") != 0) {
                     filename_string = filename_option;
                 } else {
-                    filename_string = "vk_apidump.txt";
+                    filename_string = output_format == ApiDumpFormat::Binary ? "vk_apidump.bin" : "vk_apidump.txt";
                 }
             }
         }
         // If an environment variable is set, always output to that filename instead,
         // whether or not the settings file enables the option.  Just assume a non-empty
         // string is asking for the file output to the given name.
-        std::string env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_LOG_FILE);
+        env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_LOG_FILE);
         if (!env_value.empty()) {
             filename_string = env_value;
         }
+
+        // The binary output is always written to a file
+        if (output_format == ApiDumpFormat::Binary && filename_string.empty()) {
+            filename_string = "vk_apidump.bin";
+        }
+
         // If one of the above has set a filename, open the file as an output stream.
         if (!filename_string.empty()) {
             use_cout = false;
-            output_stream.open(filename_string, std::ofstream::out | std::ostream::trunc);
+            if (output_format == ApiDumpFormat::Binary) {
+                output_stream.open(filename_string, std::ofstream::out | std::ostream::trunc | std::ostream::binary);
+            } else {
+                output_stream.open(filename_string, std::ofstream::out | std::ostream::trunc);
+            }
             size_t last_slash_idx = filename_string.find_last_of("\\/");
             if (std::string::npos != last_slash_idx) {
                 output_dir = filename_string.substr(0, last_slash_idx + 1);
@@ -274,18 +626,6 @@ class ApiDumpSettings {
         // Get the remaining settings (some we also want to provide the ability to override
         // using environment variables).
 
-        output_format = readFormatOption("lunarg_api_dump.output_format", ApiDumpFormat::Text);
-        env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_OUTPUT_FMT);
-        if (!env_value.empty()) {
-            if (ToLowerString(env_value) == "html") {
-                output_format = ApiDumpFormat::Html;
-            } else if (ToLowerString(env_value) == "json") {
-                output_format = ApiDumpFormat::Json;
-            } else {
-                output_format = ApiDumpFormat::Text;
-            }
-        }
-
         show_params = readBoolOption("lunarg_api_dump.detailed", true);
         env_value = GetPlatformEnvVar(API_DUMP_ENV_VAR_DETAILED_OUTPUT);
         if (!env_value.empty()) {
@@ -440,14 +780,37 @@ class ApiDumpSettings {
             // clang-format on
         } else if (output_format == ApiDumpFormat::Json) {
             stream() << "[\n";
+        } else if (output_format == ApiDumpFormat::Binary) {
+            binary_writer = new ApiDumpBinaryWriter(stream());
         }
 
-        if (isFrameInRange(0)) {
-            setupInterFrameOutputFormatting(0);
-        }
     }
 
+    // Only used in vktracedump, to format parts of a trace on several threads: the same settings as 'other', writing to
+    // 'part_stream' without the heading and the closing of the output.
+    ApiDumpSettings(const ApiDumpSettings &other, std::ostream &part_stream)
+        : use_cout(other.use_cout),
+          output_dir(other.output_dir),
+          output_format(other.output_format),
+          show_params(other.show_params),
+          show_address(other.show_address),
+          should_flush(other.should_flush),
+          show_timestamp(other.show_timestamp),
+          show_type(other.show_type),
+          indent_size(other.indent_size),
+          name_size(other.name_size),
+          type_size(other.type_size),
+          use_spaces(other.use_spaces),
+          show_shader(other.show_shader),
+          show_thread_and_frame(other.show_thread_and_frame),
+          use_conditional_output(other.use_conditional_output),
+          condFrameOutput(other.condFrameOutput),
+          part_stream(&part_stream) {}
+
     ~ApiDumpSettings() {
+        if (part_stream != NULL) return;
+        // Waits for the buffered records to be written
+        if (binary_writer != NULL) delete binary_writer;
         if (output_format == ApiDumpFormat::Html) {
             // Close off html
             stream() << "</div></body></html>";
@@ -458,9 +821,9 @@ class ApiDumpSettings {
         if (!use_cout) output_stream.close();
     }
 
-    void setupInterFrameOutputFormatting(uint64_t frame_count) const /*name change? */
+    // 'has_printed_frame' is kept by the instance, vktracedump carries it from one part of a trace to the next
+    void setupInterFrameOutputFormatting(uint64_t frame_count, bool &has_printed_frame) const /*name change? */
     {
-        static bool hasPrintedAFrame = false;
         switch (format()) {
             case (ApiDumpFormat::Html):
                 if (frame_count > 0) {
@@ -481,8 +844,8 @@ class ApiDumpSettings {
                     if (condFrameOutput.isFrameInRange(frame_count - 1)) stream() << "\n" << indentation(1) << "]\n}";
                 }
                 if (condFrameOutput.isFrameInRange(frame_count)) {
-                    if (!hasPrintedAFrame) {
-                        hasPrintedAFrame = true;
+                    if (!has_printed_frame) {
+                        has_printed_frame = true;
                     } else {
                         stream() << ",\n";
                     }
@@ -555,7 +918,16 @@ class ApiDumpSettings {
 
     inline bool showThreadAndFrame() const { return show_thread_and_frame; }
 
-    inline std::ostream &stream() const { return use_cout ? std::cout : *(std::ofstream *)&output_stream; }
+    inline std::ostream &stream() const {
+        if (call_stream != NULL) return *call_stream;
+        if (part_stream != NULL) return *part_stream;
+        return use_cout ? std::cout : *(std::ofstream *)&output_stream;
+    }
+
+    inline bool isPart() const { return part_stream != NULL; }
+
+    // Only with the binary output format
+    inline ApiDumpBinaryWriter *binaryWriter() const { return binary_writer; }
 
     inline std::string directory() const { return output_dir; }
 
@@ -647,6 +1019,8 @@ class ApiDumpSettings {
             return ApiDumpFormat::Html;
         else if (lowered_option == "json")
             return ApiDumpFormat::Json;
+        else if (lowered_option == "binary")
+            return ApiDumpFormat::Binary;
         else
             return default_value;
     }
@@ -675,6 +1049,13 @@ class ApiDumpSettings {
     bool use_conditional_output = false;
     ConditionalFrameOutput condFrameOutput;
 
+    std::ostream *part_stream = NULL;
+    ApiDumpBinaryWriter *binary_writer = NULL;
+
+    // The buffer of the call being formatted on this thread, set by ApiDumpInstance::beginCallOutput()
+    static thread_local std::ostream *call_stream;
+    friend class ApiDumpInstance;
+
     static const char *const SPACES;
     static const int MAX_SPACES = 144;
     static const char *const TABS;
@@ -685,55 +1066,124 @@ const char *const ApiDumpSettings::SPACES =
     "                                                                                                                          "
     "    "
     "                  ";
+thread_local std::ostream *ApiDumpSettings::call_stream = NULL;
 const char *const ApiDumpSettings::TABS = "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
 
 class ApiDumpInstance {
    public:
-    inline ApiDumpInstance() : dump_settings(NULL), frame_count(0), thread_count(0), draw_call_count(0) {
+    inline ApiDumpInstance() : dump_settings(NULL), frame_count(0), draw_call_count(0) {
         program_start = std::chrono::system_clock::now();
     }
 
+    // Only used in vktracedump, to format parts of a trace on several threads: the part is written to 'part_stream' with
+    // the settings of 'other'.
+    inline ApiDumpInstance(ApiDumpInstance &other, std::ostream &part_stream)
+        : dump_settings(new ApiDumpSettings(other.settings(), part_stream)), frame_count(0), draw_call_count(0) {
+        program_start = other.program_start;
+        should_dump_output = dump_settings->isFrameInRange(0);
+        has_printed_frame = dump_settings->isFrameInRange(0);
+    }
+
     inline ~ApiDumpInstance() {
-        if (dump_settings && !first_func_call_on_frame) settings().closeFrameOutput();
+        if (dump_settings && !first_func_call_on_frame && !dump_settings->isPart()) settings().closeFrameOutput();
 
         if (dump_settings != NULL) delete dump_settings;
     }
 
-    inline uint64_t frameCount() {
-        std::lock_guard<std::recursive_mutex> lg(frame_mutex);
-        uint64_t count = frame_count;
-        return count;
-    }
+    inline uint64_t frameCount() { return frame_count.load(std::memory_order_relaxed); }
 
+    // The frame changes under the output mutex, so that the output of the calls stays in its frame
     inline void nextFrame() {
-        std::lock_guard<std::recursive_mutex> lg(frame_mutex);
-        ++frame_count;
+        std::lock_guard<std::recursive_mutex> lg(output_mutex);
+        if (settings().format() == ApiDumpFormat::Binary) {
+            // Written in all frames, the decoder counts the frames with these records
+            beginBinaryCall();
+            beginBinaryRecord(API_DUMP_BINARY_FRAME)->end();
+            settings().binaryWriter()->flush(false);
+        }
+        uint64_t frame = ++frame_count;
 
-        should_dump_output = settings().isFrameInRange(frame_count);
-        settings().setupInterFrameOutputFormatting(frame_count);
+        should_dump_output.store(settings().isFrameInRange(frame), std::memory_order_relaxed);
+        settings().setupInterFrameOutputFormatting(frame, has_printed_frame);
         first_func_call_on_frame = true;
     }
 
+    // Lock free, the calls of the frames which are not dumped only pay for this check
     inline bool shouldDumpOutput() {
-        if (!conditional_initialized) {
-            should_dump_output = settings().isFrameInRange(frame_count);
-            conditional_initialized = true;
-        }
-        return should_dump_output;
+        if (dump_settings == NULL) settings();
+        return should_dump_output.load(std::memory_order_relaxed);
     }
 
-    inline bool firstFunctionCallOnFrame() {
+    // Only used in vktracedump: counts a frame which is not formatted
+    inline void skipFrame() {
+        // The frame which ends was opened in the output if it is in range, by the part of the trace formatting it
+        has_printed_frame = has_printed_frame || settings().isFrameInRange(frame_count);
+        uint64_t frame = ++frame_count;
+
+        should_dump_output.store(settings().isFrameInRange(frame), std::memory_order_relaxed);
+        first_func_call_on_frame = true;
+    }
+
+    // Only used in vktracedump: opens the current frame in the output, after the frames before it were skipped
+    inline void startFrame() { settings().setupInterFrameOutputFormatting(frame_count, has_printed_frame); }
+
+    // Only used in vktracedump: carries on from where 'other' stopped, as if the calls it saw had been made here
+    inline void copyState(const ApiDumpInstance &other) {
+        frame_count = other.frame_count.load();
+        draw_call_count = other.draw_call_count;
+        cmd_buffer_pools = other.cmd_buffer_pools;
+        cmd_buffer_level = other.cmd_buffer_level;
+        object_name_map = other.object_name_map;
+        has_object_names = other.has_object_names.load();
+        should_dump_output = other.should_dump_output.load();
+        first_func_call_on_frame = other.first_func_call_on_frame;
+        need_func_comma = other.need_func_comma;
+        has_printed_frame = other.has_printed_frame;
+    }
+
+    // Only used by the JSON output: the separator from the previous call of the frame. The calls formatted into the
+    // buffer of their thread get it from endCallOutput(), when they are written in the order of the output.
+    inline void writeFuncSeparator(std::ostream &out) {
+        if (ApiDumpSettings::call_stream != NULL) return;
         if (first_func_call_on_frame) {
             first_func_call_on_frame = false;
-            return true;
+            need_func_comma = false;
         }
-        return false;
+        if (need_func_comma) out << ",\n";
+        need_func_comma = true;
     }
 
     inline std::recursive_mutex *outputMutex() { return &output_mutex; }
 
+    // The layer formats the text, HTML and JSON output of a call into a buffer of the calling thread, from the head to
+    // the body of the call, without holding the output mutex across the call down the chain. endCallOutput() writes the
+    // whole call to the stream at once.
+    inline void beginCallOutput() { ApiDumpSettings::call_stream = &call_output; }
+
+    // False if the head of the call was not formatted, because the frame was not in range
+    inline bool callOutputStarted() const { return ApiDumpSettings::call_stream != NULL; }
+
+    inline void endCallOutput() {
+        ApiDumpSettings::call_stream = NULL;
+        if (call_output.tellp() > 0) {
+            std::lock_guard<std::recursive_mutex> lg(output_mutex);
+            // Dropped if another thread ended the last frame in range since the head of the call
+            if (should_dump_output.load(std::memory_order_relaxed)) {
+                std::ostream &out = settings().stream();
+                if (settings().format() == ApiDumpFormat::Json) writeFuncSeparator(out);
+                out << call_output.rdbuf();
+                if (settings().shouldFlush()) out.flush();
+            }
+        }
+        call_output.str(std::string());
+        call_output.clear();
+    }
+
     inline const ApiDumpSettings &settings() {
-        if (dump_settings == NULL) dump_settings = new ApiDumpSettings();
+        if (dump_settings == NULL) {
+            dump_settings = new ApiDumpSettings();
+            startOutput();
+        }
 
         return *dump_settings;
     }
@@ -744,9 +1194,19 @@ class ApiDumpInstance {
             setLayerOption("lunarg_api_dump.log_filename", dump_file_name);
         }
         dump_settings = new ApiDumpSettings();
+        startOutput();
         return *dump_settings;
     }
 
+    // Opens frame 0 in a new output
+    inline void startOutput() {
+        should_dump_output = dump_settings->isFrameInRange(frame_count);
+        has_printed_frame = false;
+        if (dump_settings->isFrameInRange(0)) {
+            dump_settings->setupInterFrameOutputFormatting(0, has_printed_frame);
+        }
+    }
+
     uint32_t nextDrawcall() {
         return draw_call_count++;
     }
@@ -754,23 +1214,15 @@ class ApiDumpInstance {
     // Only used in vktracedump to print thread id in trace file
     void setThreadID(uint64_t trace_thread_id) { thread_id = trace_thread_id; }
 
+    // The threads are numbered in the order of their first call
     uint64_t threadID() {
         if (thread_id != UINT64_MAX) {
             return thread_id;
         }
-        std::thread::id this_id = std::this_thread::get_id();
-        std::lock_guard<std::recursive_mutex> lg(thread_mutex);
-
-        for (uint32_t i = 0; i < thread_count; ++i) {
-            if (thread_map[i] == this_id) {
-                return i;
-            }
+        if (thread_index == UINT64_MAX) {
+            thread_index = thread_count++;
         }
-
-        uint32_t new_index = thread_count;
-        thread_map[thread_count++] = this_id;
-        assert(thread_count < MAX_THREADS);
-        return new_index;
+        return thread_index;
     }
 
     inline VkCommandBufferLevel getCmdBufferLevel(VkCommandBuffer cmd_buffer) {
@@ -826,26 +1278,81 @@ class ApiDumpInstance {
     }
 
     inline std::chrono::microseconds current_time_since_start() {
+        if (call_time >= 0) {
+            return std::chrono::microseconds(call_time);
+        }
         std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
         return std::chrono::duration_cast<std::chrono::microseconds>(now - program_start);
     }
 
-    static inline ApiDumpInstance &current() { return current_instance; }
+    // Only used in api_dump_decode: the time printed for the call, instead of the current time
+    inline void setCallTime(int64_t time) { call_time = time; }
 
-    std::unordered_map<uint64_t, std::string> object_name_map;
+    // Binary output: the head of a call only takes its order and its time, which the body records with the parameters
+    inline void beginBinaryCall() {
+        binary_call.started = true;
+        binary_call.sequence = binary_sequence++;
+        binary_call.time = current_time_since_start().count();
+    }
+
+    // The encoder of the calling thread, with a record for 'function' begun. NULL if the head of the call was not
+    // recorded, when the frame is not in range.
+    inline ApiDumpBinaryEncoder *beginBinaryRecord(uint32_t function) {
+        if (!binary_call.started) return NULL;
+        binary_call.started = false;
+        if (binary_call.thread == UINT64_MAX) binary_call.thread = threadID();
+        ApiDumpBinaryEncoder &enc = settings().binaryWriter()->encoder();
+        enc.begin(function, binary_call.sequence, binary_call.thread, binary_call.time);
+        return &enc;
+    }
+
+    static inline ApiDumpInstance &current() { return thread_instance != NULL ? *thread_instance : current_instance; }
+
+    // Only used in vktracedump: the instance of the calling thread, NULL for the shared one
+    static inline void setThreadInstance(ApiDumpInstance *instance) { thread_instance = instance; }
+
+    // The names given with vkSetDebugUtilsObjectNameEXT and vkDebugMarkerSetObjectNameEXT. The calls are formatted on
+    // several threads, the names are looked up under their own mutex, and only once a name was given.
+    inline void setObjectName(uint64_t object, const char *name) {
+        std::lock_guard<std::mutex> lg(object_name_mutex);
+        if (name != NULL) {
+            object_name_map.insert(std::make_pair(object, std::string(name)));
+            has_object_names = true;
+        } else {
+            object_name_map.erase(object);
+        }
+    }
+
+    inline bool findObjectName(uint64_t object, std::string &name) {
+        if (!has_object_names.load(std::memory_order_acquire)) return false;
+        std::lock_guard<std::mutex> lg(object_name_mutex);
+        std::unordered_map<uint64_t, std::string>::const_iterator it = object_name_map.find(object);
+        if (it == object_name_map.end()) return false;
+        name = it->second;
+        return true;
+    }
 
    private:
     static ApiDumpInstance current_instance;
+    static thread_local ApiDumpInstance *thread_instance;
+
+    struct BinaryCall {
+        bool started;
+        uint64_t sequence;
+        int64_t time;
+        uint64_t thread;
+    };
+    static thread_local BinaryCall binary_call;
+    std::atomic<uint64_t> binary_sequence{0};
+    int64_t call_time = -1;
 
     ApiDumpSettings *dump_settings;
     std::recursive_mutex output_mutex;
-    std::recursive_mutex frame_mutex;
-    uint64_t frame_count;
+    std::atomic<uint64_t> frame_count;
+    static thread_local std::stringstream call_output;
 
-    static const size_t MAX_THREADS = 513;
-    std::recursive_mutex thread_mutex;
-    std::thread::id thread_map[MAX_THREADS];
-    uint32_t thread_count;
+    static std::atomic<uint64_t> thread_count;
+    static thread_local uint64_t thread_index;
     uint64_t thread_id = UINT64_MAX;
     uint32_t draw_call_count;
 
@@ -853,9 +1360,14 @@ class ApiDumpInstance {
     std::map<std::pair<VkDevice, VkCommandPool>, std::unordered_set<VkCommandBuffer> > cmd_buffer_pools;
     std::unordered_map<VkCommandBuffer, VkCommandBufferLevel> cmd_buffer_level;
 
-    bool conditional_initialized = false;
-    bool should_dump_output = true;
+    std::mutex object_name_mutex;
+    std::unordered_map<uint64_t, std::string> object_name_map;
+    std::atomic<bool> has_object_names{false};
+
+    std::atomic<bool> should_dump_output{true};
     bool first_func_call_on_frame = false;
+    bool need_func_comma = false;
+    bool has_printed_frame = false;  // Only used by the JSON output: a frame was opened, the next one needs a separator
 
     std::chrono::system_clock::time_point program_start;
 };
@@ -876,6 +1388,11 @@ void OutputAddress(const ApiDumpSettings &settings, const void *addr, bool quote
 }
 
 ApiDumpInstance ApiDumpInstance::current_instance;
+thread_local ApiDumpInstance *ApiDumpInstance::thread_instance = NULL;
+thread_local ApiDumpInstance::BinaryCall ApiDumpInstance::binary_call = {false, 0, 0, UINT64_MAX};
+thread_local std::stringstream ApiDumpInstance::call_output;
+std::atomic<uint64_t> ApiDumpInstance::thread_count(0);
+thread_local uint64_t ApiDumpInstance::thread_index = UINT64_MAX;
 
 //==================================== Text Backend Helpers ======================================//
 
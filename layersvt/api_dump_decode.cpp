@@ -0,0 +1,209 @@
+/*
+ * (C) COPYRIGHT 2020 ARM Limited
+ * ALL RIGHTS RESERVED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Writes the binary output of the api_dump layer as text, HTML or JSON, with the same printers as the layer. The other
+// settings of the output (detailed, no_addr, output_range, timestamp...) are read like in the layer, from
+// vk_layer_settings.txt and the VK_APIDUMP_* environment variables.
+
+#include "api_dump_binary.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+struct DecodeRecord {
+    uint64_t sequence;
+    size_t offset;
+};
+
+static void print_usage() {
+    fprintf(stderr, "Usage: api_dump_decode [-o <output file>] [-f text|html|json] <vk_apidump.bin>\n");
+    fprintf(stderr, "  -o <output file>  File to write, the output goes to stdout without it\n");
+    fprintf(stderr, "  -f <format>       Output format, text by default\n");
+}
+
+static void set_env_var(const char *name, const char *value) {
+#if defined(_WIN32)
+    _putenv_s(name, value);
+#else
+    if (value[0] != '\0') {
+        setenv(name, value, 1);
+    } else {
+        unsetenv(name);
+    }
+#endif
+}
+
+static bool read_file(const char *filename, std::vector<uint8_t> &data) {
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    uint8_t chunk[65536];
+    size_t count;
+    while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        data.insert(data.end(), chunk, chunk + count);
+    }
+    bool ok = ferror(file) == 0;
+    fclose(file);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    const char *input = NULL;
+    const char *output = NULL;
+    std::string format = "text";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (arg == "-f" && i + 1 < argc) {
+            format = argv[++i];
+        } else if (arg[0] != '-' && input == NULL) {
+            input = argv[i];
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+    if (input == NULL || (format != "text" && format != "html" && format != "json")) {
+        print_usage();
+        return 1;
+    }
+
+    std::vector<uint8_t> file;
+    if (!read_file(input, file)) {
+        fprintf(stderr, "Failed to read %s\n", input);
+        return 1;
+    }
+    ApiDumpBinaryFileHeader file_header;
+    if (file.size() < sizeof(file_header)) {
+        fprintf(stderr, "%s is not an api_dump binary file\n", input);
+        return 1;
+    }
+    memcpy(&file_header, file.data(), sizeof(file_header));
+    if (memcmp(file_header.magic, API_DUMP_BINARY_MAGIC, sizeof(file_header.magic)) != 0) {
+        fprintf(stderr, "%s is not an api_dump binary file\n", input);
+        return 1;
+    }
+    if (file_header.version != API_DUMP_BINARY_VERSION) {
+        fprintf(stderr, "%s has version %u of the binary format, only version %u is supported\n", input, file_header.version,
+                API_DUMP_BINARY_VERSION);
+        return 1;
+    }
+    if (file_header.pointer_size != sizeof(void *)) {
+        fprintf(stderr, "%s was written by a %u-bit layer, it must be decoded by a %u-bit api_dump_decode\n", input,
+                file_header.pointer_size * 8, (uint32_t)sizeof(void *) * 8);
+        return 1;
+    }
+    if (file_header.header_version != VK_HEADER_VERSION) {
+        fprintf(stderr, "Warning: %s was written with Vulkan headers version %u, api_dump_decode was built with version %u\n",
+                input, file_header.header_version, VK_HEADER_VERSION);
+    }
+
+    // The threads of the layer write their records in blocks, the calls are put back in order by their sequence number
+    std::vector<DecodeRecord> records;
+    size_t offset = sizeof(file_header);
+    while (offset + sizeof(ApiDumpBinaryRecordHeader) <= file.size()) {
+        ApiDumpBinaryRecordHeader header;
+        memcpy(&header, &file[offset], sizeof(header));
+        uint64_t needed = sizeof(header) + (uint64_t)header.data_size + (uint64_t)header.pointer_count * sizeof(ApiDumpBinaryPointer);
+        if (header.size < needed || header.size > file.size() - offset) {
+            break;
+        }
+        records.push_back({header.sequence, offset});
+        offset += header.size;
+    }
+    if (offset != file.size()) {
+        fprintf(stderr, "Warning: %s is truncated or corrupted after %zu records\n", input, records.size());
+    }
+    std::stable_sort(records.begin(), records.end(),
+                     [](const DecodeRecord &a, const DecodeRecord &b) { return a.sequence < b.sequence; });
+
+    setLayerOption("lunarg_api_dump.output_format", format.c_str());
+    set_env_var(API_DUMP_ENV_VAR_OUTPUT_FMT, format.c_str());
+    if (output != NULL) {
+        setLayerOption("lunarg_api_dump.file", "TRUE");
+        setLayerOption("lunarg_api_dump.log_filename", output);
+        set_env_var(API_DUMP_ENV_VAR_LOG_FILE, output);
+    } else {
+        setLayerOption("lunarg_api_dump.file", "FALSE");
+        set_env_var(API_DUMP_ENV_VAR_LOG_FILE, "");
+    }
+    ApiDumpInstance &dump_inst = ApiDumpInstance::current();
+    dump_inst.settings();
+
+    std::vector<uint64_t> data;
+    uint64_t unknown = 0;
+    uint64_t corrupted = 0;
+    for (const DecodeRecord &record : records) {
+        ApiDumpBinaryRecordHeader header;
+        memcpy(&header, &file[record.offset], sizeof(header));
+        if (header.function == API_DUMP_BINARY_FRAME) {
+            dump_inst.nextFrame();
+            continue;
+        }
+
+        // The pointers were written as offsets from the start of the data, they become addresses in the copy
+        data.assign(header.data_size / sizeof(uint64_t) + 1, 0);
+        uint8_t *base = (uint8_t *)data.data();
+        memcpy(base, &file[record.offset + sizeof(header)], header.data_size);
+        const uint8_t *pointers = &file[record.offset + sizeof(header) + header.data_size];
+        bool valid = true;
+        for (uint32_t i = 0; i < header.pointer_count && valid; i++) {
+            ApiDumpBinaryPointer pointer;
+            memcpy(&pointer, pointers + i * sizeof(pointer), sizeof(pointer));
+            uintptr_t target;
+            if ((uint64_t)pointer.field + sizeof(target) > header.data_size) {
+                valid = false;
+                break;
+            }
+            // The whole object must be in the data, not only its start
+            memcpy(&target, base + pointer.field, sizeof(target));
+            if ((uint64_t)target + pointer.size > header.data_size) {
+                valid = false;
+                break;
+            }
+            if (target != 0) {
+                target = (uintptr_t)(base + target);
+                memcpy(base + pointer.field, &target, sizeof(target));
+            }
+        }
+        if (!valid) {
+            corrupted++;
+            continue;
+        }
+
+        dump_inst.setThreadID(header.thread);
+        dump_inst.setCallTime(header.time);
+        if (!dump_binary_record(dump_inst, header.function, base, header.data_size)) {
+            unknown++;
+        }
+    }
+
+    if (unknown > 0) {
+        fprintf(stderr, "Warning: %" PRIu64 " calls of unknown functions were skipped, was the layer built with other Vulkan headers?\n",
+                unknown);
+    }
+    if (corrupted > 0) {
+        fprintf(stderr, "Warning: %" PRIu64 " corrupted records were skipped\n", corrupted);
+    }
+    return 0;
+}
@@ -53,6 +53,14 @@
 #include <mutex>
 #include <sstream>
 
+#if !defined(_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include <json/json.h>  // https://github.com/open-source-parsers/jsoncpp
 
 #include "vulkan/vk_layer.h"
@@ -75,6 +83,7 @@ struct StringSetting {
 };
 
 struct StringSetting inputFilename;
+struct StringSetting cacheDirectory;
 
 #if defined(__ANDROID__)
 #include <android/log.h>
@@ -155,8 +164,11 @@ void AndroidPrintf(VkLogLevel level, const char *fmt, va_list args) {
 struct IntSetting debugLevel;
 struct IntSetting errorLevel;
 
+// Set while compiling a profile, which loads the same JSON again and would repeat its messages.
+bool quietOutput = false;
+
 void DebugPrintf(const char *fmt, ...) {
-    if (debugLevel.num > 0) {
+    if (debugLevel.num > 0 && !quietOutput) {
 #if !defined(__ANDROID__)
         printf("\tDEBUG devsim ");
 #endif
@@ -172,6 +184,9 @@ void DebugPrintf(const char *fmt, ...) {
 }
 
 void ErrorPrintf(const char *fmt, ...) {
+    if (quietOutput) {
+        return;
+    }
 #if !defined(__ANDROID__)
     fprintf(stderr, "\tERROR devsim ");
 #endif
@@ -422,11 +437,13 @@ const char *const kEnvarDevsimFilename = "debug.vulkan.devsim.filepath";
 const char *const kEnvarDevsimDebugEnable = "debug.vulkan.devsim.debugenable";  // a non-zero integer will enable debugging output.
 const char *const kEnvarDevsimExitOnError = "debug.vulkan.devsim.exitonerror";  // a non-zero integer will enable exit-on-error.
 const char *const kEnvarDevsimCompatMode = "debug.vulkan.devsim.compatmode";    // a non-zero integer will enable compatible mode.
+const char *const kEnvarDevsimCacheDir = "debug.vulkan.devsim.cachedir";        // directory of the compiled profiles, "none" to disable.
 #else
 const char *const kEnvarDevsimFilename = "VK_DEVSIM_FILENAME";          // path of the configuration file(s) to load.
 const char *const kEnvarDevsimDebugEnable = "VK_DEVSIM_DEBUG_ENABLE";   // a non-zero integer will enable debugging output.
 const char *const kEnvarDevsimExitOnError = "VK_DEVSIM_EXIT_ON_ERROR";  // a non-zero integer will enable exit-on-error.
 const char *const kEnvarDevsimCompatMode = "VK_DEVSIM_COMPAT_MODE";     // a non-zero integer will enable compatible mode.
+const char *const kEnvarDevsimCacheDir = "VK_DEVSIM_CACHE_DIR";         // directory of the compiled profiles, "none" to disable.
 #endif
 
 const char *const kLayerSettingsDevsimFilename =
@@ -435,6 +452,8 @@ const char *const kLayerSettingsDevsimDebugEnable =
     "lunarg_device_simulation.debug_enable";  // vk_layer_settings.txt equivalent for kEnvarDevsimDebugEnable
 const char *const kLayerSettingsDevsimExitOnError =
     "lunarg_device_simulation.exit_on_error";  // vk_layer_settings.txt equivalent for kEnvarDevsimExitOnError
+const char *const kLayerSettingsDevsimCacheDir =
+    "lunarg_device_simulation.cache_dir";  // vk_layer_settings.txt equivalent for kEnvarDevsimCacheDir
 
 // Get all elements from a vkEnumerate*() lambda into a std::vector.
 template <typename T>
@@ -505,6 +524,17 @@ class PhysicalDeviceData {
         return (iter != map_.end()) ? &iter->second : nullptr;
     }
 
+    // Create a PDD which doesn't belong to any physical device, with every byte of the structures a profile can patch set to fill.
+    // Comparing two of them after loading the same JSON shows which bytes the JSON sets, see JsonLoader::CompileProfile().
+    static PhysicalDeviceData CreateProbe(uint8_t fill) {
+        PhysicalDeviceData pdd(VK_NULL_HANDLE);
+        memset(&pdd.physical_device_properties_, fill, sizeof(pdd.physical_device_properties_));
+        memset(&pdd.physical_device_features_, fill, sizeof(pdd.physical_device_features_));
+        memset(&pdd.physical_device_memory_properties_, fill, sizeof(pdd.physical_device_memory_properties_));
+        memset(&pdd.mapof_extended_properties_[VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES], fill, sizeof(ExtendedProperty));
+        return pdd;
+    }
+
     VkInstance instance() const { return instance_; }
 
     VkPhysicalDeviceProperties physical_device_properties_;
@@ -534,6 +564,118 @@ class PhysicalDeviceData {
 
 PhysicalDeviceData::Map PhysicalDeviceData::map_;
 
+// Compiled DevSim profiles //////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Parsing a large JSON configuration file takes much longer than applying it, and happens in every vkCreateInstance().  So each
+// validated file is compiled once into a binary profile, named after the hash of the JSON, in the cache directory.  Later runs
+// mmap the profile and copy its contents into the PDD instead of parsing the JSON.  A profile holds:
+// * for the structures where only the values present in the JSON are applied, the runs of bytes the JSON sets;
+// * for the "ArrayOf" and extended sections, the arrays which replace the previous contents.
+// Records are in the order JsonLoader::LoadDocument() applies the sections.
+
+const char kProfileMagic[8] = {'D', 'E', 'V', 'S', 'I', 'M', 'B', 'P'};
+const uint32_t kProfileFormatVersion = 1;
+
+enum ProfileRecordType : uint32_t {
+    kProfilePhysicalDeviceProperties = 1,  // ProfileRun list
+    kProfileSubgroupProperties,            // ProfileRun list
+    kProfilePhysicalDeviceFeatures,        // ProfileRun list
+    kProfileMemoryProperties,              // ProfileRun list
+    kProfileQueueFamilies,                 // VkQueueFamilyProperties array
+    kProfileFormats,                       // ProfileFormat array
+    kProfileLayers,                        // VkLayerProperties array
+    kProfileExtensions,                    // VkExtensionProperties array
+    kProfileExtendedFeatures,              // ProfileExtendedFeature array
+    kProfileExtendedProperties,            // ProfileExtendedProperty array
+};
+
+struct ProfileHeader {
+    char magic[8];
+    uint32_t format_version;  // kProfileFormatVersion
+    uint32_t layer_version;   // kVersionDevsimImplementation
+    uint32_t header_version;  // VK_HEADER_VERSION, the offsets in the runs depend on it
+    uint32_t pointer_size;
+    uint64_t json_size;
+    uint64_t json_hash;
+    uint32_t record_count;
+    uint32_t reserved;
+    uint64_t data_hash;  // of the records, to catch a damaged file
+};
+
+struct ProfileRecord {
+    uint32_t type;   // ProfileRecordType
+    uint32_t count;  // number of runs or array elements
+    uint64_t size;   // bytes of data following the record
+};
+
+// Followed by size bytes to copy at offset in the structure, padded to 8 bytes.
+struct ProfileRun {
+    uint32_t offset;
+    uint32_t size;
+};
+
+struct ProfileFormat {
+    uint32_t format;
+    VkFormatProperties properties;
+};
+
+struct ProfileExtendedFeature {
+    uint64_t stype;
+    ExtendedFeature feature;
+};
+
+struct ProfileExtendedProperty {
+    uint64_t stype;
+    ExtendedProperty property;
+};
+
+// FNV-1a, enough to tell configuration files apart.
+uint64_t HashBytes(const char *data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ static_cast<uint8_t>(data[i])) * 1099511628211ull;
+    }
+    return hash;
+}
+
+void AppendBytes(std::vector<uint8_t> *dest, const void *src, size_t size) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(src);
+    dest->insert(dest->end(), bytes, bytes + size);
+    dest->resize((dest->size() + 7) & ~static_cast<size_t>(7), 0);
+}
+
+// Append a record of the runs of bytes which are the same in both probes, i.e. which the JSON has set.
+void AppendPatch(std::vector<uint8_t> *profile, ProfileRecordType type, const void *probe0, const void *probe1, size_t size) {
+    const uint8_t *a = static_cast<const uint8_t *>(probe0);
+    const uint8_t *b = static_cast<const uint8_t *>(probe1);
+    std::vector<uint8_t> data;
+    uint32_t count = 0;
+    for (size_t i = 0; i < size;) {
+        if (a[i] != b[i]) {
+            ++i;
+            continue;
+        }
+        const size_t start = i;
+        while (i < size && a[i] == b[i]) {
+            ++i;
+        }
+        const ProfileRun run = {static_cast<uint32_t>(start), static_cast<uint32_t>(i - start)};
+        AppendBytes(&data, &run, sizeof(run));
+        AppendBytes(&data, a + start, run.size);
+        ++count;
+    }
+    const ProfileRecord record = {type, count, data.size()};
+    AppendBytes(profile, &record, sizeof(record));
+    profile->insert(profile->end(), data.begin(), data.end());
+}
+
+template <typename T>
+void AppendArray(std::vector<uint8_t> *profile, ProfileRecordType type, const std::vector<T> &elements) {
+    const ProfileRecord record = {type, static_cast<uint32_t>(elements.size()), elements.size() * sizeof(T)};
+    AppendBytes(profile, &record, sizeof(record));
+    AppendBytes(profile, elements.data(), elements.size() * sizeof(T));
+}
+
 // Loader for DevSim JSON configuration files ////////////////////////////////////////////////////////////////////////////////////
 
 class JsonLoader {
@@ -553,6 +695,26 @@ class JsonLoader {
         kDevsim100,
     };
 
+    // The sections of a document which replace the previous contents rather than override single values.
+    struct ReplacedSections {
+        bool queue_families = false;
+        bool formats = false;
+        bool layers = false;
+        bool extensions = false;
+        bool extended_features = false;
+        bool extended_properties = false;
+    };
+
+    bool LoadDocument(const Json::Value &root, ReplacedSections *replaced);
+    static bool ValidateDocument(const Json::Value &root);
+    static bool CompileProfile(const Json::Value &root, uint64_t json_size, uint64_t json_hash, std::vector<uint8_t> *profile);
+    static bool ApplyProfile(const uint8_t *data, size_t size, uint64_t json_size, uint64_t json_hash, PhysicalDeviceData &pdd,
+                             bool *sets_memory_types);
+    bool LoadProfile(const std::string &path, uint64_t json_size, uint64_t json_hash);
+    void WarnProfileChanges(const VkPhysicalDeviceLimits &old_limits, const VkPhysicalDeviceMemoryProperties &old_memory,
+                            bool sets_memory_types) const;
+    static bool StoreProfile(const std::string &path, const std::vector<uint8_t> &profile);
+
     SchemaId IdentifySchema(const Json::Value &value);
     void GetValue(const Json::Value &parent, const char *name, VkPhysicalDeviceProperties *dest);
     void GetValue(const Json::Value &parent, const char *name, VkPhysicalDeviceSubgroupProperties *dest);
@@ -883,22 +1045,48 @@ bool JsonLoader::LoadFiles(const char *filename_list) {
     return true;
 }
 
+// The compiled profile of a JSON file with the given hash, or an empty string if profiles are disabled.
+static std::string ProfilePath(uint64_t json_hash) {
+#if defined(_WIN32)
+    (void)json_hash;
+    return "";
+#else
+    if (cacheDirectory.str.empty() || cacheDirectory.str == "none") {
+        return "";
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "/%016" PRIx64 ".devsim", json_hash);
+    return cacheDirectory.str + name;
+#endif
+}
+
 bool JsonLoader::LoadFile(const char *filename) {
-    std::ifstream json_file(filename);
+    std::ifstream json_file(filename, std::ios::binary);
     if (!json_file) {
         ErrorPrintf("JsonLoader failed to open file \"%s\"\n", filename);
         return false;
     }
 
     DebugPrintf("JsonLoader::LoadFile(\"%s\")\n", filename);
+    std::stringstream json_stream;
+    json_stream << json_file.rdbuf();
+    json_file.close();
+    const std::string json_text = json_stream.str();
+    const uint64_t json_hash = HashBytes(json_text.data(), json_text.size());
+
+    const std::string profile_path = ProfilePath(json_hash);
+    if (!profile_path.empty() && LoadProfile(profile_path, json_text.size(), json_hash)) {
+        DebugPrintf("\tLoaded compiled profile \"%s\"\n", profile_path.c_str());
+        return true;
+    }
+
     Json::Reader reader;
     Json::Value root = Json::nullValue;
-    bool success = reader.parse(json_file, root, false);
+    bool success = reader.parse(json_text.data(), json_text.data() + json_text.size(), root, false);
     if (!success) {
         ErrorPrintf("Json::Reader failed {\n%s}\n", reader.getFormattedErrorMessages().c_str());
         return false;
     }
-    json_file.close();
 
     if (root.type() != Json::objectValue) {
         ErrorPrintf("Json document root is not an object\n");
@@ -906,6 +1094,21 @@ bool JsonLoader::LoadFile(const char *filename) {
     }
 
     DebugPrintf("{\n");
+    const bool result = LoadDocument(root, nullptr);
+    DebugPrintf("}\n");
+
+    if (result && !profile_path.empty() && ValidateDocument(root)) {
+        std::vector<uint8_t> profile;
+        if (CompileProfile(root, json_text.size(), json_hash, &profile) && StoreProfile(profile_path, profile)) {
+            DebugPrintf("\tCompiled profile \"%s\"\n", profile_path.c_str());
+        }
+    }
+
+    return result;
+}
+
+bool JsonLoader::LoadDocument(const Json::Value &root, ReplacedSections *replaced) {
+    ReplacedSections sections;
     bool result = false;
     const Json::Value schema_value = root["$schema"];
     const SchemaId schema_id = IdentifySchema(schema_value);
@@ -915,12 +1118,12 @@ bool JsonLoader::LoadFile(const char *filename) {
             GetValue(root["VkPhysicalDeviceProperties"], "subgroupProperties", &pdd_.mapof_extended_properties_[VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES].physical_device_subgroup_prop);
             GetValue(root, "VkPhysicalDeviceFeatures", &pdd_.physical_device_features_);
             GetValue(root, "VkPhysicalDeviceMemoryProperties", &pdd_.physical_device_memory_properties_);
-            GetArray(root, "ArrayOfVkQueueFamilyProperties", &pdd_.arrayof_queue_family_properties_);
-            GetArray(root, "ArrayOfVkFormatProperties", &pdd_.arrayof_format_properties_);
-            GetArray(root, "ArrayOfVkLayerProperties", &pdd_.arrayof_layer_properties_);
-            GetArray(root, "ArrayOfVkExtensionProperties", &pdd_.arrayof_ext_properties_);
-            GetExtendedFeatures(root, &pdd_.mapof_extended_features_);
-            GetExtendedProperties(root, &pdd_.mapof_extended_properties_);
+            sections.queue_families = GetArray(root, "ArrayOfVkQueueFamilyProperties", &pdd_.arrayof_queue_family_properties_) >= 0;
+            sections.formats = GetArray(root, "ArrayOfVkFormatProperties", &pdd_.arrayof_format_properties_) >= 0;
+            sections.layers = GetArray(root, "ArrayOfVkLayerProperties", &pdd_.arrayof_layer_properties_) >= 0;
+            sections.extensions = GetArray(root, "ArrayOfVkExtensionProperties", &pdd_.arrayof_ext_properties_) >= 0;
+            sections.extended_features = GetExtendedFeatures(root, &pdd_.mapof_extended_features_) >= 0;
+            sections.extended_properties = GetExtendedProperties(root, &pdd_.mapof_extended_properties_) >= 0;
             result = true;
             break;
 
@@ -928,9 +1131,439 @@ bool JsonLoader::LoadFile(const char *filename) {
         default:
             break;
     }
-    DebugPrintf("}\n");
+    if (replaced) {
+        *replaced = sections;
+    }
+    return result;
+}
+
+// Checks the parts of the DevSim schema which, if broken, would make the loader write past the end of a Vulkan structure.  The
+// JSON loader trusts the file was validated separately, but a compiled profile is reused without looking at the JSON again.
+bool JsonLoader::ValidateDocument(const Json::Value &root) {
+    bool valid = true;
+    auto check_object = [&](const Json::Value &value, const char *name) {
+        if (!value.isNull() && !value.isObject()) {
+            DebugPrintf("WARN \"%s\" is not an object\n", name);
+            valid = false;
+        }
+    };
+    auto check_array = [&](const Json::Value &parent, const char *name, Json::ArrayIndex max_size) {
+        const Json::Value &value = parent[name];
+        if (!value.isNull() && (!value.isArray() || value.size() > max_size)) {
+            DebugPrintf("WARN \"%s\" is not an array of at most %u elements\n", name, max_size);
+            valid = false;
+        }
+    };
+    auto check_string = [&](const Json::Value &parent, const char *name, size_t max_size) {
+        const Json::Value &value = parent[name];
+        if (!value.isNull() && (!value.isString() || strlen(value.asCString()) >= max_size)) {
+            DebugPrintf("WARN \"%s\" is not a string shorter than %u characters\n", name, static_cast<unsigned>(max_size));
+            valid = false;
+        }
+    };
+    auto check_elements = [&](const Json::Value &parent, const char *name, std::function<void(const Json::Value &)> check) {
+        const Json::Value &value = parent[name];
+        if (value.isNull()) {
+            return;
+        }
+        if (!value.isArray()) {
+            DebugPrintf("WARN \"%s\" is not an array\n", name);
+            valid = false;
+            return;
+        }
+        for (const Json::Value &element : value) {
+            check_object(element, name);
+            if (element.isObject()) {
+                check(element);
+            }
+        }
+    };
+
+    const Json::Value &properties = root["VkPhysicalDeviceProperties"];
+    check_object(properties, "VkPhysicalDeviceProperties");
+    if (properties.isObject()) {
+        check_string(properties, "deviceName", VK_MAX_PHYSICAL_DEVICE_NAME_SIZE);
+        check_array(properties, "pipelineCacheUUID", VK_UUID_SIZE);
+        check_object(properties["subgroupProperties"], "subgroupProperties");
+        const Json::Value &limits = properties["limits"];
+        check_object(limits, "limits");
+        if (limits.isObject()) {
+            check_array(limits, "maxComputeWorkGroupCount", 3);
+            check_array(limits, "maxComputeWorkGroupSize", 3);
+            check_array(limits, "maxViewportDimensions", 2);
+            check_array(limits, "viewportBoundsRange", 2);
+            check_array(limits, "pointSizeRange", 2);
+            check_array(limits, "lineWidthRange", 2);
+        }
+        check_object(properties["sparseProperties"], "sparseProperties");
+    }
+    check_object(root["VkPhysicalDeviceFeatures"], "VkPhysicalDeviceFeatures");
+    const Json::Value &memory = root["VkPhysicalDeviceMemoryProperties"];
+    check_object(memory, "VkPhysicalDeviceMemoryProperties");
+    if (memory.isObject()) {
+        check_array(memory, "memoryHeaps", VK_MAX_MEMORY_HEAPS);
+        check_array(memory, "memoryTypes", VK_MAX_MEMORY_TYPES);
+    }
+    check_elements(root, "ArrayOfVkQueueFamilyProperties", [&](const Json::Value &element) {
+        check_object(element["minImageTransferGranularity"], "minImageTransferGranularity");
+    });
+    check_elements(root, "ArrayOfVkFormatProperties", [&](const Json::Value &) {});
+    check_elements(root, "ArrayOfVkLayerProperties", [&](const Json::Value &element) {
+        check_string(element, "layerName", VK_MAX_EXTENSION_NAME_SIZE);
+        check_string(element, "description", VK_MAX_DESCRIPTION_SIZE);
+    });
+    check_elements(root, "ArrayOfVkExtensionProperties", [&](const Json::Value &element) {
+        check_string(element, "extensionName", VK_MAX_EXTENSION_NAME_SIZE);
+    });
+    const Json::Value &extended = root["extended"];
+    check_object(extended, "extended");
+    if (extended.isObject()) {
+        auto check_extended = [&](const Json::Value &element) { check_string(element, "extension", VK_MAX_EXTENSION_NAME_SIZE); };
+        check_elements(extended, "devicefeatures2", check_extended);
+        check_elements(extended, "deviceproperties2", check_extended);
+    }
+    return valid;
+}
 
+// Loads the document into two probes filled with different bytes: whatever the JSON sets ends up the same in both.
+bool JsonLoader::CompileProfile(const Json::Value &root, uint64_t json_size, uint64_t json_hash, std::vector<uint8_t> *profile) {
+    PhysicalDeviceData probes[2] = {PhysicalDeviceData::CreateProbe(0x00), PhysicalDeviceData::CreateProbe(0xff)};
+    ReplacedSections replaced[2];
+    bool loaded = true;
+    quietOutput = true;
+    for (int i = 0; i < 2; ++i) {
+        JsonLoader loader(probes[i]);
+        loaded = loader.LoadDocument(root, &replaced[i]) && loaded;
+    }
+    quietOutput = false;
+    if (!loaded) {
+        return false;
+    }
+    const PhysicalDeviceData &pdd = probes[0];
+    const ReplacedSections &sections = replaced[0];
+    uint32_t record_count = 0;
+
+    ProfileHeader header = {};
+    memcpy(header.magic, kProfileMagic, sizeof(header.magic));
+    header.format_version = kProfileFormatVersion;
+    header.layer_version = kVersionDevsimImplementation;
+    header.header_version = VK_HEADER_VERSION;
+    header.pointer_size = sizeof(void *);
+    header.json_size = json_size;
+    header.json_hash = json_hash;
+    profile->clear();
+    AppendBytes(profile, &header, sizeof(header));
+
+    AppendPatch(profile, kProfilePhysicalDeviceProperties, &probes[0].physical_device_properties_,
+                &probes[1].physical_device_properties_, sizeof(VkPhysicalDeviceProperties));
+    ++record_count;
+    if (!sections.extended_properties) {  // otherwise the subgroup properties are replaced below
+        const VkStructureType stype = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+        AppendPatch(profile, kProfileSubgroupProperties, &probes[0].mapof_extended_properties_[stype],
+                    &probes[1].mapof_extended_properties_[stype], sizeof(ExtendedProperty));
+        ++record_count;
+    }
+    AppendPatch(profile, kProfilePhysicalDeviceFeatures, &probes[0].physical_device_features_,
+                &probes[1].physical_device_features_, sizeof(VkPhysicalDeviceFeatures));
+    ++record_count;
+    AppendPatch(profile, kProfileMemoryProperties, &probes[0].physical_device_memory_properties_,
+                &probes[1].physical_device_memory_properties_, sizeof(VkPhysicalDeviceMemoryProperties));
+    ++record_count;
+    if (sections.queue_families) {
+        AppendArray(profile, kProfileQueueFamilies, pdd.arrayof_queue_family_properties_);
+        ++record_count;
+    }
+    if (sections.formats) {
+        std::vector<ProfileFormat> formats;
+        for (const auto &format : pdd.arrayof_format_properties_) {
+            formats.push_back({format.first, format.second});
+        }
+        AppendArray(profile, kProfileFormats, formats);
+        ++record_count;
+    }
+    if (sections.layers) {
+        AppendArray(profile, kProfileLayers, pdd.arrayof_layer_properties_);
+        ++record_count;
+    }
+    if (sections.extensions) {
+        AppendArray(profile, kProfileExtensions, pdd.arrayof_ext_properties_);
+        ++record_count;
+    }
+    if (sections.extended_features) {
+        std::vector<ProfileExtendedFeature> features;
+        for (const auto &feature : pdd.mapof_extended_features_) {
+            features.push_back({feature.first, feature.second});
+        }
+        AppendArray(profile, kProfileExtendedFeatures, features);
+        ++record_count;
+    }
+    if (sections.extended_properties) {
+        std::vector<ProfileExtendedProperty> properties;
+        for (const auto &property : pdd.mapof_extended_properties_) {
+            properties.push_back({property.first, property.second});
+        }
+        AppendArray(profile, kProfileExtendedProperties, properties);
+        ++record_count;
+    }
+
+    header.record_count = record_count;
+    header.data_hash = HashBytes(reinterpret_cast<const char *>(profile->data()) + sizeof(header), profile->size() - sizeof(header));
+    memcpy(profile->data(), &header, sizeof(header));
+    return true;
+}
+
+template <typename T>
+static bool ReadArray(const uint8_t *data, const ProfileRecord &record, std::vector<T> *elements) {
+    if (record.size != static_cast<uint64_t>(record.count) * sizeof(T)) {
+        return false;
+    }
+    elements->resize(record.count);
+    memcpy(elements->data(), data, record.size);
+    return true;
+}
+
+// Applies a profile to pdd.  The profile is checked completely before anything is applied, so a damaged file leaves pdd untouched.
+// sets_memory_types tells if the JSON has memory types, the JSON loader checks their heap indices then.
+bool JsonLoader::ApplyProfile(const uint8_t *data, size_t size, uint64_t json_size, uint64_t json_hash, PhysicalDeviceData &pdd,
+                              bool *sets_memory_types) {
+    *sets_memory_types = false;
+    ProfileHeader header;
+    if (size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, kProfileMagic, sizeof(header.magic)) != 0 || header.format_version != kProfileFormatVersion ||
+        header.layer_version != kVersionDevsimImplementation || header.header_version != VK_HEADER_VERSION ||
+        header.pointer_size != sizeof(void *) || header.json_size != json_size || header.json_hash != json_hash ||
+        header.data_hash != HashBytes(reinterpret_cast<const char *>(data) + sizeof(header), size - sizeof(header))) {
+        return false;
+    }
+
+    for (int pass = 0; pass < 2; ++pass) {
+        const bool apply = pass == 1;
+        size_t offset = sizeof(header);
+        for (uint32_t r = 0; r < header.record_count; ++r) {
+            ProfileRecord record;
+            if (size - offset < sizeof(record)) {
+                return false;
+            }
+            memcpy(&record, data + offset, sizeof(record));
+            offset += sizeof(record);
+            const uint64_t padded_size = (record.size + 7) & ~static_cast<uint64_t>(7);
+            if (record.size > size - offset || padded_size > size - offset) {
+                return false;
+            }
+            const uint8_t *record_data = data + offset;
+            offset += padded_size;
+
+            uint8_t *target = nullptr;
+            size_t target_size = 0;
+            switch (record.type) {
+                case kProfilePhysicalDeviceProperties:
+                    target = reinterpret_cast<uint8_t *>(&pdd.physical_device_properties_);
+                    target_size = sizeof(pdd.physical_device_properties_);
+                    break;
+                case kProfileSubgroupProperties:
+                    target_size = sizeof(ExtendedProperty);
+                    if (apply) {
+                        target = reinterpret_cast<uint8_t *>(
+                            &pdd.mapof_extended_properties_[VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES]);
+                    }
+                    break;
+                case kProfilePhysicalDeviceFeatures:
+                    target = reinterpret_cast<uint8_t *>(&pdd.physical_device_features_);
+                    target_size = sizeof(pdd.physical_device_features_);
+                    break;
+                case kProfileMemoryProperties:
+                    target = reinterpret_cast<uint8_t *>(&pdd.physical_device_memory_properties_);
+                    target_size = sizeof(pdd.physical_device_memory_properties_);
+                    break;
+                case kProfileQueueFamilies: {
+                    ArrayOfVkQueueFamilyProperties queue_families;
+                    if (!ReadArray(record_data, record, &queue_families)) return false;
+                    if (apply) pdd.arrayof_queue_family_properties_ = queue_families;
+                    continue;
+                }
+                case kProfileFormats: {
+                    std::vector<ProfileFormat> formats;
+                    if (!ReadArray(record_data, record, &formats)) return false;
+                    if (apply) {
+                        pdd.arrayof_format_properties_.clear();
+                        for (const ProfileFormat &format : formats) {
+                            pdd.arrayof_format_properties_.insert({format.format, format.properties});
+                        }
+                    }
+                    continue;
+                }
+                case kProfileLayers: {
+                    ArrayOfVkLayerProperties layers;
+                    if (!ReadArray(record_data, record, &layers)) return false;
+                    if (apply) pdd.arrayof_layer_properties_ = layers;
+                    continue;
+                }
+                case kProfileExtensions: {
+                    ArrayOfVkExtensionProperties extensions;
+                    if (!ReadArray(record_data, record, &extensions)) return false;
+                    if (apply) pdd.arrayof_ext_properties_ = extensions;
+                    continue;
+                }
+                case kProfileExtendedFeatures: {
+                    std::vector<ProfileExtendedFeature> features;
+                    if (!ReadArray(record_data, record, &features)) return false;
+                    if (apply) {
+                        pdd.mapof_extended_features_.clear();
+                        for (const ProfileExtendedFeature &feature : features) {
+                            pdd.mapof_extended_features_[static_cast<uint32_t>(feature.stype)] = feature.feature;
+                        }
+                    }
+                    continue;
+                }
+                case kProfileExtendedProperties: {
+                    std::vector<ProfileExtendedProperty> properties;
+                    if (!ReadArray(record_data, record, &properties)) return false;
+                    if (apply) {
+                        pdd.mapof_extended_properties_.clear();
+                        for (const ProfileExtendedProperty &property : properties) {
+                            pdd.mapof_extended_properties_[static_cast<uint32_t>(property.stype)] = property.property;
+                        }
+                    }
+                    continue;
+                }
+                default:
+                    return false;
+            }
+
+            // Runs of bytes to copy into target
+            size_t run_offset = 0;
+            for (uint32_t i = 0; i < record.count; ++i) {
+                ProfileRun run;
+                if (record.size - run_offset < sizeof(run)) {
+                    return false;
+                }
+                memcpy(&run, record_data + run_offset, sizeof(run));
+                run_offset += sizeof(run);
+                const size_t padded_run = (static_cast<size_t>(run.size) + 7) & ~static_cast<size_t>(7);
+                if (run.offset > target_size || run.size > target_size - run.offset || padded_run > record.size - run_offset) {
+                    return false;
+                }
+                if (apply) {
+                    memcpy(target + run.offset, record_data + run_offset, run.size);
+                    const size_t type_count_offset = offsetof(VkPhysicalDeviceMemoryProperties, memoryTypeCount);
+                    if (record.type == kProfileMemoryProperties && run.offset <= type_count_offset &&
+                        type_count_offset < run.offset + run.size) {
+                        *sets_memory_types = true;
+                    }
+                }
+                run_offset += padded_run;
+            }
+        }
+    }
+    return true;
+}
+
+bool JsonLoader::LoadProfile(const std::string &path, uint64_t json_size, uint64_t json_hash) {
+#if defined(_WIN32)
+    (void)path;
+    (void)json_size;
+    (void)json_hash;
+    return false;
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    bool result = false;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            const VkPhysicalDeviceLimits old_limits = pdd_.physical_device_properties_.limits;
+            const VkPhysicalDeviceMemoryProperties old_memory = pdd_.physical_device_memory_properties_;
+            bool sets_memory_types = false;
+            result = ApplyProfile(static_cast<const uint8_t *>(data), st.st_size, json_size, json_hash, pdd_, &sets_memory_types);
+            munmap(data, st.st_size);
+            if (result) {
+                WarnProfileChanges(old_limits, old_memory, sets_memory_types);
+            }
+        }
+    }
+    close(fd);
+    if (!result) {
+        DebugPrintf("\tIgnoring invalid or out of date compiled profile \"%s\"\n", path.c_str());
+    }
+    return result;
+#endif
+}
+
+// Gives the warnings of the JSON loader for a profile, which only holds the values: a value the JSON doesn't set is unchanged,
+// and a value it sets is compared with the one before, as GET_VALUE_WARN() does.
+void JsonLoader::WarnProfileChanges(const VkPhysicalDeviceLimits &old_limits, const VkPhysicalDeviceMemoryProperties &old_memory,
+                                    bool sets_memory_types) const {
+    const VkPhysicalDeviceLimits &limits = pdd_.physical_device_properties_.limits;
+#define WARN_LIMIT(name) WarnIfGreater(#name, limits.name, old_limits.name)
+    WARN_LIMIT(maxBoundDescriptorSets);
+    WARN_LIMIT(maxPerStageDescriptorSamplers);
+    WARN_LIMIT(maxPerStageDescriptorUniformBuffers);
+    WARN_LIMIT(maxPerStageDescriptorStorageBuffers);
+    WARN_LIMIT(maxPerStageDescriptorSampledImages);
+    WARN_LIMIT(maxPerStageDescriptorStorageImages);
+    WARN_LIMIT(maxPerStageDescriptorInputAttachments);
+    WARN_LIMIT(maxPerStageResources);
+    WARN_LIMIT(maxDescriptorSetSamplers);
+    WARN_LIMIT(maxDescriptorSetUniformBuffers);
+    WARN_LIMIT(maxDescriptorSetUniformBuffersDynamic);
+    WARN_LIMIT(maxDescriptorSetStorageBuffers);
+    WARN_LIMIT(maxDescriptorSetStorageBuffersDynamic);
+    WARN_LIMIT(maxDescriptorSetSampledImages);
+    WARN_LIMIT(maxDescriptorSetStorageImages);
+    WARN_LIMIT(maxDescriptorSetInputAttachments);
+#undef WARN_LIMIT
+
+    const VkPhysicalDeviceMemoryProperties &memory = pdd_.physical_device_memory_properties_;
+    for (uint32_t i = 0; i < VK_MAX_MEMORY_HEAPS; ++i) {
+        WarnIfGreater("size", memory.memoryHeaps[i].size, old_memory.memoryHeaps[i].size);
+    }
+    if (sets_memory_types) {
+        for (uint32_t i = 0; i < memory.memoryTypeCount; ++i) {
+            if (memory.memoryTypes[i].heapIndex >= memory.memoryHeapCount) {
+                DebugPrintf("WARN \"memoryType[%" PRIu32 "].heapIndex\" (%" PRIu32 ") exceeds memoryHeapCount (%" PRIu32 ")\n", i,
+                            memory.memoryTypes[i].heapIndex, memory.memoryHeapCount);
+            }
+        }
+    }
+}
+
+// Writes the profile to a temporary file first, so other processes never see it partially written.
+bool JsonLoader::StoreProfile(const std::string &path, const std::vector<uint8_t> &profile) {
+#if defined(_WIN32)
+    (void)path;
+    (void)profile;
+    return false;
+#else
+    for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+        const std::string directory = path.substr(0, slash);
+        if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+            DebugPrintf("WARN Failed to create profile cache directory \"%s\": %s\n", directory.c_str(), strerror(errno));
+            return false;
+        }
+    }
+    const std::string temp_path = path + "." + std::to_string(getpid()) + ".tmp";
+    FILE *file = fopen(temp_path.c_str(), "wb");
+    if (!file) {
+        DebugPrintf("WARN Failed to write compiled profile \"%s\": %s\n", temp_path.c_str(), strerror(errno));
+        return false;
+    }
+    bool result = fwrite(profile.data(), 1, profile.size(), file) == profile.size();
+    result = fclose(file) == 0 && result;
+    if (result) {
+        result = rename(temp_path.c_str(), path.c_str()) == 0;
+    }
+    if (!result) {
+        DebugPrintf("WARN Failed to write compiled profile \"%s\": %s\n", path.c_str(), strerror(errno));
+        remove(temp_path.c_str());
+    }
     return result;
+#endif
 }
 
 JsonLoader::SchemaId JsonLoader::IdentifySchema(const Json::Value &value) {
@@ -1320,12 +1953,36 @@ static void getDevSimErrorLevel() {
 #endif
 }
 
+// Fill the cacheDirectory variable with a value from either vk_layer_settings.txt or environment variables.
+// Environment variables get priority.  On Linux the compiled profiles go to the user's cache directory by default.
+static void getDevSimCacheDir() {
+    cacheDirectory.str = getLayerOption(kLayerSettingsDevsimCacheDir);
+    cacheDirectory.fromEnvVar = false;
+    std::string env_var = GetEnvarValue(kEnvarDevsimCacheDir);
+    if (!env_var.empty()) {
+        cacheDirectory.str = env_var;
+        cacheDirectory.fromEnvVar = true;
+    }
+#if !defined(_WIN32) && !defined(__ANDROID__)
+    if (cacheDirectory.str.empty()) {
+        const char *xdg_cache_home = getenv("XDG_CACHE_HOME");
+        const char *home = getenv("HOME");
+        if (xdg_cache_home && xdg_cache_home[0] == '/') {
+            cacheDirectory.str = std::string(xdg_cache_home) + "/vkdevsim";
+        } else if (home && home[0] == '/') {
+            cacheDirectory.str = std::string(home) + "/.cache/vkdevsim";
+        }
+    }
+#endif
+}
+
 // Generic layer dispatch table setup, see [LALI].
 static VkResult LayerSetupCreateInstance(const VkInstanceCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator,
                                          VkInstance *pInstance) {
     getDevSimFilename();
     getDevSimDebugLevel();
     getDevSimErrorLevel();
+    getDevSimCacheDir();
 
     VkLayerInstanceCreateInfo *chain_info = get_chain_info(pCreateInfo, VK_LAYER_LINK_INFO);
     assert(chain_info->u.pLayerInfo);
@@ -31,10 +31,13 @@
 #include <algorithm>
 #include <list>
 #include <map>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 #include <set>
 #include <vector>
-#include <fstream>
-#include <iomanip>
+#include <sstream>
 #include <math.h>
 
 using namespace std;
@@ -47,6 +50,7 @@ using namespace std;
 #include "vk_enum_string_helper.h"
 
 #include "screenshot_parsing.h"
+#include "screenshot_encode.h"
 
 #ifdef ANDROID
 
@@ -68,18 +72,24 @@ const char *env_var_format = "debug.vulkan.screenshot.format";
 const char *env_var_dir = "debug.vulkan.screenshot.dir";
 // /path/to/snapshots/prefix- Must contain full path and a prefix
 const char *env_var_prefix = "debug.vulkan.screenshot.prefix";
+const char *env_var_encoding = "debug.vulkan.screenshot.encoding";
+const char *env_var_hash_tile = "debug.vulkan.screenshot.hashtile";
 #else  // Linux or Windows
 const char *env_var_old = "_VK_SCREENSHOT";
 const char *env_var_frames = "VK_SCREENSHOT_FRAMES";
 const char *env_var_format = "VK_SCREENSHOT_FORMAT";
 const char *env_var_dir = "VK_SCREENSHOT_DIR";
 const char *env_var_prefix = "VK_SCREENSHOT_PREFIX";
+const char *env_var_encoding = "VK_SCREENSHOT_ENCODING";
+const char *env_var_hash_tile = "VK_SCREENSHOT_HASH_TILE";
 #endif
 const char *env_var_dump_renderpass = "VK_SCREENSHOT_DUMP_RENDERPASS";
 
 const char *settings_option_frames = "lunarg_screenshot.frames";
 const char *settings_option_format = "lunarg_screenshot.format";
 const char *settings_option_dir = "lunarg_screenshot.dir";
+const char *settings_option_encoding = "lunarg_screenshot.encoding";
+const char *settings_option_hash_tile = "lunarg_screenshot.hash_tile";
 
 #ifdef ANDROID
 char *android_exec(const char *cmd) {
@@ -172,6 +182,88 @@ static uint32_t dumpRenderPassIndex = UINT32_MAX;
 
 static std::string screenshotPrefix = "";
 
+static ScreenshotEncoding screenshotEncoding = SCREENSHOT_ENCODING_PPM;
+
+// Size of the tiles hashed in addition to the whole frame in HASH mode, 0 for none
+static uint32_t screenshotHashTileSize = 0;
+
+// In HASH mode the "file name" of a screenshot is only its label in the hash log
+static const char *screenshotFileExtension() {
+    switch (screenshotEncoding) {
+        case SCREENSHOT_ENCODING_QOI:
+            return ".qoi";
+        case SCREENSHOT_ENCODING_HASH:
+            return "";
+        default:
+            return ".ppm";
+    }
+}
+
+// Hashes of all the frames go to one log, written by whichever thread encodes the screenshot
+static std::mutex hashLogMutex;
+static FILE *hashLogFile = NULL;
+static bool hashLogStarted = false;  // later devices append to the log of the first one
+
+static std::string hashLogFileName() { return screenshotPrefix + "framehash.log"; }
+
+// Append one line per frame: "frame=<name> size=<width>x<height> hash=<hash> [tile=<size> tiles=<hash>,<hash>,...]".
+// Lines are flushed at once so that the log is complete even if the app is killed.
+static bool logFrameHash(const std::string &fileName, uint32_t width, uint32_t height, const ImageHash &frameHash,
+                         const vector<ImageHash> &tileHashes) {
+    std::string name = fileName;
+    if (!screenshotPrefix.empty() && name.compare(0, screenshotPrefix.size(), screenshotPrefix) == 0) {
+        name.erase(0, screenshotPrefix.size());
+    }
+    std::ostringstream line;
+    line << "frame=" << name << " size=" << width << "x" << height << " hash=" << hashToString(frameHash);
+    if (!tileHashes.empty()) {
+        line << " tile=" << screenshotHashTileSize << " tiles=";
+        for (size_t i = 0; i < tileHashes.size(); i++) {
+            if (i > 0) line << ",";
+            line << hashToString(tileHashes[i]);
+        }
+    }
+    line << "\n";
+
+    std::lock_guard<std::mutex> lock(hashLogMutex);
+    if (hashLogFile == NULL) {
+        hashLogFile = fopen(hashLogFileName().c_str(), hashLogStarted ? "a" : "w");
+        if (hashLogFile == NULL) return false;
+        hashLogStarted = true;
+    }
+    std::string const text = line.str();
+    if (fwrite(text.data(), 1, text.size(), hashLogFile) != text.size()) return false;
+    fflush(hashLogFile);
+    return true;
+}
+
+// Called once the encoder of a device has finished, the log is reopened if another device hashes a frame
+static void closeHashLog() {
+    std::lock_guard<std::mutex> lock(hashLogMutex);
+    if (hashLogFile != NULL) {
+        fclose(hashLogFile);
+        hashLogFile = NULL;
+    }
+}
+
+// Report a screenshot written to a file, or hashed to the hash log
+static void reportScreenshot(const char *fileName) {
+    if (screenshotEncoding == SCREENSHOT_ENCODING_HASH) {
+#ifdef ANDROID
+        __android_log_print(ANDROID_LOG_INFO, "screenshot", "Screen capture hash of %s is in: %s", fileName,
+                            hashLogFileName().c_str());
+#else
+        printf("Screen capture hash of %s is in: %s \n", fileName, hashLogFileName().c_str());
+#endif
+    } else {
+#ifdef ANDROID
+        __android_log_print(ANDROID_LOG_INFO, "screenshot", "Screen capture file is: %s", fileName);
+#else
+        printf("Screen capture file is: %s \n", fileName);
+#endif
+    }
+}
+
 static std::set<VkImage> renderPassImages;
 static unordered_map<VkCommandBuffer, std::set<VkImage>> commandBufferToImages;
 static unordered_map<VkCommandBuffer, std::set<VkCommandBuffer>> commandBufferToCommandBuffers;
@@ -202,6 +294,8 @@ typedef struct {
 } ImageMapStruct;
 static unordered_map<VkImage, ImageMapStruct *> imageMap;
 
+struct ReadbackRing;
+
 // unordered map: associates a device with a queue, commandPool, and physical
 // device also contains per device info including dispatch table
 typedef struct {
@@ -210,6 +304,7 @@ typedef struct {
     VkQueue queue;
     VkPhysicalDevice physicalDevice;
     PFN_vkSetDeviceLoaderData pfn_dev_init;
+    ReadbackRing *readbackRing;  // created with the first screenshot taken at present time
 } DeviceMapStruct;
 static unordered_map<VkDevice, DeviceMapStruct *> deviceMap;
 static unordered_map<VkQueue, uint32_t> queueIndexMap;
@@ -359,6 +454,49 @@ void readScreenShotRenderPassENV(void) {
     local_free_getenv(vk_screenshot_dump_renderpass);
 }
 
+// Get the file format of the screenshots, PPM or QOI, or HASH to only log their hashes
+void readScreenShotEncodingENV(void) {
+    const char *vk_screenshot_encoding = getLayerOption(settings_option_encoding);
+    const char *env_var = local_getenv(env_var_encoding);
+
+    if (env_var != NULL && strlen(env_var) > 0) {
+        vk_screenshot_encoding = env_var;
+    }
+
+    if (vk_screenshot_encoding && *vk_screenshot_encoding) {
+        if (strcmp(vk_screenshot_encoding, "QOI") == 0) {
+            screenshotEncoding = SCREENSHOT_ENCODING_QOI;
+        } else if (strcmp(vk_screenshot_encoding, "PPM") == 0) {
+            screenshotEncoding = SCREENSHOT_ENCODING_PPM;
+        } else if (strcmp(vk_screenshot_encoding, "HASH") == 0) {
+            screenshotEncoding = SCREENSHOT_ENCODING_HASH;
+        } else {
+#ifdef ANDROID
+            __android_log_print(ANDROID_LOG_INFO, "screenshot", "Selected encoding:%s\nIs NOT in the list:\nPPM, QOI, HASH\nPPM will be used instead\n",
+                                vk_screenshot_encoding);
+#else
+            fprintf(stderr, "Selected encoding:%s\nIs NOT in the list:\nPPM, QOI, HASH\nPPM will be used instead\n", vk_screenshot_encoding);
+#endif
+        }
+    }
+
+    if (env_var != NULL) {
+        local_free_getenv(env_var);
+    }
+
+    const char *vk_screenshot_hash_tile = getLayerOption(settings_option_hash_tile);
+    env_var = local_getenv(env_var_hash_tile);
+    if (env_var != NULL && strlen(env_var) > 0) {
+        vk_screenshot_hash_tile = env_var;
+    }
+    if (vk_screenshot_hash_tile && *vk_screenshot_hash_tile) {
+        screenshotHashTileSize = (uint32_t)strtoul(vk_screenshot_hash_tile, NULL, 10);
+    }
+    if (env_var != NULL) {
+        local_free_getenv(env_var);
+    }
+}
+
 void readScreenShotPrefixENV(void) {
     char *vk_screenshot_prefix = local_getenv(env_var_prefix);
     if (vk_screenshot_prefix && *vk_screenshot_prefix) {
@@ -496,44 +634,75 @@ static void init_screenshot() {
     readScreenShotDir();
     readScreenShotFrames();
     readScreenShotPrefixENV();
+    readScreenShotEncodingENV();
     readScreenShotRenderPassENV();
 }
 
-// Track allocated resources in writePPM()
-// and clean them up when they go out of scope.
-struct WritePPMCleanupData {
+// Staging resources of one screenshot: the images the source image is copied to, the command buffer doing the copy
+// and the fence it signals. writePPM() creates them for a single screenshot and frees them when it returns, a slot of
+// the readback ring keeps them from one screenshot to the next.
+struct ScreenshotReadback {
     VkDevice device;
     VkLayerDispatchTable *pTableDevice;
     VkImage image2;
     VkImage image3;
     VkDeviceMemory mem2;
     VkDeviceMemory mem3;
-    bool mem2mapped;
-    bool mem3mapped;
     VkCommandBuffer commandBuffer;
     VkCommandPool commandPool;
-    ~WritePPMCleanupData();
+    VkFence fence;
+    VkSemaphore semaphore;
+
+    // What the resources above were created for and what has been copied
+    uint32_t queueFamilyIndex;
+    uint32_t width;
+    uint32_t height;
+    VkFormat format;
+    VkFormat destformat;
+    VkFormat dataFormat;  // format of the pixels in the staging image, the source format when they are only copied
+    VkImageAspectFlags aspectMask;
+    bool need2steps;
+    bool ppmSupport;
+    string filename;
+
+    void release();
+    ~ScreenshotReadback() { release(); }
 };
 
-WritePPMCleanupData::~WritePPMCleanupData() {
-    if (mem2mapped) pTableDevice->UnmapMemory(device, mem2);
+void ScreenshotReadback::release() {
     if (mem2) pTableDevice->FreeMemory(device, mem2, NULL);
     if (image2) pTableDevice->DestroyImage(device, image2, NULL);
 
-    if (mem3mapped) pTableDevice->UnmapMemory(device, mem3);
     if (mem3) pTableDevice->FreeMemory(device, mem3, NULL);
     if (image3) pTableDevice->DestroyImage(device, image3, NULL);
 
     if (commandBuffer) pTableDevice->FreeCommandBuffers(device, commandPool, 1, &commandBuffer);
     if (commandPool) pTableDevice->DestroyCommandPool(device, commandPool, NULL);
+
+    if (fence) pTableDevice->DestroyFence(device, fence, NULL);
+    if (semaphore) pTableDevice->DestroySemaphore(device, semaphore, NULL);
+
+    image2 = VK_NULL_HANDLE;
+    image3 = VK_NULL_HANDLE;
+    mem2 = VK_NULL_HANDLE;
+    mem3 = VK_NULL_HANDLE;
+    commandBuffer = VK_NULL_HANDLE;
+    commandPool = VK_NULL_HANDLE;
+    fence = VK_NULL_HANDLE;
+    semaphore = VK_NULL_HANDLE;
 }
 
-// Save an image to a PPM image file.
+// Record the copy of an image to a host visible image.
 //
 // This function issues commands to copy/convert the swapchain image
 // from whatever compatible format the swapchain image uses
 // to a single format (VK_FORMAT_R8G8B8A8_UNORM) so that the converted
-// result can be easily written to a PPM file.
+// result can be easily written to a PPM file. The command buffer is meant
+// to be submitted on 'queue' with data->fence, encodeReadback() then
+// writes the file.
+//
+// The staging resources already in 'data' are reused when they were
+// created for the same kind of copy, otherwise they are recreated.
 //
 // Error handling: If there is a problem, this function should silently
 // fail without affecting the Present operation going on in the caller.
@@ -541,7 +710,7 @@ WritePPMCleanupData::~WritePPMCleanupData() {
 // expected to assert.  Recovery and clean up are implemented for image memory
 // allocation failures.
 // (TODO) It would be nice to pass any failure info to DebugReport or something.
-static bool writePPM(const char *filename, VkImage image1) {
+static bool prepareReadback(ScreenshotReadback *data, const char *filename, VkImage image1, VkQueue queue) {
     VkResult err;
     bool pass;
     bool ppmSupport = true;
@@ -554,7 +723,6 @@ static bool writePPM(const char *filename, VkImage image1) {
     VkDevice device = imageMap[image1]->device;
     VkPhysicalDevice physicalDevice = deviceMap[device]->physicalDevice;
     VkInstance instance = physDeviceMap[physicalDevice]->instance;
-    VkQueue queue = deviceMap[device]->queue;
     DeviceMapStruct *devMap = get_dev_info(device);
     if (NULL == devMap) {
         assert(0);
@@ -564,7 +732,6 @@ static bool writePPM(const char *filename, VkImage image1) {
     VkLayerDispatchTable *pTableQueue = get_dev_info(static_cast<VkDevice>(static_cast<void *>(queue)))->device_dispatch_table;
     VkLayerInstanceDispatchTable *pInstanceTable;
     pInstanceTable = instance_dispatch_table(instance);
-
     // Gather incoming image info and check image format for compatibility with
     // the target format.
     // This function supports both 24-bit and 32-bit swapchain images.
@@ -746,7 +913,9 @@ static bool writePPM(const char *filename, VkImage image1) {
     }
 
     if ((FormatCompatibilityClass(destformat) != FormatCompatibilityClass(format))) {
-        if (FormatElementSize(format) != 4) {
+        if (pixelLayoutFromFormat(format) != PIXEL_LAYOUT_UNKNOWN) {
+            // Copied as is, the pixels are converted when the file is written
+        } else if (FormatElementSize(format) != 4) {
 #ifdef ANDROID
             __android_log_print(ANDROID_LOG_DEBUG, "screenshot", "Format %s NOT supported yet! Won't save data to %s.",
                                 string_VkFormat(format), filename);
@@ -763,9 +932,9 @@ static bool writePPM(const char *filename, VkImage image1) {
             fprintf(stderr, "Dest %s format is not compatible with %s format, will save raw data to %s.\n",
                     string_VkFormat(destformat), string_VkFormat(format), filename);
 #endif
+            ppmSupport = false;
         }
         destformat = format;
-        ppmSupport = false;
     }
 
     // General Approach
@@ -824,130 +993,165 @@ static bool writePPM(const char *filename, VkImage image1) {
         // Else bltLinear is available and only 1 step is needed.
     }
 
-    // Put resources that need to be cleaned up in a struct with a destructor
-    // so that things get cleaned up when this function is exited.
-    WritePPMCleanupData data = {};
-    data.device = device;
-    data.pTableDevice = pTableDevice;
-
-    // Set up the image creation info for both the blit and copy images, in case
-    // both are needed.
-    VkImageCreateInfo imgCreateInfo2 = {
-        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-        NULL,
-        0,
-        VK_IMAGE_TYPE_2D,
-        destformat,
-        {width, height, 1},
-        1,
-        1,
-        VK_SAMPLE_COUNT_1_BIT,
-        VK_IMAGE_TILING_LINEAR,
-        VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-        VK_SHARING_MODE_EXCLUSIVE,
-        0,
-        NULL,
-        VK_IMAGE_LAYOUT_UNDEFINED,
-    };
-    VkImageCreateInfo imgCreateInfo3 = imgCreateInfo2;
-
-    // If we need both images, set up image2 to be read/write and tiled.
-    if (need2steps) {
-        imgCreateInfo2.tiling = VK_IMAGE_TILING_OPTIMAL;
-        imgCreateInfo2.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-    }
-
-    VkMemoryAllocateInfo memAllocInfo = {
-        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL,
-        0,  // allocationSize, queried later
-        0   // memoryTypeIndex, queried later
-    };
-    VkMemoryRequirements memRequirements;
-    VkPhysicalDeviceMemoryProperties memoryProperties;
-
-    // Create image2 and allocate its memory.  It could be the intermediate or
-    // final image.
-    err = pTableDevice->CreateImage(device, &imgCreateInfo2, NULL, &data.image2);
-    assert(!err);
-    if (VK_SUCCESS != err) return false;
-    pTableDevice->GetImageMemoryRequirements(device, data.image2, &memRequirements);
-    memAllocInfo.allocationSize = memRequirements.size;
-    pInstanceTable->GetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
-    pass = memory_type_from_properties(&memoryProperties, memRequirements.memoryTypeBits,
-                                       need2steps ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-                                       &memAllocInfo.memoryTypeIndex);
-    assert(pass);
-    err = pTableDevice->AllocateMemory(device, &memAllocInfo, NULL, &data.mem2);
-    assert(!err);
-    if (VK_SUCCESS != err) return false;
-    err = pTableQueue->BindImageMemory(device, data.image2, data.mem2, 0);
-    assert(!err);
-    if (VK_SUCCESS != err) return false;
+    auto it = queueIndexMap.find(queue);
+    assert(it != queueIndexMap.end());
+    if (it == queueIndexMap.end()) return false;
+    uint32_t const queueFamilyIndex = it->second;
+
+    // The resources of the previous screenshot can be reused for the same kind of copy.
+    if (data->device != device || data->queueFamilyIndex != queueFamilyIndex || data->width != width ||
+        data->height != height || data->destformat != destformat || data->need2steps != need2steps) {
+        data->release();
+    }
+    data->device = device;
+    data->pTableDevice = pTableDevice;
+    data->queueFamilyIndex = queueFamilyIndex;
+    data->width = width;
+    data->height = height;
+    data->format = format;
+    data->destformat = destformat;
+    data->dataFormat = copyOnly ? format : destformat;
+    data->need2steps = need2steps;
+    data->ppmSupport = ppmSupport;
+    data->filename = filename;
+    if (data->image2 == VK_NULL_HANDLE) {
+        // Set up the image creation info for both the blit and copy images, in case
+        // both are needed.
+        VkImageCreateInfo imgCreateInfo2 = {
+            VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            NULL,
+            0,
+            VK_IMAGE_TYPE_2D,
+            destformat,
+            {width, height, 1},
+            1,
+            1,
+            VK_SAMPLE_COUNT_1_BIT,
+            VK_IMAGE_TILING_LINEAR,
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            VK_SHARING_MODE_EXCLUSIVE,
+            0,
+            NULL,
+            VK_IMAGE_LAYOUT_UNDEFINED,
+        };
+        VkImageCreateInfo imgCreateInfo3 = imgCreateInfo2;
+
+        // If we need both images, set up image2 to be read/write and tiled.
+        if (need2steps) {
+            imgCreateInfo2.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imgCreateInfo2.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        }
 
-    // Create image3 and allocate its memory, if needed.
-    if (need2steps) {
-        err = pTableDevice->CreateImage(device, &imgCreateInfo3, NULL, &data.image3);
+        VkMemoryAllocateInfo memAllocInfo = {
+            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL,
+            0,  // allocationSize, queried later
+            0   // memoryTypeIndex, queried later
+        };
+        VkMemoryRequirements memRequirements;
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+
+        // Create image2 and allocate its memory.  It could be the intermediate or
+        // final image.
+        err = pTableDevice->CreateImage(device, &imgCreateInfo2, NULL, &data->image2);
         assert(!err);
         if (VK_SUCCESS != err) return false;
-        pTableDevice->GetImageMemoryRequirements(device, data.image3, &memRequirements);
+        pTableDevice->GetImageMemoryRequirements(device, data->image2, &memRequirements);
         memAllocInfo.allocationSize = memRequirements.size;
         pInstanceTable->GetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
-        pass = memory_type_from_properties(&memoryProperties, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+        pass = memory_type_from_properties(&memoryProperties, memRequirements.memoryTypeBits,
+                                           need2steps ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
                                            &memAllocInfo.memoryTypeIndex);
         assert(pass);
-        err = pTableDevice->AllocateMemory(device, &memAllocInfo, NULL, &data.mem3);
+        err = pTableDevice->AllocateMemory(device, &memAllocInfo, NULL, &data->mem2);
         assert(!err);
         if (VK_SUCCESS != err) return false;
-        err = pTableQueue->BindImageMemory(device, data.image3, data.mem3, 0);
+        err = pTableQueue->BindImageMemory(device, data->image2, data->mem2, 0);
         assert(!err);
         if (VK_SUCCESS != err) return false;
+
+        // Create image3 and allocate its memory, if needed.
+        if (need2steps) {
+            err = pTableDevice->CreateImage(device, &imgCreateInfo3, NULL, &data->image3);
+            assert(!err);
+            if (VK_SUCCESS != err) return false;
+            pTableDevice->GetImageMemoryRequirements(device, data->image3, &memRequirements);
+            memAllocInfo.allocationSize = memRequirements.size;
+            pInstanceTable->GetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+            pass = memory_type_from_properties(&memoryProperties, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                               &memAllocInfo.memoryTypeIndex);
+            assert(pass);
+            err = pTableDevice->AllocateMemory(device, &memAllocInfo, NULL, &data->mem3);
+            assert(!err);
+            if (VK_SUCCESS != err) return false;
+            err = pTableQueue->BindImageMemory(device, data->image3, data->mem3, 0);
+            assert(!err);
+            if (VK_SUCCESS != err) return false;
+        }
     }
 
-    // We want to create our own command pool to be sure we can use it from this thread
-    VkCommandPoolCreateInfo cmd_pool_info = {};
-    cmd_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    cmd_pool_info.pNext = NULL;
-    auto it = queueIndexMap.find(queue);
-    assert(it != queueIndexMap.end());
-    cmd_pool_info.queueFamilyIndex = it->second;
-    cmd_pool_info.flags = 0;
+    if (data->commandPool == VK_NULL_HANDLE) {
+        // We want to create our own command pool to be sure we can use it from this thread
+        VkCommandPoolCreateInfo cmd_pool_info = {};
+        cmd_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        cmd_pool_info.pNext = NULL;
+        cmd_pool_info.queueFamilyIndex = queueFamilyIndex;
+        cmd_pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
-    err = pTableDevice->CreateCommandPool(device, &cmd_pool_info, NULL, &data.commandPool);
-    assert(!err);
+        err = pTableDevice->CreateCommandPool(device, &cmd_pool_info, NULL, &data->commandPool);
+        assert(!err);
+        if (VK_SUCCESS != err) return false;
 
-    // Set up the command buffer.
-    const VkCommandBufferAllocateInfo allocCommandBufferInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, NULL,
-                                                                data.commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1};
-    err = pTableDevice->AllocateCommandBuffers(device, &allocCommandBufferInfo, &data.commandBuffer);
-    assert(!err);
-    if (VK_SUCCESS != err) return false;
+        // Set up the command buffer.
+        const VkCommandBufferAllocateInfo allocCommandBufferInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, NULL,
+                                                                    data->commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1};
+        err = pTableDevice->AllocateCommandBuffers(device, &allocCommandBufferInfo, &data->commandBuffer);
+        assert(!err);
+        if (VK_SUCCESS != err) return false;
 
-    VkDevice cmdBuf = static_cast<VkDevice>(static_cast<void *>(data.commandBuffer));
-    if (deviceMap.find(cmdBuf) != deviceMap.end()) {
-        // Remove element with key cmdBuf from deviceMap so we can replace it
-        deviceMap.erase(cmdBuf);
+        VkDevice cmdBuf = static_cast<VkDevice>(static_cast<void *>(data->commandBuffer));
+        if (deviceMap.find(cmdBuf) != deviceMap.end()) {
+            // Remove element with key cmdBuf from deviceMap so we can replace it
+            deviceMap.erase(cmdBuf);
+        }
+        deviceMap.emplace(cmdBuf, devMap);
+
+        // We have just created a dispatchable object, but the dispatch table has
+        // not been placed in the object yet.  When a "normal" application creates
+        // a command buffer, the dispatch table is installed by the top-level api
+        // binding (trampoline.c). But here, we have to do it ourselves.
+        if (!devMap->pfn_dev_init) {
+            *((const void **)data->commandBuffer) = *(void **)device;
+        } else {
+            err = devMap->pfn_dev_init(device, (void *)data->commandBuffer);
+            assert(!err);
+        }
     }
-    deviceMap.emplace(cmdBuf, devMap);
-    VkLayerDispatchTable *pTableCommandBuffer;
-    pTableCommandBuffer = get_dev_info(cmdBuf)->device_dispatch_table;
-
-    // We have just created a dispatchable object, but the dispatch table has
-    // not been placed in the object yet.  When a "normal" application creates
-    // a command buffer, the dispatch table is installed by the top-level api
-    // binding (trampoline.c). But here, we have to do it ourselves.
-    if (!devMap->pfn_dev_init) {
-        *((const void **)data.commandBuffer) = *(void **)device;
+
+    // The fence tells when the copy is done, the semaphore is only waited on
+    // when the copy is submitted ahead of a present.
+    if (data->fence == VK_NULL_HANDLE) {
+        const VkFenceCreateInfo fenceCreateInfo = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, NULL, 0};
+        err = pTableDevice->CreateFence(device, &fenceCreateInfo, NULL, &data->fence);
+        assert(!err);
+        if (VK_SUCCESS != err) return false;
+        const VkSemaphoreCreateInfo semaphoreCreateInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, NULL, 0};
+        err = pTableDevice->CreateSemaphore(device, &semaphoreCreateInfo, NULL, &data->semaphore);
+        assert(!err);
+        if (VK_SUCCESS != err) return false;
     } else {
-        err = devMap->pfn_dev_init(device, (void *)data.commandBuffer);
+        err = pTableDevice->ResetFences(device, 1, &data->fence);
         assert(!err);
+        if (VK_SUCCESS != err) return false;
     }
 
+    VkLayerDispatchTable *pTableCommandBuffer;
+    pTableCommandBuffer = get_dev_info(static_cast<VkDevice>(static_cast<void *>(data->commandBuffer)))->device_dispatch_table;
     const VkCommandBufferBeginInfo commandBufferBeginInfo = {
         VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
         NULL,
         VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
     };
-    err = pTableCommandBuffer->BeginCommandBuffer(data.commandBuffer, &commandBufferBeginInfo);
+    err = pTableCommandBuffer->BeginCommandBuffer(data->commandBuffer, &commandBufferBeginInfo);
     assert(!err);
 
     VkImageAspectFlags aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -981,7 +1185,7 @@ static bool writePPM(const char *filename, VkImage image1) {
                                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                                               VK_QUEUE_FAMILY_IGNORED,
                                               VK_QUEUE_FAMILY_IGNORED,
-                                              data.image2,
+                                              data->image2,
                                               {aspectMask, 0, 1, 0, 1}};
 
     // This barrier is used to transition a dest layout to general layout.
@@ -993,7 +1197,7 @@ static bool writePPM(const char *filename, VkImage image1) {
                                                  VK_IMAGE_LAYOUT_GENERAL,
                                                  VK_QUEUE_FAMILY_IGNORED,
                                                  VK_QUEUE_FAMILY_IGNORED,
-                                                 data.image2,
+                                                 data->image2,
                                                  {aspectMask, 0, 1, 0, 1}};
 
     VkPipelineStageFlags srcStages = VK_PIPELINE_STAGE_TRANSFER_BIT;
@@ -1005,17 +1209,17 @@ static bool writePPM(const char *filename, VkImage image1) {
 
     // The source image needs to be transitioned from present to transfer
     // source.
-    pTableCommandBuffer->CmdPipelineBarrier(data.commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, dstStages, 0, 0, NULL, 0,
+    pTableCommandBuffer->CmdPipelineBarrier(data->commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, dstStages, 0, 0, NULL, 0,
                                             NULL, 1, &presentMemoryBarrier);
 
     // image2 needs to be transitioned from its undefined state to transfer
     // destination.
-    pTableCommandBuffer->CmdPipelineBarrier(data.commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1, &destMemoryBarrier);
+    pTableCommandBuffer->CmdPipelineBarrier(data->commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1, &destMemoryBarrier);
 
     const VkImageCopy imageCopyRegion = {{aspectMask, 0, 0, 1}, {0, 0, 0}, {aspectMask, 0, 0, 1}, {0, 0, 0}, {width, height, 1}};
 
     if (copyOnly) {
-        pTableCommandBuffer->CmdCopyImage(data.commandBuffer, image1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, data.image2,
+        pTableCommandBuffer->CmdCopyImage(data->commandBuffer, image1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, data->image2,
                                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageCopyRegion);
     } else {
         VkImageBlit imageBlitRegion = {};
@@ -1034,13 +1238,13 @@ static bool writePPM(const char *filename, VkImage image1) {
         imageBlitRegion.dstOffsets[1].y = height;
         imageBlitRegion.dstOffsets[1].z = 1;
 
-        pTableCommandBuffer->CmdBlitImage(data.commandBuffer, image1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, data.image2,
+        pTableCommandBuffer->CmdBlitImage(data->commandBuffer, image1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, data->image2,
                                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlitRegion, VK_FILTER_NEAREST);
         if (need2steps) {
             // image 3 needs to be transitioned from its undefined state to a
             // transfer destination.
-            destMemoryBarrier.image = data.image3;
-            pTableCommandBuffer->CmdPipelineBarrier(data.commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
+            destMemoryBarrier.image = data->image3;
+            pTableCommandBuffer->CmdPipelineBarrier(data->commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
                                                     &destMemoryBarrier);
 
             // Transition image2 so that it can be read for the upcoming copy to
@@ -1049,20 +1253,20 @@ static bool writePPM(const char *filename, VkImage image1) {
             destMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
             destMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
             destMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            destMemoryBarrier.image = data.image2;
-            pTableCommandBuffer->CmdPipelineBarrier(data.commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
+            destMemoryBarrier.image = data->image2;
+            pTableCommandBuffer->CmdPipelineBarrier(data->commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
                                                     &destMemoryBarrier);
 
             // This step essentially untiles the image.
-            pTableCommandBuffer->CmdCopyImage(data.commandBuffer, data.image2, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, data.image3,
+            pTableCommandBuffer->CmdCopyImage(data->commandBuffer, data->image2, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, data->image3,
                                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageCopyRegion);
-            generalMemoryBarrier.image = data.image3;
+            generalMemoryBarrier.image = data->image3;
         }
     }
 
     // The destination needs to be transitioned from the optimal copy format to
     // the format we can read with the CPU.
-    pTableCommandBuffer->CmdPipelineBarrier(data.commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
+    pTableCommandBuffer->CmdPipelineBarrier(data->commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
                                             &generalMemoryBarrier);
 
     // Restore the swap chain image layout to what it was before.
@@ -1076,56 +1280,92 @@ static bool writePPM(const char *filename, VkImage image1) {
     }
     presentMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
     presentMemoryBarrier.dstAccessMask = 0;
-    pTableCommandBuffer->CmdPipelineBarrier(data.commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
+    pTableCommandBuffer->CmdPipelineBarrier(data->commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
                                             &presentMemoryBarrier);
 
-    err = pTableCommandBuffer->EndCommandBuffer(data.commandBuffer);
+    err = pTableCommandBuffer->EndCommandBuffer(data->commandBuffer);
     assert(!err);
+    data->aspectMask = aspectMask;
+    return true;
+}
 
-    VkFence nullFence = {VK_NULL_HANDLE};
-    VkSubmitInfo submitInfo;
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.pNext = NULL;
-    submitInfo.waitSemaphoreCount = 0;
-    submitInfo.pWaitSemaphores = NULL;
-    submitInfo.pWaitDstStageMask = NULL;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &data.commandBuffer;
-    submitInfo.signalSemaphoreCount = 0;
-    submitInfo.pSignalSemaphores = NULL;
+// Wait for the copy recorded by prepareReadback() and write the staging
+// image to data->filename.
+static bool encodeReadback(ScreenshotReadback *data) {
+    VkResult err;
+    VkDevice device = data->device;
+    VkLayerDispatchTable *pTableDevice = data->pTableDevice;
+    const char *filename = data->filename.c_str();
+    VkFormat const format = data->format;
+    VkFormat const destformat = data->destformat;
 
-    err = pTableQueue->QueueSubmit(queue, 1, &submitInfo, nullFence);
+    err = pTableDevice->WaitForFences(device, 1, &data->fence, VK_TRUE, UINT64_MAX);
     assert(!err);
+    if (VK_SUCCESS != err) return false;
 
-    err = pTableQueue->QueueWaitIdle(queue);
+    // Map the final image so that the CPU can read it.
+    const VkImageSubresource sr = {data->aspectMask, 0, 0};
+    VkSubresourceLayout srLayout;
+    const uint8_t *ptr;
+    VkImage image = data->need2steps ? data->image3 : data->image2;
+    VkDeviceMemory mem = data->need2steps ? data->mem3 : data->mem2;
+    pTableDevice->GetImageSubresourceLayout(device, image, &sr, &srLayout);
+    err = pTableDevice->MapMemory(device, mem, 0, VK_WHOLE_SIZE, 0, (void **)&ptr);
     assert(!err);
+    if (VK_SUCCESS != err) return false;
 
-    err = pTableDevice->DeviceWaitIdle(device);
-    assert(!err);
+    // Encode the whole file in memory, it is then written at once.
+    std::ostringstream comment;
+    comment << "# format: " << destformat << " " << string_VkFormat(destformat) << "\n";
+    comment << "# srcFormat: " << format << " " << string_VkFormat(format) << "\n";
+    comment << "# rowPitch: " << srLayout.rowPitch << "\n";
 
-    // Map the final image so that the CPU can read it.
-    const VkImageSubresource sr = {aspectMask, 0, 0};
-    VkSubresourceLayout srLayout;
-    const char *ptr;
-    if (!need2steps) {
-        pTableDevice->GetImageSubresourceLayout(device, data.image2, &sr, &srLayout);
-        err = pTableDevice->MapMemory(device, data.mem2, 0, VK_WHOLE_SIZE, 0, (void **)&ptr);
-        assert(!err);
-        if (VK_SUCCESS != err) return false;
-        data.mem2mapped = true;
+    vector<uint8_t> encoded;
+    PixelLayout const layout = pixelLayoutFromFormat(data->dataFormat);
+    if (screenshotEncoding == SCREENSHOT_ENCODING_HASH) {
+        if (!data->ppmSupport || layout == PIXEL_LAYOUT_UNKNOWN) {
+#ifdef ANDROID
+            __android_log_print(ANDROID_LOG_DEBUG, "screenshot", "Format %s NOT supported yet for hashing!\n",
+                                string_VkFormat(destformat));
+#else
+            fprintf(stderr, "Format %s NOT supported yet for hashing!\n", string_VkFormat(destformat));
+#endif
+            pTableDevice->UnmapMemory(device, mem);
+            return false;
+        }
+        ImageHash frameHash;
+        vector<ImageHash> tileHashes;
+        hashImage(layout, ptr + srLayout.offset, data->width, data->height, srLayout.rowPitch, screenshotHashTileSize, frameHash,
+                  tileHashes);
+        pTableDevice->UnmapMemory(device, mem);
+        if (!logFrameHash(data->filename, data->width, data->height, frameHash, tileHashes)) {
+#ifdef ANDROID
+            __android_log_print(ANDROID_LOG_DEBUG, "screenshot", "Failed to write hash log: %s.", hashLogFileName().c_str());
+#else
+            fprintf(stderr, "Failed to write hash log: %s\n", hashLogFileName().c_str());
+#endif
+            return false;
+        }
+        return true;
+    } else if (data->ppmSupport && layout != PIXEL_LAYOUT_UNKNOWN) {
+        encodeImage(screenshotEncoding, layout, ptr + srLayout.offset, data->width, data->height, srLayout.rowPitch,
+                    comment.str(), encoded);
+    } else if (FormatElementSize(destformat) == 4) {
+        comment << "# width: " << data->width << "\n";
+        comment << "# height: " << data->height << "\n";
+        encodeImageHex(ptr + srLayout.offset, data->width, data->height, srLayout.rowPitch, comment.str(), encoded);
     } else {
-        pTableDevice->GetImageSubresourceLayout(device, data.image3, &sr, &srLayout);
-        err = pTableDevice->MapMemory(device, data.mem3, 0, VK_WHOLE_SIZE, 0, (void **)&ptr);
-        assert(!err);
-        if (VK_SUCCESS != err) return false;
-        data.mem3mapped = true;
+#ifdef ANDROID
+        __android_log_print(ANDROID_LOG_DEBUG, "screenshot", "Format %s NOT supported yet!\n", string_VkFormat(destformat));
+#else
+        fprintf(stderr, "Format %s NOT supported yet!\n", string_VkFormat(destformat));
+#endif
+        pTableDevice->UnmapMemory(device, mem);
+        return false;
     }
+    pTableDevice->UnmapMemory(device, mem);
 
-    // Write the data to a PPM file.
-    ofstream file(filename, ios::binary);
-    assert(file.is_open());
-
-    if (!file.is_open()) {
+    if (!writeImageFile(filename, encoded)) {
 #ifdef ANDROID
         __android_log_print(ANDROID_LOG_DEBUG, "screenshot",
                             "Failed to open output file: %s.  Be sure to grant read and write permissions.", filename);
@@ -1134,82 +1374,149 @@ static bool writePPM(const char *filename, VkImage image1) {
 #endif
         return false;
     }
+    return true;
+}
 
-    if (ppmSupport) {
-        uint32_t bytesPerChannel = FormatElementSize(destformat) / FormatComponentCount(destformat);
-        uint32_t maxColorValue = pow(256, bytesPerChannel) - 1;
-
-        file << "P6\n";
-        file << "# format: " << destformat << " " << string_VkFormat(destformat) << "\n";
-        file << "# srcFormat: " << format << " " << string_VkFormat(format) << "\n";
-        file << "# rowPitch: " << srLayout.rowPitch << "\n";
-        file << width << "\n";
-        file << height << "\n";
-        file << 255 << "\n";
-
-        ptr += srLayout.offset;
-        for (uint32_t y = 0; y < height; y++) {
-            const char *row = (const char *)ptr;
-            for (uint32_t x = 0; x < width; x++) {
-                // ppm only supports 3 channels r, g, b
-                for (uint32_t i = 0; i < 3; i++) {
-                    char colorValue = 0;
-                    if (i >= numChannels) {
-                        file.write((const char *)&colorValue, 1);
-                    } else {
-                        const char *rawcolor = row + (i * bytesPerChannel);
-                        uint32_t factor = maxColorValue / 255;
-                        uint32_t tmpcolor = 0;
-                        memcpy(&tmpcolor, rawcolor, bytesPerChannel);
-                        tmpcolor = tmpcolor / factor;
-                        colorValue = tmpcolor;
-                        file.write((const char *)&colorValue, 1);
-                    }
-                }
-                row = row + FormatElementSize(destformat);
-            }
-            ptr += srLayout.rowPitch;
-        }
-    } else {
-        if (FormatElementSize(destformat) != 4) {
+// Save an image to a PPM image file, waiting for the copy.
+static bool writePPM(const char *filename, VkImage image1) {
+    VkResult err;
+
+    // Bail immediately if we can't find the image.
+    if (imageMap.empty() || imageMap.find(image1) == imageMap.end()) return false;
+
+    VkQueue queue = deviceMap[imageMap[image1]->device]->queue;
+    VkLayerDispatchTable *pTableQueue = get_dev_info(static_cast<VkDevice>(static_cast<void *>(queue)))->device_dispatch_table;
+
+    // Put resources that need to be cleaned up in a struct with a destructor
+    // so that things get cleaned up when this function is exited.
+    ScreenshotReadback data = {};
+    if (!prepareReadback(&data, filename, image1, queue)) return false;
+
+    VkSubmitInfo submitInfo;
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = NULL;
+    submitInfo.waitSemaphoreCount = 0;
+    submitInfo.pWaitSemaphores = NULL;
+    submitInfo.pWaitDstStageMask = NULL;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &data.commandBuffer;
+    submitInfo.signalSemaphoreCount = 0;
+    submitInfo.pSignalSemaphores = NULL;
+
+    err = pTableQueue->QueueSubmit(queue, 1, &submitInfo, data.fence);
+    assert(!err);
+    if (VK_SUCCESS != err) return false;
+
+    return encodeReadback(&data);
+}
+
+// Screenshots taken at present time are read back in a pipelined way: the
+// copy is submitted on the present queue ahead of the present and an encoder
+// thread waits for its fence, maps the staging image and writes the file.
+// The app only blocks when the encoder is still writing the screenshot taken
+// readbackSlotCount presents ago.
+static const uint32_t readbackSlotCount = 3;
+
+struct ReadbackRing {
+    ReadbackRing() : slots(), busy(), next(0), exiting(false) {}
+
+    ScreenshotReadback slots[readbackSlotCount];
+    bool busy[readbackSlotCount];  // submitted and not written yet
+    uint32_t next;
+    std::deque<uint32_t> pending;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::thread encoder;
+    bool exiting;
+};
+
+static void readbackEncoderThread(ReadbackRing *ring) {
+    std::unique_lock<std::mutex> lock(ring->mutex);
+    while (true) {
+        ring->cond.wait(lock, [ring] { return ring->exiting || !ring->pending.empty(); });
+        if (ring->pending.empty()) break;
+        uint32_t index = ring->pending.front();
+        ring->pending.pop_front();
+        lock.unlock();
+
+        ScreenshotReadback *data = &ring->slots[index];
+        bool ret = encodeReadback(data);
+        if (ret) {
+            reportScreenshot(data->filename.c_str());
+        } else {
 #ifdef ANDROID
-            __android_log_print(ANDROID_LOG_DEBUG, "screenshot", "Format %s NOT supported yet!\n", string_VkFormat(destformat));
+            __android_log_print(ANDROID_LOG_DEBUG, "screenshot", "Failed to save screenshot to file %s.", data->filename.c_str());
 #else
-            fprintf(stderr, "Format %s NOT supported yet!\n", string_VkFormat(destformat));
+            fprintf(stderr, "Failed to save screenshot to file %s.\n", data->filename.c_str());
 #endif
-        } else {
-            file << "# format: " << destformat << " " << string_VkFormat(destformat) << "\n";
-            file << "# srcFormat: " << format << " " << string_VkFormat(format) << "\n";
-            file << "# rowPitch: " << srLayout.rowPitch << "\n";
-            file << "# width: " << width << "\n";
-            file << "# height: " << height << "\n";
-            uint8_t i = 0;
-            ptr += srLayout.offset;
-            for (uint32_t y = 0; y < height; y++) {
-                const char *row = (const char *)ptr;
-                for (uint32_t x = 0; x < width; x++) {
-                    uint32_t pixelValue = 0;
-                    memcpy(&pixelValue, row, FormatElementSize(destformat));
-                    file << setfill('0') << setw(8) << hex << pixelValue;
-                    i++;
-                    if (i == 4) {
-                        file << "\n";
-                        i = 0;
-                    } else {
-                        file << " ";
-                    }
-                    row = row + FormatElementSize(destformat);
-                }
-                ptr += srLayout.rowPitch;
-            }
         }
+
+        lock.lock();
+        ring->busy[index] = false;
+        ring->cond.notify_all();
+    }
+}
+
+// Copy the image about to be presented to the next slot of the device's
+// readback ring. The copy waits for the semaphores of the present and
+// signals the slot semaphore, which the present has to wait for instead.
+static bool submitPresentReadback(DeviceMapStruct *devMap, VkQueue queue, const VkPresentInfoKHR *pPresentInfo,
+                                  const char *filename, VkImage image, VkSemaphore *pSemaphore) {
+    if (devMap->readbackRing == nullptr) {
+        devMap->readbackRing = new ReadbackRing();
+        devMap->readbackRing->encoder = std::thread(readbackEncoderThread, devMap->readbackRing);
     }
-    file.close();
+    ReadbackRing *ring = devMap->readbackRing;
+
+    // Wait until the oldest screenshot is written
+    uint32_t index;
+    {
+        std::unique_lock<std::mutex> lock(ring->mutex);
+        index = ring->next;
+        ring->cond.wait(lock, [ring, index] { return !ring->busy[index]; });
+        ring->next = (index + 1) % readbackSlotCount;
+    }
+
+    ScreenshotReadback *data = &ring->slots[index];
+    if (!prepareReadback(data, filename, image, queue)) return false;
+
+    vector<VkPipelineStageFlags> waitStages(pPresentInfo->waitSemaphoreCount, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    VkSubmitInfo submitInfo;
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = NULL;
+    submitInfo.waitSemaphoreCount = pPresentInfo->waitSemaphoreCount;
+    submitInfo.pWaitSemaphores = pPresentInfo->pWaitSemaphores;
+    submitInfo.pWaitDstStageMask = waitStages.data();
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &data->commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &data->semaphore;
+
+    VkResult err = devMap->device_dispatch_table->QueueSubmit(queue, 1, &submitInfo, data->fence);
+    assert(!err);
+    if (VK_SUCCESS != err) return false;
 
-    // Clean up handled by ~WritePPMCleanupData()
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    ring->busy[index] = true;
+    ring->pending.push_back(index);
+    ring->cond.notify_all();
+    *pSemaphore = data->semaphore;
     return true;
 }
 
+// Write the screenshots still in flight and free the ring.
+static void destroyReadbackRing(VkDevice device, VkLayerDispatchTable *pDisp, ReadbackRing *ring) {
+    {
+        std::lock_guard<std::mutex> lock(ring->mutex);
+        ring->exiting = true;
+        ring->cond.notify_all();
+    }
+    ring->encoder.join();
+    // The presents may still be waiting for the slot semaphores
+    pDisp->DeviceWaitIdle(device);
+    delete ring;
+}
+
 VKAPI_ATTR VkResult VKAPI_CALL CreateInstance(const VkInstanceCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator,
                                               VkInstance *pInstance) {
     VkLayerInstanceCreateInfo *chain_info = get_chain_info(pCreateInfo, VK_LAYER_LINK_INFO);
@@ -1284,6 +1591,7 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateDevice(VkPhysicalDevice gpu, const VkDevice
     createDeviceRegisterExtensions(pCreateInfo, *pDevice);
     // Create a mapping from a device to a physicalDevice
     deviceMapElem->physicalDevice = gpu;
+    deviceMapElem->readbackRing = nullptr;
 
     // store the loader callback for initializing created dispatchable objects
     chain_info = get_chain_info(pCreateInfo, VK_LOADER_DATA_CALLBACK);
@@ -1341,6 +1649,11 @@ VKAPI_ATTR void VKAPI_CALL DestroyDevice(VkDevice device, const VkAllocationCall
     DeviceMapStruct *devMap = get_dev_info(device);
     assert(devMap);
     VkLayerDispatchTable *pDisp = devMap->device_dispatch_table;
+    if (devMap->readbackRing != nullptr) {
+        destroyReadbackRing(device, pDisp, devMap->readbackRing);
+        devMap->readbackRing = nullptr;
+    }
+    closeHashLog();
     pDisp->DestroyDevice(device, pAllocator);
 
     if (vk_screenshot_dir_used_env_var) {
@@ -1518,6 +1831,8 @@ VKAPI_ATTR VkResult VKAPI_CALL QueuePresentKHR(VkQueue queue, const VkPresentInf
     DeviceMapStruct *devMap = get_dev_info((VkDevice)queue);
     assert(devMap);
     VkLayerDispatchTable *pDisp = devMap->device_dispatch_table;
+    VkPresentInfoKHR presentInfo = *pPresentInfo;
+    VkSemaphore readbackSemaphore = VK_NULL_HANDLE;
     loader_platform_thread_lock_mutex(&globalLock);
 
     if (!screenshotFrames.empty() || screenShotFrameRange.valid) {
@@ -1531,34 +1846,39 @@ VKAPI_ATTR VkResult VKAPI_CALL QueuePresentKHR(VkQueue queue, const VkPresentInf
             string fileName;
 
             if (vk_screenshot_dir == NULL || strlen(vk_screenshot_dir) == 0) {
-                fileName = to_string(g_frameNumber) + ".ppm";
+                fileName = to_string(g_frameNumber) + screenshotFileExtension();
             } else {
                 fileName = vk_screenshot_dir;
-                fileName += "/" + to_string(g_frameNumber) + ".ppm";
+                fileName += "/" + to_string(g_frameNumber) + screenshotFileExtension();
             }
 
             char buffer[64];
             snprintf(buffer, sizeof(buffer), "%d", g_frameNumber);
             std::string base(buffer);
-            fileName = screenshotPrefix + base + ".ppm";
+            fileName = screenshotPrefix + base + screenshotFileExtension();
 
             VkImage image;
             VkSwapchainKHR swapchain;
             // We'll dump only one image: the first
             swapchain = pPresentInfo->pSwapchains[0];
             image = swapchainMap[swapchain]->imageList[pPresentInfo->pImageIndices[0]];
-            if (devMap->queue != queue) {
-                // Multiple queues are used
+            bool ret;
+            if (queueIndexMap.find(queue) != queueIndexMap.end()) {
+                // The file is written by the encoder thread, the present waits for the copy only
+                ret = submitPresentReadback(devMap, queue, pPresentInfo, fileName.c_str(), image, &readbackSemaphore);
+                if (ret) {
+                    presentInfo.waitSemaphoreCount = 1;
+                    presentInfo.pWaitSemaphores = &readbackSemaphore;
+                }
+            } else {
+                // The copy can't be submitted on this queue, wait for it and take the screenshot on the device queue
                 pDisp->QueueWaitIdle(queue);
+                ret = writePPM(fileName.c_str(), image);
+                if (ret) {
+                    reportScreenshot(fileName.c_str());
+                }
             }
-            bool ret = writePPM(fileName.c_str(), image);
-            if (ret) {
-#ifdef ANDROID
-                __android_log_print(ANDROID_LOG_INFO, "screenshot", "Screen capture file is: %s", fileName.c_str());
-#else
-                printf("Screen capture file is: %s \n", fileName.c_str());
-#endif
-            } else {
+            if (!ret) {
 #ifdef ANDROID
                 __android_log_print(ANDROID_LOG_DEBUG, "screenshot", "Failed to save screenshot to file %s.", fileName.c_str());
 #else
@@ -1599,7 +1919,7 @@ VKAPI_ATTR VkResult VKAPI_CALL QueuePresentKHR(VkQueue queue, const VkPresentInf
     }
     g_frameNumber++;
     loader_platform_thread_unlock_mutex(&globalLock);
-    VkResult result = pDisp->QueuePresentKHR(queue, pPresentInfo);
+    VkResult result = pDisp->QueuePresentKHR(queue, &presentInfo);
     return result;
 }
 
@@ -1679,14 +1999,10 @@ VKAPI_ATTR void VKAPI_CALL CmdBeginRenderPass(VkCommandBuffer commandBuffer, con
             snprintf(buffer, sizeof(buffer), "%d-rp%d-img%d-presubmit", g_frameNumber,
                      renderPassToIndex[pRenderPassBegin->renderPass], imageIndex);
             std::string base(buffer);
-            fileName = screenshotPrefix + base + ".ppm";
+            fileName = screenshotPrefix + base + screenshotFileExtension();
             bool ret = writePPM(fileName.c_str(), *iter);
             if (ret) {
-#ifdef ANDROID
-                __android_log_print(ANDROID_LOG_INFO, "screenshot", "Screen capture file is: %s", fileName.c_str());
-#else
-                printf("Screen capture file is: %s \n", fileName.c_str());
-#endif
+                reportScreenshot(fileName.c_str());
             }
         }
 
@@ -1892,14 +2208,10 @@ VKAPI_ATTR VkResult VKAPI_CALL QueueSubmit(VkQueue queue, uint32_t submitCount,
                             snprintf(buffer, sizeof(buffer), "%d-rp%d-img%d", g_frameNumber, imageMap[*iter]->renderPassIndex,
                                      imageMap[*iter]->imageIndex);
                             std::string base(buffer);
-                            fileName = screenshotPrefix + base + ".ppm";
+                            fileName = screenshotPrefix + base + screenshotFileExtension();
                             bool ret = writePPM(fileName.c_str(), *iter);
                             if (ret) {
-#ifdef ANDROID
-                                __android_log_print(ANDROID_LOG_INFO, "screenshot", "Screen capture file is: %s", fileName.c_str());
-#else
-                                printf("Screen capture file is: %s \n", fileName.c_str());
-#endif
+                                reportScreenshot(fileName.c_str());
                             }
                         }
                     }
@@ -1922,32 +2234,35 @@ static void saveUIFrame(int frameNumber) {
     char filename[filenamelength] = {0};
     int i = 0;
     for (auto e : deviceMemoryToAHWBufInfo) {
-        sprintf(filename, "%s%d_%d.ppm", screenshotPrefix.c_str(), frameNumber, i);
-        std::ofstream file(filename, ios::binary);
-        if (!file.is_open()) {
-            __android_log_print(ANDROID_LOG_ERROR, "screenshot", "Save UI frame failed, file open error.");
-            return ;
-        }
+        snprintf(filename, filenamelength, "%s%d_%d%s", screenshotPrefix.c_str(), frameNumber, i, screenshotFileExtension());
         void* ahwBuf = nullptr;
         int ret = AHardwareBuffer_lock(e.second.buffer, AHARDWAREBUFFER_USAGE_CPU_READ_RARELY, -1, nullptr, &ahwBuf);
         if (ret != 0) {
-            file.close();
             __android_log_print(ANDROID_LOG_ERROR, "screenshot", "Save UI frame %s failed, hardware buffer lock error.", filename);
             continue;
         }
-        // ppm file head
-        file << "P6\n";
-        file << e.second.stride << "\n";
-        file << e.second.height << "\n";
-        file << 255 << "\n";
-        char* ptemp = (char*)ahwBuf;
-        uint32_t size = e.second.stride * e.second.height;
-        for (uint32_t pix = 0; pix < size; pix++) {
-            file.write(ptemp, 3);  //3 is RGB channel
-            ptemp = ptemp + 4;     //4 is RGBA channel
+        // The buffer is RGBA, 4 bytes per pixel
+        if (screenshotEncoding == SCREENSHOT_ENCODING_HASH) {
+            ImageHash frameHash;
+            vector<ImageHash> tileHashes;
+            hashImage(PIXEL_LAYOUT_RGBA8, (const uint8_t*)ahwBuf, e.second.stride, e.second.height, (uint64_t)e.second.stride * 4,
+                      screenshotHashTileSize, frameHash, tileHashes);
+            AHardwareBuffer_unlock(e.second.buffer, nullptr);
+            if (!logFrameHash(filename, e.second.stride, e.second.height, frameHash, tileHashes)) {
+                __android_log_print(ANDROID_LOG_ERROR, "screenshot", "Save UI frame hash failed, file open error.");
+                return ;
+            }
+            i++;
+            continue;
         }
+        vector<uint8_t> encoded;
+        encodeImage(screenshotEncoding, PIXEL_LAYOUT_RGBA8, (const uint8_t*)ahwBuf, e.second.stride, e.second.height,
+                    (uint64_t)e.second.stride * 4, "", encoded);
         AHardwareBuffer_unlock(e.second.buffer, nullptr);
-        file.close();
+        if (!writeImageFile(filename, encoded)) {
+            __android_log_print(ANDROID_LOG_ERROR, "screenshot", "Save UI frame failed, file open error.");
+            return ;
+        }
         i++;
     }
 }
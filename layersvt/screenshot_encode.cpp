@@ -0,0 +1,652 @@
+/*
+ * Copyright (C) 2020 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#include "screenshot_encode.h"
+
+// The x86 paths are built for SSSE3 and F16C whatever the compiler flags, and only used when the CPU has them
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SCREENSHOT_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SCREENSHOT_TARGET(features)
+#else
+#include <cpuid.h>
+#define SCREENSHOT_TARGET(features) __attribute__((target(features)))
+#endif
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+using namespace std;
+
+namespace screenshot {
+
+PixelLayout pixelLayoutFromFormat(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_R8_UNORM:
+        case VK_FORMAT_R8_SNORM:
+        case VK_FORMAT_R8_USCALED:
+        case VK_FORMAT_R8_SSCALED:
+        case VK_FORMAT_R8_UINT:
+        case VK_FORMAT_R8_SINT:
+        case VK_FORMAT_R8_SRGB:
+            return PIXEL_LAYOUT_R8;
+        case VK_FORMAT_R8G8_UNORM:
+        case VK_FORMAT_R8G8_SNORM:
+        case VK_FORMAT_R8G8_USCALED:
+        case VK_FORMAT_R8G8_SSCALED:
+        case VK_FORMAT_R8G8_UINT:
+        case VK_FORMAT_R8G8_SINT:
+        case VK_FORMAT_R8G8_SRGB:
+            return PIXEL_LAYOUT_RG8;
+        case VK_FORMAT_R8G8B8_UNORM:
+        case VK_FORMAT_R8G8B8_SNORM:
+        case VK_FORMAT_R8G8B8_USCALED:
+        case VK_FORMAT_R8G8B8_SSCALED:
+        case VK_FORMAT_R8G8B8_UINT:
+        case VK_FORMAT_R8G8B8_SINT:
+        case VK_FORMAT_R8G8B8_SRGB:
+            return PIXEL_LAYOUT_RGB8;
+        case VK_FORMAT_B8G8R8_UNORM:
+        case VK_FORMAT_B8G8R8_SNORM:
+        case VK_FORMAT_B8G8R8_USCALED:
+        case VK_FORMAT_B8G8R8_SSCALED:
+        case VK_FORMAT_B8G8R8_UINT:
+        case VK_FORMAT_B8G8R8_SINT:
+        case VK_FORMAT_B8G8R8_SRGB:
+            return PIXEL_LAYOUT_BGR8;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SNORM:
+        case VK_FORMAT_R8G8B8A8_USCALED:
+        case VK_FORMAT_R8G8B8A8_SSCALED:
+        case VK_FORMAT_R8G8B8A8_UINT:
+        case VK_FORMAT_R8G8B8A8_SINT:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
+        case VK_FORMAT_A8B8G8R8_SNORM_PACK32:
+        case VK_FORMAT_A8B8G8R8_USCALED_PACK32:
+        case VK_FORMAT_A8B8G8R8_SSCALED_PACK32:
+        case VK_FORMAT_A8B8G8R8_UINT_PACK32:
+        case VK_FORMAT_A8B8G8R8_SINT_PACK32:
+        case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+            return PIXEL_LAYOUT_RGBA8;
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SNORM:
+        case VK_FORMAT_B8G8R8A8_USCALED:
+        case VK_FORMAT_B8G8R8A8_SSCALED:
+        case VK_FORMAT_B8G8R8A8_UINT:
+        case VK_FORMAT_B8G8R8A8_SINT:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            return PIXEL_LAYOUT_BGRA8;
+        case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+        case VK_FORMAT_A2B10G10R10_SNORM_PACK32:
+        case VK_FORMAT_A2B10G10R10_USCALED_PACK32:
+        case VK_FORMAT_A2B10G10R10_SSCALED_PACK32:
+        case VK_FORMAT_A2B10G10R10_UINT_PACK32:
+        case VK_FORMAT_A2B10G10R10_SINT_PACK32:
+            return PIXEL_LAYOUT_RGB10A2;
+        case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+        case VK_FORMAT_A2R10G10B10_SNORM_PACK32:
+        case VK_FORMAT_A2R10G10B10_USCALED_PACK32:
+        case VK_FORMAT_A2R10G10B10_SSCALED_PACK32:
+        case VK_FORMAT_A2R10G10B10_UINT_PACK32:
+        case VK_FORMAT_A2R10G10B10_SINT_PACK32:
+            return PIXEL_LAYOUT_BGR10A2;
+        case VK_FORMAT_R16_SFLOAT:
+            return PIXEL_LAYOUT_R16F;
+        case VK_FORMAT_R16G16_SFLOAT:
+            return PIXEL_LAYOUT_RG16F;
+        case VK_FORMAT_R16G16B16_SFLOAT:
+            return PIXEL_LAYOUT_RGB16F;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+            return PIXEL_LAYOUT_RGBA16F;
+        default:
+            return PIXEL_LAYOUT_UNKNOWN;
+    }
+}
+
+uint32_t pixelLayoutSize(PixelLayout layout) {
+    switch (layout) {
+        case PIXEL_LAYOUT_R8:
+            return 1;
+        case PIXEL_LAYOUT_RG8:
+        case PIXEL_LAYOUT_R16F:
+            return 2;
+        case PIXEL_LAYOUT_RGB8:
+        case PIXEL_LAYOUT_BGR8:
+            return 3;
+        case PIXEL_LAYOUT_RGBA8:
+        case PIXEL_LAYOUT_BGRA8:
+        case PIXEL_LAYOUT_RGB10A2:
+        case PIXEL_LAYOUT_BGR10A2:
+        case PIXEL_LAYOUT_RG16F:
+            return 4;
+        case PIXEL_LAYOUT_RGB16F:
+            return 6;
+        case PIXEL_LAYOUT_RGBA16F:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+static inline float halfToFloat(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1f;
+    uint32_t mantissa = h & 0x3ff;
+    uint32_t bits;
+    if (exponent == 0) {
+        // Zero or denormal
+        float f = ldexpf((float)mantissa, -24);
+        return sign ? -f : f;
+    } else if (exponent == 31) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static inline uint8_t floatToByte(float f) {
+    // NaN and negative values give 0
+    if (!(f > 0.0f)) return 0;
+    if (f >= 1.0f) return 255;
+    return (uint8_t)(f * 255.0f + 0.5f);
+}
+
+#if defined(SCREENSHOT_X86)
+static void cpuid1(unsigned int &ecx) {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    ecx = (unsigned int)info[2];
+#else
+    unsigned int eax, ebx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        ecx = 0;
+    }
+#endif
+}
+
+static bool cpuHasSsse3() {
+    unsigned int ecx;
+    cpuid1(ecx);
+    return (ecx & (1u << 9)) != 0;
+}
+
+// F16C instructions are VEX encoded, so the OS must also save the AVX registers
+static bool cpuHasF16c() {
+    unsigned int ecx;
+    cpuid1(ecx);
+    if ((ecx & (1u << 29)) == 0 || (ecx & (1u << 27)) == 0) {
+        return false;
+    }
+#if defined(_MSC_VER)
+    unsigned long long xcr0 = _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    unsigned long long xcr0 = ((unsigned long long)edx << 32) | eax;
+#endif
+    return (xcr0 & 6) == 6;
+}
+
+// Converts RGBA8, or BGRA8 with 'swapRB', 4 pixels at a time. Returns the number of pixels converted. Each store writes 16
+// bytes of which 12 are valid, the next store overwrites the rest.
+SCREENSHOT_TARGET("ssse3")
+static uint32_t convertRow8888Ssse3(const uint8_t *src, uint8_t *dst, uint32_t width, bool swapRB) {
+    const __m128i mask = swapRB ? _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)
+                                : _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    uint32_t x = 0;
+    for (; x + 8 <= width; x += 4) {
+        __m128i pixels = _mm_loadu_si128((const __m128i *)(src + x * 4));
+        _mm_storeu_si128((__m128i *)(dst + x * 3), _mm_shuffle_epi8(pixels, mask));
+    }
+    return x;
+}
+
+SCREENSHOT_TARGET("f16c")
+static uint32_t convertRowRGBA16FF16c(const uint8_t *src, uint8_t *dst, uint32_t width) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(255.0f);
+    uint32_t x = 0;
+    for (; x + 2 <= width; x++) {
+        // max() returns its second operand for NaN, so NaN gives 0 like floatToByte()
+        __m128 f = _mm_cvtph_ps(_mm_loadl_epi64((const __m128i *)(src + x * 8)));
+        f = _mm_min_ps(_mm_max_ps(f, zero), one);
+        __m128i i = _mm_cvtps_epi32(_mm_mul_ps(f, scale));
+        i = _mm_packus_epi16(_mm_packs_epi32(i, i), i);
+        uint32_t rgba = (uint32_t)_mm_cvtsi128_si32(i);
+        // Writes 4 bytes, the 4th is overwritten by the next pixel
+        memcpy(dst + x * 3, &rgba, sizeof(rgba));
+    }
+    return x;
+}
+#endif
+
+static void convertRowRGBA8(const uint8_t *src, uint8_t *dst, uint32_t width) {
+    uint32_t x = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x4_t rgba = vld4q_u8(src + x * 4);
+        uint8x16x3_t rgb;
+        rgb.val[0] = rgba.val[0];
+        rgb.val[1] = rgba.val[1];
+        rgb.val[2] = rgba.val[2];
+        vst3q_u8(dst + x * 3, rgb);
+    }
+#elif defined(SCREENSHOT_X86)
+    static const bool ssse3 = cpuHasSsse3();
+    if (ssse3) {
+        x = convertRow8888Ssse3(src, dst, width, false);
+    }
+#endif
+    for (; x < width; x++) {
+        dst[x * 3 + 0] = src[x * 4 + 0];
+        dst[x * 3 + 1] = src[x * 4 + 1];
+        dst[x * 3 + 2] = src[x * 4 + 2];
+    }
+}
+
+static void convertRowBGRA8(const uint8_t *src, uint8_t *dst, uint32_t width) {
+    uint32_t x = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x4_t bgra = vld4q_u8(src + x * 4);
+        uint8x16x3_t rgb;
+        rgb.val[0] = bgra.val[2];
+        rgb.val[1] = bgra.val[1];
+        rgb.val[2] = bgra.val[0];
+        vst3q_u8(dst + x * 3, rgb);
+    }
+#elif defined(SCREENSHOT_X86)
+    static const bool ssse3 = cpuHasSsse3();
+    if (ssse3) {
+        x = convertRow8888Ssse3(src, dst, width, true);
+    }
+#endif
+    for (; x < width; x++) {
+        dst[x * 3 + 0] = src[x * 4 + 2];
+        dst[x * 3 + 1] = src[x * 4 + 1];
+        dst[x * 3 + 2] = src[x * 4 + 0];
+    }
+}
+
+// Keeps the 8 most significant bits of the 10-bit channels. 'redShift' is 0 for RGB10A2 and 20 for BGR10A2.
+static void convertRow10A2(const uint8_t *src, uint8_t *dst, uint32_t width, uint32_t redShift) {
+    uint32_t const blueShift = 20 - redShift;
+    uint32_t x = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; x + 8 <= width; x += 8) {
+        uint32x4_t p0 = vld1q_u32((const uint32_t *)(src + x * 4));
+        uint32x4_t p1 = vld1q_u32((const uint32_t *)(src + x * 4 + 16));
+        uint8x8x3_t rgb;
+        rgb.val[0] = vmovn_u16(vcombine_u16(vmovn_u32(vshlq_u32(p0, vdupq_n_s32(-(int32_t)(redShift + 2)))),
+                                            vmovn_u32(vshlq_u32(p1, vdupq_n_s32(-(int32_t)(redShift + 2))))));
+        rgb.val[1] = vmovn_u16(vcombine_u16(vmovn_u32(vshrq_n_u32(p0, 12)), vmovn_u32(vshrq_n_u32(p1, 12))));
+        rgb.val[2] = vmovn_u16(vcombine_u16(vmovn_u32(vshlq_u32(p0, vdupq_n_s32(-(int32_t)(blueShift + 2)))),
+                                            vmovn_u32(vshlq_u32(p1, vdupq_n_s32(-(int32_t)(blueShift + 2))))));
+        vst3_u8(dst + x * 3, rgb);
+    }
+#endif
+    for (; x < width; x++) {
+        uint32_t pixel;
+        memcpy(&pixel, src + x * 4, sizeof(pixel));
+        dst[x * 3 + 0] = (uint8_t)(pixel >> (redShift + 2));
+        dst[x * 3 + 1] = (uint8_t)(pixel >> 12);
+        dst[x * 3 + 2] = (uint8_t)(pixel >> (blueShift + 2));
+    }
+}
+
+static void convertRowRGBA16F(const uint8_t *src, uint8_t *dst, uint32_t width) {
+    uint32_t x = 0;
+#if defined(SCREENSHOT_X86)
+    static const bool f16c = cpuHasF16c();
+    if (f16c) {
+        x = convertRowRGBA16FF16c(src, dst, width);
+    }
+#elif defined(__aarch64__)
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    for (; x + 2 <= width; x++) {
+        float32x4_t f = vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16((const uint16_t *)(src + x * 8))));
+        f = vminq_f32(vmaxq_f32(f, zero), one);
+        uint32x4_t i = vcvtnq_u32_f32(vmulq_n_f32(f, 255.0f));
+        uint8x8_t b = vmovn_u16(vcombine_u16(vmovn_u32(i), vmovn_u32(i)));
+        vst1_lane_u32((uint32_t *)(dst + x * 3), vreinterpret_u32_u8(b), 0);
+    }
+#endif
+    for (; x < width; x++) {
+        const uint16_t *pixel = (const uint16_t *)(src + x * 8);
+        dst[x * 3 + 0] = floatToByte(halfToFloat(pixel[0]));
+        dst[x * 3 + 1] = floatToByte(halfToFloat(pixel[1]));
+        dst[x * 3 + 2] = floatToByte(halfToFloat(pixel[2]));
+    }
+}
+
+void convertRowToRGB8(PixelLayout layout, const uint8_t *src, uint8_t *dst, uint32_t width) {
+    switch (layout) {
+        case PIXEL_LAYOUT_R8:
+            for (uint32_t x = 0; x < width; x++) {
+                dst[x * 3 + 0] = src[x];
+                dst[x * 3 + 1] = 0;
+                dst[x * 3 + 2] = 0;
+            }
+            break;
+        case PIXEL_LAYOUT_RG8:
+            for (uint32_t x = 0; x < width; x++) {
+                dst[x * 3 + 0] = src[x * 2 + 0];
+                dst[x * 3 + 1] = src[x * 2 + 1];
+                dst[x * 3 + 2] = 0;
+            }
+            break;
+        case PIXEL_LAYOUT_RGB8:
+            memcpy(dst, src, (size_t)width * 3);
+            break;
+        case PIXEL_LAYOUT_BGR8:
+            for (uint32_t x = 0; x < width; x++) {
+                dst[x * 3 + 0] = src[x * 3 + 2];
+                dst[x * 3 + 1] = src[x * 3 + 1];
+                dst[x * 3 + 2] = src[x * 3 + 0];
+            }
+            break;
+        case PIXEL_LAYOUT_RGBA8:
+            convertRowRGBA8(src, dst, width);
+            break;
+        case PIXEL_LAYOUT_BGRA8:
+            convertRowBGRA8(src, dst, width);
+            break;
+        case PIXEL_LAYOUT_RGB10A2:
+            convertRow10A2(src, dst, width, 0);
+            break;
+        case PIXEL_LAYOUT_BGR10A2:
+            convertRow10A2(src, dst, width, 20);
+            break;
+        case PIXEL_LAYOUT_RGBA16F:
+            convertRowRGBA16F(src, dst, width);
+            break;
+        case PIXEL_LAYOUT_R16F:
+        case PIXEL_LAYOUT_RG16F:
+        case PIXEL_LAYOUT_RGB16F: {
+            uint32_t const channels = pixelLayoutSize(layout) / 2;
+            const uint16_t *halves = (const uint16_t *)src;
+            for (uint32_t x = 0; x < width; x++) {
+                for (uint32_t c = 0; c < 3; c++) {
+                    dst[x * 3 + c] = c < channels ? floatToByte(halfToFloat(halves[x * channels + c])) : 0;
+                }
+            }
+            break;
+        }
+        default:
+            memset(dst, 0, (size_t)width * 3);
+            break;
+    }
+}
+
+// QOI encoder, see https://qoiformat.org/qoi-specification.pdf
+static const uint8_t QOI_OP_INDEX = 0x00;
+static const uint8_t QOI_OP_DIFF = 0x40;
+static const uint8_t QOI_OP_LUMA = 0x80;
+static const uint8_t QOI_OP_RUN = 0xc0;
+static const uint8_t QOI_OP_RGB = 0xfe;
+
+static inline void appendBigEndian32(vector<uint8_t> &output, uint32_t value) {
+    output.push_back((uint8_t)(value >> 24));
+    output.push_back((uint8_t)(value >> 16));
+    output.push_back((uint8_t)(value >> 8));
+    output.push_back((uint8_t)value);
+}
+
+static void encodeQOI(PixelLayout layout, const uint8_t *pixels, uint32_t width, uint32_t height, uint64_t rowPitch,
+                      vector<uint8_t> &output) {
+    output.reserve(14 + (size_t)width * height * 4 + 8);
+    const uint8_t magic[4] = {'q', 'o', 'i', 'f'};
+    output.insert(output.end(), magic, magic + 4);
+    appendBigEndian32(output, width);
+    appendBigEndian32(output, height);
+    output.push_back(3);  // RGB
+    output.push_back(0);  // sRGB with linear alpha
+
+    // All the screenshots are opaque, so pixels are packed as 0xffBBGGRR and QOI_OP_RGBA is never needed
+    uint32_t index[64] = {};
+    uint32_t previous = 0xff000000;
+    uint32_t run = 0;
+    vector<uint8_t> row((size_t)width * 3);
+    for (uint32_t y = 0; y < height; y++) {
+        convertRowToRGB8(layout, pixels + y * rowPitch, row.data(), width);
+        const uint8_t *rgb = row.data();
+        for (uint32_t x = 0; x < width; x++, rgb += 3) {
+            uint32_t pixel = 0xff000000 | ((uint32_t)rgb[2] << 16) | ((uint32_t)rgb[1] << 8) | rgb[0];
+            if (pixel == previous) {
+                run++;
+                if (run == 62) {
+                    output.push_back(QOI_OP_RUN | (uint8_t)(run - 1));
+                    run = 0;
+                }
+                continue;
+            }
+            if (run > 0) {
+                output.push_back(QOI_OP_RUN | (uint8_t)(run - 1));
+                run = 0;
+            }
+
+            uint32_t hash = (rgb[0] * 3 + rgb[1] * 5 + rgb[2] * 7 + 255 * 11) % 64;
+            if (index[hash] == pixel) {
+                output.push_back(QOI_OP_INDEX | (uint8_t)hash);
+            } else {
+                index[hash] = pixel;
+                int8_t dr = (int8_t)(rgb[0] - (uint8_t)previous);
+                int8_t dg = (int8_t)(rgb[1] - (uint8_t)(previous >> 8));
+                int8_t db = (int8_t)(rgb[2] - (uint8_t)(previous >> 16));
+                int8_t dr_dg = (int8_t)(dr - dg);
+                int8_t db_dg = (int8_t)(db - dg);
+                if (dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2) {
+                    output.push_back(QOI_OP_DIFF | (uint8_t)((dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+                } else if (dr_dg > -9 && dr_dg < 8 && dg > -33 && dg < 32 && db_dg > -9 && db_dg < 8) {
+                    output.push_back(QOI_OP_LUMA | (uint8_t)(dg + 32));
+                    output.push_back((uint8_t)((dr_dg + 8) << 4 | (db_dg + 8)));
+                } else {
+                    output.push_back(QOI_OP_RGB);
+                    output.push_back(rgb[0]);
+                    output.push_back(rgb[1]);
+                    output.push_back(rgb[2]);
+                }
+            }
+            previous = pixel;
+        }
+    }
+    if (run > 0) {
+        output.push_back(QOI_OP_RUN | (uint8_t)(run - 1));
+    }
+    const uint8_t end[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    output.insert(output.end(), end, end + 8);
+}
+
+void encodeImage(ScreenshotEncoding encoding, PixelLayout layout, const uint8_t *pixels, uint32_t width, uint32_t height,
+                 uint64_t rowPitch, const string &comment, vector<uint8_t> &output) {
+    output.clear();
+    if (encoding == SCREENSHOT_ENCODING_QOI) {
+        encodeQOI(layout, pixels, width, height, rowPitch, output);
+        return;
+    }
+
+    string header = "P6\n" + comment + to_string(width) + "\n" + to_string(height) + "\n255\n";
+    output.resize(header.size() + (size_t)width * height * 3);
+    memcpy(output.data(), header.data(), header.size());
+    uint8_t *dst = output.data() + header.size();
+    for (uint32_t y = 0; y < height; y++) {
+        convertRowToRGB8(layout, pixels + y * rowPitch, dst, width);
+        dst += (size_t)width * 3;
+    }
+}
+
+void encodeImageHex(const uint8_t *pixels, uint32_t width, uint32_t height, uint64_t rowPitch, const string &comment,
+                    vector<uint8_t> &output) {
+    static const char digits[] = "0123456789abcdef";
+    output.clear();
+    output.reserve(comment.size() + (size_t)width * height * 9);
+    output.insert(output.end(), comment.begin(), comment.end());
+    uint32_t column = 0;
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t *row = pixels + y * rowPitch;
+        for (uint32_t x = 0; x < width; x++) {
+            uint32_t pixelValue;
+            memcpy(&pixelValue, row + x * 4, sizeof(pixelValue));
+            for (int shift = 28; shift >= 0; shift -= 4) {
+                output.push_back(digits[(pixelValue >> shift) & 0xf]);
+            }
+            column++;
+            if (column == 4) {
+                output.push_back('\n');
+                column = 0;
+            } else {
+                output.push_back(' ');
+            }
+        }
+    }
+}
+
+static inline uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+static inline uint64_t fmix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+ImageHash hash128(const void *data, size_t size, uint64_t seed) {
+    static const uint64_t c1 = 0x87c37b91114253d5ULL;
+    static const uint64_t c2 = 0x4cf5ad432745937fULL;
+    const uint8_t *bytes = (const uint8_t *)data;
+    size_t const blocks = size / 16;
+    uint64_t h1 = seed;
+    uint64_t h2 = seed;
+
+    for (size_t i = 0; i < blocks; i++) {
+        uint64_t k1, k2;
+        memcpy(&k1, bytes + i * 16, sizeof(k1));
+        memcpy(&k2, bytes + i * 16 + 8, sizeof(k2));
+
+        k1 *= c1;
+        k1 = rotl64(k1, 31);
+        k1 *= c2;
+        h1 ^= k1;
+        h1 = rotl64(h1, 27);
+        h1 += h2;
+        h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= c2;
+        k2 = rotl64(k2, 33);
+        k2 *= c1;
+        h2 ^= k2;
+        h2 = rotl64(h2, 31);
+        h2 += h1;
+        h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    const uint8_t *tail = bytes + blocks * 16;
+    size_t const rest = size & 15;
+    uint64_t k1 = 0;
+    uint64_t k2 = 0;
+    for (size_t i = 8; i < rest; i++) {
+        k2 ^= (uint64_t)tail[i] << ((i - 8) * 8);
+    }
+    for (size_t i = 0; i < rest && i < 8; i++) {
+        k1 ^= (uint64_t)tail[i] << (i * 8);
+    }
+    if (rest > 8) {
+        k2 *= c2;
+        k2 = rotl64(k2, 33);
+        k2 *= c1;
+        h2 ^= k2;
+    }
+    if (rest > 0) {
+        k1 *= c1;
+        k1 = rotl64(k1, 31);
+        k1 *= c2;
+        h1 ^= k1;
+    }
+
+    h1 ^= (uint64_t)size;
+    h2 ^= (uint64_t)size;
+    h1 += h2;
+    h2 += h1;
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+    h1 += h2;
+    h2 += h1;
+
+    ImageHash hash = {h1, h2};
+    return hash;
+}
+
+string hashToString(const ImageHash &hash) {
+    char text[33];
+    snprintf(text, sizeof(text), "%016llx%016llx", (unsigned long long)hash.high, (unsigned long long)hash.low);
+    return string(text);
+}
+
+void hashImage(PixelLayout layout, const uint8_t *pixels, uint32_t width, uint32_t height, uint64_t rowPitch, uint32_t tileSize,
+               ImageHash &frameHash, vector<ImageHash> &tileHashes) {
+    size_t const rgbPitch = (size_t)width * 3;
+    vector<uint8_t> rgb(rgbPitch * height);
+    for (uint32_t y = 0; y < height; y++) {
+        convertRowToRGB8(layout, pixels + y * rowPitch, rgb.data() + y * rgbPitch, width);
+    }
+    frameHash = hash128(rgb.data(), rgb.size(), 0);
+
+    tileHashes.clear();
+    if (tileSize == 0) {
+        return;
+    }
+    // A tile larger than the image would only size the scratch buffer from the user setting.
+    tileSize = min(tileSize, max(width, height));
+    vector<uint8_t> tile((size_t)tileSize * tileSize * 3);
+    for (uint32_t ty = 0; ty < height; ty += tileSize) {
+        uint32_t const tileHeight = min(tileSize, height - ty);
+        for (uint32_t tx = 0; tx < width; tx += tileSize) {
+            size_t const tilePitch = (size_t)min(tileSize, width - tx) * 3;
+            for (uint32_t y = 0; y < tileHeight; y++) {
+                memcpy(tile.data() + y * tilePitch, rgb.data() + (ty + y) * rgbPitch + (size_t)tx * 3, tilePitch);
+            }
+            tileHashes.push_back(hash128(tile.data(), tilePitch * tileHeight, 0));
+        }
+    }
+}
+
+bool writeImageFile(const char *filename, const vector<uint8_t> &data) {
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) {
+        return false;
+    }
+    bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+    return fclose(file) == 0 && ok;
+}
+
+}  // namespace screenshot
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2020 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace screenshot {
+
+typedef enum ScreenshotEncoding {
+    SCREENSHOT_ENCODING_PPM = 0,   // binary PPM, uncompressed
+    SCREENSHOT_ENCODING_QOI = 1,   // "Quite OK Image" format, lossless and several times smaller than PPM
+    SCREENSHOT_ENCODING_HASH = 2,  // no image, only the hash of each frame in a log
+} ScreenshotEncoding;
+
+typedef struct ImageHash {
+    uint64_t low;
+    uint64_t high;
+} ImageHash;
+
+// Memory layout of the pixels read back from the staging image.
+typedef enum PixelLayout {
+    PIXEL_LAYOUT_UNKNOWN = 0,
+    PIXEL_LAYOUT_R8,
+    PIXEL_LAYOUT_RG8,
+    PIXEL_LAYOUT_RGB8,
+    PIXEL_LAYOUT_BGR8,
+    PIXEL_LAYOUT_RGBA8,
+    PIXEL_LAYOUT_BGRA8,
+    PIXEL_LAYOUT_RGB10A2,  // VK_FORMAT_A2B10G10R10_*_PACK32, red in the low bits
+    PIXEL_LAYOUT_BGR10A2,  // VK_FORMAT_A2R10G10B10_*_PACK32, blue in the low bits
+    PIXEL_LAYOUT_R16F,
+    PIXEL_LAYOUT_RG16F,
+    PIXEL_LAYOUT_RGB16F,
+    PIXEL_LAYOUT_RGBA16F,
+} PixelLayout;
+
+// Returns the layout of 'format', or PIXEL_LAYOUT_UNKNOWN if the row kernels can't convert it.
+PixelLayout pixelLayoutFromFormat(VkFormat format);
+
+// Returns the size in bytes of a pixel of 'layout'.
+uint32_t pixelLayoutSize(PixelLayout layout);
+
+// Converts a row of 'width' pixels to 8-bit RGB. Missing channels are written as 0 and floats are clamped to [0, 1].
+void convertRowToRGB8(PixelLayout layout, const uint8_t *src, uint8_t *dst, uint32_t width);
+
+// Encodes an image whose rows are 'rowPitch' bytes apart into 'output'. 'comment' lines are added to the PPM header,
+// they must each end with a new line.
+void encodeImage(ScreenshotEncoding encoding, PixelLayout layout, const uint8_t *pixels, uint32_t width, uint32_t height,
+                 uint64_t rowPitch, const std::string &comment, std::vector<uint8_t> &output);
+
+// Writes the pixels as text, 4 hexadecimal 32-bit values per line. Used for formats which can't be converted to RGB.
+void encodeImageHex(const uint8_t *pixels, uint32_t width, uint32_t height, uint64_t rowPitch, const std::string &comment,
+                    std::vector<uint8_t> &output);
+
+// 128-bit hash of 'size' bytes (MurmurHash3 x64_128), fast enough to hash every presented frame.
+ImageHash hash128(const void *data, size_t size, uint64_t seed);
+
+// Returns the hash as 32 hexadecimal digits, most significant first.
+std::string hashToString(const ImageHash &hash);
+
+// Hashes the image converted to 8-bit RGB, so the frame hash is the hash of the pixel data of the equivalent PPM file.
+// If 'tileSize' isn't 0, 'tileHashes' gets the hashes of the tileSize x tileSize tiles in row-major order, those of the
+// last row and column may be smaller.
+void hashImage(PixelLayout layout, const uint8_t *pixels, uint32_t width, uint32_t height, uint64_t rowPitch, uint32_t tileSize,
+               ImageHash &frameHash, std::vector<ImageHash> &tileHashes);
+
+// Writes 'data' to 'filename' at once. Returns false if the file can't be written.
+bool writeImageFile(const char *filename, const std::vector<uint8_t> &data);
+
+}  // namespace screenshot
@@ -19,7 +19,7 @@
 #
 # Currently, the API cost layer generates the following files from the following strings:
 #   * api_cost.cpp: APICOST_CODEGEN - Provides all entrypoints for functions and dispatches the calls
-#       to the proper back end
+#       to the proper back end. Every entrypoint gets a compile-time ID which indexes the cost counters.
 #
 
 import os,re,sys,string
@@ -49,6 +49,24 @@ APICOST_CODEGEN = """
 
 #include "api_cost.h"
 
+//============================= Entrypoint IDs ==============================//
+
+// Compile-time IDs of the entrypoints, they index the per-thread counters
+enum ApiCostId : uint32_t {{
+@foreach function
+    APICOST_ID_{funcName},
+@end function
+    APICOST_ID_COUNT
+}};
+
+const char *const kApiCostNames[] = {{
+@foreach function
+    "{funcName}",
+@end function
+}};
+
+const uint32_t kApiCostCount = APICOST_ID_COUNT;
+
 //============================= API EntryPoints =============================//
 
 // Specifically implemented functions
@@ -74,7 +92,7 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
     uint64_t elapse = ApiCostInstance::current().getCurrentTime() - start;
 
     // Output the API cost
-    ApiCostInstance::current().writeFile("{funcName}",elapse);
+    ApiCostInstance::current().record(APICOST_ID_{funcName}, elapse);
 
     if(result == VK_SUCCESS) {{
         initInstanceTable(*pInstance, fpGetInstanceProcAddr);
@@ -94,7 +112,7 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
     destroy_instance_dispatch_table(key);
 
     // Output the API cost
-    ApiCostInstance::current().writeFile("{funcName}",elapse);
+    ApiCostInstance::current().record(APICOST_ID_{funcName}, elapse);
 }}
 @end function
 
@@ -118,7 +136,7 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
     uint64_t elapse = ApiCostInstance::current().getCurrentTime() - start;
 
     // Output the API cost
-    ApiCostInstance::current().writeFile("{funcName}",elapse);
+    ApiCostInstance::current().record(APICOST_ID_{funcName}, elapse);
 
     if(result == VK_SUCCESS) {{
         initDeviceTable(*pDevice, fpGetDeviceProcAddr);
@@ -139,7 +157,7 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
     destroy_device_dispatch_table(key);
 
     // Output the API cost
-    ApiCostInstance::current().writeFile("{funcName}",elapse);
+    ApiCostInstance::current().record(APICOST_ID_{funcName}, elapse);
 }}
 @end function
 
@@ -190,7 +208,7 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
     uint64_t elapse = ApiCostInstance::current().getCurrentTime() - start;
 
     // Output the API cost
-    ApiCostInstance::current().writeFile("{funcName}",elapse);
+    ApiCostInstance::current().record(APICOST_ID_{funcName}, elapse);
     ApiCostInstance::current().nextFrame();
     return result;
 }}
@@ -206,7 +224,7 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
     uint64_t elapse = ApiCostInstance::current().getCurrentTime() - start;
 
     // Output the API cost
-    ApiCostInstance::current().writeFile("{funcName}",elapse);
+    ApiCostInstance::current().record(APICOST_ID_{funcName}, elapse);
     return result;
 }}
 @end function
@@ -219,7 +237,7 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
     uint64_t elapse = ApiCostInstance::current().getCurrentTime() - start;
 
     // Output the API cost
-    ApiCostInstance::current().writeFile("{funcName}",elapse);
+    ApiCostInstance::current().record(APICOST_ID_{funcName}, elapse);
 }}
 @end function
 
@@ -233,7 +251,7 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
     uint64_t elapse = ApiCostInstance::current().getCurrentTime() - start;
 
     // Output the API cost
-    ApiCostInstance::current().writeFile("{funcName}",elapse);
+    ApiCostInstance::current().record(APICOST_ID_{funcName}, elapse);
     return result;
 }}
 @end function
@@ -246,7 +264,7 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
     uint64_t elapse = ApiCostInstance::current().getCurrentTime() - start;
 
     // Output the API cost
-    ApiCostInstance::current().writeFile("{funcName}",elapse);
+    ApiCostInstance::current().record(APICOST_ID_{funcName}, elapse);
 }}
 @end function
 
@@ -73,17 +73,25 @@ COMMON_CODEGEN = """
  * This file is generated from the Khronos Vulkan XML API Registry.
  */
 
-#include "api_dump_text.h"
-#include "api_dump_html.h"
-#include "api_dump_json.h"
+#include "api_dump_binary.h"
 
 //============================= Dump Functions ==============================//
 
 @foreach function where(not '{funcName}' in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr', 'vkDebugMarkerSetObjectNameEXT','vkSetDebugUtilsObjectNameEXT'])
 inline void dump_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
 {{
+    if (dump_inst.settings().format() == ApiDumpFormat::Binary) {{
+        @if('{funcName}' in TRACKED_STATE)
+        // Recorded in all frames, the decoder tracks the state with it
+        dump_inst.beginBinaryCall();
+        @end if
+        @if('{funcName}' not in TRACKED_STATE)
+        if (dump_inst.shouldDumpOutput()) dump_inst.beginBinaryCall();
+        @end if
+        return;
+    }}
     if (!dump_inst.shouldDumpOutput()) return ;
-    dump_inst.outputMutex()->lock();
+    dump_inst.beginCallOutput();
     switch(dump_inst.settings().format())
     {{
     case ApiDumpFormat::Text:
@@ -95,17 +103,21 @@ inline void dump_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
     case ApiDumpFormat::Json:
         dump_json_head_{funcName}(dump_inst, {funcNamedParams});
         break;
+    default:
+        break;
     }}
-    //Keep lock
 }}
 @end function
 
 @foreach function where('{funcReturn}' != 'void' and not '{funcName}' in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr', 'vkDebugMarkerSetObjectNameEXT','vkSetDebugUtilsObjectNameEXT'])
 inline void dump_body_{funcName}(ApiDumpInstance& dump_inst, {funcReturn} result, {funcTypedParams})
 {{
-    if (!dump_inst.shouldDumpOutput()) return;
+    if (dump_inst.settings().format() == ApiDumpFormat::Binary) {{
+        dump_binary_{funcName}(dump_inst, result, {funcNamedParams});
+        return;
+    }}
+    if (!dump_inst.callOutputStarted()) return;
 
-    //Lock is already held
     switch(dump_inst.settings().format())
     {{
     case ApiDumpFormat::Text:
@@ -117,16 +129,21 @@ inline void dump_body_{funcName}(ApiDumpInstance& dump_inst, {funcReturn} result
     case ApiDumpFormat::Json:
         dump_json_body_{funcName}(dump_inst, result, {funcNamedParams});
         break;
+    default:
+        break;
     }}
-    dump_inst.outputMutex()->unlock();
+    dump_inst.endCallOutput();
 }}
 @end function
 
 @foreach function where('{funcReturn}' == 'void')
 inline void dump_body_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
 {{
-    if (!dump_inst.shouldDumpOutput()) return ;
-    //Lock is already held
+    if (dump_inst.settings().format() == ApiDumpFormat::Binary) {{
+        dump_binary_{funcName}(dump_inst, {funcNamedParams});
+        return;
+    }}
+    if (!dump_inst.callOutputStarted()) return ;
     switch(dump_inst.settings().format())
     {{
     case ApiDumpFormat::Text:
@@ -138,8 +155,10 @@ inline void dump_body_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
     case ApiDumpFormat::Json:
         dump_json_body_{funcName}(dump_inst, {funcNamedParams});
         break;
+    default:
+        break;
     }}
-    dump_inst.outputMutex()->unlock();
+    dump_inst.endCallOutput();
 }}
 @end function
 
@@ -147,18 +166,15 @@ inline void dump_body_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
 @foreach function where('{funcName}' == 'vkDebugMarkerSetObjectNameEXT')
 inline void dump_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
 {{
-    dump_inst.outputMutex()->lock();
-
-    if (pNameInfo->pObjectName)
-    {{
-        dump_inst.object_name_map.insert(std::make_pair<uint64_t, std::string>((uint64_t &&)pNameInfo->object, pNameInfo->pObjectName));
-    }}
-    else
-    {{
-        dump_inst.object_name_map.erase(pNameInfo->object);
+    if (dump_inst.settings().format() == ApiDumpFormat::Binary) {{
+        // Recorded in all frames, the decoder keeps the object names
+        dump_inst.beginBinaryCall();
+        return;
     }}
+    dump_inst.setObjectName((uint64_t)pNameInfo->object, pNameInfo->pObjectName);
 
     if (dump_inst.shouldDumpOutput()) {{
+        dump_inst.beginCallOutput();
         switch(dump_inst.settings().format())
         {{
         case ApiDumpFormat::Text:
@@ -170,49 +186,51 @@ inline void dump_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
         case ApiDumpFormat::Json:
             dump_json_head_{funcName}(dump_inst, {funcNamedParams});
             break;
+        default:
+            break;
         }}
     }}
-
-    //Keep lock
 }}
 @end function
 
 @foreach function where('{funcName}' == 'vkDebugMarkerSetObjectNameEXT')
 inline void dump_body_{funcName}(ApiDumpInstance& dump_inst, {funcReturn} result, {funcTypedParams})
 {{
-    //Lock is already held
-    if (dump_inst.shouldDumpOutput()) {{
-        switch(dump_inst.settings().format())
-        {{
-        case ApiDumpFormat::Text:
-            dump_text_body_{funcName}(dump_inst, result, {funcNamedParams});
-            break;
-        case ApiDumpFormat::Html:
-            dump_html_body_{funcName}(dump_inst, result, {funcNamedParams});
-            break;
-        case ApiDumpFormat::Json:
-            dump_json_body_{funcName}(dump_inst, result, {funcNamedParams});
-            break;
-        }}
+    if (dump_inst.settings().format() == ApiDumpFormat::Binary) {{
+        dump_binary_{funcName}(dump_inst, result, {funcNamedParams});
+        return;
     }}
-
-    dump_inst.outputMutex()->unlock();
+    if (!dump_inst.callOutputStarted()) return;
+    switch(dump_inst.settings().format())
+    {{
+    case ApiDumpFormat::Text:
+        dump_text_body_{funcName}(dump_inst, result, {funcNamedParams});
+        break;
+    case ApiDumpFormat::Html:
+        dump_html_body_{funcName}(dump_inst, result, {funcNamedParams});
+        break;
+    case ApiDumpFormat::Json:
+        dump_json_body_{funcName}(dump_inst, result, {funcNamedParams});
+        break;
+    default:
+        break;
+    }}
+    dump_inst.endCallOutput();
 }}
 @end function
 
 @foreach function where('{funcName}' == 'vkSetDebugUtilsObjectNameEXT')
 inline void dump_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
 {{
-    dump_inst.outputMutex()->lock();
-    if (pNameInfo->pObjectName)
-    {{
-        dump_inst.object_name_map.insert(std::make_pair<uint64_t, std::string>((uint64_t &&)pNameInfo->objectHandle, pNameInfo->pObjectName));
-    }}
-    else
-    {{
-        dump_inst.object_name_map.erase(pNameInfo->objectHandle);
+    if (dump_inst.settings().format() == ApiDumpFormat::Binary) {{
+        // Recorded in all frames, the decoder keeps the object names
+        dump_inst.beginBinaryCall();
+        return;
     }}
+    dump_inst.setObjectName((uint64_t)pNameInfo->objectHandle, pNameInfo->pObjectName);
+
     if (dump_inst.shouldDumpOutput()) {{
+        dump_inst.beginCallOutput();
         switch(dump_inst.settings().format())
         {{
         case ApiDumpFormat::Text:
@@ -224,31 +242,36 @@ inline void dump_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
         case ApiDumpFormat::Json:
             dump_json_head_{funcName}(dump_inst, {funcNamedParams});
             break;
+        default:
+            break;
         }}
     }}
-    //Keep lock
 }}
 @end function
 
 @foreach function where('{funcName}' == 'vkSetDebugUtilsObjectNameEXT')
 inline void dump_body_{funcName}(ApiDumpInstance& dump_inst, {funcReturn} result, {funcTypedParams})
 {{
-    //Lock is already held
-    if (dump_inst.shouldDumpOutput()) {{
-        switch(dump_inst.settings().format())
-        {{
-        case ApiDumpFormat::Text:
-            dump_text_body_{funcName}(dump_inst, result, {funcNamedParams});
-            break;
-        case ApiDumpFormat::Html:
-            dump_html_body_{funcName}(dump_inst, result, {funcNamedParams});
-            break;
-        case ApiDumpFormat::Json:
-            dump_json_body_{funcName}(dump_inst, result, {funcNamedParams});
-            break;
-        }}
+    if (dump_inst.settings().format() == ApiDumpFormat::Binary) {{
+        dump_binary_{funcName}(dump_inst, result, {funcNamedParams});
+        return;
     }}
-    dump_inst.outputMutex()->unlock();
+    if (!dump_inst.callOutputStarted()) return;
+    switch(dump_inst.settings().format())
+    {{
+    case ApiDumpFormat::Text:
+        dump_text_body_{funcName}(dump_inst, result, {funcNamedParams});
+        break;
+    case ApiDumpFormat::Html:
+        dump_html_body_{funcName}(dump_inst, result, {funcNamedParams});
+        break;
+    case ApiDumpFormat::Json:
+        dump_json_body_{funcName}(dump_inst, result, {funcNamedParams});
+        break;
+    default:
+        break;
+    }}
+    dump_inst.endCallOutput();
 }}
 @end function
 
@@ -383,7 +406,6 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 @foreach function where('{funcName}' == 'vkQueuePresentKHR')
 VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 {{
-    ApiDumpInstance::current().outputMutex()->lock();
     dump_head_{funcName}(ApiDumpInstance::current(), {funcNamedParams});
 
     {funcReturn} result = device_dispatch_table({funcDispatchParam})->{funcShortName}({funcNamedParams});
@@ -391,7 +413,6 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
     dump_body_{funcName}(ApiDumpInstance::current(), result, {funcNamedParams});
 
     ApiDumpInstance::current().nextFrame();
-    ApiDumpInstance::current().outputMutex()->unlock();
     return result;
 }}
 @end function
@@ -648,9 +669,9 @@ inline std::ostream& dump_text_{hdlName}(const {hdlName} object, const ApiDumpSe
     if(settings.showAddress()) {{
         settings.stream() << object;
 
-        std::unordered_map<uint64_t, std::string>::const_iterator it = ApiDumpInstance::current().object_name_map.find((uint64_t) object);
-        if (it != ApiDumpInstance::current().object_name_map.end()) {{
-            settings.stream() << " [" << it->second << "]";
+        std::string object_name;
+        if (ApiDumpInstance::current().findObjectName((uint64_t) object, object_name)) {{
+            settings.stream() << " [" << object_name << "]";
         }}
     }} else {{
         settings.stream() << "address";
@@ -1173,9 +1194,9 @@ inline std::ostream& dump_html_{hdlName}(const {hdlName} object, const ApiDumpSe
     if(settings.showAddress()) {{
         settings.stream() << object;
 
-        std::unordered_map<uint64_t, std::string>::const_iterator it = ApiDumpInstance::current().object_name_map.find((uint64_t) object);
-        if (it != ApiDumpInstance::current().object_name_map.end()) {{
-            settings.stream() << "</div><div class='val'>[" << it->second << "]";
+        std::string object_name;
+        if (ApiDumpInstance::current().findObjectName((uint64_t) object, object_name)) {{
+            settings.stream() << "</div><div class='val'>[" << object_name << "]";
         }}
     }} else {{
         settings.stream() << "address";
@@ -1892,17 +1913,12 @@ bool is_union(const char *t)
 
 //========================= Function Implementations ========================//
 
-static bool needFuncComma = false;
-
 @foreach function where(not '{funcName}' in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr'])
 std::ostream& dump_json_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
 {{
     const ApiDumpSettings& settings(dump_inst.settings());
 
-    if(dump_inst.firstFunctionCallOnFrame())
-        needFuncComma = false;
-
-    if (needFuncComma) settings.stream() << ",\\n";
+    dump_inst.writeFuncSeparator(settings.stream());
 
     // Display apicall name
     settings.stream() << settings.indentation(2) << "{{\\n";
@@ -1931,10 +1947,7 @@ std::ostream& dump_json_head_{funcName}Remap{postfixName}(ApiDumpInstance& dump_
 {{
     const ApiDumpSettings& settings(dump_inst.settings());
 
-    if(dump_inst.firstFunctionCallOnFrame())
-        needFuncComma = false;
-
-    if (needFuncComma) settings.stream() << ",\\n";
+    dump_inst.writeFuncSeparator(settings.stream());
 
     // Display apicall name
     settings.stream() << settings.indentation(2) << "{{\\n";
@@ -1963,10 +1976,7 @@ std::ostream& dump_json_head_{funcName}Remap(ApiDumpInstance& dump_inst, {funcTy
 {{
     const ApiDumpSettings& settings(dump_inst.settings());
 
-    if(dump_inst.firstFunctionCallOnFrame())
-        needFuncComma = false;
-
-    if (needFuncComma) settings.stream() << ",\\n";
+    dump_inst.writeFuncSeparator(settings.stream());
 
     // Display apicall name
     settings.stream() << settings.indentation(2) << "{{\\n";
@@ -2032,13 +2042,293 @@ std::ostream& dump_json_body_{funcName}(ApiDumpInstance& dump_inst, {funcTypedPa
         settings.stream() << "\\n" << settings.indentation(3) << "]\\n";
     }}
     settings.stream() << settings.indentation(2) << "}}";
-    needFuncComma = true;
     if (settings.shouldFlush()) settings.stream().flush();
     return settings.stream();
 }}
 @end function
 """
 
+BINARY_CODEGEN = """
+/*
+ * (C) COPYRIGHT 2020 ARM Limited
+ * ALL RIGHTS RESERVED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * This file is generated from the Khronos Vulkan XML API Registry.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include "api_dump_text.h"
+#include "api_dump_html.h"
+#include "api_dump_json.h"
+
+@foreach struct
+inline void encode_binary(ApiDumpBinaryEncoder& enc, const {sctName}& object, uint64_t offset{sctConditionVars});
+@end struct
+@foreach union
+inline void encode_binary(ApiDumpBinaryEncoder& enc, const {unName}& object, uint64_t offset);
+@end union
+
+//======================== pNext Chain Implementation =======================//
+
+// Copies the pNext chain as the printers follow it: the structs they don't know are only printed with their sType.
+inline void encode_binary_pNext(ApiDumpBinaryEncoder& enc, const void* object, uint64_t field)
+{{
+    if (object == NULL) return;
+    switch((int64_t) (static_cast<const VkBaseInStructure*>(object)->sType)) {{
+    @foreach struct where('{sctName}' not in ['VkPipelineViewportStateCreateInfo', 'VkCommandBufferBeginInfo'])
+        @if({sctStructureTypeIndex} != -1)
+    case {sctStructureTypeIndex}:
+        enc.pointer(field, static_cast<const {sctName}*>(object));
+        break;
+        @end if
+    @end struct
+
+    case 47: // VK_STRUCTURE_TYPE_LOADER_INSTANCE_CREATE_INFO
+    case 48: // VK_STRUCTURE_TYPE_LOADER_DEVICE_CREATE_INFO
+    {{
+        uint64_t base = enc.copy(field, static_cast<const VkBaseInStructure*>(object));
+        encode_binary_pNext(enc, static_cast<const VkBaseInStructure*>(object)->pNext, base + offsetof(VkBaseInStructure, pNext));
+        break;
+    }}
+    default:
+    {{
+        uint64_t base = enc.copy(field, static_cast<const VkBaseInStructure*>(object));
+        enc.at<const void*>(base + offsetof(VkBaseInStructure, pNext)) = NULL;
+    }}
+    }}
+}}
+
+//========================== Struct Implementations =========================//
+
+@foreach struct
+inline void encode_binary(ApiDumpBinaryEncoder& enc, const {sctName}& object, uint64_t offset{sctConditionVars})
+{{
+    @foreach member
+    @if('{memName}' == 'pNext')
+    encode_binary_pNext(enc, object.pNext, offset + offsetof({sctName}, pNext));
+    @end if
+    @if({memPtrLevel} == 0 and ({memIsAggregate} or ('{memTypeID}' == 'cstring' and '[' not in '{memType}')))
+    @if('{memCondition}' != 'None')
+    if({memCondition})
+    @end if
+    encode_binary(enc, object.{memName}, offset + offsetof({sctName}, {memName}){memInheritedConditions});
+    @end if
+    @if({memPtrLevel} == 1 and '{memLength}' == 'None')
+    @if('{memCondition}' != 'None')
+    if({memCondition})
+    @end if
+    enc.pointer(offset + offsetof({sctName}, {memName}), object.{memName}{memInheritedConditions});
+    @end if
+    @if({memPtrLevel} == 1 and '{memLength}' != 'None' and not {memLengthIsMember} and {memIsAggregate})
+    for (uint64_t i = 0; i < (uint64_t)({memLength}); ++i)
+        encode_binary(enc, object.{memName}[i], offset + offsetof({sctName}, {memName}) + i * sizeof(object.{memName}[0]){memInheritedConditions});
+    @end if
+    @if({memPtrLevel} == 1 and '{memLength}' != 'None' and {memLengthIsMember})
+    @if('{memCondition}' != 'None')
+    if({memCondition})
+    @end if
+    @if('{memLength}'[0].isdigit() or '{memLength}'[0].isupper())
+    enc.array(offset + offsetof({sctName}, {memName}), object.{memName}, {memLength}{memInheritedConditions});
+    @end if
+    @if(not ('{memLength}'[0].isdigit() or '{memLength}'[0].isupper()))
+    enc.array(offset + offsetof({sctName}, {memName}), object.{memName}, object.{memLength}{memInheritedConditions});
+    @end if
+    @end if
+    @if({memPtrLevel} == 2 and '{memLength}' != 'None' and '{memBaseType}' == 'VkAccelerationStructureGeometryKHR')
+    enc.pointers(offset + offsetof({sctName}, {memName}), object.{memName}, object.{memLength}{memInheritedConditions});
+    @end if
+    @end member
+}}
+@end struct
+
+//========================== Union Implementations ==========================//
+
+@foreach union
+inline void encode_binary(ApiDumpBinaryEncoder& enc, const {unName}& object, uint64_t offset)
+{{
+    @foreach choice
+    @if({chcPtrLevel} == 0 and ({chcIsAggregate} or ('{chcTypeID}' == 'cstring' and '[' not in '{chcType}')))
+    encode_binary(enc, object.{chcName}, offset + offsetof({unName}, {chcName}));
+    @end if
+    @if({chcPtrLevel} == 1 and '{chcLength}' == 'None')
+    enc.pointer(offset + offsetof({unName}, {chcName}), object.{chcName});
+    @end if
+    @if({chcPtrLevel} == 1 and '{chcLength}' != 'None' and {chcIsAggregate})
+    for (uint64_t i = 0; i < (uint64_t)({chcLength}); ++i)
+        encode_binary(enc, object.{chcName}[i], offset + offsetof({unName}, {chcName}) + i * sizeof(object.{chcName}[0]));
+    @end if
+    @end choice
+}}
+@end union
+
+//========================= Function Implementations ========================//
+
+// The parameters of a call, at the start of the data of its record
+
+@foreach function where('{funcName}' not in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr'])
+struct ApiDumpBinary_{funcName}
+{{
+    @if('{funcReturn}' != 'void')
+    {funcReturn} result;
+    @end if
+    @foreach parameter
+    {prmFieldType} {prmName};
+    @end parameter
+}};
+
+@end function
+
+@foreach function where('{funcName}' not in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr'])
+@if('{funcReturn}' != 'void')
+inline void dump_binary_{funcName}(ApiDumpInstance& dump_inst, {funcReturn} result, {funcTypedParams})
+@end if
+@if('{funcReturn}' == 'void')
+inline void dump_binary_{funcName}(ApiDumpInstance& dump_inst, {funcTypedParams})
+@end if
+{{
+    ApiDumpBinaryEncoder* enc = dump_inst.beginBinaryRecord({funcID});
+    if (enc == NULL) return;
+
+    ApiDumpBinary_{funcName} binary = {{}};
+    @if('{funcReturn}' != 'void')
+    binary.result = result;
+    @end if
+    @foreach parameter
+    binary.{prmName} = {prmName};
+    @end parameter
+    enc->append(&binary, sizeof(binary));
+
+    @foreach parameter
+    @if({prmPtrLevel} == 0 and ({prmIsAggregate} or '{prmTypeID}' == 'cstring'))
+    encode_binary(*enc, {prmName}, offsetof(ApiDumpBinary_{funcName}, {prmName}){prmInheritedConditions});
+    @end if
+    @if({prmPtrLevel} == 1 and '{prmLength}' == 'None')
+    enc->pointer(offsetof(ApiDumpBinary_{funcName}, {prmName}), {prmName}{prmInheritedConditions});
+    @end if
+    @if({prmPtrLevel} == 1 and '{prmLength}' != 'None')
+    enc->array(offsetof(ApiDumpBinary_{funcName}, {prmName}), {prmName}, {prmLength}{prmInheritedConditions});
+    @end if
+    @if('{funcName}' == 'vkBuildAccelerationStructuresKHR' and '{prmName}' == 'pInfos')
+    for (uint32_t i = 0; pInfos != NULL && i < infoCount; ++i) {{
+        uint64_t info = enc->target(offsetof(ApiDumpBinary_{funcName}, pInfos)) + i * sizeof(VkAccelerationStructureBuildGeometryInfoKHR);
+        uint64_t geometries = enc->target(info + offsetof(VkAccelerationStructureBuildGeometryInfoKHR, pGeometries));
+        for (uint32_t j = 0; geometries != 0 && j < pInfos[i].geometryCount; ++j) {{
+            if (pInfos[i].pGeometries[j].geometryType == VK_GEOMETRY_TYPE_INSTANCES_KHR) {{
+                enc->array(geometries + j * sizeof(VkAccelerationStructureGeometryKHR) + offsetof(VkAccelerationStructureGeometryKHR, geometry.instances.data.hostAddress),
+                           (const VkAccelerationStructureInstanceKHR*)pInfos[i].pGeometries[j].geometry.instances.data.hostAddress,
+                           ppBuildRangeInfos[i][j].primitiveCount);
+            }}
+        }}
+    }}
+    @end if
+    @if({prmPtrLevel} == 2 and '{prmLength}' != 'None' and '{prmBaseType}' == 'VkAccelerationStructureBuildRangeInfoKHR')
+    uint64_t ranges = enc->copy(offsetof(ApiDumpBinary_{funcName}, {prmName}), {prmName}, {prmLength});
+    for (uint32_t i = 0; {prmName} != NULL && i < {prmLength}; ++i) {{
+        enc->array(ranges + i * sizeof(*{prmName}), {prmName}[i], pInfos[i].geometryCount);
+    }}
+    @end if
+    @end parameter
+    enc->end();
+}}
+@end function
+
+//============================= Decoder Function ============================//
+
+// Only used in api_dump_decode: prints the call of a record made by the layer, of which the pointers are relocated.
+// Returns false if the function is not known or the record is too small for its parameters.
+inline bool dump_binary_record(ApiDumpInstance& dump_inst, uint32_t binary_function, const void* binary_data, uint32_t binary_size)
+{{
+    switch(binary_function)
+    {{
+    @foreach function where('{funcName}' not in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr'])
+    case {funcID}:
+    {{
+        if (binary_size < sizeof(ApiDumpBinary_{funcName})) return false;
+        const ApiDumpBinary_{funcName}& binary = *static_cast<const ApiDumpBinary_{funcName}*>(binary_data);
+        @if('{funcReturn}' != 'void')
+        {funcReturn} result = binary.result;
+        @end if
+        @foreach parameter
+        {prmFieldType} {prmName} = binary.{prmName};
+        @end parameter
+        @if('{funcName}' == 'vkDebugMarkerSetObjectNameEXT')
+        dump_inst.setObjectName((uint64_t)pNameInfo->object, pNameInfo->pObjectName);
+        @end if
+        @if('{funcName}' == 'vkSetDebugUtilsObjectNameEXT')
+        dump_inst.setObjectName((uint64_t)pNameInfo->objectHandle, pNameInfo->pObjectName);
+        @end if
+        if (dump_inst.shouldDumpOutput()) {{
+            switch(dump_inst.settings().format())
+            {{
+            case ApiDumpFormat::Text:
+                dump_text_head_{funcName}(dump_inst, {funcNamedParams});
+                break;
+            case ApiDumpFormat::Html:
+                dump_html_head_{funcName}(dump_inst, {funcNamedParams});
+                break;
+            case ApiDumpFormat::Json:
+                dump_json_head_{funcName}(dump_inst, {funcNamedParams});
+                break;
+            default:
+                break;
+            }}
+        }}
+        {funcStateTrackingCode}
+        if (dump_inst.shouldDumpOutput()) {{
+            switch(dump_inst.settings().format())
+            {{
+            @if('{funcReturn}' != 'void')
+            case ApiDumpFormat::Text:
+                dump_text_body_{funcName}(dump_inst, result, {funcNamedParams});
+                break;
+            case ApiDumpFormat::Html:
+                dump_html_body_{funcName}(dump_inst, result, {funcNamedParams});
+                break;
+            case ApiDumpFormat::Json:
+                dump_json_body_{funcName}(dump_inst, result, {funcNamedParams});
+                break;
+            @end if
+            @if('{funcReturn}' == 'void')
+            case ApiDumpFormat::Text:
+                dump_text_body_{funcName}(dump_inst, {funcNamedParams});
+                break;
+            case ApiDumpFormat::Html:
+                dump_html_body_{funcName}(dump_inst, {funcNamedParams});
+                break;
+            case ApiDumpFormat::Json:
+                dump_json_body_{funcName}(dump_inst, {funcNamedParams});
+                break;
+            @end if
+            default:
+                break;
+            }}
+        }}
+        return true;
+    }}
+    @end function
+    default:
+        return false;
+    }}
+}}
+"""
+
 POINTER_TYPES = ['void', 'xcb_connection_t', 'Display', 'SECURITY_ATTRIBUTES', 'ANativeWindow', 'AHardwareBuffer']
 
 DEFINE_TYPES = ['ANativeWindow', 'AHardwareBuffer']
@@ -2288,6 +2578,20 @@ class ApiDumpOutputGenerator(OutputGenerator):
                                         if sysType not in self.sysTypes:
                                             self.sysTypes.add(sysType)
 
+        # Mark the variables of struct and union types, the binary output copies what they point to
+        aggregates = set(self.aliases)
+        aggregates.update(struct.name for struct in self.structs)
+        aggregates.update(union.name for union in self.unions)
+        for struct in self.structs:
+            for member in struct.members:
+                member.isAggregate = member.typeID in aggregates
+        for union in self.unions:
+            for choice in union.choices:
+                choice.isAggregate = choice.typeID in aggregates
+        for func in self.functions:
+            for param in func.parameters:
+                param.isAggregate = param.typeID in aggregates
+
         # Find every @foreach, @if, and @end
         forIter = re.finditer('(^\\s*\\@foreach\\s+[a-z]+(\\s+where\\(.*\\))?\\s*^)|(\\@foreach [a-z]+(\\s+where\\(.*\\))?\\b)', self.format, flags=re.MULTILINE)
         ifIter = re.finditer('(^\\s*\\@if\\(.*\\)\\s*^)|(\\@if\\(.*\\))', self.format, flags=re.MULTILINE)
@@ -2618,6 +2922,8 @@ class VulkanVariable:
             self.pointerLevels -= 1
         assert(self.pointerLevels >= 0)
 
+        self.isAggregate = False                    # Whether the type is a struct or a union, set once they are all known
+
         self.inheritedConditions = ''
         if self.typeID in INHERITED_STATE and parentName in INHERITED_STATE[self.typeID]:
             for states in INHERITED_STATE[self.typeID][parentName]:
@@ -2855,6 +3161,8 @@ class VulkanFunction:
                 'prmPtrLevel': self.pointerLevels,
                 'prmLength': self.arrayLength,
                 'prmInheritedConditions': self.inheritedConditions,
+                'prmIsAggregate': self.isAggregate,
+                'prmFieldType': self.childType + '*' if '[' in self.type else self.type,
             }
 
     def __init__(self, rootNode, constants, aliases, extensions):
@@ -2886,6 +3194,12 @@ class VulkanFunction:
         if self.name in TRACKED_STATE:
             self.stateTrackingCode = TRACKED_STATE[self.name]
 
+        # Identifies the function in the records of the binary output, FNV-1a hash of the name
+        self.id = 0x811c9dc5
+        for c in self.name.encode():
+            self.id = ((self.id ^ c) * 0x01000193) & 0xffffffff
+        self.id = '0x{:08x}u'.format(self.id)
+
         self.safeToPrint = True
         for param in self.parameters:
             if param.pointerLevels == 1 and param.type.find("const") == -1:
@@ -2894,6 +3208,7 @@ class VulkanFunction:
     def values(self):
         return {
             'funcName': self.name,
+            'funcID': self.id,
             'funcShortName': self.name[2:len(self.name)],
             'funcType': self.type,
             'funcReturn': self.returnType,
@@ -2960,6 +3275,7 @@ class VulkanStruct:
                 'memLengthIsMember': self.lengthMember,
                 'memCondition': self.condition,
                 'memInheritedConditions': self.inheritedConditions,
+                'memIsAggregate': self.isAggregate,
             }
 
 
@@ -3030,6 +3346,7 @@ class VulkanUnion:
                 'chcPtrLevel': self.pointerLevels,
                 'chcLength': self.arrayLength,
                 #'chcLengthIsMember': self.lengthMember,
+                'chcIsAggregate': self.isAggregate,
             }
 
     def __init__(self, rootNode, constants):
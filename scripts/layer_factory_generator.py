@@ -181,6 +181,15 @@ debug_report_data *vlf_report_data = VK_NULL_HANDLE;
 
 #include "layer_factory.h"
 
+// Interceptors overriding each hook, built once at layer init so that every entrypoint only calls those
+static std::vector<layer_factory *> pre_call_interceptors[VLF_HOOK_COUNT];
+static std::vector<layer_factory *> post_call_interceptors[VLF_HOOK_COUNT];
+
+struct vlf_intercept {
+    void *funcptr;
+    uint32_t hook;  // VLF_HOOK_COUNT for the manually written functions, which are always intercepted
+};
+
 struct instance_layer_data {
     VkLayerInstanceDispatchTable dispatch_table;
     VkInstance instance = VK_NULL_HANDLE;
@@ -220,7 +229,27 @@ static const VkLayerProperties global_layer = {
 
 static const VkExtensionProperties instance_extensions[] = {{VK_EXT_DEBUG_REPORT_EXTENSION_NAME, VK_EXT_DEBUG_REPORT_SPEC_VERSION}};
 
-extern const std::unordered_map<std::string, void*> name_to_funcptr_map;
+extern const std::unordered_map<std::string, vlf_intercept> name_to_funcptr_map;
+
+static std::once_flag interceptor_lists_once;
+
+static void InitInterceptorLists() {
+    std::call_once(interceptor_lists_once, [] {
+        for (auto intercept : global_interceptor_list) {
+            for (uint32_t hook = 0; hook < VLF_HOOK_COUNT; hook++) {
+                if (intercept->pre_call_hooks[hook]) pre_call_interceptors[hook].push_back(intercept);
+                if (intercept->post_call_hooks[hook]) post_call_interceptors[hook].push_back(intercept);
+            }
+        }
+    });
+}
+
+// Entrypoints which no interceptor hooks are not wrapped, the application calls the next layer directly
+static bool IsIntercepted(const vlf_intercept &intercept) {
+    InitInterceptorLists();
+    return intercept.hook == VLF_HOOK_COUNT || !pre_call_interceptors[intercept.hook].empty() ||
+           !post_call_interceptors[intercept.hook].empty();
+}
 
 
 // Manually written functions
@@ -229,8 +258,8 @@ VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetDeviceProcAddr(VkDevice device, cons
     assert(device);
     device_layer_data *device_data = GetLayerDataPtr(get_dispatch_key(device), device_layer_data_map);
     const auto &item = name_to_funcptr_map.find(funcName);
-    if (item != name_to_funcptr_map.end()) {
-        return reinterpret_cast<PFN_vkVoidFunction>(item->second);
+    if (item != name_to_funcptr_map.end() && IsIntercepted(item->second)) {
+        return reinterpret_cast<PFN_vkVoidFunction>(item->second.funcptr);
     }
     auto &table = device_data->dispatch_table;
     if (!table.GetDeviceProcAddr) return nullptr;
@@ -240,8 +269,8 @@ VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetDeviceProcAddr(VkDevice device, cons
 VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetInstanceProcAddr(VkInstance instance, const char *funcName) {
     instance_layer_data *instance_data;
     const auto &item = name_to_funcptr_map.find(funcName);
-    if (item != name_to_funcptr_map.end()) {
-        return reinterpret_cast<PFN_vkVoidFunction>(item->second);
+    if (item != name_to_funcptr_map.end() && IsIntercepted(item->second)) {
+        return reinterpret_cast<PFN_vkVoidFunction>(item->second.funcptr);
     }
     instance_data = GetLayerDataPtr(get_dispatch_key(instance), instance_layer_data_map);
     auto &table = instance_data->dispatch_table;
@@ -294,7 +323,8 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateInstance(const VkInstanceCreateInfo *pCreat
     chain_info->u.pLayerInfo = chain_info->u.pLayerInfo->pNext;
 
     // Init dispatch array and call registration functions
-    for (auto intercept : global_interceptor_list) {
+    InitInterceptorLists();
+    for (auto intercept : pre_call_interceptors[VLF_HOOK_CreateInstance]) {
         intercept->PreCallCreateInstance(pCreateInfo, pAllocator, pInstance);
     }
 
@@ -309,7 +339,7 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateInstance(const VkInstanceCreateInfo *pCreat
     layer_debug_messenger_actions(instance_data->report_data, pAllocator, "lunarg_layer_factory");
     vlf_report_data = instance_data->report_data;
 
-    for (auto intercept : global_interceptor_list) {
+    for (auto intercept : post_call_interceptors[VLF_HOOK_CreateInstance]) {
         intercept->PostCallCreateInstance(pCreateInfo, pAllocator, pInstance, result);
     }
 
@@ -319,14 +349,14 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateInstance(const VkInstanceCreateInfo *pCreat
 VKAPI_ATTR void VKAPI_CALL DestroyInstance(VkInstance instance, const VkAllocationCallbacks *pAllocator) {
     dispatch_key key = get_dispatch_key(instance);
     instance_layer_data *instance_data = GetLayerDataPtr(key, instance_layer_data_map);
-    for (auto intercept : global_interceptor_list) {
+    for (auto intercept : pre_call_interceptors[VLF_HOOK_DestroyInstance]) {
         intercept->PreCallDestroyInstance(instance, pAllocator);
     }
 
     instance_data->dispatch_table.DestroyInstance(instance, pAllocator);
 
     lock_guard_t lock(global_lock);
-    for (auto intercept : global_interceptor_list) {
+    for (auto intercept : post_call_interceptors[VLF_HOOK_DestroyInstance]) {
         intercept->PostCallDestroyInstance(instance, pAllocator);
     }
     // Clean up logging callback, if any
@@ -355,7 +385,7 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateDevice(VkPhysicalDevice gpu, const VkDevice
     PFN_vkCreateDevice fpCreateDevice = (PFN_vkCreateDevice)fpGetInstanceProcAddr(instance_data->instance, "vkCreateDevice");
     chain_info->u.pLayerInfo = chain_info->u.pLayerInfo->pNext;
 
-    for (auto intercept : global_interceptor_list) {
+    for (auto intercept : pre_call_interceptors[VLF_HOOK_CreateDevice]) {
         intercept->PreCallCreateDevice(gpu, pCreateInfo, pAllocator, pDevice);
     }
     lock.unlock();
@@ -363,7 +393,7 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateDevice(VkPhysicalDevice gpu, const VkDevice
     VkResult result = fpCreateDevice(gpu, pCreateInfo, pAllocator, pDevice);
 
     lock.lock();
-    for (auto intercept : global_interceptor_list) {
+    for (auto intercept : post_call_interceptors[VLF_HOOK_CreateDevice]) {
         intercept->PostCallCreateDevice(gpu, pCreateInfo, pAllocator, pDevice, result);
     }
     device_layer_data *device_data = GetLayerDataPtr(get_dispatch_key(*pDevice), device_layer_data_map);
@@ -385,7 +415,7 @@ VKAPI_ATTR void VKAPI_CALL DestroyDevice(VkDevice device, const VkAllocationCall
     device_layer_data *device_data = GetLayerDataPtr(key, device_layer_data_map);
 
     unique_lock_t lock(global_lock);
-    for (auto intercept : global_interceptor_list) {
+    for (auto intercept : pre_call_interceptors[VLF_HOOK_DestroyDevice]) {
         intercept->PreCallDestroyDevice(device, pAllocator);
     }
     lock.unlock();
@@ -393,7 +423,7 @@ VKAPI_ATTR void VKAPI_CALL DestroyDevice(VkDevice device, const VkAllocationCall
     device_data->dispatch_table.DestroyDevice(device, pAllocator);
 
     lock.lock();
-    for (auto intercept : global_interceptor_list) {
+    for (auto intercept : post_call_interceptors[VLF_HOOK_DestroyDevice]) {
         intercept->PostCallDestroyDevice(device, pAllocator);
     }
 
@@ -405,12 +435,12 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateDebugReportCallbackEXT(VkInstance instance,
                                                             const VkAllocationCallbacks *pAllocator,
                                                             VkDebugReportCallbackEXT *pCallback) {
     instance_layer_data *instance_data = GetLayerDataPtr(get_dispatch_key(instance), instance_layer_data_map);
-    for (auto intercept : global_interceptor_list) {
+    for (auto intercept : pre_call_interceptors[VLF_HOOK_CreateDebugReportCallbackEXT]) {
         intercept->PreCallCreateDebugReportCallbackEXT(instance, pCreateInfo, pAllocator, pCallback);
     }
     VkResult result = instance_data->dispatch_table.CreateDebugReportCallbackEXT(instance, pCreateInfo, pAllocator, pCallback);
     result = layer_create_report_callback(instance_data->report_data, false, pCreateInfo, pAllocator, pCallback);
-    for (auto intercept : global_interceptor_list) {
+    for (auto intercept : post_call_interceptors[VLF_HOOK_CreateDebugReportCallbackEXT]) {
         intercept->PostCallCreateDebugReportCallbackEXT(instance, pCreateInfo, pAllocator, pCallback, result);
     }
     return result;
@@ -419,15 +449,54 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateDebugReportCallbackEXT(VkInstance instance,
 VKAPI_ATTR void VKAPI_CALL DestroyDebugReportCallbackEXT(VkInstance instance, VkDebugReportCallbackEXT callback,
                                                          const VkAllocationCallbacks *pAllocator) {
     instance_layer_data *instance_data = GetLayerDataPtr(get_dispatch_key(instance), instance_layer_data_map);
-    for (auto intercept : global_interceptor_list) {
+    for (auto intercept : pre_call_interceptors[VLF_HOOK_DestroyDebugReportCallbackEXT]) {
         intercept->PreCallDestroyDebugReportCallbackEXT(instance, callback, pAllocator);
     }
     instance_data->dispatch_table.DestroyDebugReportCallbackEXT(instance, callback, pAllocator);
     layer_destroy_callback(instance_data->report_data, callback, pAllocator);
-    for (auto intercept : global_interceptor_list) {
+    for (auto intercept : post_call_interceptors[VLF_HOOK_DestroyDebugReportCallbackEXT]) {
         intercept->PostCallDestroyDebugReportCallbackEXT(instance, callback, pAllocator);
     }
 }
+"""
+
+    interceptor_template_preamble = """
+// Deduce the class declaring a generic hook: layer_factory unless the interceptor overrides it
+template <typename C>
+std::is_same<C, layer_factory> vlf_api_hook_in_base(void (C::*)(const char *));
+template <typename C>
+std::is_same<C, layer_factory> vlf_api_result_hook_in_base(void (C::*)(const char *, VkResult));
+
+template <typename T>
+auto vlf_pre_api_hook_in_base(int) -> decltype(vlf_api_hook_in_base(&T::PreCallApiFunction));
+template <typename T>
+std::false_type vlf_pre_api_hook_in_base(...);
+template <typename T>
+auto vlf_post_api_hook_in_base(int) -> decltype(vlf_api_hook_in_base(&T::PostCallApiFunction));
+template <typename T>
+std::false_type vlf_post_api_hook_in_base(...);
+template <typename T>
+auto vlf_post_api_result_hook_in_base(int) -> decltype(vlf_api_result_hook_in_base(&T::PostCallApiFunction));
+template <typename T>
+std::false_type vlf_post_api_result_hook_in_base(...);
+
+// Base class of the interceptors which are only called for the hooks they override. The overrides are found at compile
+// time by comparing the types of &T::PreCallX and &layer_factory::PreCallX, so entrypoints that no interceptor hooks
+// are not even wrapped by the layer.
+template <typename T>
+class layer_interceptor : public layer_factory {
+    public:
+        layer_interceptor() {
+            // The default hooks call PreCallApiFunction() and PostCallApiFunction(), overriding these hooks everything
+            bool const generic_pre = !decltype(vlf_pre_api_hook_in_base<T>(0))::value;
+            bool const generic_post = !decltype(vlf_post_api_hook_in_base<T>(0))::value ||
+                                      !decltype(vlf_post_api_result_hook_in_base<T>(0))::value;
+            pre_call_hooks.reset();
+            post_call_hooks.reset();
+"""
+
+    interceptor_template_postamble = """        };
+};
 """
 
     inline_custom_source_postamble = """
@@ -498,6 +567,8 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
         self.sections = dict([(section, []) for section in self.ALL_SECTIONS])
         self.intercepts = []
         self.layer_factory = ''                     # String containing base layer factory class definition
+        self.hook_ids = ''                          # Enum of the entrypoints which can be hooked
+        self.hook_checks = ''                       # Compile-time override checks of layer_interceptor<T>
 
     # Check if the parameter passed in is a pointer to an array
     def paramIsArray(self, param):
@@ -541,6 +612,8 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
                 for s in genOpts.prefixText:
                     write(s, file=self.outFile)
             write('#include "vulkan/vk_layer.h"', file=self.outFile)
+            write('#include <bitset>', file=self.outFile)
+            write('#include <type_traits>', file=self.outFile)
             write('#include <unordered_map>\n', file=self.outFile)
             write('class layer_factory;', file=self.outFile)
             write('extern std::vector<layer_factory *> global_interceptor_list;', file=self.outFile)
@@ -555,8 +628,15 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
         self.layer_factory += '    public:\n'
         self.layer_factory += '        layer_factory() {\n'
         self.layer_factory += '            global_interceptor_list.emplace_back(this);\n'
+        self.layer_factory += '            // Without type information, the interceptor is called for every entrypoint\n'
+        self.layer_factory += '            pre_call_hooks.set();\n'
+        self.layer_factory += '            post_call_hooks.set();\n'
         self.layer_factory += '        };\n'
         self.layer_factory += '\n'
+        self.layer_factory += '        // Hooks this interceptor overrides, indexed by vlf_hook_id. layer_interceptor<T> narrows them down.\n'
+        self.layer_factory += '        std::bitset<VLF_HOOK_COUNT> pre_call_hooks;\n'
+        self.layer_factory += '        std::bitset<VLF_HOOK_COUNT> post_call_hooks;\n'
+        self.layer_factory += '\n'
         self.layer_factory += '        std::string layer_name = "VLF";\n'
         self.layer_factory += '\n'
         self.layer_factory += '        bool log_msg(const debug_report_data *debug_data, VkFlags msg_flags, VkObjectType object_type,\n'
@@ -627,16 +707,25 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
         if not self.header:
             # Record intercepted procedures
             write('// Map of all APIs to be intercepted by this layer', file=self.outFile)
-            write('const std::unordered_map<std::string, void*> name_to_funcptr_map = {', file=self.outFile)
+            write('const std::unordered_map<std::string, vlf_intercept> name_to_funcptr_map = {', file=self.outFile)
             write('\n'.join(self.intercepts), file=self.outFile)
             write('};\n', file=self.outFile)
             self.newline()
         write('} // namespace vulkan_layer_factory', file=self.outFile)
         if self.header:
             self.newline()
+            # Output the hook IDs, indexing the per-entrypoint interceptor lists
+            write('// IDs of the entrypoints which interceptors can hook', file=self.outFile)
+            write('enum vlf_hook_id {', file=self.outFile)
+            write(self.hook_ids, end=u'', file=self.outFile)
+            write('    VLF_HOOK_COUNT', file=self.outFile)
+            write('};\n', file=self.outFile)
             # Output Layer Factory Class Definitions
             self.layer_factory += '};\n'
             write(self.layer_factory, file=self.outFile)
+            write(self.interceptor_template_preamble, file=self.outFile)
+            write(self.hook_checks, end=u'', file=self.outFile)
+            write(self.interceptor_template_postamble, file=self.outFile)
         else:
             write(self.inline_custom_source_postamble, file=self.outFile)
         # Finish processing in superclass
@@ -749,13 +838,21 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
             if (self.featureExtraProtect is not None):
                 self.intercepts += [ '#ifdef %s' % self.featureExtraProtect ]
                 self.layer_factory += '#ifdef %s\n' % self.featureExtraProtect
+                self.hook_ids += '#ifdef %s\n' % self.featureExtraProtect
+                self.hook_checks += '#ifdef %s\n' % self.featureExtraProtect
             # Update base class with virtual function declarations
             self.layer_factory += self.BaseClassCdecl(cmdinfo.elem, name)
+            self.hook_ids += '    VLF_HOOK_%s,\n' % name[2:]
+            for side in ['pre', 'post']:
+                hook = '%sCall%s' % (side.capitalize(), name[2:])
+                self.hook_checks += '            if (generic_%s || !std::is_same<decltype(&T::%s), decltype(&layer_factory::%s)>::value) %s_call_hooks.set(VLF_HOOK_%s);\n' % (side, hook, hook, side, name[2:])
             # Update function intercepts
             self.intercepts += [ '    {"%s", (void*)%s},' % (name,name[2:]) ]
             if (self.featureExtraProtect is not None):
                 self.intercepts += [ '#endif' ]
                 self.layer_factory += '#endif\n'
+                self.hook_ids += '#endif\n'
+                self.hook_checks += '#endif\n'
             return
 
         manual_functions = [
@@ -779,12 +876,12 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
             ####self.appendSection('command', '')
             ####self.appendSection('command', '// Declare only')
             ####self.appendSection('command', decls[0])
-            self.intercepts += [ '    {"%s", (void*)%s},' % (name,name[2:]) ]
+            self.intercepts += [ '    {"%s", {(void*)%s, VLF_HOOK_COUNT}},' % (name,name[2:]) ]
             return
         # Record that the function will be intercepted
         if (self.featureExtraProtect is not None):
             self.intercepts += [ '#ifdef %s' % self.featureExtraProtect ]
-        self.intercepts += [ '    {"%s", (void*)%s},' % (name,name[2:]) ]
+        self.intercepts += [ '    {"%s", {(void*)%s, VLF_HOOK_%s}},' % (name,name[2:],name[2:]) ]
         if (self.featureExtraProtect is not None):
             self.intercepts += [ '#endif' ]
         OutputGenerator.genCmd(self, cmdinfo, name, alias)
@@ -809,7 +906,7 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
         API = api_function_name.replace('vk','%s_data->dispatch_table.' % (device_or_instance),1)
 
         # Generate pre-call object processing source code
-        self.appendSection('command', '    for (auto intercept : global_interceptor_list) {')
+        self.appendSection('command', '    for (auto intercept : pre_call_interceptors[VLF_HOOK_%s]) {' % api_function_name[2:])
         self.appendSection('command', '        intercept->PreCall%s(%s);' % (api_function_name[2:], paramstext))
         self.appendSection('command', '    }')
 
@@ -828,7 +925,7 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
         returnParam = ''
         if (resulttype is not None and resulttype.text == 'VkResult'):
             returnParam = ', result'
-        self.appendSection('command', '    for (auto intercept : global_interceptor_list) {')
+        self.appendSection('command', '    for (auto intercept : post_call_interceptors[VLF_HOOK_%s]) {' % api_function_name[2:])
         self.appendSection('command', '        intercept->PostCall%s(%s%s);' % (api_function_name[2:], paramstext, returnParam))
         self.appendSection('command', '    }')
 
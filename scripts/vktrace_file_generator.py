@@ -1164,6 +1164,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         replay_gen_source += '#include "vkreplay_vkreplay.h"\n'
         replay_gen_source += '#include "vkreplay.h"\n'
         replay_gen_source += '#include "vkreplay_main.h"\n'
+        replay_gen_source += '#include "vkreplay_profiler.h"\n'
         replay_gen_source += '#include <algorithm>\n'
         replay_gen_source += '#include <queue>\n'
         replay_gen_source += '\n'
@@ -1594,8 +1595,10 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                     rr_string = rr_string.replace('pPacket->pSetLayouts', 'pLocalDescSetLayouts')
                 elif cmdname == 'ResetFences':
                    rr_string = rr_string.replace('pPacket->pFences', 'fences')
-                # Insert the real_*(..) call
+                # Insert the real_*(..) call, bracketed for the CPU profiler
+                replay_gen_source += '            vktrace_replay::profile_driver_begin();\n'
                 replay_gen_source += '%s\n' % rr_string
+                replay_gen_source += '            vktrace_replay::profile_driver_end();\n'
                 if cmdname == 'GetRefreshCycleDurationGOOGLE' or cmdname == 'GetPastPresentationTimingGOOGLE':
                     replay_gen_source += '            }\n'
                 if cmdname == 'DestroyFramebuffer':
@@ -1977,7 +1980,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         #
         # Construct packet id stringify helper function
         trace_pkt_id_hdr += 'static const char *vktrace_stringify_vk_packet_id(const VKTRACE_TRACE_PACKET_ID_VK id, const vktrace_trace_packet_header* pHeader) {\n'
-        trace_pkt_id_hdr += '    static char str[1024];\n'
+        trace_pkt_id_hdr += '    static VKTRACE_THREAD_LOCAL char str[1024];\n'
         trace_pkt_id_hdr += '    switch(id) {\n'
         trace_pkt_id_hdr += '        case VKTRACE_TPI_VK_vkApiVersion: {\n'
         trace_pkt_id_hdr += '            packet_vkApiVersion* pPacket = (packet_vkApiVersion*)(pHeader->pBody);\n'
@@ -3427,6 +3430,75 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         dump_gen_source += '    }\n'
         dump_gen_source += '}\n'
         dump_gen_source += '\n'
+        dump_gen_source += 'ApiDumpInstance* create_dump_part(std::ostream& output) {\n'
+        dump_gen_source += '    return new ApiDumpInstance(ApiDumpInstance::current(), output);\n'
+        dump_gen_source += '}\n'
+        dump_gen_source += '\n'
+        dump_gen_source += 'void delete_dump_part(ApiDumpInstance* part) { delete part; }\n'
+        dump_gen_source += '\n'
+        dump_gen_source += 'void set_dump_part(ApiDumpInstance* part) { ApiDumpInstance::setThreadInstance(part); }\n'
+        dump_gen_source += '\n'
+        dump_gen_source += 'void copy_dump_state(ApiDumpInstance* to, const ApiDumpInstance* from) {\n'
+        dump_gen_source += '    (to != nullptr ? *to : ApiDumpInstance::current()).copyState(from != nullptr ? *from : ApiDumpInstance::current());\n'
+        dump_gen_source += '}\n'
+        dump_gen_source += '\n'
+        dump_gen_source += 'std::ostream& dump_output() { return ApiDumpInstance::current().settings().stream(); }\n'
+        dump_gen_source += '\n'
+        dump_gen_source += 'void start_dump_frame() {\n'
+        dump_gen_source += '    ApiDumpInstance& dump_inst = ApiDumpInstance::current();\n'
+        dump_gen_source += '    if (dump_inst.frameCount() > 0) {\n'
+        dump_gen_source += '        dump_inst.startFrame();\n'
+        dump_gen_source += '    }\n'
+        dump_gen_source += '}\n'
+        dump_gen_source += '\n'
+        dump_gen_source += 'void track_packet(ApiDumpInstance* part, const vktrace_trace_packet_header* packet) {\n'
+        dump_gen_source += '    ApiDumpInstance& dump_inst = *part;\n'
+        dump_gen_source += '    switch (packet->packet_id) {\n'
+        dump_gen_source += '        case VKTRACE_TPI_VK_vkQueuePresentKHR:\n'
+        dump_gen_source += '            dump_inst.skipFrame();\n'
+        dump_gen_source += '            break;\n'
+        dump_gen_source += '        case VKTRACE_TPI_VK_vkCmdDraw:\n'
+        dump_gen_source += '        case VKTRACE_TPI_VK_vkCmdDrawIndexed:\n'
+        dump_gen_source += '        case VKTRACE_TPI_VK_vkCmdDrawIndirect:\n'
+        dump_gen_source += '        case VKTRACE_TPI_VK_vkCmdDrawIndexedIndirect:\n'
+        dump_gen_source += '            if (dump_inst.settings().isFrameInRange(dump_inst.frameCount())) {\n'
+        dump_gen_source += '                dump_inst.nextDrawcall();\n'
+        dump_gen_source += '            }\n'
+        dump_gen_source += '            break;\n'
+        dump_gen_source += '        case VKTRACE_TPI_VK_vkAllocateCommandBuffers: {\n'
+        dump_gen_source += '            packet_vkAllocateCommandBuffers* pPacket = (packet_vkAllocateCommandBuffers*)(packet->pBody);\n'
+        dump_gen_source += '            dump_inst.addCmdBuffers(pPacket->device,\n'
+        dump_gen_source += '                                    pPacket->pAllocateInfo->commandPool,\n'
+        dump_gen_source += '                                    std::vector<VkCommandBuffer>(pPacket->pCommandBuffers, pPacket->pCommandBuffers + pPacket->pAllocateInfo->commandBufferCount),\n'
+        dump_gen_source += '                                    pPacket->pAllocateInfo->level);\n'
+        dump_gen_source += '        } break;\n'
+        dump_gen_source += '        case VKTRACE_TPI_VK_vkDestroyCommandPool: {\n'
+        dump_gen_source += '            packet_vkDestroyCommandPool* pPacket = (packet_vkDestroyCommandPool*)(packet->pBody);\n'
+        dump_gen_source += '            dump_inst.eraseCmdBufferPool(pPacket->device, pPacket->commandPool);\n'
+        dump_gen_source += '        } break;\n'
+        dump_gen_source += '        case VKTRACE_TPI_VK_vkFreeCommandBuffers: {\n'
+        dump_gen_source += '            packet_vkFreeCommandBuffers* pPacket = (packet_vkFreeCommandBuffers*)(packet->pBody);\n'
+        dump_gen_source += '            dump_inst.eraseCmdBuffers(pPacket->device,\n'
+        dump_gen_source += '                                      pPacket->commandPool,\n'
+        dump_gen_source += '                                      std::vector<VkCommandBuffer>(pPacket->pCommandBuffers, pPacket->pCommandBuffers + pPacket->commandBufferCount));\n'
+        dump_gen_source += '        } break;\n'
+        dump_gen_source += '        case VKTRACE_TPI_VK_vkSetDebugUtilsObjectNameEXT: {\n'
+        dump_gen_source += '            packet_vkSetDebugUtilsObjectNameEXT* pPacket = (packet_vkSetDebugUtilsObjectNameEXT*)(packet->pBody);\n'
+        dump_gen_source += '            if (pPacket->pNameInfo != nullptr) {\n'
+        dump_gen_source += '                dump_inst.setObjectName((uint64_t)pPacket->pNameInfo->objectHandle, pPacket->pNameInfo->pObjectName);\n'
+        dump_gen_source += '            }\n'
+        dump_gen_source += '        } break;\n'
+        dump_gen_source += '        case VKTRACE_TPI_VK_vkDebugMarkerSetObjectNameEXT: {\n'
+        dump_gen_source += '            packet_vkDebugMarkerSetObjectNameEXT* pPacket = (packet_vkDebugMarkerSetObjectNameEXT*)(packet->pBody);\n'
+        dump_gen_source += '            if (pPacket->pNameInfo != nullptr) {\n'
+        dump_gen_source += '                dump_inst.setObjectName((uint64_t)pPacket->pNameInfo->object, pPacket->pNameInfo->pObjectName);\n'
+        dump_gen_source += '            }\n'
+        dump_gen_source += '        } break;\n'
+        dump_gen_source += '        default:\n'
+        dump_gen_source += '            break;\n'
+        dump_gen_source += '    }\n'
+        dump_gen_source += '}\n'
+        dump_gen_source += '\n'
         dump_gen_source += 'void dump_packet(const vktrace_trace_packet_header* packet) {\n'
         dump_gen_source += '    switch (packet->packet_id) {\n'
 
@@ -3623,6 +3695,8 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                 dump_gen_source += '                dump_json_body_vk%s(dump_inst, ' % cmdname_removeRemap
                 dump_gen_source += '%s\n' % param_string
                 dump_gen_source += '                break;\n'
+                dump_gen_source += '            default:\n'
+                dump_gen_source += '                break;\n'
                 dump_gen_source += '            }\n'
                 if cmdname == 'QueuePresentKHR':
                     dump_gen_source += '            dump_inst.nextFrame();\n'
@@ -3704,12 +3778,15 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         trace_vk_src += '    // On Android, we can use an abstract socket to fit permissions model\n'
         trace_vk_src += '    const char *ipAddr = "localabstract";\n'
         trace_vk_src += '    const char *ipPort = "vktrace";\n'
-        trace_vk_src += '    gMessageStream = vktrace_MessageStream_create_port_string(FALSE, ipAddr, ipPort);\n'
+        trace_vk_src += '    gMessageStream = vktrace_MessageStream_create_port_string(FALSE, ipAddr, ipPort, VKTRACE_TRANSPORT_TCP);\n'
         trace_vk_src += '#else\n'
         trace_vk_src += '    const char *ipAddr = vktrace_get_global_var("VKTRACE_LIB_IPADDR");\n'
         trace_vk_src += '    if (ipAddr == NULL)\n'
         trace_vk_src += '        ipAddr = "127.0.0.1";\n'
-        trace_vk_src += '    gMessageStream = vktrace_MessageStream_create(FALSE, ipAddr, VKTRACE_BASE_PORT + VKTRACE_TID_VULKAN);\n'
+        trace_vk_src += '    const char *transport = vktrace_get_global_var(VKTRACE_LIB_TRANSPORT_ENV);\n'
+        trace_vk_src += '    gMessageStream = vktrace_MessageStream_create(FALSE, ipAddr, VKTRACE_BASE_PORT + VKTRACE_TID_VULKAN,\n'
+        trace_vk_src += '                                                  (transport && strcmp(transport, "tcp") == 0) ? VKTRACE_TRANSPORT_TCP\n'
+        trace_vk_src += '                                                                                               : VKTRACE_TRANSPORT_AUTO);\n'
         trace_vk_src += '#endif\n'
         trace_vk_src += '    vktrace_trace_set_trace_file(vktrace_FileLike_create_msg(gMessageStream));\n'
         trace_vk_src += '    vktrace_tracelog_set_tracer_id(VKTRACE_TID_VULKAN);\n'
@@ -5149,6 +5226,326 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                 trace_pkt_hdr += '\n'
         return trace_pkt_hdr
 
+    #
+    # Construct vktraceconvert_vk_convert_gen.cpp, which rewrites the packets of a 32-bit trace with the 64-bit layout.
+    # Each struct which differs between the two (it has pointers, size_t, dispatchable handles or function pointers, or
+    # contains such a struct) gets a copy with 32-bit members, VkFoo_32, and a function converting it into the 64-bit
+    # struct. The data a pointer points to is converted as its 'len' in vk.xml says.
+    def GenerateConvertGenSource(self):
+        cmd_member_dict = dict(self.cmdMembers)
+        cmd_info_dict = dict(self.cmd_info_data)
+        cmd_protect_dict = dict(self.cmd_feature_protect)
+        cmd_extension_dict = dict(self.cmd_extension_names)
+        struct_dict = dict((s.name, s) for s in self.structMembers if len(s.members) > 0)
+        # Types which are 4 bytes in a 32-bit trace and 8 bytes in a 64-bit one, besides the pointers
+        pointer_types = set(['size_t', 'HINSTANCE', 'HWND', 'HMONITOR', 'HANDLE', 'LPCWSTR', 'Window', 'VisualID', 'RROutput'])
+        aliases = {}
+        unions = set()
+        stypes = {}
+        selectors = {}   # struct -> {union member -> selector member}
+        selections = {}  # union -> {member -> [selection values]}
+        for elem in self.registry.tree.findall('types/type'):
+            name = elem.get('name')
+            if name is None and elem.find('name') is not None:
+                name = elem.find('name').text
+            category = elem.get('category')
+            if elem.get('alias') is not None:
+                aliases[name] = elem.get('alias')
+                continue
+            if category == 'handle' and elem.find('type') is not None and elem.find('type').text == 'VK_DEFINE_HANDLE':
+                pointer_types.add(name)
+            elif category == 'funcpointer':
+                pointer_types.add(name)
+            elif category == 'basetype' and '*' in ''.join(elem.itertext()):
+                pointer_types.add(name)
+            elif category == 'union':
+                unions.add(name)
+                for member in elem.findall('member'):
+                    if member.get('selection') is not None:
+                        selections.setdefault(name, {})[member.find('name').text] = member.get('selection').split(',')
+            if category == 'struct':
+                for member in elem.findall('member'):
+                    if member.find('name').text == 'sType' and member.get('values') is not None:
+                        stypes[name] = member.get('values')
+                    if member.get('selector') is not None:
+                        selectors.setdefault(name, {})[member.find('name').text] = member.get('selector')
+
+        def base_type(t):
+            return aliases.get(t, t)
+        def pointer_level(m):
+            return m.cdecl.count('*')
+        def array_dims(m):
+            return re.findall(r'\[\s*([^\]]+?)\s*\]', m.cdecl)
+        differs = {}
+        def type_differs(t):
+            t = base_type(t)
+            if t in pointer_types:
+                return True
+            if t not in struct_dict:
+                return False
+            if t not in differs:
+                differs[t] = False
+                differs[t] = True in [pointer_level(m) > 0 or type_differs(m.type) for m in struct_dict[t].members]
+            return differs[t]
+        # The type of a value of type 't' in a 32-bit trace
+        def mirror_type(t):
+            if base_type(t) in pointer_types:
+                return 'uint32_t'
+            if type_differs(t):
+                return base_type(t) + '_32'
+            return t
+        def mirror_member(m):
+            dims = ''.join('[%s]' % d for d in array_dims(m))
+            if pointer_level(m) > 0:
+                return '    uint32_t %s%s;\n' % (m.name, dims)
+            if type_differs(m.type):
+                return '    %s %s%s;\n' % (mirror_type(m.type), m.name, dims)
+            return '    %s;\n' % m.cdecl.strip()
+        def converter(t):
+            t = base_type(t)
+            if t in selections or t in unions:
+                # A union in an array is converted without its selector
+                return '[](vkconvert_packet& p, const %s_32* in, uint64_t out) { vkconvert_%s(p, in, out, -1); }' % (t, t)
+            return 'vkconvert_%s' % t
+        # The number of elements 'expr' gives, with the members of 'in' it names read from the 32-bit data
+        def count_expr(expr, members, owner):
+            by_name = dict((m.name, m) for m in members)
+            def value(match):
+                name, field = match.group(1), match.group(2)
+                if name not in by_name:
+                    if name[0].islower():
+                        self.warnFile.write('vktraceconvert: unknown length %s in %s\n' % (expr, owner))
+                    return match.group(0)
+                m = by_name[name]
+                if pointer_level(m) > 0:
+                    text = 'p.value<%s>(in->%s)' % (mirror_type(m.type), name)
+                else:
+                    text = 'in->%s' % name
+                return text + ('.%s' % field if field is not None else '')
+            return re.sub(r'\b([A-Za-z_]\w*)(?:->(\w+))?', value, expr)
+        # Returns (lines before the 64-bit struct is written, lines writing its members) converting member 'm' of
+        # 'owner' from 'in' to 'o', which is at 'out' in the new body
+        def convert_member(m, members, owner):
+            before = []
+            after = []
+            level = pointer_level(m)
+            t = base_type(m.type)
+            dims = array_dims(m)
+            lengths = m.len.split(',') if m.len is not None else []
+            count = lambda: count_expr(lengths[0], members, owner) if len(lengths) > 0 else '1'
+            if level > 0:
+                local = '%s_out' % m.name
+                if m.name == 'pNext':
+                    value = 'vkconvert_pnext(p, in->pNext)'
+                elif level == 1 and t in pointer_types:
+                    value = 'vkconvert_scalars<%s>(p, in->%s, %s)' % (m.type, m.name, count())
+                elif level == 1 and type_differs(t):
+                    value = 'vkconvert_structs<%s_32, %s>(p, in->%s, %s, %s)' % (t, t, m.name, count(), converter(t))
+                elif level == 1:
+                    value = 'p.rebase(in->%s)' % m.name
+                elif type_differs(t):
+                    value = 'vkconvert_pointer_structs<%s_32, %s>(p, in->%s, %s, %s)' % (t, t, m.name, count(), converter(t))
+                else:
+                    value = 'vkconvert_pointers(p, in->%s, %s)' % (m.name, count())
+                before.append('uint64_t %s = %s;' % (local, value))
+                after.append('vkconvert_set(o->%s, %s);' % (m.name, local))
+            elif t in pointer_types:
+                if len(dims) > 0:
+                    after.append('for (uint32_t i = 0; i < %s; i++) vkconvert_set(o->%s[i], in->%s[i]);' % (dims[0], m.name, m.name))
+                else:
+                    after.append('vkconvert_set(o->%s, in->%s);' % (m.name, m.name))
+            elif type_differs(t):
+                selection = '(int64_t)in->%s' % selectors[owner][m.name] if m.name in selectors.get(owner, {}) else '-1'
+                if len(dims) > 0:
+                    call = 'vkconvert_%s(p, &in->%s[i], out + offsetof(%s, %s) + i * sizeof(%s)' % (t, m.name, owner, m.name, t)
+                    call += ', -1);' if t in unions else ');'
+                    before.append('for (uint32_t i = 0; i < %s; i++) %s' % (dims[0], call))
+                else:
+                    call = 'vkconvert_%s(p, &in->%s, out + offsetof(%s, %s)' % (t, m.name, owner, m.name)
+                    call += ', %s);' % selection if t in unions else ');'
+                    before.append(call)
+            elif len(dims) > 0:
+                after.append('memcpy((void*)o->%s, in->%s, sizeof(o->%s));' % (m.name, m.name, m.name))
+            else:
+                after.append('o->%s = in->%s;' % (m.name, m.name))
+            return before, after
+        def convert_members(members, owner, indent):
+            before = []
+            after = []
+            for m in members:
+                b, a = convert_member(m, members, owner)
+                before += b
+                after += a
+            text = ''.join('%s%s\n' % (indent, line) for line in before)
+            if len(after) > 0:
+                text += '%s%s* o = p.out<%s>(out);\n' % (indent, owner, owner)
+            text += ''.join('%s%s\n' % (indent, line) for line in after)
+            return text
+
+        # Skip the structs and unions which are the same in both layouts, and the aliases
+        convert_structs = [s for s in self.structMembers if len(s.members) > 0 and type_differs(s.name)]
+        convert_cmds = []
+        for api in self.cmdMembers:
+            if not isSupportedCmd(api, cmd_extension_dict) or api.name[2:] in api_remap:
+                continue
+            convert_cmds.append(api)
+
+        convert_gen_source  = '\n'
+        convert_gen_source += '#include <stddef.h>\n'
+        convert_gen_source += '#include <string.h>\n\n'
+        convert_gen_source += '#include "vktrace_vk_vk_packets.h"\n'
+        convert_gen_source += '#include "vktrace_vk_packet_id.h"\n'
+        convert_gen_source += '#include "vktraceconvert_main.h"\n\n'
+        convert_gen_source += '// The structs with the layout they have in a 32-bit trace, where pointers and size_t are 4 bytes\n\n'
+        for s in convert_structs:
+            if s.ifdef_protect is not None:
+                convert_gen_source += '#ifdef %s\n' % s.ifdef_protect
+            keyword = 'union' if s.name in unions else 'struct'
+            convert_gen_source += 'typedef %s %s_32 {\n' % (keyword, s.name)
+            for m in s.members:
+                convert_gen_source += mirror_member(m)
+            convert_gen_source += '} %s_32;\n' % s.name
+            if s.ifdef_protect is not None:
+                convert_gen_source += '#endif  // %s\n' % s.ifdef_protect
+            convert_gen_source += '\n'
+
+        for s in convert_structs:
+            if s.ifdef_protect is not None:
+                convert_gen_source += '#ifdef %s\n' % s.ifdef_protect
+            if s.name in unions:
+                convert_gen_source += 'void vkconvert_%s(vkconvert_packet& p, const %s_32* in, uint64_t out, int64_t selection);\n' % (s.name, s.name)
+            else:
+                convert_gen_source += 'void vkconvert_%s(vkconvert_packet& p, const %s_32* in, uint64_t out);\n' % (s.name, s.name)
+            if s.ifdef_protect is not None:
+                convert_gen_source += '#endif  // %s\n' % s.ifdef_protect
+        convert_gen_source += '\n'
+
+        # pNext chains, the structs are told apart by their sType
+        convert_gen_source += 'uint64_t vkconvert_pnext(vkconvert_packet& p, uint32_t offset) {\n'
+        convert_gen_source += '    if (offset == 0) {\n'
+        convert_gen_source += '        return 0;\n'
+        convert_gen_source += '    }\n'
+        convert_gen_source += '    const vkconvert_base_32* base = p.in<vkconvert_base_32>(offset);\n'
+        convert_gen_source += '    if (base == NULL) {\n'
+        convert_gen_source += '        return p.keep(offset);\n'
+        convert_gen_source += '    }\n'
+        convert_gen_source += '    switch ((int32_t)base->sType) {\n'
+        for s in convert_structs:
+            if s.name not in stypes:
+                continue
+            if s.ifdef_protect is not None:
+                convert_gen_source += '#ifdef %s\n' % s.ifdef_protect
+            convert_gen_source += '        case %s:\n' % stypes[s.name]
+            convert_gen_source += '            return vkconvert_structs<%s_32, %s>(p, offset, 1, vkconvert_%s);\n' % (s.name, s.name, s.name)
+            if s.ifdef_protect is not None:
+                convert_gen_source += '#endif  // %s\n' % s.ifdef_protect
+        convert_gen_source += '        default:\n'
+        convert_gen_source += '            return p.drop(base->sType);\n'
+        convert_gen_source += '    }\n'
+        convert_gen_source += '}\n\n'
+
+        for s in convert_structs:
+            if s.ifdef_protect is not None:
+                convert_gen_source += '#ifdef %s\n' % s.ifdef_protect
+            if s.name in unions:
+                convert_gen_source += 'void vkconvert_%s(vkconvert_packet& p, const %s_32* in, uint64_t out, int64_t selection) {\n' % (s.name, s.name)
+                convert_gen_source += '    switch (selection) {\n'
+                for m in s.members:
+                    if m.name not in selections.get(s.name, {}):
+                        continue
+                    for value in selections[s.name][m.name]:
+                        convert_gen_source += '        case %s:\n' % value
+                    convert_gen_source += '        {\n'
+                    convert_gen_source += convert_members([m], s.name, '            ')
+                    convert_gen_source += '            return;\n'
+                    convert_gen_source += '        }\n'
+                convert_gen_source += '        default:\n'
+                convert_gen_source += '            break;\n'
+                convert_gen_source += '    }\n'
+                convert_gen_source += '    // Without a selector the bytes which are in both layouts are kept\n'
+                convert_gen_source += '    memcpy(p.out<%s>(out), in, sizeof(%s) < sizeof(*in) ? sizeof(%s) : sizeof(*in));\n' % (s.name, s.name, s.name)
+            else:
+                convert_gen_source += 'void vkconvert_%s(vkconvert_packet& p, const %s_32* in, uint64_t out) {\n' % (s.name, s.name)
+                convert_gen_source += convert_members(s.members, s.name, '    ')
+            convert_gen_source += '}\n'
+            if s.ifdef_protect is not None:
+                convert_gen_source += '#endif  // %s\n' % s.ifdef_protect
+            convert_gen_source += '\n'
+
+        # The packets, with the extra members the tracer adds to some of them
+        convert_gen_source += 'typedef struct packet_vkApiVersion_32 {\n'
+        convert_gen_source += '    uint32_t header;\n'
+        convert_gen_source += '    uint32_t version;\n'
+        convert_gen_source += '} packet_vkApiVersion_32;\n\n'
+        convert_gen_source += 'static bool vkconvert_vkApiVersion(vkconvert_packet& p) {\n'
+        convert_gen_source += '    const packet_vkApiVersion_32* in = p.in<packet_vkApiVersion_32>(0);\n'
+        convert_gen_source += '    if (in == NULL) {\n'
+        convert_gen_source += '        return false;\n'
+        convert_gen_source += '    }\n'
+        convert_gen_source += '    uint64_t out = p.begin(sizeof(packet_vkApiVersion));\n'
+        convert_gen_source += '    packet_vkApiVersion* o = p.out<packet_vkApiVersion>(out);\n'
+        convert_gen_source += '    o->version = in->version;\n'
+        convert_gen_source += '    return true;\n'
+        convert_gen_source += '}\n\n'
+        for api in convert_cmds:
+            protect = cmd_protect_dict[api.name]
+            params = [m for m in cmd_member_dict[api.name] if m.name != '']
+            if 'UnmapMemory' in api.name:
+                params.append(self.CommandParam(type='void', name='pData', ispointer=True, isstaticarray=False, isconst=False, iscount=False,
+                                                len=None, cdecl='void* pData', feature_protect=protect, handle=None))
+            elif 'FlushMappedMemoryRanges' in api.name or 'InvalidateMappedMemoryRanges' in api.name:
+                params.append(self.CommandParam(type='void', name='ppData', ispointer=True, isstaticarray=False, isconst=False, iscount=False,
+                                                len='memoryRangeCount', cdecl='void** ppData', feature_protect=protect, handle=None))
+            resulttype = cmd_info_dict[api.name].elem.find('proto/type')
+            if resulttype is not None and resulttype.text != 'void':
+                params.append(self.CommandParam(type=resulttype.text, name='result', ispointer=False, isstaticarray=False, isconst=False,
+                                                iscount=False, len=None, cdecl='%s result' % resulttype.text, feature_protect=protect, handle=None))
+            if protect is not None:
+                convert_gen_source += '#ifdef %s\n' % protect
+            convert_gen_source += 'typedef struct packet_%s_32 {\n' % api.name
+            convert_gen_source += '    uint32_t header;\n'
+            for m in params:
+                convert_gen_source += mirror_member(m)
+            convert_gen_source += '} packet_%s_32;\n\n' % api.name
+            convert_gen_source += 'static bool vkconvert_%s(vkconvert_packet& p) {\n' % api.name
+            convert_gen_source += '    const packet_%s_32* in = p.in<packet_%s_32>(0);\n' % (api.name, api.name)
+            convert_gen_source += '    if (in == NULL) {\n'
+            convert_gen_source += '        return false;\n'
+            convert_gen_source += '    }\n'
+            convert_gen_source += '    uint64_t out = p.begin(sizeof(packet_%s));\n' % api.name
+            convert_gen_source += convert_members(params, 'packet_%s' % api.name, '    ')
+            convert_gen_source += '    return true;\n'
+            convert_gen_source += '}\n'
+            if protect is not None:
+                convert_gen_source += '#endif  // %s\n' % protect
+            convert_gen_source += '\n'
+
+        convert_gen_source += 'bool convert_packet(vkconvert_packet& p) {\n'
+        convert_gen_source += '    switch (p.packet_id()) {\n'
+        convert_gen_source += '        case VKTRACE_TPI_VK_vkApiVersion:\n'
+        convert_gen_source += '            return vkconvert_vkApiVersion(p);\n'
+        for api in convert_cmds:
+            protect = cmd_protect_dict[api.name]
+            if protect is not None:
+                convert_gen_source += '#ifdef %s\n' % protect
+            convert_gen_source += '        case VKTRACE_TPI_VK_%s:\n' % api.name
+            convert_gen_source += '            return vkconvert_%s(p);\n' % api.name
+            if protect is not None:
+                convert_gen_source += '#endif  // %s\n' % protect
+        convert_gen_source += '        case VKTRACE_TPI_VK_vkCmdCopyBufferRemapBuffer:\n'
+        convert_gen_source += '        case VKTRACE_TPI_VK_vkCmdCopyBufferRemapAS:\n'
+        convert_gen_source += '        case VKTRACE_TPI_VK_vkCmdCopyBufferRemapASandBuffer:\n'
+        convert_gen_source += '            return vkconvert_vkCmdCopyBuffer(p);\n'
+        convert_gen_source += '        case VKTRACE_TPI_VK_vkFlushMappedMemoryRangesRemap:\n'
+        convert_gen_source += '            return vkconvert_vkFlushMappedMemoryRanges(p);\n'
+        convert_gen_source += '        case VKTRACE_TPI_VK_vkCmdPushConstantsRemap:\n'
+        convert_gen_source += '            return vkconvert_vkCmdPushConstants(p);\n'
+        convert_gen_source += '        default:\n'
+        convert_gen_source += '            return false;\n'
+        convert_gen_source += '    }\n'
+        convert_gen_source += '}\n'
+        return convert_gen_source
+
     #
     # Create a vktrace file and return it as a string
     def OutputDestFile(self):
@@ -5166,5 +5563,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
             return self.GenerateTraceVkPacketsHeader()
         elif self.vktrace_file_type == 'vktrace_dump_gen_source':
             return self.GenerateParserGenSource()
+        elif self.vktrace_file_type == 'vktrace_convert_gen_source':
+            return self.GenerateConvertGenSource()
         else:
             return 'Bad VkTrace File Generator Option %s' % self.vktrace_file_type
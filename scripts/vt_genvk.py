@@ -281,6 +281,34 @@ def makeGenOpts(args):
             expandEnumerants  = False)
     ]
 
+    # API dump generator options for api_dump_binary.h
+    genOpts['api_dump_binary.h'] = [
+        ApiDumpOutputGenerator,
+        ApiDumpGeneratorOptions(
+            conventions       = conventions,
+            input             = BINARY_CODEGEN,
+            filename          = 'api_dump_binary.h',
+            apiname           = 'vulkan',
+            profile           = None,
+            versions          = featuresPat,
+            emitversions      = featuresPat,
+            defaultExtensions = 'vulkan',
+            addExtensions     = addExtensionsPat,
+            removeExtensions  = removeExtensionsPat,
+            emitExtensions    = emitExtensionsPat,
+            prefixText        = prefixStrings + vkPrefixStrings,
+            genFuncPointers   = True,
+            protectFile       = protect,
+            protectFeature    = False,
+            protectProto      = None,
+            protectProtoStr   = 'VK_NO_PROTOTYPES',
+            apicall           = 'VKAPI_ATTR ',
+            apientry          = 'VKAPI_CALL ',
+            apientryp         = 'VKAPI_PTR *',
+            alignFuncParam    = 48,
+            expandEnumerants  = False)
+    ]
+
     # VkTrace file generator options for vkreplay_vk_objmapper.h
     genOpts['vkreplay_vk_objmapper.h'] = [
           VkTraceFileOutputGenerator,
@@ -379,6 +407,32 @@ def makeGenOpts(args):
             expandEnumerants  = False)
         ]
 
+    # VkTrace file generator options for vktraceconvert_vk_convert_gen.cpp
+    genOpts['vktraceconvert_vk_convert_gen.cpp'] = [
+          VkTraceFileOutputGenerator,
+          VkTraceFileOutputGeneratorOptions(
+            conventions       = conventions,
+            filename          = 'vktraceconvert_vk_convert_gen.cpp',
+            directory         = directory,
+            apiname           = 'vulkan',
+            profile           = None,
+            versions          = featuresPat,
+            emitversions      = featuresPat,
+            defaultExtensions = 'vulkan',
+            addExtensions     = addExtensionsPat,
+            removeExtensions  = removeExtensionsPat,
+            emitExtensions    = emitExtensionsPat,
+            prefixText        = prefixStrings + vkPrefixStrings,
+            protectFeature    = False,
+            genFuncPointers   = True,
+            apicall           = 'VKAPI_ATTR ',
+            apientry          = 'VKAPI_CALL ',
+            apientryp         = 'VKAPI_PTR *',
+            alignFuncParam    = 48,
+            vktrace_file_type  = 'vktrace_convert_gen_source',
+            expandEnumerants  = False)
+        ]
+
 
     # VkTrace file generator options for vktrace_vk_packet_id.h
     genOpts['vktrace_vk_packet_id.h'] = [
@@ -763,7 +817,7 @@ if __name__ == '__main__':
 
     # VulkanTools generator additions
     from tool_helper_file_generator import ToolHelperFileOutputGenerator, ToolHelperFileOutputGeneratorOptions
-    from api_dump_generator import ApiDumpGeneratorOptions, ApiDumpOutputGenerator, COMMON_CODEGEN, TEXT_CODEGEN, HTML_CODEGEN, JSON_CODEGEN
+    from api_dump_generator import ApiDumpGeneratorOptions, ApiDumpOutputGenerator, COMMON_CODEGEN, TEXT_CODEGEN, HTML_CODEGEN, JSON_CODEGEN, BINARY_CODEGEN
     from vktrace_file_generator import VkTraceFileOutputGenerator, VkTraceFileOutputGeneratorOptions
     from layer_factory_generator import LayerFactoryGeneratorOptions, LayerFactoryOutputGenerator
     from vkconventions import VulkanConventions
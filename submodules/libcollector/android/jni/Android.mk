@@ -23,6 +23,7 @@ include $(CLEAR_VARS)
 LOCAL_MODULE    	:= collector_android
 LOCAL_SRC_FILES 	:=  \
                     ../../interface.cpp \
+                    ../../stream.cpp \
                     ../../collectors/collector_utility.cpp \
                     ../../collectors/cputemp.cpp \
                     ../../collectors/debug.cpp \
@@ -12,6 +12,7 @@
 #include <fstream>
 #include <sstream>
 #include <assert.h>
+#include <errno.h>
 
 
 void splitString(const char* s, char delimiter, std::vector<std::string>& tokens)
@@ -240,6 +241,45 @@ bool DDKHasInstrCompiledIn(const std::string &keyword)
     return false;
 }
 
+ssize_t readFromStart(int& fd, const std::string& path, char* buffer, size_t size)
+{
+    ssize_t len = pread(fd, buffer, size - 1, 0);
+    if (len == -1 && errno != EINTR && errno != EAGAIN)
+    {
+        // workaround for weird hikey implementation, which can't seek
+        close(fd);
+        fd = open(path.c_str(), O_RDONLY);
+        len = fd < 0 ? -1 : read(fd, buffer, size - 1);
+    }
+    buffer[len < 0 ? 0 : len] = '\0';
+    return len;
+}
+
+const char* parseInteger(const char* p, int64_t& value)
+{
+    const char* s = p;
+    while (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r')
+    {
+        s++;
+    }
+    const bool negative = *s == '-';
+    if (negative || *s == '+')
+    {
+        s++;
+    }
+    if (*s < '0' || *s > '9')
+    {
+        return p;
+    }
+    uint64_t v = 0;
+    for (; *s >= '0' && *s <= '9'; s++)
+    {
+        v = v * 10 + (*s - '0');
+    }
+    value = negative ? -(int64_t)v : (int64_t)v;
+    return s;
+}
+
 int32_t _stoi(const std::string& str)
 {
     int32_t value;
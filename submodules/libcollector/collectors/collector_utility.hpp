@@ -4,6 +4,7 @@
 
 #include <vector>
 #include <sys/stat.h>
+#include <sys/types.h>
 
 #include "interface.hpp"
 
@@ -13,6 +14,15 @@ bool DDKHasInstrCompiledIn(const std::string &keyword);
 std::string getMidgardInstrConfigPath();
 std::string getMidgardInstrOutputPath();
 
+/// Read a sysfs or procfs file from its start with a single pread(), so it can be sampled again without
+/// seeking. The content is null-terminated. Files which can't be read at an offset are reopened instead.
+/// Returns the number of bytes read, or -1 on failure.
+ssize_t readFromStart(int& fd, const std::string& path, char* buffer, size_t size);
+
+/// Parse a decimal integer, skipping any whitespace before it. Returns the first character after the
+/// number, or p if there is no number there.
+const char* parseInteger(const char* p, int64_t& value);
+
 
 // Hack to workaround strange missing support for std::to_string in Android
 #ifdef __ANDROID__
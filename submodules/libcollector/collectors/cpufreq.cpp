@@ -2,8 +2,78 @@
 #include "collector_utility.hpp"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+
+static std::string timeInStatePath(int core)
+{
+    return "/sys/devices/system/cpu/cpu" + _to_string(core) + "/cpufreq/stats/time_in_state";
+}
+
+static std::string frequencyPath(int core)
+{
+    return "/sys/devices/system/cpu/cpu" + _to_string(core) + "/cpufreq/scaling_cur_freq";
+}
+
+// Reads the "<frequency> <time>" lines of time_in_state into c.times. The first read fills c.frequencies, the
+// following ones add the time spent in each state since the previous read, weighted by frequency, to sum.
+bool CPUFreqCollector::readTimeInState(Core& c, int64_t* sum, int64_t* values)
+{
+    if (readFromStart(c.time_in_state, c.time_in_state_path, mBuffer, sizeof(mBuffer)) <= 0)
+    {
+        return false;
+    }
+    const bool first = c.frequencies.empty();
+    const char* p = mBuffer;
+    size_t idx = 0;
+    while (true)
+    {
+        int64_t freq, times;
+        const char* end = parseInteger(p, freq);
+        if (end == p)
+        {
+            break;
+        }
+        p = parseInteger(end, times);
+        if (p == end)
+        {
+            break;
+        }
+        if (first)
+        {
+            c.frequencies.push_back(freq);
+        }
+        if (idx < c.times.size())
+        {
+            const int64_t relative = times - c.times[idx]; // want value relative to last sampling point
+            if (sum && idx < c.frequencies.size())
+            {
+                *sum += relative * c.frequencies[idx];
+                *values += relative;
+            }
+            c.times[idx] = times;
+        }
+        else
+        {
+            c.times.push_back(times);
+        }
+        idx++;
+    }
+    return idx > 0;
+}
+
+bool CPUFreqCollector::readFrequency(Core& c, long& freq)
+{
+    int64_t value;
+    if (readFromStart(c.freq_file, c.freq_path, mBuffer, sizeof(mBuffer)) <= 0 || parseInteger(mBuffer, value) == mBuffer)
+    {
+        return false;
+    }
+    freq = value;
+    return true;
+}
 
 bool CPUFreqCollector::init()
 {
@@ -12,24 +82,21 @@ bool CPUFreqCollector::init()
     mCores.clear();
 
     // find all CPU cores
-    std::string filename_cf = "/sys/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq";
     int core = 0;
-    FILE *cf = fopen(filename_cf.c_str(), "r");
-    while (cf)
+    int cf = open(frequencyPath(core).c_str(), O_RDONLY);
+    while (cf >= 0)
     {
-        long freq = 0;
-        long times = 0;
-        std::string filename_tis = "/sys/devices/system/cpu/cpu" + _to_string(core) + "/cpufreq/stats/time_in_state";
-        FILE *tis = fopen(filename_tis.c_str(), "r");
+        int tis = open(timeInStatePath(core).c_str(), O_RDONLY);
         mCores.emplace_back(tis, cf, core, "cpu_" + _to_string(core));
-        while (tis && fscanf(tis, "%ld %ld\n", &freq, &times) == 2)
+        mCores.back().time_in_state_path = timeInStatePath(core);
+        mCores.back().freq_path = frequencyPath(core);
+        if (tis >= 0)
         {
-            mCores.back().frequencies.push_back(freq);
+            readTimeInState(mCores.back());
         }
 
         core++;
-        std::string filename_cf = "/sys/devices/system/cpu/cpu" + _to_string(core) + "/cpufreq/scaling_cur_freq";
-        cf = fopen(filename_cf.c_str(), "r");
+        cf = open(frequencyPath(core).c_str(), O_RDONLY);
     }
     return core > 0;
 }
@@ -38,13 +105,16 @@ bool CPUFreqCollector::deinit()
 {
     for (Core& c : mCores)
     {
-        if (c.time_in_state)
+        if (c.time_in_state >= 0)
+        {
+            close(c.time_in_state);
+        }
+        c.time_in_state = -1;
+        if (c.freq_file >= 0)
         {
-            fclose(c.time_in_state);
-            c.time_in_state = nullptr;
+            close(c.freq_file);
         }
-        fclose(c.freq_file);
-        c.freq_file = nullptr;
+        c.freq_file = -1;
     }
     return true;
 }
@@ -53,16 +123,11 @@ bool CPUFreqCollector::start()
 {
     for (Core& c : mCores)
     {
-        long freq = 0;
-        long times = 0;
-        if (c.time_in_state)
+        if (c.time_in_state >= 0)
         {
-            rewind(c.time_in_state);
-            while (fscanf(c.time_in_state, "%ld %ld\n", &freq, &times) == 2)
-            {
-                c.times.push_back(times);
-            }
+            readTimeInState(c);
         }
+        c.previous = 0;
     }
     return true;
 }
@@ -75,46 +140,31 @@ bool CPUFreqCollector::collect(int64_t /* now */)
         long freq = 0;
         int64_t sum = 0;
         int64_t values = 0;
-        if (c.time_in_state)
+        if (c.time_in_state >= 0)
         {
-            int idx = 0;
-            long times = 0;
-            rewind(c.time_in_state);
-            while (fscanf(c.time_in_state, "%ld %ld\n", &freq, &times) == 2)
-            {
-                const int64_t relative = times - c.times[idx]; // want value relative to last sampling point
-                sum += relative * c.frequencies[idx];
-                values += relative;
-                c.times[idx] = times;
-                idx++;
-            }
+            readTimeInState(c, &sum, &values);
         }
-        else
+        else if (readFrequency(c, freq))
         {
-            rewind(c.freq_file);
-            while (fscanf(c.freq_file, "%ld\n", &freq) == 1)
-            {
-                sum = freq;
-                values = 1;
-            }
+            sum = freq;
+            values = 1;
         }
         if (sum == 0) // this can happen - time_in_state updates relatively slowly - so reuse previous result
         {
-            if (mResults[c.corename].size() == 0) // no previous result?
+            if (c.previous == 0) // no previous result?
             {
                 // Just read the current frequency
-                rewind(c.freq_file);
-                int r = fscanf(c.freq_file, "%ld", &freq);
-                (void)r; // elaborate way to silence compiler
+                readFrequency(c, freq);
                 sum = freq;
             }
             else
             {
-                sum = mResults[c.corename].data().back().i64; // reuse
+                sum = c.previous; // reuse, kept here since results() is empty when streaming
             }
             values = 1;
         }
         const int64_t avg = sum / values;
+        c.previous = avg;
         add(c.corename, avg);
         highest_avg = avg > highest_avg ? avg : highest_avg;
     }
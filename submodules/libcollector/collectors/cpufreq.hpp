@@ -7,20 +7,23 @@
 
 struct Core
 {
-    FILE *time_in_state = nullptr;
-    FILE *freq_file = nullptr;
+    int time_in_state = -1;
+    int freq_file = -1;
     int core = -1; // core number
     std::string corename;
+    std::string time_in_state_path;
+    std::string freq_path;
     std::vector<int> frequencies; // states
     std::vector<int64_t> times; // times in state
+    int64_t previous = 0; // last result, 0 before the first one
 
-    Core(FILE* tis, FILE* cf, int c, const std::string& n)
+    Core(int tis, int cf, int c, const std::string& n)
         : time_in_state(tis), freq_file(cf), core(c), corename(n) {}
 
     ~Core()
     {
-        assert(time_in_state == nullptr);
-        assert(freq_file == nullptr);
+        assert(time_in_state == -1);
+        assert(freq_file == -1);
     }
 };
 
@@ -36,5 +39,9 @@ public:
     virtual bool available() override;
 
 private:
+    bool readTimeInState(Core& c, int64_t* sum = nullptr, int64_t* values = nullptr);
+    bool readFrequency(Core& c, long& freq);
+
     std::list<Core> mCores;
+    char mBuffer[4096];
 };
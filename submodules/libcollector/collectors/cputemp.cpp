@@ -39,13 +39,14 @@ bool CPUTemperatureCollector::parse(const char* buffer)
     int count = 0;
     do
     {
-        char *tmp = NULL;
         const char *prefix = strchr(end, ':');
         if (prefix)
         {
             end = ++prefix; // skip any prefix
         }
-        double temp = strtol(end, &tmp, 10);
+        int64_t value = 0;
+        const char *tmp = parseInteger(end, value);
+        double temp = value;
         if (tmp == buffer)
         {
             return count > 0; // if we read any, we are good; we will try to read all the numbers
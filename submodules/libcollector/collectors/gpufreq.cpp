@@ -1,4 +1,5 @@
 #include "gpufreq.hpp"
+#include "collector_utility.hpp"
 
 #include <stdio.h>
 
@@ -33,30 +34,29 @@ GPUFreqCollector::GPUFreqCollector(const Json::Value& config, const std::string&
 bool GPUFreqCollector::parse(const char* buffer)
 {
     const int ONE_MILLION = 1000000;
-    // old driver?
     int freq;
-    int ret = sscanf(buffer, "Current sclk_g3d[G3D_BLK] = %dMhz", &freq);
-    if (ret != 1)
+    int64_t value;
+    if (parseInteger(buffer, value) != buffer)
     {
-        ret = sscanf(buffer, "Current clk mali = %dMhz", &freq); // firefly
-    }
-    if (ret != 1)
-    {
-        // no, new driver, which has only a simple number
-        char* end;
-        freq = strtol(buffer, &end, 10);
-        if (buffer == end)
+        // new driver, which has only a simple number
+        freq = value < 0 ? 0 : (int)value;
+        // on qcom, they store hz, not mhz... so transform to mhz
+        if (freq > ONE_MILLION)
         {
-            return false;
+            freq /= ONE_MILLION;
         }
-        if (freq < 0)
+    }
+    else
+    {
+        // old driver?
+        int ret = sscanf(buffer, "Current sclk_g3d[G3D_BLK] = %dMhz", &freq);
+        if (ret != 1)
         {
-            freq = 0;
+            ret = sscanf(buffer, "Current clk mali = %dMhz", &freq); // firefly
         }
-        // on qcom, they store hz, not mhz... so transform to mhz
-        if (freq > ONE_MILLION)
+        if (ret != 1)
         {
-            freq /= ONE_MILLION;
+            return false;
         }
     }
     add("gpufreq", freq * 1000);
@@ -1,11 +1,14 @@
 #include "perf.hpp"
+#include "collector_utility.hpp"
 
 #include <errno.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <dirent.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/syscall.h>
 #if !defined(ANDROID)
 #include <linux/perf_event.h>
@@ -18,6 +21,9 @@
 PerfCollector::PerfCollector(const Json::Value& config, const std::string& name) : Collector(config, name)
 {
     mSet = mConfig.get("set", 0).asInt();
+    mInherit = mConfig.get("inherit", true).asBool();
+    mPerThread = mConfig.get("per_thread", false).asBool();
+    mThreadScanInterval = mConfig.get("thread_scan_interval", 100).asInt();
 }
 
 static long perf_event_open(struct perf_event_attr *hw_event, pid_t pid,
@@ -44,7 +50,7 @@ enum perf_event_exclude
 };
 
 static int add_event(int type, int config, int group, int inherit = 1,
-                     perf_event_exclude exclude = PERF_EVENT_EXCLUDE_NONE)
+                     int exclude = PERF_EVENT_EXCLUDE_NONE, pid_t tid = 0, bool quiet = false)
 {
     struct perf_event_attr pe;
 
@@ -52,86 +58,338 @@ static int add_event(int type, int config, int group, int inherit = 1,
     pe.type = type;
     pe.size = sizeof(struct perf_event_attr);
     pe.config = config;
-    pe.disabled = 1;
+    pe.disabled = (group == -1 ? 1 : 0); // the group is enabled through its leader
     pe.inherit = inherit;
+    pe.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID;
     pe.exclude_user = (exclude == PERF_EVENT_EXCLUDE_USER ? 1 : 0) ;
     pe.exclude_kernel = (exclude == PERF_EVENT_EXCLUDE_KERNEL ? 1 : 0);
     pe.exclude_hv = 0;
-    const int fd = perf_event_open(&pe, 0, -1, group, 0);
+    const int fd = perf_event_open(&pe, tid, -1, group, 0);
     if (fd < 0)
     {
-        DBG_LOG("Error opening perf: error %d\n", errno);
-        perror("syscall");
+        if (!quiet)
+        {
+            DBG_LOG("Error opening perf: error %d\n", errno);
+            perror("syscall");
+        }
         return -1;
     }
     return fd;
 }
 
+// Reads hardware counter 'index' of this CPU from userspace, see perf_event_mmap_page::index
+static bool read_user_counter(uint32_t index, uint64_t* value)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    uint32_t low, high;
+    asm volatile("rdpmc" : "=a"(low), "=d"(high) : "c"(index - 1));
+    *value = low | ((uint64_t)high << 32);
+    return true;
+#elif defined(__aarch64__)
+    uint64_t v;
+    if (index == 32) // cycle counter
+    {
+        asm volatile("mrs %0, pmccntr_el0" : "=r"(v));
+    }
+    else
+    {
+        asm volatile("msr pmselr_el0, %0" : : "r"((uint64_t)(index - 1)));
+        asm volatile("isb" : : : "memory");
+        asm volatile("mrs %0, pmxevcntr_el0" : "=r"(v));
+    }
+    *value = v;
+    return true;
+#else
+    (void)index;
+    (void)value;
+    return false;
+#endif
+}
+
+static pid_t current_tid()
+{
+    return (pid_t)syscall(SYS_gettid);
+}
+
+bool PerfCollector::openGroup(const std::vector<event_spec>& specs, bool inherit, pid_t tid, const std::string& suffix)
+{
+    const bool quiet = tid != 0; // threads may exit before their counters are opened
+    group g;
+    g.inherit = inherit;
+    g.tid = tid;
+    g.owner = current_tid();
+    g.samples_before = mSamples;
+    for (const event_spec& spec : specs)
+    {
+        event e;
+        e.key = spec.name + suffix;
+        e.fd = add_event(spec.type, spec.config, g.events.empty() ? -1 : g.events[0].fd, inherit, spec.exclude, tid, quiet);
+        if (e.fd == -1)
+        {
+            if (!quiet) DBG_LOG("libcollector perf: Failed to init counter %s\n", e.key.c_str());
+            closeGroup(g);
+            return false;
+        }
+        if (ioctl(e.fd, PERF_EVENT_IOC_ID, &e.id) == -1)
+        {
+            perror("ioctl PERF_EVENT_IOC_ID");
+            close(e.fd);
+            closeGroup(g);
+            return false;
+        }
+        if (!inherit && tid == 0)
+        {
+            // The count of inherited events is the sum over threads, so the user page only helps for this thread
+            void* page = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, e.fd, 0);
+            if (page != MAP_FAILED)
+            {
+                e.page = (struct perf_event_mmap_page*)page;
+            }
+        }
+        g.events.push_back(e);
+    }
+    if (mCollecting && !enableGroup(g))
+    {
+        closeGroup(g);
+        return false;
+    }
+    mReadBuffer.resize(std::max(mReadBuffer.size(), 1 + 2 * g.events.size()));
+    mGroups.push_back(g);
+    return true;
+}
+
+void PerfCollector::closeGroup(group& g)
+{
+    for (event& e : g.events)
+    {
+        if (e.page)
+        {
+            munmap(e.page, sysconf(_SC_PAGESIZE));
+        }
+        if (e.fd != -1)
+        {
+            close(e.fd);
+        }
+    }
+    g.events.clear();
+}
+
+bool PerfCollector::enableGroup(group& g)
+{
+    if (ioctl(g.events[0].fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP) == -1)
+    {
+        perror("ioctl PERF_EVENT_IOC_RESET");
+        return false;
+    }
+    if (ioctl(g.events[0].fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) == -1)
+    {
+        perror("ioctl PERF_EVENT_IOC_ENABLE");
+        return false;
+    }
+    for (event& e : g.events)
+    {
+        e.previous = 0;
+    }
+    return true;
+}
+
+// Reads the whole group with one syscall, the values are in mValues in the order of the events
+bool PerfCollector::readGroup(group& g)
+{
+    const size_t size = (1 + 2 * g.events.size()) * sizeof(uint64_t);
+    if (read(g.events[0].fd, mReadBuffer.data(), size) != (ssize_t)size)
+    {
+        perror("read");
+        return false;
+    }
+    // { nr, { value, id } * nr }, in the order the events were added to the group
+    const uint64_t count = mReadBuffer[0];
+    for (size_t i = 0; i < g.events.size(); i++)
+    {
+        event& e = g.events[i];
+        size_t j = i < count && mReadBuffer[2 + 2 * i] == e.id ? i : count;
+        for (size_t k = 0; j == count && k < count; k++)
+        {
+            if (mReadBuffer[2 + 2 * k] == e.id) j = k;
+        }
+        mValues[i] = j < count ? mReadBuffer[1 + 2 * j] : e.previous;
+    }
+    return true;
+}
+
+// Reads the events of the calling thread from their user pages, without a syscall. Returns false if one of them
+// can't be read this way, for instance because it is not scheduled on this CPU or the kernel doesn't allow it.
+bool PerfCollector::readUserPage(group& g)
+{
+    for (size_t i = 0; i < g.events.size(); i++)
+    {
+        volatile struct perf_event_mmap_page* pc = g.events[i].page;
+        if (!pc)
+        {
+            return false;
+        }
+        uint32_t seq;
+        uint64_t count;
+        do
+        {
+            seq = pc->lock;
+            __sync_synchronize();
+            const uint32_t index = pc->index;
+            if (!pc->cap_user_rdpmc || index == 0)
+            {
+                return false;
+            }
+            uint64_t pmc;
+            if (!read_user_counter(index, &pmc))
+            {
+                return false;
+            }
+            const int shift = 64 - pc->pmc_width;
+            count = pc->offset + (uint64_t)(((int64_t)(pmc << shift)) >> shift);
+            __sync_synchronize();
+        } while (pc->lock != seq);
+        mValues[i] = count;
+    }
+    return true;
+}
+
+// Closes the events of the threads which are not in 'live' anymore. Their groups are kept, so that they go on
+// with zeros like the threads which started late, and so that their tid isn't counted again if it is reused.
+void PerfCollector::closeExitedThreads(const std::map<pid_t, bool>& live)
+{
+    for (group& g : mGroups)
+    {
+        if (g.tid == 0 || g.exited || live.count(g.tid) > 0)
+        {
+            continue;
+        }
+        for (event& e : g.events)
+        {
+            close(e.fd);
+            e.fd = -1;
+        }
+        g.exited = true;
+        if (mDebug) DBG_LOG("libcollector perf: Closed counters for exited thread %d\n", (int)g.tid);
+    }
+}
+
+void PerfCollector::scanThreads(int64_t now)
+{
+    if (mLastThreadScan != 0 && now - mLastThreadScan < mThreadScanInterval * 1000)
+    {
+        return;
+    }
+    mLastThreadScan = now;
+    DIR* dir = opendir("/proc/self/task");
+    if (!dir)
+    {
+        return;
+    }
+    std::map<pid_t, bool> live;
+    while (struct dirent* entry = readdir(dir))
+    {
+        const pid_t tid = atoi(entry->d_name);
+        if (tid > 0)
+        {
+            live[tid] = true;
+        }
+        if (tid <= 0 || mThreads.count(tid) > 0)
+        {
+            continue;
+        }
+        std::string name = _to_string(tid);
+        FILE* fp = fopen(("/proc/self/task/" + name + "/comm").c_str(), "r");
+        if (fp)
+        {
+            char comm[32] = {};
+            if (fgets(comm, sizeof(comm), fp))
+            {
+                comm[strcspn(comm, "\n")] = '\0';
+                name = std::string(comm) + "." + name;
+            }
+            fclose(fp);
+        }
+        mThreads[tid] = openGroup(mThreadSpecs, false, tid, "." + name);
+        if (mDebug) DBG_LOG("libcollector perf: %s counters for thread %s\n", mThreads[tid] ? "Added" : "Failed to add", name.c_str());
+    }
+    closedir(dir);
+    closeExitedThreads(live);
+}
+
 bool PerfCollector::init()
 {
-    const int group = mCounters["CPUCycleCount"] = add_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+    std::vector<event_spec> specs = { { "CPUCycleCount", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, PERF_EVENT_EXCLUDE_NONE } };
+    std::vector<event_spec> main_thread_specs;
     if (mSet == 1)
     {
         DBG_LOG("Using CPU counter set number 1, this will fail on non-ARM CPU's\n");
-        mCounters["CPUInstructionRetired"] = add_event(PERF_TYPE_RAW, 0x8, group);
-        mCounters["CPUL1CacheAccesses"] = add_event(PERF_TYPE_RAW, 0x4, group);
-        mCounters["CPUL2CacheAccesses"] = add_event(PERF_TYPE_RAW, 0x16, group);
-        mCounters["CPULASESpec"] = add_event(PERF_TYPE_RAW, 0x74, group); // simd instruction
-        mCounters["CPUVFPSpec"] = add_event(PERF_TYPE_RAW, 0x75, group); // float instruction
-        mCounters["CPUCryptoSpec"] = add_event(PERF_TYPE_RAW, 0x77, group);
+        specs.push_back({ "CPUInstructionRetired", PERF_TYPE_RAW, 0x8, PERF_EVENT_EXCLUDE_NONE });
+        specs.push_back({ "CPUL1CacheAccesses", PERF_TYPE_RAW, 0x4, PERF_EVENT_EXCLUDE_NONE });
+        specs.push_back({ "CPUL2CacheAccesses", PERF_TYPE_RAW, 0x16, PERF_EVENT_EXCLUDE_NONE });
+        specs.push_back({ "CPULASESpec", PERF_TYPE_RAW, 0x74, PERF_EVENT_EXCLUDE_NONE }); // simd instruction
+        specs.push_back({ "CPUVFPSpec", PERF_TYPE_RAW, 0x75, PERF_EVENT_EXCLUDE_NONE }); // float instruction
+        specs.push_back({ "CPUCryptoSpec", PERF_TYPE_RAW, 0x77, PERF_EVENT_EXCLUDE_NONE });
     }
     else if (mSet == 2)
     {
         DBG_LOG("Using CPU counter set number 2, this will fail on non-ARM CPU's\n");
-        mCounters["CPUL3CacheAccesses"] = add_event(PERF_TYPE_RAW, 0x2b, group);
-        mCounters["CPUBusAccessRead"] = add_event(PERF_TYPE_RAW, 0x60, group);
-        mCounters["CPUBusAccessWrite"] = add_event(PERF_TYPE_RAW, 0x61, group);
-        mCounters["CPUMemoryAccessRead"] = add_event(PERF_TYPE_RAW, 0x66, group);
-        mCounters["CPUMemoryAccessWrite"] = add_event(PERF_TYPE_RAW, 0x67, group);
+        specs.push_back({ "CPUL3CacheAccesses", PERF_TYPE_RAW, 0x2b, PERF_EVENT_EXCLUDE_NONE });
+        specs.push_back({ "CPUBusAccessRead", PERF_TYPE_RAW, 0x60, PERF_EVENT_EXCLUDE_NONE });
+        specs.push_back({ "CPUBusAccessWrite", PERF_TYPE_RAW, 0x61, PERF_EVENT_EXCLUDE_NONE });
+        specs.push_back({ "CPUMemoryAccessRead", PERF_TYPE_RAW, 0x66, PERF_EVENT_EXCLUDE_NONE });
+        specs.push_back({ "CPUMemoryAccessWrite", PERF_TYPE_RAW, 0x67, PERF_EVENT_EXCLUDE_NONE });
     }
     else if (mSet == 3)
     {
         DBG_LOG("Using CPU counter set number 3, this will fail on non-ARM CPU's\n");
-        mCounters["CPUCycles"] = add_event(PERF_TYPE_RAW, 0x11, group);
-        mCounters["CPUBusAccesses"] = add_event(PERF_TYPE_RAW, 0x19, group);
-        mCounters["CPUL2CacheRead"] = add_event(PERF_TYPE_RAW, 0x050, group);
-        mCounters["CPUL2CacheWrite"] = add_event(PERF_TYPE_RAW, 0x51, group);
-        mCounters["CPUMemoryAccessRead"] = add_event(PERF_TYPE_RAW, 0x66, group);
-        mCounters["CPUMemoryAccessWrite"] = add_event(PERF_TYPE_RAW, 0x67, group);
+        specs.push_back({ "CPUCycles", PERF_TYPE_RAW, 0x11, PERF_EVENT_EXCLUDE_NONE });
+        specs.push_back({ "CPUBusAccesses", PERF_TYPE_RAW, 0x19, PERF_EVENT_EXCLUDE_NONE });
+        specs.push_back({ "CPUL2CacheRead", PERF_TYPE_RAW, 0x050, PERF_EVENT_EXCLUDE_NONE });
+        specs.push_back({ "CPUL2CacheWrite", PERF_TYPE_RAW, 0x51, PERF_EVENT_EXCLUDE_NONE });
+        specs.push_back({ "CPUMemoryAccessRead", PERF_TYPE_RAW, 0x66, PERF_EVENT_EXCLUDE_NONE });
+        specs.push_back({ "CPUMemoryAccessWrite", PERF_TYPE_RAW, 0x67, PERF_EVENT_EXCLUDE_NONE });
     }
     else if (mSet == 4)
     {
         DBG_LOG("Using CPU counter set number 4, this will fail on non-ARM CPU's\n");
         /* All Threads */
-        mCounters["CPUCyclesUser"] = add_event(PERF_TYPE_RAW, 0x11, group, 1, PERF_EVENT_EXCLUDE_KERNEL);
-        mCounters["CPUCyclesKernel"] = add_event(PERF_TYPE_RAW, 0x11, group, 1, PERF_EVENT_EXCLUDE_USER);
+        specs.push_back({ "CPUCyclesUser", PERF_TYPE_RAW, 0x11, PERF_EVENT_EXCLUDE_KERNEL });
+        specs.push_back({ "CPUCyclesKernel", PERF_TYPE_RAW, 0x11, PERF_EVENT_EXCLUDE_USER });
 
         /* Main Thread */
-        const int group_main_thread = mCounters["CPUCycleCountMainThread"] =
-            add_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1, 0);
-        mCounters["CPUCyclesUserMainThread"] =
-            add_event(PERF_TYPE_RAW, 0x11, group_main_thread, 0, PERF_EVENT_EXCLUDE_KERNEL);
-        mCounters["CPUCyclesKernelMainThread"] =
-            add_event(PERF_TYPE_RAW, 0x11, group_main_thread, 0, PERF_EVENT_EXCLUDE_USER);
+        main_thread_specs.push_back({ "CPUCycleCountMainThread", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, PERF_EVENT_EXCLUDE_NONE });
+        main_thread_specs.push_back({ "CPUCyclesUserMainThread", PERF_TYPE_RAW, 0x11, PERF_EVENT_EXCLUDE_KERNEL });
+        main_thread_specs.push_back({ "CPUCyclesKernelMainThread", PERF_TYPE_RAW, 0x11, PERF_EVENT_EXCLUDE_USER });
     }
     else // default set, same as for x86
     {
         DBG_LOG("Using CPU counter set number 0 (default)\n");
-        mCounters["CPUInstructionCount"] = add_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, group);
-        mCounters["CPUCacheReferences"] = add_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES, group);
-        mCounters["CPUCacheMisses"] = add_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, group);
-        mCounters["CPUBranchMispredictions"] = add_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, group);
+        specs.push_back({ "CPUInstructionCount", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, PERF_EVENT_EXCLUDE_NONE });
+        specs.push_back({ "CPUCacheReferences", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES, PERF_EVENT_EXCLUDE_NONE });
+        specs.push_back({ "CPUCacheMisses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, PERF_EVENT_EXCLUDE_NONE });
+        specs.push_back({ "CPUBranchMispredictions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, PERF_EVENT_EXCLUDE_NONE });
+    }
+    if (!openGroup(specs, mInherit, 0, "") || (!main_thread_specs.empty() && !openGroup(main_thread_specs, false, 0, "")))
+    {
+        deinit();
+        return false;
+    }
+    if (mPerThread)
+    {
+        mThreadSpecs = specs;
+        mThreads.clear();
+        mLastThreadScan = 0;
     }
-    for (const auto pair : mCounters) if (pair.second == -1) { DBG_LOG("libcollector perf: Failed to init counter %s\n", pair.first.c_str()); return false; }
     return true;
 }
 
 bool PerfCollector::deinit()
 {
-    for (const auto pair : mCounters)
-        if (pair.second != -1)
-            close(pair.second);
-    mCounters.clear();
+    for (group& g : mGroups)
+        closeGroup(g);
+    mGroups.clear();
+    mThreads.clear();
+    mThreadSpecs.clear();
     return true;
 }
 
@@ -140,20 +398,16 @@ bool PerfCollector::start()
     if (mCollecting)
         return true;
 
-    for (const auto pair : mCounters)
+    for (group& g : mGroups)
     {
-        if (ioctl(pair.second, PERF_EVENT_IOC_RESET, 0) == -1)
+        if (!g.exited && !enableGroup(g))
         {
-            perror("ioctl PERF_EVENT_IOC_RESET");
-            return false;
-        }
-
-        if (ioctl(pair.second, PERF_EVENT_IOC_ENABLE, 0) == -1)
-        {
-            perror("ioctl PERF_EVENT_IOC_ENABLE");
             return false;
         }
+        g.samples_before = 0;
+        g.filled = false;
     }
+    mSamples = 0;
 
     mCollecting = true;
 
@@ -166,44 +420,71 @@ bool PerfCollector::stop()
         return true;
 
     DBG_LOG("Stopping perf collection.\n");
-    for (const auto pair : mCounters)
-        if (pair.second != -1)
+    for (group& g : mGroups)
+    {
+        if (g.exited)
         {
-            if (ioctl(pair.second, PERF_EVENT_IOC_DISABLE, 0) == -1)
-            {
-                perror("ioctl PERF_EVENT_IOC_DISABLE");
-                return false;
-            }
+            continue;
         }
+        if (ioctl(g.events[0].fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP) == -1)
+        {
+            perror("ioctl PERF_EVENT_IOC_DISABLE");
+            return false;
+        }
+    }
 
     mCollecting = false;
 
     return true;
 }
 
-bool PerfCollector::collect(int64_t /* now */)
+bool PerfCollector::collect(int64_t now)
 {
-    long long count = 0;
-
     if (!mCollecting)
         return false;
 
-    for (const auto pair : mCounters)
+    if (mPerThread && !mThreadSpecs.empty())
     {
-        if (pair.second == -1) continue;
-        if (read(pair.second, &count, sizeof(long long)) == -1)
+        scanThreads(now);
+    }
+
+    // Counters are never reset while collecting, each sample is the difference with the previous read. The user
+    // pages only give the counts of the thread reading them, so the other threads read the groups with a syscall.
+    const pid_t self = current_tid();
+    for (group& g : mGroups)
+    {
+        mValues.resize(g.events.size());
+        if (g.exited)
         {
-            perror("read");
-            return false;
+            for (size_t i = 0; i < g.events.size(); i++)
+            {
+                mValues[i] = g.events[i].previous;
+            }
         }
-
-        if (ioctl(pair.second, PERF_EVENT_IOC_RESET, 0) == -1)
+        else if (!(!g.inherit && g.owner == self && readUserPage(g)) && !readGroup(g))
         {
-            perror("ioctl PERF_EVENT_IOC_RESET");
             return false;
         }
-        add(pair.first, count);
+        if (!g.filled)
+        {
+            // Threads which started late get zeros for the samples taken before, to line up with the others
+            for (const event& e : g.events)
+            {
+                for (uint64_t i = 0; i < g.samples_before; i++)
+                {
+                    add(e.key, 0LL);
+                }
+            }
+            g.filled = true;
+        }
+        for (size_t i = 0; i < g.events.size(); i++)
+        {
+            event& e = g.events[i];
+            add(e.key, (long long)(mValues[i] - e.previous));
+            e.previous = mValues[i];
+        }
     }
+    mSamples++;
 
     return true;
 }
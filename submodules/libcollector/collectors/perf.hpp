@@ -2,7 +2,19 @@
 
 #include "interface.hpp"
 #include <map>
+#include <sys/types.h>
 
+struct perf_event_mmap_page;
+
+// Counts CPU events with perf. The events of a set are opened as one group, which is read with a single
+// syscall per sample (PERF_FORMAT_GROUP), or without any syscall with rdpmc when the events only count the
+// thread which opened them, collect() runs on that thread, and the kernel allows it.
+//
+// Options:
+//  "set": 0 to 4, the events to count (see init())
+//  "inherit": true to count all the threads of the process, false to count the thread calling init()
+//  "per_thread": true to also count each thread of the process separately, as "<event>.<name>.<tid>"
+//  "thread_scan_interval": milliseconds between looks for new threads, with per_thread
 class PerfCollector : public Collector
 {
 public:
@@ -16,6 +28,51 @@ public:
     virtual bool available() override;
 
 private:
-    std::map<std::string, int> mCounters;
+    struct event_spec
+    {
+        std::string name;
+        int type;
+        int config;
+        int exclude;
+    };
+
+    struct event
+    {
+        std::string key;
+        int fd = -1;
+        uint64_t id = 0;
+        struct perf_event_mmap_page* page = nullptr; // only mapped for events of the opening thread, for rdpmc
+        uint64_t previous = 0;
+    };
+
+    struct group
+    {
+        std::vector<event> events; // the first one is the group leader
+        bool inherit = true;
+        pid_t tid = 0; // the thread counted by a per-thread group, 0 for the others
+        pid_t owner = 0; // the thread which opened the group, only it can read its user pages
+        uint64_t samples_before = 0; // samples taken before this group was opened, they are zero
+        bool filled = false;
+        bool exited = false; // the thread of a per-thread group has exited, its events are closed
+    };
+
+    bool openGroup(const std::vector<event_spec>& specs, bool inherit, pid_t tid, const std::string& suffix);
+    void closeGroup(group& g);
+    void closeExitedThreads(const std::map<pid_t, bool>& live);
+    bool enableGroup(group& g);
+    bool readGroup(group& g);
+    bool readUserPage(group& g);
+    void scanThreads(int64_t now);
+
+    std::vector<group> mGroups;
+    std::vector<event_spec> mThreadSpecs; // events counted per thread
+    std::map<pid_t, bool> mThreads; // threads already seen, and if their counters could be opened
+    std::vector<uint64_t> mReadBuffer;
+    std::vector<uint64_t> mValues;
     int mSet = 0;
+    bool mInherit = true;
+    bool mPerThread = false;
+    int mThreadScanInterval = 100;
+    int64_t mLastThreadScan = 0;
+    uint64_t mSamples = 0;
 };
@@ -45,6 +45,7 @@ public:
     virtual bool postprocess(const std::vector<int64_t>& timing) override;
     virtual bool collect(int64_t) override;
     virtual bool available() override;
+    virtual bool streamable() const override { return false; } // the samples come from the daemon at stop
 
 private:
     PowerDaemon mPD;
@@ -27,36 +27,29 @@ ProcFSStatCollector::ProcFSStatCollector(const Json::Value& config, const std::s
 
 bool ProcFSStatCollector::parse(const char* buffer)
 {
-    int pid;
-    char comm[256];
-    char state;
-    int ppid;
-    int pgrp;
-    int session;
-    int tty_nr;
-    int tpgid;
-    unsigned int flags;
-    unsigned long minflt;
-    unsigned long cminflt;
-    unsigned long majflt;
-    unsigned long cmajflt;
-    unsigned long utime;
-    unsigned long stime;
-    unsigned int cutime;
-    unsigned int cstime;
-    int priority;
-    int nice;
-    int num_threads;
-
-    int ret = sscanf(buffer, "%d %s %c %d %d %d %d %d %u %lu %lu %lu %lu %lu %lu %u %u %d %d %d",
-                     &pid, comm, &state, &ppid, &pgrp, &session, &tty_nr, &tpgid, &flags,
-                     &minflt, &cminflt, &majflt, &cmajflt, &utime, &stime, &cutime, &cstime, &priority,
-                     &nice, &num_threads);
-
-    if (ret != 20)
+    // pid (comm) state ppid pgrp session tty_nr tpgid flags minflt cminflt majflt cmajflt utime stime cutime cstime
+    // priority nice num_threads ..., where comm may hold spaces and parentheses, so start after the last ')'
+    const char* p = strrchr(buffer, ')');
+    if (!p || p[1] != ' ' || p[2] == '\0')
     {
         return false;
     }
+    p += 3; // skip state
+    int64_t fields[17]; // ppid to num_threads
+    for (int64_t& field : fields)
+    {
+        const char* end = parseInteger(p, field);
+        if (end == p)
+        {
+            return false;
+        }
+        p = end;
+    }
+    const unsigned long utime = fields[10];
+    const unsigned long stime = fields[11];
+    const unsigned long cutime = fields[12];
+    const unsigned long cstime = fields[13];
+    const int num_threads = fields[16];
 
     unsigned long tot_time = utime + stime + cutime + cstime;
 
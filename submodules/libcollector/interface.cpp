@@ -1,4 +1,6 @@
 #include "interface.hpp"
+#include "stream.hpp"
+#include "collectors/collector_utility.hpp"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -41,20 +43,15 @@ void Collector::useThreading(int sampleRate)
     mSampleRate = sampleRate;
 }
 
-void Collector::loop()
+void Collector::sample(int64_t now)
 {
-    while (!finished)
+    collect( now );
+    if (mStream)
     {
-        int64_t t1 = getTime();
-        collect( t1 );
-        int64_t t2 = getTime();
-
-        auto duration = std::chrono::microseconds( t2 - t1 );
-
-        if (!finished && duration < std::chrono::milliseconds(mSampleRate))
-        {
-            std::this_thread::sleep_for(std::chrono::milliseconds(mSampleRate) - duration);
-        }
+        // threaded samples don't match frames, so record when they were taken
+        CollectorValue v;
+        v.i64 = now - mStream->startTime();
+        stream("sample_time", CollectorValueList::TYPE_I64, v, false);
     }
 }
 
@@ -63,7 +60,7 @@ void Collector::loop()
 // in order to do the matching, which has its own costs.
 bool Collector::postprocess(const std::vector<int64_t>& timing)
 {
-    if (mIsThreaded && !mIsSummarized) // remix values based on frame times
+    if (mIsThreaded && !mIsSummarized && !mStream) // remix values based on frame times
     {
         double duration = 0;
         for (const int64_t v : timing)
@@ -93,6 +90,30 @@ bool Collector::postprocess(const std::vector<int64_t>& timing)
     return true;
 }
 
+void Collector::stream(const std::string& key, CollectorValueList::vtype type, CollectorValue value, bool statistics)
+{
+    auto it = mColumns.find(key);
+    if (it == mColumns.end())
+    {
+        it = mColumns.emplace(key, mStream->column(mName + ":" + key, type, statistics)).first;
+    }
+    assert(it->second->type() == type);
+    it->second->push(value);
+}
+
+Json::Value Collector::streamSummary() const
+{
+    Json::Value v;
+    for (const auto& pair : mColumns)
+    {
+        if (pair.second->statistics())
+        {
+            v[pair.first] = pair.second->summary();
+        }
+    }
+    return v;
+}
+
 // ---------- SYSFS COLLECTOR ----------
 
 SysfsCollector::SysfsCollector(const Json::Value& config, const std::string& name, const std::vector<std::string>& sysfsfiles, bool accumulative)
@@ -103,15 +124,14 @@ SysfsCollector::SysfsCollector(const Json::Value& config, const std::string& nam
 
 bool SysfsCollector::parse(const char* buffer)
 {
-    char *end;
-    long temp = strtol(buffer, &end, 10);
-    if (!*end)
+    int64_t temp;
+    if (parseInteger(buffer, temp) == buffer)
     {
         return false;
     }
     if (std::isnan(mFactor))
     {
-        add(mName, temp);
+        add(mName, (long)temp);
     }
     else
     {
@@ -125,27 +145,13 @@ bool SysfsCollector::collect(int64_t now)
     char buf[1024];
 
     assert(mFD != -1);
-    memset(buf, 0x00, sizeof(buf));
 
-    if (read(mFD, buf, sizeof(buf) - 1) == -1)
+    if (readFromStart(mFD, mSysfsFile, buf, sizeof(buf)) == -1)
     {
         DBG_LOG("%s: Failed to read %s: %s\n", mName.c_str(), mSysfsFile.c_str(), strerror(errno));
         return false;
     }
 
-    if (lseek(mFD, 0, SEEK_SET) == -1)
-    {
-        // workaround for weird hikey implementation
-        close(mFD);
-        mFD = open(mSysfsFile.c_str(), O_RDONLY);
-        if (mFD < 0)
-        {
-            DBG_LOG("%s: Failed to both seek and re-open %s: %s\n", mName.c_str(), mSysfsFile.c_str(), strerror(errno));
-            mFD = -1;
-            return false;
-        }
-    }
-
     if (!parse(buf))
     {
         DBG_LOG("%s: Read garbage from %s: \"%s\"\n", mName.c_str(), mSysfsFile.c_str(), buf);
@@ -187,6 +193,72 @@ SysfsCollector::~SysfsCollector()
     mCollecting = false;
 }
 
+// ---------- SAMPLER ----------
+
+void Sampler::start(const std::vector<Collector*>& collectors)
+{
+    stop();
+    mEntries.clear();
+    const int64_t now = getTime();
+    for (Collector* c : collectors)
+    {
+        mEntries.push_back({ c, now });
+    }
+    if (mEntries.empty())
+    {
+        return;
+    }
+    mFinished = false;
+    mThread = std::thread(&Sampler::loop, this);
+    int failure = pthread_setname_np(mThread.native_handle(), "lcsampler");
+    if (failure)
+    {
+        DBG_LOG("Failed to set sampler thread name, will inherit from parent process.\n");
+    }
+}
+
+void Sampler::stop()
+{
+    if (!mThread.joinable())
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFinished = true;
+    }
+    mCondition.notify_one();
+    mThread.join();
+}
+
+void Sampler::loop()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mFinished)
+    {
+        lock.unlock();
+        const int64_t now = getTime();
+        int64_t next = INT64_MAX;
+        for (entry& e : mEntries)
+        {
+            if (e.next <= now)
+            {
+                e.collector->sample(now);
+                const int64_t period = (int64_t)e.collector->sampleRate() * 1000;
+                e.next += period;
+                if (e.next <= now)
+                {
+                    e.next = now + period; // fell behind, skip the missed samples rather than bursting
+                }
+            }
+            next = std::min(next, e.next);
+        }
+        lock.lock();
+        const auto deadline = std::chrono::high_resolution_clock::time_point(std::chrono::microseconds(next));
+        mCondition.wait_until(lock, deadline, [this] { return mFinished; });
+    }
+}
+
 // ---------- COLLECTION ----------
 
 Collection::Collection(const Json::Value& config) : mConfig(config)
@@ -247,6 +319,11 @@ Collection::Collection(const Json::Value& config) : mConfig(config)
 
     // Various specializations
     mCollectorMap["battery_temperature"]->doubleTransform(0.1); // divide by 10 and store as float
+
+    if (config.isMember("streaming") && config["streaming"].isObject())
+    {
+        mStream = new CollectorStream(config["streaming"]);
+    }
 }
 
 Collection::~Collection()
@@ -256,6 +333,7 @@ Collection::~Collection()
         c->deinit();
         delete c;
     }
+    delete mStream;
 }
 
 std::vector<std::string> Collection::available()
@@ -341,45 +419,52 @@ void Collection::start(const std::vector<std::string>& headers)
     mCustomHeaders = headers;
     mCustom.resize(headers.size());
     mCustomSummarized.resize(headers.size());
+    mCustomColumns.clear();
+    if (mStream)
+    {
+        if (mStream->open(mStartTime))
+        {
+            mTimingColumn = mStream->column("timing:time", CollectorValueList::TYPE_I64);
+            for (const std::string& h : headers)
+            {
+                mCustomColumns.push_back(mStream->column("custom:" + h, CollectorValueList::TYPE_I64));
+            }
+            if (mDebug) DBG_LOG("Streaming samples to %s\n", mStream->path().c_str());
+        }
+        else
+        {
+            DBG_LOG("Streaming disabled, keeping results in memory\n");
+            delete mStream;
+            mStream = nullptr;
+        }
+    }
+    std::vector<Collector*> threaded;
+    mKeepTiming = !mStream;
     for (Collector* c : mRunning)
     {
         c->clear();
+        c->setStream(c->streamable() ? mStream : nullptr);
+        mKeepTiming = mKeepTiming || !c->streamable();
         c->start();
         if (c->isThreaded())
         {
-            c->finished = false;
-            c->thread = std::thread(&Collector::loop, c);
-            int failure = pthread_setname_np(
-                c->thread.native_handle(),
-                c->name().c_str());
-
-            if (failure) {
-                DBG_LOG("%s: Failed to set collector thread name, will inherit from parent process.\n", c->name().c_str());
-            }
+            threaded.push_back(c);
         }
     }
+    // All threaded collectors share one sampling thread
+    mSampler.start(threaded);
 
     running = true;
 }
 
 void Collection::stop()
 {
-    // First signal all threaded collectors to stop to end threaded measurements
-    for (Collector* c : mRunning)
-    {
-        if (c->isThreaded())
-        {
-            c->finished = true;
-        }
-    }
+    // First end threaded measurements
+    mSampler.stop();
     // Then stop all collectors (this can take some time)
     std::vector<Collector*> tmp;
     for (Collector* c : mRunning)
     {
-        if (c->isThreaded())
-        {
-            c->thread.join();
-        }
         c->stop();
         if (c->postprocess(mTiming))
         {
@@ -387,6 +472,10 @@ void Collection::stop()
         }
     }
     mRunning = tmp;
+    if (mStream)
+    {
+        mStream->close();
+    }
 
     running = false;
 }
@@ -394,7 +483,16 @@ void Collection::stop()
 void Collection::collect(std::vector<int64_t> custom)
 {
     const int64_t now = getTime();
-    mTiming.push_back(now - mPreviousTime);
+    if (mStream)
+    {
+        CollectorValue v;
+        v.i64 = now - mPreviousTime;
+        mTimingColumn->push(v);
+    }
+    if (mKeepTiming)
+    {
+        mTiming.push_back(now - mPreviousTime);
+    }
     mPreviousTime = now;
     for (Collector* c : mRunning)
     {
@@ -406,7 +504,16 @@ void Collection::collect(std::vector<int64_t> custom)
     assert(custom.size() == mCustomHeaders.size());
     for (unsigned i = 0; i < mCustomHeaders.size(); i++)
     {
-        mCustom[i].push_back(custom[i]);
+        if (mStream)
+        {
+            CollectorValue v;
+            v.i64 = custom[i];
+            mCustomColumns[i]->push(v);
+        }
+        else
+        {
+            mCustom[i].push_back(custom[i]);
+        }
     }
 }
 
@@ -421,6 +528,13 @@ Json::Value Collection::results()
             results[c->name()] = v;
             continue;
         }
+        if (c->isStreamed())
+        {
+            v = c->streamSummary();
+            v["streamed"] = true;
+            results[c->name()] = v;
+            continue;
+        }
         for (const auto& pair : c->results())
         {
             if (c->isSummarized()) v["summarized"] = true;
@@ -441,7 +555,12 @@ Json::Value Collection::results()
     Json::Value v;
     v["time"] = Json::arrayValue;
     results["timing"] = v;
-    if (mTimingSummarized.size() > 0)
+    if (mStream)
+    {
+        results["timing"]["time"] = mTimingColumn->summary();
+        results["timing"]["streamed"] = true;
+    }
+    else if (mTimingSummarized.size() > 0)
     {
         for (int64_t t : mTimingSummarized)
         {
@@ -455,7 +574,12 @@ Json::Value Collection::results()
     for (unsigned i = 0; i < mCustomHeaders.size(); i++)
     {
         results["custom"][mCustomHeaders[i]] = Json::arrayValue;
-        if (mCustomSummarized[i].size() > 0)
+        if (mStream)
+        {
+            results["custom"][mCustomHeaders[i]] = mCustomColumns[i]->summary();
+            results["custom"]["streamed"] = true;
+        }
+        else if (mCustomSummarized[i].size() > 0)
         {
             for (int64_t t : mCustomSummarized[i])
             {
@@ -468,6 +592,11 @@ Json::Value Collection::results()
             results["custom"][mCustomHeaders[i]].append(static_cast<Json::Value::Int64>(t));
         }
     }
+    if (mStream)
+    {
+        results["streaming"]["path"] = mStream->path();
+        results["streaming"]["dropped"] = static_cast<Json::UInt64>(mStream->dropped());
+    }
     if (mConfig.isMember("provenance")) // pass provenance through from config to results
     {
         results["provenance"] = mConfig["provenance"];
@@ -477,6 +606,11 @@ Json::Value Collection::results()
 
 bool Collection::writeCSV_MTV(const std::string& filename)
 {
+    if (mStream)
+    {
+        fprintf(stderr, "FAILED to write %s: samples were streamed to %s\n", filename.c_str(), mStream->path().c_str());
+        return false;
+    }
     FILE *fp = fopen(filename.c_str(), "w");
     if (!fp)
     {
@@ -519,6 +653,10 @@ bool Collection::writeCSV_MTV(const std::string& filename)
 
 void Collection::summarize()
 {
+    if (mStream)
+    {
+        return; // the stream only keeps summaries already
+    }
     for (auto c : mCollectors) c->summarize();
     int64_t sum = 0;
     for (auto c : mTiming) sum += c;
@@ -535,6 +673,11 @@ void Collection::summarize()
 
 bool Collection::writeCSV(const std::string& filename)
 {
+    if (mStream)
+    {
+        fprintf(stderr, "FAILED to write %s: samples were streamed to %s\n", filename.c_str(), mStream->path().c_str());
+        return false;
+    }
     FILE *fp = fopen(filename.c_str(), "w");
     if (!fp)
     {
@@ -11,6 +11,8 @@
 #include <thread>
 #include <pthread.h>
 #include <chrono>
+#include <mutex>
+#include <condition_variable>
 
 #include <jsoncpp/json/value.h>
 
@@ -72,12 +74,15 @@ struct CollectorValueList
 
 typedef std::map<std::string, CollectorValueList> CollectorValueResults;
 
+class CollectorStream;
+class StreamColumn;
+
 // General collector class
 class Collector
 {
 public:
     Collector(const Json::Value& config, const std::string& name)
-        : finished(false), mSampleRate(100), mCollecting(false), mConfig(config.get(name, Json::Value()))
+        : mSampleRate(100), mCollecting(false), mConfig(config.get(name, Json::Value()))
         , mName(name), mFactor(NAN) {}
     virtual ~Collector() {}
 
@@ -97,6 +102,7 @@ public:
     virtual void doubleTransform(double factor) final { mFactor = factor; }
     virtual void useThreading(int sampleRate) final;
     virtual bool isThreaded() const final { return mIsThreaded; }
+    virtual int sampleRate() const final { return mSampleRate; }
     virtual bool isSummarized() const final { return mIsSummarized; }
 
     virtual void summarize()
@@ -117,24 +123,31 @@ public:
         }
     }
 
-    virtual void add(const std::string& key, double value) final { mResults[key].push_back(value); }
-    virtual void add(const std::string& key, float value) final { mResults[key].push_back(value); }
-    virtual void add(const std::string& key, int value) final { mResults[key].push_back(value); }
-    virtual void add(const std::string& key, long value) final { mResults[key].push_back(value); }
-    virtual void add(const std::string& key, long long value) final { mResults[key].push_back(value); }
-    virtual void add(const std::string& key, unsigned value) final { mResults[key].push_back(value); }
-    virtual void add(const std::string& key, unsigned long value) final { mResults[key].push_back(value); }
-
-    /// For multi-threaded operation, this loop is called instead of owning class calling collect() directly.
-    virtual void loop() final;
+    virtual void add(const std::string& key, double value) final { if (mStream) { CollectorValue v; v.fp64 = value; stream(key, CollectorValueList::TYPE_FP64, v); } else mResults[key].push_back(value); }
+    virtual void add(const std::string& key, float value) final { if (mStream) { CollectorValue v; v.fp64 = value; stream(key, CollectorValueList::TYPE_FP64, v); } else mResults[key].push_back(value); }
+    virtual void add(const std::string& key, int value) final { if (mStream) { CollectorValue v; v.i64 = value; stream(key, CollectorValueList::TYPE_I64, v); } else mResults[key].push_back(value); }
+    virtual void add(const std::string& key, long value) final { if (mStream) { CollectorValue v; v.i64 = value; stream(key, CollectorValueList::TYPE_I64, v); } else mResults[key].push_back(value); }
+    virtual void add(const std::string& key, long long value) final { if (mStream) { CollectorValue v; v.i64 = value; stream(key, CollectorValueList::TYPE_I64, v); } else mResults[key].push_back(value); }
+    virtual void add(const std::string& key, unsigned value) final { if (mStream) { CollectorValue v; v.u64 = value; stream(key, CollectorValueList::TYPE_U64, v); } else mResults[key].push_back(value); }
+    virtual void add(const std::string& key, unsigned long value) final { if (mStream) { CollectorValue v; v.u64 = value; stream(key, CollectorValueList::TYPE_U64, v); } else mResults[key].push_back(value); }
 
-    /// If threaded, this holds the thread information
-    std::thread thread;
-    /// Set this to true in order to stop collecting data
-    std::atomic<bool> finished;
+    /// For threaded operation, the Sampler calls this instead of the owning class calling collect() directly.
+    virtual void sample(int64_t now) final;
 
     virtual void setDebug(bool debug) final { mDebug = debug; }
 
+    /// Send samples to the given stream instead of keeping them in results(). Pass nullptr to go
+    /// back to keeping results in memory.
+    virtual void setStream(CollectorStream* stream) final { mStream = stream; mColumns.clear(); }
+    virtual bool isStreamed() const final { return mStream != nullptr; }
+
+    /// False for collectors which only fill results() in postprocess(), from the frame times. They
+    /// keep their results in memory when the Collection streams.
+    virtual bool streamable() const { return true; }
+
+    /// Summary statistics of each streamed key
+    virtual Json::Value streamSummary() const final;
+
 protected:
     /// In debug mode?
     bool mDebug = false;
@@ -156,6 +169,14 @@ protected:
     double mFactor;
     /// Custom results (replaces sampling points)
     Json::Value mCustomResult;
+
+private:
+    void stream(const std::string& key, CollectorValueList::vtype type, CollectorValue value, bool statistics = true);
+
+    /// Streaming sink, if enabled. Replaces mResults.
+    CollectorStream* mStream = nullptr;
+    /// Stream column of each key, only used by the thread collecting the data
+    std::map<std::string, StreamColumn*> mColumns;
 };
 
 // Specialized collector class for handling /sys filesystem polling
@@ -179,6 +200,38 @@ private:
     bool mAccumulative = false;
 };
 
+// Samples all threaded collectors from a single thread, each at its own sample rate. The clock
+// is read once per tick and the same timestamp is given to every collector sampled in it.
+class Sampler
+{
+public:
+    Sampler() {}
+    ~Sampler() { stop(); }
+
+    /// Start sampling the given collectors, which must already be started
+    void start(const std::vector<Collector*>& collectors);
+
+    /// Stop sampling and wait for the current tick to finish
+    void stop();
+
+    bool running() const { return mThread.joinable(); }
+
+private:
+    struct entry
+    {
+        Collector* collector;
+        int64_t next; // time of the next sample
+    };
+
+    void loop();
+
+    std::vector<entry> mEntries;
+    std::thread mThread;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    bool mFinished = false;
+};
+
 // Manager class
 class Collection
 {
@@ -221,10 +274,10 @@ public:
         mCollectors.push_back((Collector*)collector);
     }
 
-    /// Write out the data to file as CSV (data in rows)
+    /// Write out the data to file as CSV (data in rows). Not available when streaming.
     bool writeCSV(const std::string& filename);
 
-    /// Write out the data to file as CSV in the MTV format (data in columns)
+    /// Write out the data to file as CSV in the MTV format (data in columns). Not available when streaming.
     bool writeCSV_MTV(const std::string& filename);
 
     /// Clear any old results and start collecting data. If the optional customHeaders
@@ -236,7 +289,8 @@ public:
     void stop();
 
     /// Summarize existing data as an average. Useful for looping tests. Once this has been
-    /// called once, what you get out with results() later will be these averages.
+    /// called once, what you get out with results() later will be these averages. Does nothing
+    /// when streaming, since results() then only has summaries anyway.
     void summarize();
 
     /// Check if any collector is running
@@ -246,9 +300,13 @@ public:
     /// result value.
     void collect(std::vector<int64_t> custom = std::vector<int64_t>());
 
-    /// Get the results as JSON
+    /// Get the results as JSON. When streaming (see stream.hpp), each key holds summary
+    /// statistics instead of the list of samples, which are in the stream file.
     Json::Value results();
 
+    /// Check if samples are streamed to a file instead of kept in memory
+    bool is_streaming() const { return mStream != nullptr; }
+
     const Json::Value& config() { return mConfig; }
 
 private:
@@ -257,11 +315,16 @@ private:
     std::vector<Collector*> mCollectors;
     std::vector<Collector*> mRunning;
     std::map<std::string, Collector*> mCollectorMap;
-    std::vector<int64_t> mTiming;
+    Sampler mSampler;
+    std::vector<int64_t> mTiming; // also kept when streaming, for the collectors which aren't streamable
+    bool mKeepTiming = true;
     std::vector<int64_t> mTimingSummarized;
     std::vector<std::vector<int64_t>> mCustom; // custom results
     std::vector<std::vector<int64_t>> mCustomSummarized; // custom results
     std::vector<std::string> mCustomHeaders;
+    CollectorStream* mStream = nullptr;
+    StreamColumn* mTimingColumn = nullptr;
+    std::vector<StreamColumn*> mCustomColumns;
     int64_t mStartTime = 0;
     int64_t mPreviousTime = 0;
     bool mDebug = false;
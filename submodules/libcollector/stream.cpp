@@ -0,0 +1,399 @@
+#include "stream.hpp"
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// ---------- SKETCH ----------
+
+// 16 buckets per power of two, for magnitudes from 2^-32 to 2^64
+static const int sketch_sub_buckets = 16;
+static const int sketch_min_exponent = -31;
+static const int sketch_max_exponent = 64;
+static const int sketch_buckets = (sketch_max_exponent - sketch_min_exponent + 1) * sketch_sub_buckets;
+
+int StreamSketch::bucket(double magnitude) const
+{
+    int exponent;
+    const double mantissa = frexp(magnitude, &exponent); // magnitude = mantissa * 2^exponent, mantissa in [0.5, 1)
+    if (magnitude == 0.0 || exponent < sketch_min_exponent)
+    {
+        return -1;
+    }
+    if (exponent > sketch_max_exponent)
+    {
+        return sketch_buckets - 1;
+    }
+    const int sub = std::min(sketch_sub_buckets - 1, (int)((mantissa - 0.5) * 2 * sketch_sub_buckets));
+    return (exponent - sketch_min_exponent) * sketch_sub_buckets + sub;
+}
+
+double StreamSketch::bucketValue(int index) const
+{
+    const int exponent = index / sketch_sub_buckets + sketch_min_exponent;
+    const double mantissa = 0.5 + ((index % sketch_sub_buckets) + 0.5) / (2 * sketch_sub_buckets);
+    return ldexp(mantissa, exponent);
+}
+
+void StreamSketch::add(double value)
+{
+    if (std::isnan(value))
+    {
+        return;
+    }
+    if (mCount == 0)
+    {
+        mMin = mMax = value;
+    }
+    mMin = std::min(mMin, value);
+    mMax = std::max(mMax, value);
+    mSum += value;
+    mCount++;
+
+    const int index = bucket(fabs(value));
+    if (index < 0)
+    {
+        mZeros++;
+        return;
+    }
+    std::vector<uint64_t>& histogram = value < 0 ? mNegative : mPositive;
+    if (histogram.empty())
+    {
+        histogram.resize(sketch_buckets, 0);
+    }
+    histogram[index]++;
+}
+
+double StreamSketch::percentile(double p) const
+{
+    if (mCount == 0)
+    {
+        return 0.0;
+    }
+    const uint64_t rank = (uint64_t)(p / 100.0 * (double)(mCount - 1));
+    uint64_t seen = 0;
+    double value = mMax;
+    bool found = false;
+    // Walk the values in increasing order: most negative first, then zeros, then positive values
+    for (int i = sketch_buckets - 1; i >= 0 && !found && !mNegative.empty(); i--)
+    {
+        seen += mNegative[i];
+        if (seen > rank)
+        {
+            value = -bucketValue(i);
+            found = true;
+        }
+    }
+    if (!found)
+    {
+        seen += mZeros;
+        if (seen > rank)
+        {
+            value = 0.0;
+            found = true;
+        }
+    }
+    for (int i = 0; i < sketch_buckets && !found && !mPositive.empty(); i++)
+    {
+        seen += mPositive[i];
+        if (seen > rank)
+        {
+            value = bucketValue(i);
+            found = true;
+        }
+    }
+    return std::max(mMin, std::min(mMax, value));
+}
+
+Json::Value StreamSketch::json() const
+{
+    Json::Value v;
+    v["count"] = static_cast<Json::UInt64>(mCount);
+    v["min"] = mMin;
+    v["max"] = mMax;
+    v["mean"] = mCount > 0 ? mSum / (double)mCount : 0.0;
+    v["p50"] = percentile(50.0);
+    v["p90"] = percentile(90.0);
+    v["p99"] = percentile(99.0);
+    return v;
+}
+
+// ---------- COLUMN ----------
+
+StreamColumn::StreamColumn(CollectorStream* stream, uint32_t id, const std::string& name, CollectorValueList::vtype type,
+                           size_t capacity, bool statistics)
+    : mStream(stream), mId(id), mName(name), mType(type), mStatistics(statistics), mRing(capacity)
+    , mHead(0), mTail(0), mDropped(0), mGapPosition(UINT64_MAX), mGapDropped(0)
+{
+}
+
+bool StreamColumn::push(CollectorValue value)
+{
+    if (mStatistics)
+    {
+        switch (mType)
+        {
+        case CollectorValueList::TYPE_FP64: mSketch.add(value.fp64); break;
+        case CollectorValueList::TYPE_U64: mSketch.add((double)value.u64); break;
+        case CollectorValueList::TYPE_I64: mSketch.add((double)value.i64); break;
+        case CollectorValueList::TYPE_UNASSIGNED: assert(false); break;
+        }
+    }
+
+    const uint64_t head = mHead.load(std::memory_order_relaxed);
+    const uint64_t tail = mTail.load(std::memory_order_acquire);
+    if (head - tail >= mRing.size())
+    {
+        mDropped.store(mDropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        mPendingGap = true;
+        mStream->wake();
+        return false;
+    }
+    if (mPendingGap)
+    {
+        mGapDropped.store(mDropped.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        mGapPosition.store(head, std::memory_order_relaxed);
+        mPendingGap = false;
+    }
+    mRing[head % mRing.size()] = value;
+    mHead.store(head + 1, std::memory_order_release);
+    if (head + 1 - tail == mRing.size() / 2)
+    {
+        mStream->wake(); // don't wait for the flush interval to make room
+    }
+    return true;
+}
+
+void StreamColumn::drain(std::vector<CollectorValue>& out, std::vector<std::pair<uint64_t, size_t>>& runs)
+{
+    const uint64_t tail = mTail.load(std::memory_order_relaxed);
+    const uint64_t head = mHead.load(std::memory_order_acquire);
+    if (head == tail)
+    {
+        return;
+    }
+    const uint64_t gap = mGapPosition.load(std::memory_order_relaxed);
+    uint64_t position = tail;
+    if (gap > tail && gap < head)
+    {
+        runs.emplace_back(tail + mDrainedDropped, gap - tail);
+        position = gap;
+    }
+    if (gap >= tail && gap < head)
+    {
+        mDrainedDropped = mGapDropped.load(std::memory_order_relaxed);
+    }
+    runs.emplace_back(position + mDrainedDropped, head - position);
+    for (uint64_t i = tail; i < head; i++)
+    {
+        out.push_back(mRing[i % mRing.size()]);
+    }
+    mTail.store(head, std::memory_order_release);
+}
+
+Json::Value StreamColumn::summary() const
+{
+    Json::Value v = mSketch.json();
+    if (dropped() > 0)
+    {
+        v["dropped"] = static_cast<Json::UInt64>(dropped());
+    }
+    return v;
+}
+
+// ---------- STREAM ----------
+
+CollectorStream::CollectorStream(const Json::Value& config)
+{
+    mPath = config.get("path", "results_stream.bin").asString();
+    mCSV = config.get("format", "binary").asString() == "csv";
+    mRingSize = std::max(2, config.get("ring_size", 4096).asInt());
+    mFlushInterval = std::max(1, config.get("flush_interval", 1000).asInt());
+}
+
+CollectorStream::~CollectorStream()
+{
+    close();
+}
+
+bool CollectorStream::open(int64_t startTime)
+{
+    close();
+    mColumns.clear();
+    mWrittenColumns = 0;
+    mFailed = false;
+    mStartTime = startTime;
+
+    mFile = fopen(mPath.c_str(), mCSV ? "w" : "wb");
+    if (!mFile)
+    {
+        DBG_LOG("Failed to open stream file %s: %s\n", mPath.c_str(), strerror(errno));
+        return false;
+    }
+    if (mCSV)
+    {
+        fprintf(mFile, "column,index,value\n");
+    }
+    else
+    {
+        const uint32_t header[2] = { 1, 0 }; // version, reserved
+        fwrite("LCSTREAM", 8, 1, mFile);
+        fwrite(header, sizeof(header), 1, mFile);
+    }
+    mFinished = false;
+    mWakeup = false;
+    mThread = std::thread(&CollectorStream::loop, this);
+    int failure = pthread_setname_np(mThread.native_handle(), "lcstream");
+    if (failure)
+    {
+        DBG_LOG("Failed to set stream thread name, will inherit from parent process.\n");
+    }
+    return true;
+}
+
+bool CollectorStream::close()
+{
+    if (!mFile)
+    {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFinished = true;
+    }
+    mCondition.notify_one();
+    mThread.join();
+    flush(); // producers have stopped, pick up anything pushed since the last flush
+    bool ok = !mFailed;
+    if (fclose(mFile) != 0)
+    {
+        ok = false;
+    }
+    mFile = nullptr;
+    if (!ok)
+    {
+        DBG_LOG("Failed to write stream file %s\n", mPath.c_str());
+    }
+    if (dropped() > 0)
+    {
+        DBG_LOG("Stream file %s is missing %llu samples, increase \"ring_size\" or decrease \"flush_interval\"\n",
+                mPath.c_str(), (unsigned long long)dropped());
+    }
+    return ok;
+}
+
+StreamColumn* CollectorStream::column(const std::string& name, CollectorValueList::vtype type, bool statistics)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mColumns.emplace_back(new StreamColumn(this, (uint32_t)mColumns.size(), name, type, mRingSize, statistics));
+    return mColumns.back().get();
+}
+
+void CollectorStream::wake()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mWakeup = true;
+    }
+    mCondition.notify_one();
+}
+
+uint64_t CollectorStream::dropped() const
+{
+    uint64_t sum = 0;
+    for (const auto& c : mColumns)
+    {
+        sum += c->dropped();
+    }
+    return sum;
+}
+
+void CollectorStream::loop()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mFinished)
+    {
+        mCondition.wait_for(lock, std::chrono::milliseconds(mFlushInterval), [this] { return mFinished || mWakeup; });
+        mWakeup = false;
+        lock.unlock();
+        flush();
+        lock.lock();
+    }
+}
+
+bool CollectorStream::flush()
+{
+    std::vector<StreamColumn*> columns;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (const auto& c : mColumns)
+        {
+            columns.push_back(c.get());
+        }
+    }
+    for (; mWrittenColumns < columns.size(); mWrittenColumns++)
+    {
+        writeColumn(*columns[mWrittenColumns]);
+    }
+    for (StreamColumn* c : columns)
+    {
+        mScratch.clear();
+        mRuns.clear();
+        c->drain(mScratch, mRuns);
+        size_t offset = 0;
+        for (const auto& run : mRuns)
+        {
+            writeData(*c, run.first, offset, run.second);
+            offset += run.second;
+        }
+    }
+    if (fflush(mFile) != 0)
+    {
+        mFailed = true;
+    }
+    return !mFailed;
+}
+
+bool CollectorStream::writeColumn(const StreamColumn& column)
+{
+    if (mCSV)
+    {
+        return true; // columns are named on each line
+    }
+    const uint32_t record[4] = { 1, column.id(), (uint32_t)column.type(), (uint32_t)column.name().size() };
+    if (fwrite(record, sizeof(record), 1, mFile) != 1 || fwrite(column.name().data(), column.name().size(), 1, mFile) != 1)
+    {
+        mFailed = true;
+    }
+    return !mFailed;
+}
+
+bool CollectorStream::writeData(const StreamColumn& column, uint64_t first, size_t offset, size_t count)
+{
+    if (mCSV)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const CollectorValue& value = mScratch[offset + i];
+            switch (column.type())
+            {
+            case CollectorValueList::TYPE_FP64: fprintf(mFile, "%s,%llu,%f\n", column.name().c_str(), (unsigned long long)(first + i), value.fp64); break;
+            case CollectorValueList::TYPE_I64: fprintf(mFile, "%s,%llu,%lld\n", column.name().c_str(), (unsigned long long)(first + i), (long long)value.i64); break;
+            case CollectorValueList::TYPE_U64: fprintf(mFile, "%s,%llu,%llu\n", column.name().c_str(), (unsigned long long)(first + i), (unsigned long long)value.u64); break;
+            case CollectorValueList::TYPE_UNASSIGNED: assert(false); break;
+            }
+        }
+        return true;
+    }
+    uint32_t record[6] = { 2, column.id(), 0, 0, (uint32_t)count, 0 };
+    memcpy(&record[2], &first, sizeof(first));
+    if (fwrite(record, sizeof(record), 1, mFile) != 1 || fwrite(&mScratch[offset], sizeof(CollectorValue), count, mFile) != count)
+    {
+        mFailed = true;
+    }
+    return !mFailed;
+}
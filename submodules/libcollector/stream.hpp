@@ -0,0 +1,156 @@
+#pragma once
+
+// Streaming sink for long running collections. Instead of keeping every sample in memory until
+// the end of the run, each result key gets a fixed-size ring buffer which a background thread
+// periodically drains to a file. Only summary statistics are kept in memory for results().
+//
+// Enabled by a "streaming" object in the Collection JSON:
+//
+//  "streaming": {
+//      "path": "results_stream.bin", # Output file, truncated on each Collection::start()
+//      "format": "binary",           # "binary" (columnar blocks, see below) or "csv"
+//      "ring_size": 4096,            # Samples buffered per key before samples are dropped
+//      "flush_interval": 1000        # Milliseconds between flushes of the ring buffers
+//  }
+//
+// Binary format, all values in host byte order:
+//  header:  char magic[8] = "LCSTREAM", uint32 version = 1, uint32 reserved = 0
+//  column:  uint32 tag = 1, uint32 column id, uint32 type (CollectorValueList::vtype),
+//           uint32 name length, name ("collector:key", not null terminated)
+//  data:    uint32 tag = 2, uint32 column id, uint64 index of the first sample, uint32 count,
+//           uint32 reserved = 0, count * 8 bytes of CollectorValue
+// A column record always comes before the first data record of that column.
+//
+// CSV format: one "column,index,value" line per sample.
+
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "interface.hpp"
+
+class CollectorStream;
+
+/// Online summary of a series of values in constant memory. Percentiles are estimated from a
+/// histogram with 16 linear buckets per power of two, so they are within about 3% of the value.
+class StreamSketch
+{
+public:
+    void add(double value);
+    double percentile(double p) const;
+    uint64_t count() const { return mCount; }
+    Json::Value json() const;
+
+private:
+    int bucket(double magnitude) const;
+    double bucketValue(int index) const;
+
+    uint64_t mCount = 0;
+    double mMin = 0.0;
+    double mMax = 0.0;
+    double mSum = 0.0;
+    uint64_t mZeros = 0; // magnitude below the smallest bucket
+    std::vector<uint64_t> mPositive; // allocated on first use
+    std::vector<uint64_t> mNegative;
+};
+
+/// Ring buffer of one result key. Written by a single producer (the collector's thread or the
+/// thread calling Collection::collect()) and drained by the stream writer thread.
+class StreamColumn
+{
+public:
+    StreamColumn(CollectorStream* stream, uint32_t id, const std::string& name, CollectorValueList::vtype type,
+                 size_t capacity, bool statistics);
+
+    /// Producer side. Returns false and counts the sample as dropped if the ring is full. Dropped
+    /// samples are still part of the summary, but not of the file, where indices skip over them.
+    bool push(CollectorValue value);
+
+    /// Consumer side. Moves all buffered samples to 'out' and describes them as runs of (index of
+    /// the first sample, count). There is more than one run if samples were dropped in between.
+    void drain(std::vector<CollectorValue>& out, std::vector<std::pair<uint64_t, size_t>>& runs);
+
+    uint32_t id() const { return mId; }
+    const std::string& name() const { return mName; }
+    CollectorValueList::vtype type() const { return mType; }
+    bool statistics() const { return mStatistics; }
+    uint64_t dropped() const { return mDropped.load(std::memory_order_relaxed); }
+
+    /// Summary of all pushed samples, only valid once the producer has stopped.
+    Json::Value summary() const;
+
+private:
+    CollectorStream* mStream;
+    uint32_t mId;
+    std::string mName;
+    CollectorValueList::vtype mType;
+    bool mStatistics;
+    std::vector<CollectorValue> mRing;
+    std::atomic<uint64_t> mHead; // written by the producer
+    std::atomic<uint64_t> mTail; // written by the consumer
+    std::atomic<uint64_t> mDropped;
+    // Position in the ring of the first sample pushed after a drop, and the number of samples
+    // dropped before it. There is at most one such gap that the consumer hasn't seen, since
+    // samples are only dropped while the ring is full.
+    std::atomic<uint64_t> mGapPosition;
+    std::atomic<uint64_t> mGapDropped;
+    bool mPendingGap = false; // producer only
+    uint64_t mDrainedDropped = 0; // consumer only
+    StreamSketch mSketch;
+};
+
+/// Owns the columns of a Collection and the thread writing them out.
+class CollectorStream
+{
+public:
+    CollectorStream(const Json::Value& config);
+    ~CollectorStream();
+
+    /// Truncate the output file, forget all previous columns and start the writer thread.
+    /// 'startTime' is the Collection start time that 'sample_time' columns are relative to.
+    bool open(int64_t startTime);
+
+    /// Flush remaining samples, stop the writer thread and close the file. Columns and their
+    /// summaries stay available until the next open().
+    bool close();
+
+    /// Create a new column. Thread safe, the returned pointer is valid until the next open().
+    StreamColumn* column(const std::string& name, CollectorValueList::vtype type, bool statistics = true);
+
+    /// Wake up the writer thread before its flush interval has elapsed.
+    void wake();
+
+    const std::string& path() const { return mPath; }
+    int64_t startTime() const { return mStartTime; }
+    uint64_t dropped() const;
+
+private:
+    void loop();
+    bool flush();
+    bool writeColumn(const StreamColumn& column);
+    bool writeData(const StreamColumn& column, uint64_t first, size_t offset, size_t count);
+
+    std::string mPath;
+    bool mCSV = false;
+    size_t mRingSize = 4096;
+    int mFlushInterval = 1000;
+    int64_t mStartTime = 0;
+
+    FILE* mFile = nullptr;
+    bool mFailed = false;
+    std::thread mThread;
+    std::mutex mMutex; // guards mColumns, mFinished and the condition variable
+    std::condition_variable mCondition;
+    bool mFinished = false;
+    bool mWakeup = false;
+    std::vector<std::unique_ptr<StreamColumn>> mColumns;
+    size_t mWrittenColumns = 0; // column records already in the file, writer thread only
+    std::vector<CollectorValue> mScratch; // samples being written, writer thread only
+    std::vector<std::pair<uint64_t, size_t>> mRuns;
+};
@@ -5,6 +5,8 @@
 #include <stdio.h>
 #include <jsoncpp/json/writer.h>
 #include <unistd.h>
+#include <string.h>
+#include <stdint.h>
 
 #ifndef DEBUG
 // otherwise we will get complaints about assert()ed variables being unused
@@ -261,6 +263,86 @@ static void test7()
 	c.writeCSV("excel.csv");
 }
 
+static void test8()
+{
+	printf("Trying to stream results through small ring buffers (should work)...\n");
+	const int frames = 100;
+	Json::Value j;
+	Json::Value threaded;
+	threaded["threaded"] = true;
+	threaded["sample_rate"] = 5;
+	j["procfs"] = threaded;
+	j["cpufreq"] = Json::objectValue;
+	j["rusage"] = Json::objectValue;
+	j["streaming"]["path"] = "stream_test.bin";
+	j["streaming"]["ring_size"] = 16;
+	j["streaming"]["flush_interval"] = 5;
+	Collection c(j);
+	bool result = c.initialize();
+	assert(result);
+	(void)result;
+	c.start({"result1"});
+	assert(c.is_streaming());
+	for (int i = 0; i < frames; i++)
+	{
+		c.collect({i});
+		usleep(1000);
+	}
+	c.stop();
+	Json::Value results = c.results();
+	Json::StyledWriter writer;
+	std::string data = writer.write(results);
+	printf("Results:\n%s", data.c_str());
+	// Samples taken at each frame are all in the summaries, even those the writer dropped
+	assert(results["timing"]["time"]["count"].asInt() == frames);
+	assert(results["custom"]["result1"]["count"].asInt() == frames);
+	for (const char* s : { "cpufreq", "rusage" })
+	{
+		assert(results[s]["streamed"].asBool());
+		for (const std::string& k : results[s].getMemberNames())
+		{
+			if (k == "streamed") continue;
+			assert(results[s][k]["count"].asInt() == frames);
+		}
+	}
+	// The file has the frame times which weren't dropped
+	FILE* fp = fopen("stream_test.bin", "rb");
+	assert(fp);
+	char magic[8];
+	uint32_t header[2];
+	result = fread(magic, sizeof(magic), 1, fp) == 1 && fread(header, sizeof(header), 1, fp) == 1;
+	assert(result && memcmp(magic, "LCSTREAM", 8) == 0 && header[0] == 1);
+	uint32_t timingId = UINT32_MAX;
+	uint64_t timingSamples = 0;
+	uint32_t tag[2];
+	while (fread(tag, sizeof(tag), 1, fp) == 1)
+	{
+		if (tag[0] == 1) // column: type, name length, name
+		{
+			uint32_t desc[2];
+			result = fread(desc, sizeof(desc), 1, fp) == 1;
+			assert(result);
+			std::string name(desc[1], '\0');
+			result = fread(&name[0], desc[1], 1, fp) == 1;
+			assert(result);
+			if (name == "timing:time") timingId = tag[1];
+		}
+		else // data: first index, count, reserved, samples
+		{
+			assert(tag[0] == 2);
+			uint64_t first;
+			uint32_t desc[2];
+			result = fread(&first, sizeof(first), 1, fp) == 1 && fread(desc, sizeof(desc), 1, fp) == 1;
+			assert(result && first + desc[0] <= (uint64_t)frames);
+			if (tag[1] == timingId) timingSamples += desc[0];
+			fseek(fp, desc[0] * sizeof(CollectorValue), SEEK_CUR);
+		}
+	}
+	fclose(fp);
+	assert(timingId != UINT32_MAX);
+	assert(timingSamples + results["timing"]["time"].get("dropped", 0).asUInt64() == (uint64_t)frames);
+}
+
 int main()
 {
 	srandom(time(NULL));
@@ -272,6 +354,7 @@ int main()
 	test5();
 	test6();
 	test7(); // summarized results
+	test8(); // streamed results
 	printf("ALL DONE!\n");
 	return 0;
 }
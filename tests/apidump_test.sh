@@ -7,6 +7,8 @@
 # script requires a path to the Vulkan-Tools build directory so that it can locate
 # vulkaninfo and the mock ICD. The path can be defined using the environment variable
 # VULKAN_TOOLS_BUILD_DIR or using the command-line argument -t or --tools.
+# It then compares the text output with the binary output decoded by api_dump_decode, found in ../layersvt or with the
+# environment variable API_DUMP_DECODE.
 
 # Track unrecognized arguments.
 UNRECOGNIZED=()
@@ -83,6 +85,34 @@ then
 fi
 
 rm apidump_file.tmp
+
+# The binary output decoded by api_dump_decode must be the same as the text output. The addresses are left out, they
+# differ from run to run.
+printf "$GREEN[ RUN      ]$NC $0 binary\n"
+API_DUMP_DECODE="${API_DUMP_DECODE:-$PWD/../layersvt/api_dump_decode}"
+VK_ICD_FILENAMES="$VULKAN_TOOLS_BUILD_DIR/icd/VkICD_mock_icd.json" \
+    VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_api_dump \
+    VK_APIDUMP_NO_ADDR=TRUE \
+    VK_APIDUMP_LOG_FILENAME=apidump_text.tmp \
+    "$VULKANINFO" > /dev/null
+VK_ICD_FILENAMES="$VULKAN_TOOLS_BUILD_DIR/icd/VkICD_mock_icd.json" \
+    VK_INSTANCE_LAYERS=VK_LAYER_LUNARG_api_dump \
+    VK_APIDUMP_OUTPUT_FORMAT=binary \
+    VK_APIDUMP_LOG_FILENAME=apidump_binary.tmp \
+    "$VULKANINFO" > /dev/null
+VK_APIDUMP_NO_ADDR=TRUE "$API_DUMP_DECODE" -o apidump_decoded.tmp apidump_binary.tmp
+if [ -s apidump_text.tmp ] && cmp -s apidump_text.tmp apidump_decoded.tmp
+then
+    printf "$GREEN[  PASSED  ]$NC $0 binary\n"
+else
+    diff apidump_text.tmp apidump_decoded.tmp | head -n 20   # Debug
+    printf "$RED[  FAILED  ]$NC $0 binary\n"
+    rm -f apidump_text.tmp apidump_binary.tmp apidump_decoded.tmp
+    popd
+    exit 1
+fi
+
+rm -f apidump_text.tmp apidump_binary.tmp apidump_decoded.tmp
 popd
 
 exit 0
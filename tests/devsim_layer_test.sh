@@ -108,6 +108,36 @@ jq -S $JSON_SECTIONS $FILENAME_02_TEMP1 > $FILENAME_02_TEMP2
 #jq --slurp  --exit-status '.[0] == .[1]' devsim_test2_gold.json $FILENAME_02_TEMP2 > /dev/null
 #[ $? -eq 0 ] || fail_msg "test2 jq comparison"
 
+#############################################################################
+# Test 3: Verify a compiled profile gives the same results as its JSON.
+# The first run parses the JSON files and compiles them into an empty cache directory, the second one loads the profiles.
+
+FILENAME_03_CACHE="devsim_test3_cache"
+FILENAME_03_TEMP1="devsim_test3_temp1.json"
+FILENAME_03_TEMP2="devsim_test3_temp2.json"
+FILENAME_03_DEBUG1="devsim_test3_debug1.txt"
+FILENAME_03_DEBUG2="devsim_test3_debug2.txt"
+rm -rf $FILENAME_03_CACHE
+rm -f $FILENAME_03_TEMP1 $FILENAME_03_TEMP2 $FILENAME_03_DEBUG1 $FILENAME_03_DEBUG2
+
+# The warnings of the JSON loader, which a compiled profile gives too
+export VK_DEVSIM_CACHE_DIR="$PWD/$FILENAME_03_CACHE"
+VK_DEVSIM_DEBUG_ENABLE="1" "$VULKANINFO" 2> /dev/null | grep "WARN" > $FILENAME_03_DEBUG1
+ls $FILENAME_03_CACHE/*.devsim > /dev/null 2>&1
+[ $? -eq 0 ] || fail_msg "test3 no compiled profile"
+VK_DEVSIM_DEBUG_ENABLE="1" "$VULKANINFO" 2> /dev/null | grep "WARN" > $FILENAME_03_DEBUG2
+diff $FILENAME_03_DEBUG1 $FILENAME_03_DEBUG2 > /dev/null
+[ $? -eq 0 ] || fail_msg "test3 warnings comparison"
+
+"$VULKANINFO" -j 2> /dev/null | jq -S $JSON_SECTIONS > $FILENAME_03_TEMP2
+[ $? -eq 0 ] || fail_msg "test3 vulkaninfo with the compiled profiles"
+VK_DEVSIM_CACHE_DIR="none" "$VULKANINFO" -j 2> /dev/null | jq -S $JSON_SECTIONS > $FILENAME_03_TEMP1
+[ $? -eq 0 ] || fail_msg "test3 vulkaninfo with the JSON files"
+unset VK_DEVSIM_CACHE_DIR
+
+jq --slurp --exit-status '.[0] == .[1]' $FILENAME_03_TEMP1 $FILENAME_03_TEMP2 > /dev/null
+[ $? -eq 0 ] || fail_msg "test3 jq comparison"
+
 #############################################################################
 
 printf "$GREEN[  PASSED  ]$NC $0\n"
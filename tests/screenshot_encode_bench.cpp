@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2020 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Microbenchmark of the screenshot layer encoders and frame hashing over synthetic images.
+//
+// Usage: screenshot_encode_bench [width height [iterations]]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "screenshot_encode.h"
+
+using namespace screenshot;
+
+struct BenchLayout {
+    PixelLayout layout;
+    const char *name;
+};
+
+static const BenchLayout layouts[] = {
+    {PIXEL_LAYOUT_RGBA8, "RGBA8"},
+    {PIXEL_LAYOUT_BGRA8, "BGRA8"},
+    {PIXEL_LAYOUT_RGB10A2, "RGB10A2"},
+    {PIXEL_LAYOUT_RGBA16F, "RGBA16F"},
+};
+
+// Gradients with flat areas, closer to a rendered frame than noise
+static void fillImage(PixelLayout layout, std::vector<uint8_t> &pixels, uint32_t width, uint32_t height) {
+    uint32_t const size = pixelLayoutSize(layout);
+    pixels.resize((size_t)width * height * size);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            uint8_t *p = &pixels[((size_t)y * width + x) * size];
+            uint32_t r = (x * 255) / width, g = (y * 255) / height, b = ((x / 64 + y / 64) % 2) * 255;
+            if (layout == PIXEL_LAYOUT_RGB10A2) {
+                uint32_t v = (r << 2) | (g << 12) | (b << 22) | (3u << 30);
+                memcpy(p, &v, 4);
+            } else if (layout == PIXEL_LAYOUT_RGBA16F) {
+                // 1.0 is 0x3c00, channels go from 0 to 1 in 256 steps
+                uint16_t v[4] = {(uint16_t)(r * 0x3c00 / 255), (uint16_t)(g * 0x3c00 / 255), (uint16_t)(b * 0x3c00 / 255), 0x3c00};
+                memcpy(p, v, 8);
+            } else {
+                p[0] = (uint8_t)r;
+                p[1] = (uint8_t)g;
+                p[2] = (uint8_t)b;
+                p[3] = 255;
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t width = 3840, height = 2160, iterations = 10;
+    if (argc >= 3) {
+        width = (uint32_t)atoi(argv[1]);
+        height = (uint32_t)atoi(argv[2]);
+    }
+    if (argc >= 4) {
+        iterations = (uint32_t)atoi(argv[3]);
+    }
+    if (width == 0 || height == 0 || iterations == 0) {
+        fprintf(stderr, "Usage: %s [width height [iterations]]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%ux%u, %u iterations\n", width, height, iterations);
+    printf("%-8s %-4s %10s %10s %12s\n", "layout", "enc", "ms/frame", "MPix/s", "bytes");
+    std::vector<uint8_t> pixels, encoded;
+    for (const BenchLayout &bench : layouts) {
+        fillImage(bench.layout, pixels, width, height);
+        uint64_t const rowPitch = (uint64_t)width * pixelLayoutSize(bench.layout);
+        for (int e = 0; e < 2; e++) {
+            ScreenshotEncoding encoding = e == 0 ? SCREENSHOT_ENCODING_PPM : SCREENSHOT_ENCODING_QOI;
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < iterations; i++) {
+                encodeImage(encoding, bench.layout, pixels.data(), width, height, rowPitch, "# bench\n", encoded);
+            }
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+            printf("%-8s %-4s %10.2f %10.1f %12zu\n", bench.name, e == 0 ? "PPM" : "QOI", ms,
+                   (double)width * height / (ms * 1000.0), encoded.size());
+        }
+
+        // Hash of the frame and of its 64x64 tiles, as logged by VK_SCREENSHOT_ENCODING=HASH
+        ImageHash frameHash;
+        std::vector<ImageHash> tileHashes;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < iterations; i++) {
+            hashImage(bench.layout, pixels.data(), width, height, rowPitch, 64, frameHash, tileHashes);
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+        printf("%-8s %-4s %10.2f %10.1f %12zu\n", bench.name, "HASH", ms, (double)width * height / (ms * 1000.0),
+               (tileHashes.size() + 1) * sizeof(ImageHash));
+    }
+    return 0;
+}
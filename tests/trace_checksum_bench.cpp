@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2020 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Microbenchmark of the trace block checksums: writes a synthetic trace with a block table, then compares the linear read
+// of its packets with vktrace_read_trace_packet() to the check of its blocks on one and several threads. The trace is
+// read back from the page cache, so this measures the CPU cost rather than the disk.
+//
+// Usage: trace_checksum_bench [size_MB [block_KB [threads]]]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "vktrace_common.h"
+#include "vktrace_filelike.h"
+#include "vktrace_trace_packet_utils.h"
+#include "blockchecksum.h"
+
+static const char *traceName = "trace_checksum_bench.vktrace";
+
+// Packets from 64 bytes to 64 KB, most of them small like in a real trace
+static bool writeTrace(uint64_t size, uint64_t blockSize, vktrace_trace_file_header &fileHeader) {
+    FILE *fp = fopen(traceName, "wb");
+    if (fp == NULL) {
+        return false;
+    }
+    memset(&fileHeader, 0, sizeof(fileHeader));
+    fileHeader.trace_file_version = VKTRACE_TRACE_FILE_VERSION;
+    fileHeader.magic = VKTRACE_FILE_MAGIC;
+    fileHeader.first_packet_offset = sizeof(fileHeader);
+    fileHeader.ptrsize = sizeof(void *);
+    bool ok = fwrite(&fileHeader, sizeof(fileHeader), 1, fp) == 1;
+
+    blockchecksum checksums(blockSize, fileHeader.first_packet_offset);
+    std::vector<uint8_t> packet;
+    uint64_t offset = fileHeader.first_packet_offset;
+    uint32_t seed = 1;
+    for (uint64_t index = 0; ok && offset - fileHeader.first_packet_offset < size; index++) {
+        seed = seed * 1664525 + 1013904223;
+        uint64_t bodySize = (seed >> 8) % 16 == 0 ? (seed >> 12) % 65536 : (seed >> 12) % 512;
+        packet.resize(ROUNDUP_TO_8(sizeof(vktrace_trace_packet_header) + 64 + bodySize));
+        for (size_t i = sizeof(vktrace_trace_packet_header); i < packet.size(); i++) {
+            packet[i] = (uint8_t)(seed >> (i % 24));
+        }
+        vktrace_trace_packet_header *header = (vktrace_trace_packet_header *)packet.data();
+        memset(header, 0, sizeof(*header));
+        header->size = packet.size();
+        header->global_packet_index = index;
+        header->tracer_id = VKTRACE_TID_VULKAN;
+        header->packet_id = VKTRACE_TPI_VK_vkCmdDraw;
+        ok = fwrite(packet.data(), 1, packet.size(), fp) == packet.size();
+        checksums.add_packet(header, packet.size());
+        offset += packet.size();
+    }
+
+    std::vector<uint8_t> table = checksums.finish();
+    vktrace_trace_packet_header header = {};
+    header.size = sizeof(header) + table.size();
+    header.tracer_id = VKTRACE_TID_VULKAN;
+    header.packet_id = VKTRACE_TPI_BLOCK_TABLE;
+    fileHeader.block_table_offset = offset;
+    ok = ok && fwrite(&header, sizeof(header), 1, fp) == 1 && fwrite(table.data(), 1, table.size(), fp) == table.size() &&
+         fseek(fp, 0, SEEK_SET) == 0 && fwrite(&fileHeader, sizeof(fileHeader), 1, fp) == 1;
+    return fclose(fp) == 0 && ok;
+}
+
+static double elapsed(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    uint64_t sizeMB = 256, blockKB = 1024;
+    uint32_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+    if (argc >= 2) {
+        sizeMB = (uint64_t)atoi(argv[1]);
+    }
+    if (argc >= 3) {
+        blockKB = (uint64_t)atoi(argv[2]);
+    }
+    if (argc >= 4) {
+        threads = (uint32_t)atoi(argv[3]);
+    }
+    if (sizeMB == 0 || blockKB == 0 || threads == 0) {
+        fprintf(stderr, "Usage: %s [size_MB [block_KB [threads]]]\n", argv[0]);
+        return 1;
+    }
+
+    vktrace_trace_file_header fileHeader;
+    if (!writeTrace(sizeMB * 1024 * 1024, blockKB * 1024, fileHeader)) {
+        fprintf(stderr, "Failed to write %s\n", traceName);
+        return 1;
+    }
+
+    std::vector<uint8_t> data(64 * 1024 * 1024, 0x5a);
+    auto start = std::chrono::steady_clock::now();
+    uint32_t crc = vktrace_crc32c(0, data.data(), data.size());
+    double seconds = elapsed(start);
+    printf("vktrace_crc32c in memory:   %8.1f MB/s (%08x)\n", data.size() / seconds / (1024 * 1024), crc);
+
+    // The existing path: every packet read whole, nothing checked
+    FILE *fp = fopen(traceName, "rb");
+    FileLike *file = vktrace_FileLike_create_file(fp);
+    vktrace_FileLike_SetCurrentPosition(file, fileHeader.first_packet_offset);
+    start = std::chrono::steady_clock::now();
+    uint64_t packets = 0, bytes = 0;
+    vktrace_trace_packet_header *packet;
+    while ((packet = vktrace_read_trace_packet(file)) != NULL && packet->packet_id != VKTRACE_TPI_BLOCK_TABLE) {
+        packets++;
+        bytes += packet->size;
+        vktrace_delete_trace_packet_no_lock(&packet);
+    }
+    seconds = elapsed(start);
+    vktrace_delete_trace_packet_no_lock(&packet);
+    printf("linear packet read:         %8.1f MB/s (%llu packets)\n", bytes / seconds / (1024 * 1024), (unsigned long long)packets);
+
+    blocktable blocks;
+    int ret = 0;
+    if (!blocks.read(file, fileHeader.block_table_offset)) {
+        fprintf(stderr, "Failed to read the block table\n");
+        ret = 1;
+    }
+    for (uint32_t count = 1; ret == 0; count = threads) {
+        start = std::chrono::steady_clock::now();
+        int64_t corrupted = blocks.verify(traceName, count);
+        seconds = elapsed(start);
+        printf("block check on %2u threads:  %8.1f MB/s (%llu blocks, %lld corrupted)\n", count, bytes / seconds / (1024 * 1024),
+               (unsigned long long)blocks.block_count(), (long long)corrupted);
+        if (count == threads) {
+            break;
+        }
+    }
+    fclose(fp);
+    vktrace_free(file);
+
+    // A flipped byte must be found in its block
+    fp = fopen(traceName, "r+b");
+    uint64_t flipped = fileHeader.first_packet_offset + bytes / 2;
+    uint8_t byte = 0;
+    if (ret == 0 && fp != NULL && fseek(fp, (long)flipped, SEEK_SET) == 0 && fread(&byte, 1, 1, fp) == 1) {
+        byte ^= 0x10;
+        fseek(fp, (long)flipped, SEEK_SET);
+        fwrite(&byte, 1, 1, fp);
+        fclose(fp);
+        int64_t corrupted = blocks.verify(traceName, threads);
+        uint64_t block = (flipped - fileHeader.first_packet_offset) / blocks.block_size();
+        printf("after flipping a byte:      %lld corrupted, block %llu %s\n", (long long)corrupted, (unsigned long long)block,
+               blocks.is_bad(block) ? "found" : "missed");
+        ret = corrupted == 1 && blocks.is_bad(block) ? 0 : 1;
+    } else if (fp != NULL) {
+        fclose(fp);
+    }
+    remove(traceName);
+    return ret;
+}
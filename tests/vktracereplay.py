@@ -6,6 +6,8 @@
 #
 # vkcube is traced and replayed with screenshot comparison, then again with trim.
 # Also runs regression by iterating through old traces in a directory specified by the user, tracing a replay of the old trace, and replaying the new trace.
+# The frames of a vkcube trace are listed from its frame boundaries, and the trace is dumped on several threads.
+# With --traces32, the 32-bit traces of another directory are converted with vktraceconvert, then dumped and replayed.
 #
 # To run this test:
 #    cd <this-dir>
@@ -13,7 +15,7 @@
 #
 #    <old-trace-directory> example: "C:\traces\" would result in the script testing against "C:\traces\trace1.vktrace", "C:\traces\trace2.vktrace", etc.
 
-import os, sys, subprocess, time, argparse, filecmp, time, shutil
+import os, re, sys, json, subprocess, time, argparse, filecmp, time, shutil
 
 
 
@@ -199,6 +201,244 @@ def LoopTest(testname, program, programArgs, args):
 
 
 
+def NamedHandles(dumpFile, firstFrame):
+    """ The lines of a text dump which show a handle with its debug name, from frame firstFrame on """
+    frameRe = re.compile(r'^Thread \d+, Frame (\d+)')
+    nameRe = re.compile(r'0x[0-9a-fA-F]+ \[.*\]')
+    frame = 0
+    lines = []
+    with open(dumpFile) as f:
+        for line in f:
+            match = frameRe.match(line)
+            if match:
+                frame = int(match.group(1))
+            elif frame >= firstFrame and nameRe.search(line):
+                lines.append(line)
+    return sorted(lines)
+
+
+
+
+def DumpTest(testname, program, programArgs, args):
+    """ Checks that vktracedump gives the same text, HTML and JSON dumps on several threads, and that the debug names of
+        the objects are kept when the frames which named them are skipped over """
+
+    print ('Beginning Dump Test: %s\n' % program)
+
+    startTime = time.time()
+
+    vktraceDumpPath = os.path.join(os.path.dirname(args.VkTracePath), 'vktracedump')
+
+    # Trace. vkcube names its objects with --validate
+    layerEnv = os.environ.copy()
+    layerEnv['VK_LAYER_PATH'] = args.VkLayerPath
+    try:
+        out = subprocess.check_output([args.VkTracePath, '-o', '%s.vktrace' % testname, '-p', program, '-a', '%s' % programArgs, '-w', '.'], env=layerEnv).decode('utf-8')
+    except subprocess.CalledProcessError as e:
+        HandleError('Error while tracing, return code %s:\n%s' % (e.returncode, e.output))
+
+    if 'error' in out:
+        err = GetErrorMessage(out)
+        HandleError('Errors while tracing:\n%s' % err)
+
+    # Dump the whole trace on one thread, then on four threads, then from frame 2 on four threads
+    dumps = [('%s.dump.txt' % testname, []),
+             ('%s.dump-j4.txt' % testname, ['-j', '4']),
+             ('%s.dump-frames.txt' % testname, ['-j', '4', '--frames', '2-%d' % 0xffffffff])]
+    # The HTML and JSON dumps on one and four threads, the JSON ones must also be valid
+    for ext, formatArg in [('html', '-dh'), ('json', '-dj')]:
+        dumps += [('%s.dump.%s' % (testname, ext), [formatArg]),
+                  ('%s.dump-j4.%s' % (testname, ext), [formatArg, '-j', '4']),
+                  ('%s.dump-frames.%s' % (testname, ext), [formatArg, '-j', '4', '--frames', '2-%d' % 0xffffffff])]
+    for dumpFile, dumpArgs in dumps:
+        try:
+            subprocess.check_output([vktraceDumpPath, '-o', '%s.vktrace' % testname, '-f', dumpFile] + dumpArgs).decode('utf-8')
+        except subprocess.CalledProcessError as e:
+            HandleError('Error while dumping, return code %s:\n%s' % (e.returncode, e.output))
+
+    for i in range(0, len(dumps), 3):
+        if not filecmp.cmp(dumps[i][0], dumps[i + 1][0], shallow=False):
+            HandleError('Error: The dumps %s on one and four threads differ.' % dumps[i][0])
+    for dumpFile, dumpArgs in dumps:
+        if dumpFile.endswith('.json'):
+            try:
+                with open(dumpFile) as jsonFile:
+                    json.load(jsonFile)
+            except ValueError as e:
+                HandleError('Error: %s is not valid JSON: %s' % (dumpFile, e))
+
+    namedHandles = NamedHandles(dumps[0][0], 2)
+    if not namedHandles:
+        HandleError('Error: No named objects in the dump of %s.' % testname)
+    if NamedHandles(dumps[2][0], 2) != namedHandles:
+        HandleError('Error: The object names are lost when the first frames are skipped over.')
+
+    elapsed = time.time() - startTime
+
+    print ('Success')
+    print ('Elapsed seconds: %s\n' % elapsed)
+
+
+
+
+def FrameInfo(vktraceDumpPath, traceFile):
+    """ The rows of the frame list of vktracedump -fi, and the offset of the last frame boundary if they were followed back
+        from it, None if the trace was scanned """
+    try:
+        out = subprocess.check_output([vktraceDumpPath, '-o', traceFile, '-hd', '-fi']).decode('utf-8')
+    except subprocess.CalledProcessError as e:
+        HandleError('Error while listing the frames, return code %s:\n%s' % (e.returncode, e.output))
+
+    rowRe = re.compile(r'^\s*(\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+([\d.]+)\s+(\d+)\s*$')
+    rows = [match.groups() for match in map(rowRe.match, out.split('\n')) if match]
+    match = re.search(r'followed back from offset (\d+)', out)
+    return rows, int(match.group(1)) if match else None
+
+
+
+
+def FrameInfoTest(testname, program, programArgs, args):
+    """ Checks that the frame boundaries which vktrace fills in list one frame per present, and that following them back
+        from the file header gives the same frames as scanning the trace for them """
+
+    print ('Beginning Frame Info Test: %s\n' % program)
+
+    startTime = time.time()
+
+    vktraceDumpPath = os.path.join(os.path.dirname(args.VkTracePath), 'vktracedump')
+
+    layerEnv = os.environ.copy()
+    layerEnv['VK_LAYER_PATH'] = args.VkLayerPath
+    try:
+        out = subprocess.check_output([args.VkTracePath, '-o', '%s.vktrace' % testname, '-p', program, '-a', '%s' % programArgs, '-w', '.'], env=layerEnv).decode('utf-8')
+    except subprocess.CalledProcessError as e:
+        HandleError('Error while tracing, return code %s:\n%s' % (e.returncode, e.output))
+
+    if 'error' in out:
+        err = GetErrorMessage(out)
+        HandleError('Errors while tracing:\n%s' % err)
+
+    # The presents, from the API call column of the simple dump
+    try:
+        subprocess.check_output([vktraceDumpPath, '-o', '%s.vktrace' % testname, '-s', '%s.simple.txt' % testname]).decode('utf-8')
+    except subprocess.CalledProcessError as e:
+        HandleError('Error while dumping, return code %s:\n%s' % (e.returncode, e.output))
+    with open('%s.simple.txt' % testname) as f:
+        presents = sum(1 for line in f if line.split(' : ')[-1].strip().startswith('vkQueuePresentKHR'))
+
+    rows, lastFrameOffset = FrameInfo(vktraceDumpPath, '%s.vktrace' % testname)
+    if lastFrameOffset is None:
+        HandleError('Error: The frame boundaries of %s are not chained from the file header.' % testname)
+    if len(rows) != presents:
+        HandleError('Error: %d frames are listed for %d presents.' % (len(rows), presents))
+    frameNumbers = [int(row[0]) for row in rows]
+    if frameNumbers != list(range(frameNumbers[0], frameNumbers[0] + len(rows))):
+        HandleError('Error: The frame numbers of the boundaries are not consecutive.')
+    if any(int(row[2]) == 0 for row in rows):
+        HandleError('Error: Frames without packets are listed, the counters of the boundaries were not filled in.')
+
+    # The same trace without the offset of the last boundary in its file header is scanned
+    with open('%s.vktrace' % testname, 'rb') as f:
+        trace = f.read()
+    firstFrameOffset = min(int(row[6]) for row in rows)
+    field = lastFrameOffset.to_bytes(8, 'little')
+    if trace.count(field, 0, firstFrameOffset) != 1:
+        HandleError('Error: The offset of the last frame boundary is not found once in the file header.')
+    fieldOffset = trace.find(field, 0, firstFrameOffset)
+    with open('%s.scan.vktrace' % testname, 'wb') as f:
+        f.write(trace[:fieldOffset] + bytes(8) + trace[fieldOffset + 8:])
+
+    scannedRows, scannedOffset = FrameInfo(vktraceDumpPath, '%s.scan.vktrace' % testname)
+    if scannedOffset is not None:
+        HandleError('Error: The frame boundaries are followed back without the offset of the last one.')
+    if scannedRows != rows:
+        HandleError('Error: Scanning the trace and following the boundaries back give different frames.')
+
+    elapsed = time.time() - startTime
+
+    print ('Success')
+    print ('Elapsed seconds: %s\n' % elapsed)
+
+
+
+
+def ConvertTest(testname, traceFile, args):
+    """ Converts a 32-bit trace on one and four threads, checks that both give the same trace, then dumps and replays it.
+        Returns which conversions the trace went through besides the pointers into the packet, which all traces with
+        structs have """
+
+    print ('Beginning Convert Test: %s\n' % testname)
+
+    startTime = time.time()
+
+    vktraceConvertPath = os.path.join(os.path.dirname(args.VkTracePath), 'vktraceconvert')
+    vktraceDumpPath = os.path.join(os.path.dirname(args.VkTracePath), 'vktracedump')
+
+    converted = ['%s.vktrace' % testname, '%s.j4.vktrace' % testname]
+    for outFile, convertArgs in zip(converted, [[], ['-j', '4']]):
+        try:
+            out = subprocess.check_output([vktraceConvertPath, '-i', traceFile, '-o', outFile] + convertArgs).decode('utf-8')
+        except subprocess.CalledProcessError as e:
+            HandleError('Error while converting, return code %s:\n%s' % (e.returncode, e.output))
+        if 'error' in out:
+            err = GetErrorMessage(out)
+            HandleError('Errors while converting:\n%s' % err)
+
+    if not filecmp.cmp(converted[0], converted[1], shallow=False):
+        HandleError('Error: The traces converted on one and four threads differ.')
+
+    # The application pointers kept as they are, and the structs of unknown layout cut from pNext chains
+    paths = set()
+    if 'pointers out of their packet were kept' in out:
+        paths.add('kept pointers')
+    if 'pNext chains were cut' in out:
+        paths.add('cut pNext chains')
+
+    # The converted pointers, arrays and pNext chains are followed by the dump
+    try:
+        out = subprocess.check_output([vktraceDumpPath, '-o', converted[0], '-f', '%s.dump.txt' % testname, '-j', '4']).decode('utf-8')
+    except subprocess.CalledProcessError as e:
+        HandleError('Error while dumping the converted trace, return code %s:\n%s' % (e.returncode, e.output))
+
+    if 'error' in out:
+        err = GetErrorMessage(out)
+        HandleError('Errors while dumping the converted trace:\n%s' % err)
+
+    # Replay, with the screenshot compared to the one of the original trace if there is one
+    if not os.path.exists('%s.config' % traceFile):
+        frame = '1'
+    else:
+        with open('%s.config' % traceFile) as configFile:
+            frame = configFile.read().strip()
+
+    layerEnv = os.environ.copy()
+    layerEnv['VK_LAYER_PATH'] = args.VkLayerPath
+    try:
+        out = subprocess.check_output([args.VkReplayPath, '-o', converted[0], '-s', frame], env=layerEnv).decode('utf-8')
+    except subprocess.CalledProcessError as e:
+        HandleError('Error while replaying the converted trace, return code %s:\n%s' % (e.returncode, e.output))
+
+    if 'error' in out:
+        err = GetErrorMessage(out)
+        HandleError('Error while replaying the converted trace:\n%s' % err)
+
+    if os.path.exists('%s.ppm' % frame):
+        os.rename('%s.ppm' % frame, '%s.replay.ppm' % testname)
+    else:
+        HandleError ('Error: Screenshot not taken while replaying the converted trace.')
+
+    if os.path.exists('%s.ppm' % traceFile) and not filecmp.cmp('%s.ppm' % traceFile, '%s.replay.ppm' % testname):
+        HandleError ('Error: The screenshot of the converted trace does not match the one of the 32-bit trace.')
+
+    elapsed = time.time() - startTime
+
+    print ('Success, with %s' % (', '.join(sorted(paths)) if paths else 'no kept pointers or cut pNext chains'))
+    print ('Elapsed seconds: %s\n' % elapsed)
+    return paths
+
+
+
+
 def TraceReplayTraceTest(testname, traceFile, args):
     print ('Beginning Trace/Replay Test: %s\n' % testname)
 
@@ -293,6 +533,7 @@ if __name__ == '__main__':
     # Load settings from command-line
     parser = argparse.ArgumentParser(description='Test vktrace and vkreplay.')
     parser.add_argument('--legacy-vkcube', help='run the legacy vkcube tests', action='store_true')
+    parser.add_argument('--traces32', help='directory of 32-bit traces to convert, with a <trace>.ppm screenshot of the frame of <trace>.config to compare with', default='')
     parser.add_argument('OldTracesPath', help='directory of old traces to replay')
     parser.add_argument('VkTracePath', help='directory containing vktrace')
     parser.add_argument('VkLayerPath', help='directory containing vktrace layer')
@@ -323,6 +564,12 @@ if __name__ == '__main__':
         # Run loop test on cube
         LoopTest('cube-loop', cubePath, '--c 50', args)
 
+        # Run dump test on cube
+        DumpTest('cube-dump', cubePath, '--c 50 --validate', args)
+
+        # Run frame boundary test on cube
+        FrameInfoTest('cube-frames', cubePath, '--c 50', args)
+
     # Run Trace/Replay on old trace files if directory specified
     directory = args.OldTracesPath
     if os.path.isdir(directory):
@@ -330,5 +577,16 @@ if __name__ == '__main__':
             if filename.endswith(".vktrace"):
                 TraceReplayTraceTest(filename, os.path.join(directory, filename), args)
 
+    # Convert the 32-bit traces if directory specified. Together they are expected to have application pointers which
+    # the tracer didn't copy and structs of unknown layout in pNext chains, so that all the conversions are tested.
+    directory = args.traces32
+    if os.path.isdir(directory):
+        convertPaths = set()
+        for filename in os.listdir(directory):
+            if filename.endswith(".vktrace"):
+                convertPaths |= ConvertTest('convert-%s' % filename[:-len('.vktrace')], os.path.join(directory, filename), args)
+        if convertPaths != set(['kept pointers', 'cut pNext chains']):
+            HandleError('Error: The 32-bit traces only went through %s.' % (', '.join(sorted(convertPaths)) if convertPaths else 'the conversion of the pointers into their packets'))
+
 
     sys.exit(0)
@@ -0,0 +1,262 @@
+/*
+ * (C) COPYRIGHT 2020 ARM Limited
+ * ALL RIGHTS RESERVED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string.h>
+
+#include "blobstore.h"
+
+extern "C" {
+#include "vktrace_trace_packet_utils.h"
+}
+
+// xxHash64 (https://github.com/Cyan4973/xxHash), fast enough to hash every large payload at record time.
+static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+static inline uint64_t read64(const unsigned char* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t read32(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t input) {
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static inline uint64_t merge64(uint64_t acc, uint64_t val) {
+    acc ^= round64(0, val);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t blob_hash64(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* p = (const unsigned char*)data;
+    const unsigned char* const end = p + size;
+    uint64_t h;
+
+    if (size >= 32) {
+        const unsigned char* const limit = end - 32;
+        uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+        uint64_t v2 = seed + PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME64_1;
+        do {
+            v1 = round64(v1, read64(p));
+            v2 = round64(v2, read64(p + 8));
+            v3 = round64(v3, read64(p + 16));
+            v4 = round64(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = merge64(h, v1);
+        h = merge64(h, v2);
+        h = merge64(h, v3);
+        h = merge64(h, v4);
+    } else {
+        h = seed + PRIME64_5;
+    }
+
+    h += (uint64_t)size;
+    while (p + 8 <= end) {
+        h ^= round64(0, read64(p));
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t)read32(p) * PRIME64_1;
+        h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p) * PRIME64_5;
+        h = rotl64(h, 11) * PRIME64_1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+int dedup_packet(blobstore* g_blobstore, vktrace_trace_packet_header*& pPacketHeader, uint64_t blob_offset, uint64_t blob_size,
+                 uint64_t packet_file_offset, packetpool& pool) {
+    if (pPacketHeader->tracer_id != VKTRACE_TID_VULKAN) {
+        return 0;
+    }
+    if (blob_size < g_blobstore->m_threshold || blob_offset < sizeof(vktrace_trace_packet_header) ||
+        blob_offset + blob_size > pPacketHeader->size) {
+        return 0;
+    }
+
+    const char* blob = (const char*)pPacketHeader + blob_offset;
+    uint64_t hash = blob_hash64(blob, (size_t)blob_size, 0);
+    uint64_t check = blob_hash64(blob, (size_t)blob_size, PRIME64_5);
+    auto it = g_blobstore->m_blobs.find(hash);
+    if (it == g_blobstore->m_blobs.end()) {
+        g_blobstore->m_blobs[hash] = {blob_size, check, packet_file_offset, blob_offset};
+        return 0;
+    }
+    if (it->second.size != blob_size || it->second.check != check) {
+        // Hash collision, keep the payload in place
+        return 0;
+    }
+
+    uint64_t suffix_size = pPacketHeader->size - blob_offset - blob_size;
+    uint64_t ref_packet_size = sizeof(vktrace_trace_packet_header) + sizeof(vktrace_trace_packet_header_blob_ext) +
+                               (blob_offset - sizeof(vktrace_trace_packet_header)) + suffix_size;
+    vktrace_trace_packet_header* pRefPacketHeader = (vktrace_trace_packet_header*)pool.alloc(ref_packet_size);
+    if (pRefPacketHeader == nullptr) {
+        vktrace_LogError("Blob reference packet malloc failed.");
+        return -1;
+    }
+
+    memcpy(pRefPacketHeader, pPacketHeader, sizeof(vktrace_trace_packet_header));
+    pRefPacketHeader->size = ref_packet_size;
+    pRefPacketHeader->tracer_id = VKTRACE_TID_VULKAN_BLOB_REF;
+    pRefPacketHeader->pBody = (uintptr_t)(pRefPacketHeader + 1);
+
+    vktrace_trace_packet_header_blob_ext* pExt = (vktrace_trace_packet_header_blob_ext*)pRefPacketHeader->pBody;
+    pExt->original_size = pPacketHeader->size;
+    pExt->blob_offset = blob_offset;
+    pExt->blob_size = blob_size;
+    pExt->source_packet_offset = it->second.source_packet_offset;
+    pExt->source_blob_offset = it->second.source_blob_offset;
+
+    char* dst = (char*)(pExt + 1);
+    memcpy(dst, (char*)pPacketHeader + sizeof(vktrace_trace_packet_header), (size_t)(blob_offset - sizeof(vktrace_trace_packet_header)));
+    dst += blob_offset - sizeof(vktrace_trace_packet_header);
+    memcpy(dst, blob + blob_size, (size_t)suffix_size);
+
+    g_blobstore->dedup_packet_counter++;
+    g_blobstore->dedup_saved_bytes += pPacketHeader->size - ref_packet_size;
+    pPacketHeader = pRefPacketHeader;
+    return 0;
+}
+
+bool blobcache::copy_blob(uint64_t source_packet_offset, uint64_t source_blob_offset, uint64_t blob_size, char* output) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_index.find(source_packet_offset);
+    if (it != m_index.end() && it->second->second.size() == blob_size) {
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        memcpy(output, it->second->second.data(), (size_t)blob_size);
+        return true;
+    }
+
+    // Not cached, read the packet holding the first occurrence and restore the current file position afterwards
+    uint64_t current_position = vktrace_FileLike_GetCurrentPosition(m_pFile);
+    if (!vktrace_FileLike_SetCurrentPosition(m_pFile, source_packet_offset)) {
+        vktrace_LogError("Failed to seek to the blob source packet at offset %llu.", source_packet_offset);
+        return false;
+    }
+    vktrace_trace_packet_header* pSourceHeader = vktrace_read_trace_packet(m_pFile);
+    vktrace_FileLike_SetCurrentPosition(m_pFile, current_position);
+    if (pSourceHeader == nullptr) {
+        vktrace_LogError("Failed to read the blob source packet at offset %llu.", source_packet_offset);
+        return false;
+    }
+    if (pSourceHeader->tracer_id == VKTRACE_TID_VULKAN_COMPRESSED &&
+        (m_decompressor == nullptr || decompress_packet(m_decompressor, pSourceHeader) != 0)) {
+        vktrace_delete_trace_packet_no_lock(&pSourceHeader);
+        return false;
+    }
+    if (pSourceHeader->tracer_id != VKTRACE_TID_VULKAN || source_blob_offset + blob_size > pSourceHeader->size) {
+        vktrace_LogError("Invalid blob source packet at offset %llu.", source_packet_offset);
+        vktrace_delete_trace_packet_no_lock(&pSourceHeader);
+        return false;
+    }
+
+    if (it != m_index.end()) {
+        m_size -= it->second->second.size();
+        m_lru.erase(it->second);
+        m_index.erase(it);
+    }
+    const char* blob = (const char*)pSourceHeader + source_blob_offset;
+    m_lru.emplace_front(source_packet_offset, std::vector<char>(blob, blob + blob_size));
+    m_index[source_packet_offset] = m_lru.begin();
+    m_size += blob_size;
+    memcpy(output, blob, (size_t)blob_size);
+    vktrace_delete_trace_packet_no_lock(&pSourceHeader);
+
+    // Evict the least recently used payloads, but always keep the one just added
+    while (m_size > m_maxSize && m_lru.size() > 1) {
+        m_size -= m_lru.back().second.size();
+        m_index.erase(m_lru.back().first);
+        m_lru.pop_back();
+    }
+    return true;
+}
+
+int resolve_packet(blobcache* g_blobcache, vktrace_trace_packet_header*& pPacketHeader) {
+    if (pPacketHeader->tracer_id != VKTRACE_TID_VULKAN_BLOB_REF) {
+        vktrace_LogWarning("Packet %d is not a blob reference, so it won't be resolved.", pPacketHeader->global_packet_index);
+        return 0;
+    }
+    if (g_blobcache == nullptr) {
+        vktrace_LogError("Packet %d is a blob reference but there is no blob cache.", pPacketHeader->global_packet_index);
+        return -1;
+    }
+    pPacketHeader->pBody = (uintptr_t)(pPacketHeader + 1);
+    const vktrace_trace_packet_header_blob_ext* pExt = (const vktrace_trace_packet_header_blob_ext*)pPacketHeader->pBody;
+    uint64_t prefix_size = pExt->blob_offset - sizeof(vktrace_trace_packet_header);
+    uint64_t suffix_size = pExt->original_size - pExt->blob_offset - pExt->blob_size;
+    if (pExt->blob_offset < sizeof(vktrace_trace_packet_header) || pExt->blob_offset + pExt->blob_size > pExt->original_size ||
+        pPacketHeader->size != sizeof(vktrace_trace_packet_header) + sizeof(vktrace_trace_packet_header_blob_ext) + prefix_size + suffix_size) {
+        vktrace_LogError("Blob reference packet %d is corrupted.", pPacketHeader->global_packet_index);
+        return -1;
+    }
+
+    vktrace_trace_packet_header* pResolvedHeader = (vktrace_trace_packet_header*)vktrace_malloc((size_t)pExt->original_size);
+    if (pResolvedHeader == nullptr) {
+        vktrace_LogError("Blob resolve packet malloc failed.");
+        return -1;
+    }
+    char* dst = (char*)pResolvedHeader;
+    const char* src = (const char*)(pExt + 1);
+    memcpy(dst, pPacketHeader, sizeof(vktrace_trace_packet_header));
+    memcpy(dst + sizeof(vktrace_trace_packet_header), src, (size_t)prefix_size);
+    if (!g_blobcache->copy_blob(pExt->source_packet_offset, pExt->source_blob_offset, pExt->blob_size, dst + pExt->blob_offset)) {
+        vktrace_free(pResolvedHeader);
+        vktrace_LogError("Failed to resolve the blob of packet %d.", pPacketHeader->global_packet_index);
+        return -1;
+    }
+    memcpy(dst + pExt->blob_offset + pExt->blob_size, src + prefix_size, (size_t)suffix_size);
+
+    pResolvedHeader->size = pExt->original_size;
+    pResolvedHeader->tracer_id = VKTRACE_TID_VULKAN;
+    pResolvedHeader->pBody = (uintptr_t)(pResolvedHeader + 1);
+
+    vktrace_free(pPacketHeader);
+    pPacketHeader = pResolvedHeader;
+    return 0;
+}
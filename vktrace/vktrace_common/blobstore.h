@@ -0,0 +1,90 @@
+/*
+ * (C) COPYRIGHT 2020 ARM Limited
+ * ALL RIGHTS RESERVED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "vktrace_trace_packet_identifiers.h"
+#include "vktrace_filelike.h"
+#include "decompressor.h"
+#include "packetpool.h"
+
+/* 64-bit hash of 'size' bytes at 'data', used to find repeated payloads.
+ */
+uint64_t blob_hash64(const void* data, size_t size, uint64_t seed);
+
+/* Record side: remembers where every payload of at least 'threshold' bytes was first written.
+ */
+class blobstore {
+public:
+    explicit blobstore(uint64_t threshold) : m_threshold(threshold) {}
+
+    struct blob_location {
+        uint64_t size;
+        uint64_t check;                 // second hash with a different seed, guards against collisions
+        uint64_t source_packet_offset;
+        uint64_t source_blob_offset;
+    };
+
+    uint64_t m_threshold;
+    std::unordered_map<uint64_t, blob_location> m_blobs;
+    uint64_t dedup_packet_counter = 0;
+    uint64_t dedup_saved_bytes = 0;
+};
+
+/* Replaces the payload [blob_offset, blob_offset + blob_size) of the packet by a reference if the same bytes were
+ * written before, in a packet allocated from 'pool'. The original packet isn't freed. Otherwise the payload is
+ * recorded as living in the packet written at 'packet_file_offset'.
+ * Returns 0 on success (whether or not the packet was changed) and -1 on error.
+ */
+int dedup_packet(blobstore* g_blobstore, vktrace_trace_packet_header*& pPacketHeader, uint64_t blob_offset, uint64_t blob_size,
+                 uint64_t packet_file_offset, packetpool& pool);
+
+/* Replay side: keeps recently referenced payloads in memory, up to 'max_size' bytes. A payload which is not cached is
+ * read back from the packet holding its first occurrence. 'pFile' is seeked and read with the cache's lock held, so no
+ * other thread may read it: the replayer gives the cache its own handle on the trace.
+ */
+class blobcache {
+public:
+    blobcache(FileLike* pFile, decompressor* decomp, uint64_t max_size = 256 * 1024 * 1024)
+        : m_pFile(pFile), m_decompressor(decomp), m_maxSize(max_size) {}
+
+    /* Copies the payload into 'output', which must hold 'blob_size' bytes. Returns false if it can't be read back.
+     */
+    bool copy_blob(uint64_t source_packet_offset, uint64_t source_blob_offset, uint64_t blob_size, char* output);
+
+private:
+    typedef std::list<std::pair<uint64_t, std::vector<char>>> blob_list;
+
+    FileLike* m_pFile;
+    decompressor* m_decompressor;
+    uint64_t m_maxSize;
+    uint64_t m_size = 0;
+    blob_list m_lru;
+    std::unordered_map<uint64_t, blob_list::iterator> m_index;
+    std::mutex m_mutex;
+};
+
+/* Restores the payload of a VKTRACE_TID_VULKAN_BLOB_REF packet, the result is a VKTRACE_TID_VULKAN packet.
+ * Returns 0 on success and -1 on error.
+ */
+int resolve_packet(blobcache* g_blobcache, vktrace_trace_packet_header*& pPacketHeader);
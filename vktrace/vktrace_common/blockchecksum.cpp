@@ -0,0 +1,341 @@
+/*
+ * (C) COPYRIGHT 2020 ARM Limited
+ * ALL RIGHTS RESERVED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "blockchecksum.h"
+
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CRC32C_X86 1
+#include <nmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(__aarch64__) && defined(__linux__)
+#define CRC32C_ARM64 1
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
+
+// Software CRC32C, slicing by 8 bytes
+static const uint32_t* crc32c_tables() {
+    static uint32_t tables[8][256];
+    static bool initialized = [] {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+            }
+            tables[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; i++) {
+            for (int t = 1; t < 8; t++) {
+                tables[t][i] = (tables[t - 1][i] >> 8) ^ tables[0][tables[t - 1][i] & 0xFF];
+            }
+        }
+        return true;
+    }();
+    (void)initialized;
+    return &tables[0][0];
+}
+
+static uint32_t crc32c_sw(uint32_t crc, const uint8_t* data, size_t size) {
+    const uint32_t* t = crc32c_tables();
+    while (size >= 8) {
+        uint32_t low, high;
+        memcpy(&low, data, 4);
+        memcpy(&high, data + 4, 4);
+        low ^= crc;
+        crc = t[7 * 256 + (low & 0xFF)] ^ t[6 * 256 + ((low >> 8) & 0xFF)] ^ t[5 * 256 + ((low >> 16) & 0xFF)] ^
+              t[4 * 256 + (low >> 24)] ^ t[3 * 256 + (high & 0xFF)] ^ t[2 * 256 + ((high >> 8) & 0xFF)] ^
+              t[1 * 256 + ((high >> 16) & 0xFF)] ^ t[high >> 24];
+        data += 8;
+        size -= 8;
+    }
+    while (size-- > 0) {
+        crc = (crc >> 8) ^ t[(crc ^ *data++) & 0xFF];
+    }
+    return crc;
+}
+
+#if defined(CRC32C_X86)
+#if !defined(_MSC_VER)
+__attribute__((target("sse4.2")))
+#endif
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t* data, size_t size) {
+#if defined(__x86_64__) || defined(_M_X64)
+    uint64_t crc64 = crc;
+    while (size >= 8) {
+        uint64_t value;
+        memcpy(&value, data, 8);
+        crc64 = _mm_crc32_u64(crc64, value);
+        data += 8;
+        size -= 8;
+    }
+    crc = (uint32_t)crc64;
+#else
+    while (size >= 4) {
+        uint32_t value;
+        memcpy(&value, data, 4);
+        crc = _mm_crc32_u32(crc, value);
+        data += 4;
+        size -= 4;
+    }
+#endif
+    while (size-- > 0) {
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+    return crc;
+}
+
+static bool crc32c_hw_supported() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 20)) != 0;
+#else
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSE4_2) != 0;
+#endif
+}
+#elif defined(CRC32C_ARM64)
+#if !defined(__ARM_FEATURE_CRC32)
+#if defined(__clang__)
+__attribute__((target("crc")))
+#else
+__attribute__((target("+crc")))
+#endif
+#endif
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t* data, size_t size) {
+    while (size >= 8) {
+        uint64_t value;
+        memcpy(&value, data, 8);
+        crc = __crc32cd(crc, value);
+        data += 8;
+        size -= 8;
+    }
+    while (size-- > 0) {
+        crc = __crc32cb(crc, *data++);
+    }
+    return crc;
+}
+
+static bool crc32c_hw_supported() { return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0; }
+#endif
+
+uint32_t vktrace_crc32c(uint32_t crc, const void* data, size_t size) {
+#if defined(CRC32C_X86) || defined(CRC32C_ARM64)
+    static const bool hw = crc32c_hw_supported();
+    if (hw) {
+        return ~crc32c_hw(~crc, (const uint8_t*)data, size);
+    }
+#endif
+    return ~crc32c_sw(~crc, (const uint8_t*)data, size);
+}
+
+std::string vktrace_block_sidecar_path(const char* trace_path) { return std::string(trace_path) + ".blocks"; }
+
+blockchecksum::blockchecksum(uint64_t block_size, uint64_t data_offset) {
+    memset(&m_table, 0, sizeof(m_table));
+    m_table.block_size = block_size;
+    m_table.data_offset = data_offset;
+    memset(&m_current, 0, sizeof(m_current));
+}
+
+blockchecksum::~blockchecksum() {
+    if (m_sidecar != NULL) {
+        fclose(m_sidecar);
+    }
+}
+
+bool blockchecksum::open_sidecar(const std::string& path) {
+    m_sidecar = fopen(path.c_str(), "wb");
+    if (m_sidecar == NULL) {
+        return false;
+    }
+    m_sidecar_path = path;
+    // block_count stays 0 in the sidecar, the readers count the entries which follow
+    if (fwrite(&m_table, sizeof(m_table), 1, m_sidecar) != 1 || fflush(m_sidecar) != 0) {
+        remove_sidecar();
+        return false;
+    }
+    return true;
+}
+
+void blockchecksum::remove_sidecar() {
+    if (m_sidecar != NULL) {
+        fclose(m_sidecar);
+        m_sidecar = NULL;
+        remove(m_sidecar_path.c_str());
+    }
+}
+
+void blockchecksum::add_packet(const vktrace_trace_packet_header* header, uint64_t size) {
+    if (m_current.packet_offset == 0 && size > 0) {
+        m_current.packet_offset = m_table.data_offset + m_table.data_size;
+        m_current.packet_index = header->global_packet_index;
+    }
+    add_bytes((const uint8_t*)header, size);
+}
+
+void blockchecksum::add_bytes(const uint8_t* data, uint64_t size) {
+    while (size > 0) {
+        uint64_t count = std::min(size, m_table.block_size - m_current_size);
+        m_current.crc32c = vktrace_crc32c(m_current.crc32c, data, (size_t)count);
+        m_current_size += count;
+        m_table.data_size += count;
+        data += count;
+        size -= count;
+        if (m_current_size == m_table.block_size) {
+            end_block();
+        }
+    }
+}
+
+void blockchecksum::end_block() {
+    m_entries.push_back(m_current);
+    // Flushed with each block, so that the sidecar covers the trace up to its last complete block if the capture stops here
+    if (m_sidecar != NULL && (fwrite(&m_current, sizeof(m_current), 1, m_sidecar) != 1 || fflush(m_sidecar) != 0)) {
+        fclose(m_sidecar);
+        m_sidecar = NULL;
+    }
+    memset(&m_current, 0, sizeof(m_current));
+    m_current_size = 0;
+}
+
+std::vector<uint8_t> blockchecksum::finish() {
+    if (m_current_size > 0) {
+        end_block();
+    }
+    m_table.block_count = m_entries.size();
+    m_table.entries_crc32c = vktrace_crc32c(0, m_entries.data(), m_entries.size() * sizeof(vktrace_trace_block_entry));
+    std::vector<uint8_t> body(sizeof(m_table) + m_entries.size() * sizeof(vktrace_trace_block_entry));
+    memcpy(body.data(), &m_table, sizeof(m_table));
+    if (!m_entries.empty()) {
+        memcpy(&body[sizeof(m_table)], m_entries.data(), m_entries.size() * sizeof(vktrace_trace_block_entry));
+    }
+    return body;
+}
+
+bool blocktable::read(FileLike* file, uint64_t offset) {
+    vktrace_trace_packet_header header;
+    if (offset == 0 || !vktrace_FileLike_SetCurrentPosition(file, offset) || !vktrace_FileLike_ReadRaw(file, &header, sizeof(header)) ||
+        header.packet_id != VKTRACE_TPI_BLOCK_TABLE || header.size < sizeof(header) + sizeof(m_table) ||
+        !vktrace_FileLike_ReadRaw(file, &m_table, sizeof(m_table)) || m_table.block_size == 0) {
+        return false;
+    }
+    uint64_t entriesSize = header.size - sizeof(header) - sizeof(m_table);
+    if (m_table.block_count != (m_table.data_size + m_table.block_size - 1) / m_table.block_size ||
+        entriesSize < m_table.block_count * sizeof(vktrace_trace_block_entry)) {
+        return false;
+    }
+    m_entries.resize((size_t)m_table.block_count);
+    if (!m_entries.empty() && !vktrace_FileLike_ReadRaw(file, m_entries.data(), m_entries.size() * sizeof(vktrace_trace_block_entry))) {
+        return false;
+    }
+    m_bad.assign(m_entries.size(), 0);
+    return vktrace_crc32c(0, m_entries.data(), m_entries.size() * sizeof(vktrace_trace_block_entry)) == m_table.entries_crc32c;
+}
+
+bool blocktable::read_sidecar(const std::string& path) {
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (fp == NULL) {
+        return false;
+    }
+    bool valid = fread(&m_table, sizeof(m_table), 1, fp) == 1 && m_table.block_size > 0 && m_table.block_count == 0;
+    m_entries.clear();
+    vktrace_trace_block_entry entry;
+    while (valid && fread(&entry, sizeof(entry), 1, fp) == 1) {
+        m_entries.push_back(entry);
+    }
+    fclose(fp);
+    if (!valid) {
+        return false;
+    }
+    // The entries of the blocks which ended, a partly written one is left out by fread()
+    m_table.block_count = m_entries.size();
+    m_table.data_size = m_table.block_count * m_table.block_size;
+    m_bad.assign(m_entries.size(), 0);
+    return true;
+}
+
+int64_t blocktable::verify(const char* path, uint32_t threads) {
+    std::atomic<uint64_t> next(0);
+    std::atomic<int64_t> bad(0);
+    std::atomic<bool> failed(false);
+    auto worker = [&]() {
+        FILE* fp = fopen(path, "rb");
+        if (fp == NULL) {
+            failed = true;
+            return;
+        }
+        std::vector<uint8_t> buffer((size_t)m_table.block_size);
+        for (uint64_t block = next++; block < m_entries.size(); block = next++) {
+            uint64_t start = block * m_table.block_size;
+            size_t size = (size_t)std::min(m_table.block_size, m_table.data_size - start);
+            bool good = Fseek(fp, m_table.data_offset + start, SEEK_SET) == 0 && fread(buffer.data(), 1, size, fp) == size &&
+                        vktrace_crc32c(0, buffer.data(), size) == m_entries[block].crc32c;
+            m_bad[block] = good ? 0 : 1;
+            if (!good) {
+                bad++;
+            }
+        }
+        fclose(fp);
+    };
+    std::vector<std::thread> workers;
+    for (uint32_t i = 1; i < threads; i++) {
+        workers.push_back(std::thread(worker));
+    }
+    worker();
+    for (std::thread& t : workers) {
+        t.join();
+    }
+    return failed ? -1 : bad.load();
+}
+
+bool blocktable::is_good(uint64_t offset, uint64_t size) const {
+    uint64_t end = std::min(offset + size, m_table.data_offset + m_table.data_size);
+    if (size == 0 || offset < m_table.data_offset || offset >= end) {
+        return true;
+    }
+    for (uint64_t block = (offset - m_table.data_offset) / m_table.block_size;
+         block < m_entries.size() && m_table.data_offset + block * m_table.block_size < end; block++) {
+        if (m_bad[block]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t blocktable::next_packet(uint64_t offset) const {
+    uint64_t block = offset < m_table.data_offset ? 0 : (offset - m_table.data_offset) / m_table.block_size + 1;
+    for (; block < m_entries.size(); block++) {
+        if (!m_bad[block] && m_entries[block].packet_offset != 0) {
+            return m_entries[block].packet_offset;
+        }
+    }
+    return m_table.data_offset + m_table.data_size;
+}
@@ -0,0 +1,114 @@
+/*
+ * (C) COPYRIGHT 2020 ARM Limited
+ * ALL RIGHTS RESERVED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "vktrace_trace_packet_identifiers.h"
+#include "vktrace_filelike.h"
+
+/* CRC32C (Castagnoli) of 'size' bytes at 'data', continuing from 'crc' (0 for the first bytes). Uses the SSE4.2 or the
+ * ARMv8 CRC32 instructions when the CPU has them.
+ */
+uint32_t vktrace_crc32c(uint32_t crc, const void* data, size_t size);
+
+/* The file next to the trace at 'trace_path' which gets the block table during the capture: a vktrace_trace_block_table with
+ * block_count 0, followed by an entry per block as the blocks end. It is deleted once the table is in the trace file, so it
+ * is only left by a capture which didn't end properly.
+ */
+std::string vktrace_block_sidecar_path(const char* trace_path);
+
+/* Record side: the checksums of the blocks of the packets, computed as the packets are written to the trace file.
+ */
+class blockchecksum {
+public:
+    blockchecksum(uint64_t block_size, uint64_t data_offset);
+    ~blockchecksum();
+
+    /* Also writes the entries to the sidecar file at 'path' as the blocks end, see vktrace_block_sidecar_path().
+     */
+    bool open_sidecar(const std::string& path);
+
+    /* The packet 'header' was written at the end of the file, 'size' bytes of it.
+     */
+    void add_packet(const vktrace_trace_packet_header* header, uint64_t size);
+
+    /* Ends the last block and returns the body of the VKTRACE_TPI_BLOCK_TABLE packet.
+     */
+    std::vector<uint8_t> finish();
+
+    /* Deletes the sidecar file, once the block table is in the trace file.
+     */
+    void remove_sidecar();
+
+    uint64_t block_count() const { return m_entries.size(); }
+
+private:
+    void add_bytes(const uint8_t* data, uint64_t size);
+    void end_block();
+
+    vktrace_trace_block_table m_table;
+    std::vector<vktrace_trace_block_entry> m_entries;
+    vktrace_trace_block_entry m_current;
+    uint64_t m_current_size = 0;
+    FILE* m_sidecar = NULL;
+    std::string m_sidecar_path;
+};
+
+/* Read side: the block table of a trace file, and which blocks verify() found corrupted.
+ */
+class blocktable {
+public:
+    /* Reads the VKTRACE_TPI_BLOCK_TABLE packet at 'offset'. Returns false if it isn't a valid block table.
+     */
+    bool read(FileLike* file, uint64_t offset);
+
+    /* Reads the sidecar file at 'path' of a capture which didn't end properly. Only its complete blocks are checked.
+     */
+    bool read_sidecar(const std::string& path);
+
+    /* Checks the blocks of the trace file at 'path' on 'threads' threads. Returns the number of corrupted blocks, or -1 if
+     * the file can't be opened.
+     */
+    int64_t verify(const char* path, uint32_t threads);
+
+    uint64_t block_count() const { return m_entries.size(); }
+    uint64_t block_size() const { return m_table.block_size; }
+    bool is_bad(uint64_t block) const { return m_bad[block] != 0; }
+
+    /* The file offset of the first packet which starts in 'block', 0 if no packet starts in it.
+     */
+    uint64_t packet_offset(uint64_t block) const { return m_entries[block].packet_offset; }
+
+    /* Whether the bytes [offset, offset + size) are only in good blocks. Bytes out of the checked data are good.
+     */
+    bool is_good(uint64_t offset, uint64_t size) const;
+
+    /* Where to carry on reading after the corrupted data at 'offset': the first packet which starts in a good block after
+     * the one of 'offset', or the end of the checked data.
+     */
+    uint64_t next_packet(uint64_t offset) const;
+
+private:
+    vktrace_trace_block_table m_table = {};
+    std::vector<vktrace_trace_block_entry> m_entries;
+    std::vector<uint8_t> m_bad;
+};
@@ -35,23 +35,29 @@ compressor* create_compressor(VKTRACE_COMPRESS_TYPE type) {
     return nullptr;
 }
 
-int compress_packet(compressor *g_compressor, vktrace_trace_packet_header* &pPacketHeader) {
+int compress_packet(compressor *g_compressor, vktrace_trace_packet_header* &pPacketHeader, packetpool& pool) {
     if (pPacketHeader->tracer_id == VKTRACE_TID_VULKAN_COMPRESSED) {
         vktrace_LogWarning("Packet %d is already a compressed one, so it won't be compressed.", pPacketHeader->global_packet_index);
         return 0;
     }
     int orig_data_size = pPacketHeader->size - sizeof(vktrace_trace_packet_header);
     int buffer_size = g_compressor->getMaxCompressedLength(orig_data_size);
-    vktrace_trace_packet_header* pCompressPacketHeader = (vktrace_trace_packet_header*)vktrace_malloc(sizeof(vktrace_trace_packet_header) + sizeof(vktrace_trace_packet_header_compression_ext) + buffer_size);
+    vktrace_trace_packet_header* pCompressPacketHeader = (vktrace_trace_packet_header*)pool.alloc(sizeof(vktrace_trace_packet_header) + sizeof(vktrace_trace_packet_header_compression_ext) + buffer_size);
+    if (pCompressPacketHeader == nullptr) {
+        vktrace_LogError("Compressed packet malloc failed.");
+        return -1;
+    }
     pPacketHeader->pBody = (uintptr_t)(pPacketHeader + 1);
     char *compress_buffer = (char *)pCompressPacketHeader + sizeof(vktrace_trace_packet_header) + sizeof(vktrace_trace_packet_header_compression_ext);
     int compressed_data_size = g_compressor->compress((char*)pPacketHeader->pBody, orig_data_size, compress_buffer, buffer_size);
     if (compressed_data_size <= 0) {
         vktrace_LogError("Compression error: %d\n", compressed_data_size);
+        pool.release(pCompressPacketHeader);
         return -1;
     }
     else if (compressed_data_size >= orig_data_size) {
         vktrace_LogWarning("The data after compression becomes even larger (%d bytes to %d bytes), so it won't be compressed.\n", orig_data_size, compressed_data_size);
+        pool.release(pCompressPacketHeader);
         return 0;
     }
     else {
@@ -65,7 +71,6 @@ int compress_packet(compressor *g_compressor, vktrace_trace_packet_header* &pPac
         reinterpret_cast<vktrace_trace_packet_header_compression_ext*>(pCompressPacketHeader->pBody)->pBody = (uintptr_t)compress_buffer;
 
         g_compressor->compress_packet_counter++;
-        vktrace_free(pPacketHeader);
         pPacketHeader = pCompressPacketHeader;
         return 0;
     }
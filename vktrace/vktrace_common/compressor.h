@@ -19,6 +19,7 @@
 #pragma once
 
 #include "vktrace_trace_packet_identifiers.h"
+#include "packetpool.h"
 
 class compressor {
 public:
@@ -40,4 +41,7 @@ public:
 
 compressor* create_compressor(VKTRACE_COMPRESS_TYPE type);
 
-int compress_packet(compressor *g_compressor, vktrace_trace_packet_header* &pPacketHeader);
+/* Replaces the packet by a compressed one allocated from 'pool', unless compressing doesn't make it smaller.
+ * The original packet isn't freed. Returns 0 on success (whether or not the packet was changed) and -1 on error.
+ */
+int compress_packet(compressor *g_compressor, vktrace_trace_packet_header* &pPacketHeader, packetpool& pool);
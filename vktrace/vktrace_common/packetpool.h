@@ -0,0 +1,110 @@
+/*
+ * (C) COPYRIGHT 2020 ARM Limited
+ * ALL RIGHTS RESERVED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <utility>
+#include <vector>
+
+/* Recycles the buffers of the packets made at record time (compressed and blob reference packets), so that they are
+ * not allocated and freed for every packet. Keeps up to 'max_buffers' free buffers of at most 'max_buffer_size' bytes.
+ * Not thread safe, each record thread has its own.
+ */
+class packetpool {
+public:
+    explicit packetpool(size_t max_buffers = 8, uint64_t max_buffer_size = 64 * 1024 * 1024)
+        : m_maxBuffers(max_buffers), m_maxBufferSize(max_buffer_size) {}
+
+    ~packetpool() {
+        for (buffer& b : m_free) {
+            free(b.data);
+        }
+    }
+
+    /* Returns a buffer of at least 'size' bytes, NULL if it can't be allocated.
+     */
+    void* alloc(uint64_t size) {
+        size_t best = m_free.size();
+        for (size_t i = 0; i < m_free.size(); i++) {
+            if (m_free[i].size >= size && (best == m_free.size() || m_free[i].size < m_free[best].size)) {
+                best = i;
+            }
+        }
+        if (best < m_free.size()) {
+            buffer b = m_free[best];
+            m_free[best] = m_free.back();
+            m_free.pop_back();
+            m_used.push_back(b);
+            return b.data;
+        }
+        // Round up so that packets of close sizes can share buffers
+        uint64_t capacity = 4096;
+        while (capacity < size) {
+            capacity *= 2;
+        }
+        buffer b = {malloc((size_t)capacity), capacity};
+        if (b.data == NULL) {
+            return NULL;
+        }
+        m_used.push_back(b);
+        return b.data;
+    }
+
+    /* Gives back a buffer returned by alloc().
+     */
+    void release(void* data) {
+        for (size_t i = 0; i < m_used.size(); i++) {
+            if (m_used[i].data == data) {
+                buffer b = m_used[i];
+                m_used[i] = m_used.back();
+                m_used.pop_back();
+                if (b.size > m_maxBufferSize) {
+                    free(b.data);
+                } else if (m_free.size() < m_maxBuffers) {
+                    m_free.push_back(b);
+                } else {
+                    // Keep the largest buffers
+                    size_t smallest = 0;
+                    for (size_t j = 1; j < m_free.size(); j++) {
+                        if (m_free[j].size < m_free[smallest].size) {
+                            smallest = j;
+                        }
+                    }
+                    if (m_free[smallest].size < b.size) {
+                        std::swap(m_free[smallest], b);
+                    }
+                    free(b.data);
+                }
+                return;
+            }
+        }
+    }
+
+private:
+    struct buffer {
+        void* data;
+        uint64_t size;
+    };
+
+    size_t m_maxBuffers;
+    uint64_t m_maxBufferSize;
+    std::vector<buffer> m_free;
+    std::vector<buffer> m_used;  // a packet or two at a time
+};
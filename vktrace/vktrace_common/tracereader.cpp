@@ -0,0 +1,99 @@
+/*
+ * (C) COPYRIGHT 2020 ARM Limited
+ * ALL RIGHTS RESERVED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#include "tracereader.h"
+#include "vktrace_tracelog.h"
+#include "vktrace_trace_packet_utils.h"
+
+bool attach_reader(trace_reader& reader, FileLike* file, const vktrace_trace_file_header& fileHeader) {
+    reader.file = file;
+    if (fileHeader.compress_type != VKTRACE_COMPRESS_TYPE_NONE) {
+        reader.decomp = create_decompressor((VKTRACE_COMPRESS_TYPE)fileHeader.compress_type);
+        if (reader.decomp == nullptr) {
+            vktrace_LogError("Create decompressor error.");
+            return false;
+        }
+    }
+    if (fileHeader.bit_flags & VKTRACE_USE_BLOB_REFERENCES_BIT) {
+        reader.blobs = new blobcache(reader.file, reader.decomp);
+    }
+    return true;
+}
+
+bool open_reader(trace_reader& reader, const char* path, const vktrace_trace_file_header& fileHeader) {
+    reader.fp = fopen(path, "rb");
+    if (reader.fp == NULL) {
+        vktrace_LogError("Cannot open trace file: '%s'.", path);
+        return false;
+    }
+    return attach_reader(reader, vktrace_FileLike_create_file(reader.fp), fileHeader);
+}
+
+void close_reader(trace_reader& reader) {
+    delete reader.blobs;
+    delete reader.decomp;
+    if (reader.fp != NULL) {
+        fclose(reader.fp);
+        vktrace_free(reader.file);
+    }
+    reader = trace_reader();
+}
+
+vktrace_trace_packet_header* read_packet(trace_reader& reader, int& ret) {
+    vktrace_trace_packet_header* packet = vktrace_read_trace_packet(reader.file);
+    if (!packet) return NULL;
+
+    if (packet->tracer_id == VKTRACE_TID_VULKAN_COMPRESSED) {
+        ret = decompress_packet(reader.decomp, packet);
+        if (ret != 0) {
+            vktrace_LogError("Decompress packet error.");
+            vktrace_delete_trace_packet_no_lock(&packet);
+            return NULL;
+        }
+    }
+    if (packet->tracer_id == VKTRACE_TID_VULKAN_BLOB_REF) {
+        ret = resolve_packet(reader.blobs, packet);
+        if (ret != 0) {
+            vktrace_LogError("Resolve blob reference packet error.");
+            vktrace_delete_trace_packet_no_lock(&packet);
+            return NULL;
+        }
+    }
+    return packet;
+}
+
+bool parse_thread_count(const char* arg, uint32_t& threads) {
+    if (!isdigit((unsigned char)arg[0])) {
+        // strtoul() would take a sign or spaces
+        return false;
+    }
+    char* end = nullptr;
+    errno = 0;
+    unsigned long count = strtoul(arg, &end, 10);
+    if (errno != 0 || *end != '\0') {
+        return false;
+    }
+    const uint32_t cpus = std::max(std::thread::hardware_concurrency(), 1u);
+    threads = (count == 0 || count > cpus) ? cpus : (uint32_t)count;
+    return true;
+}
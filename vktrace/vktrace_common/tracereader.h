@@ -0,0 +1,200 @@
+/*
+ * (C) COPYRIGHT 2020 ARM Limited
+ * ALL RIGHTS RESERVED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "vktrace_trace_packet_identifiers.h"
+#include "vktrace_filelike.h"
+#include "decompressor.h"
+#include "blobstore.h"
+
+/* Reads the packets of a trace, decompressed and with their blob references resolved. The tools which work on a trace
+ * with several threads give each thread its own.
+ */
+struct trace_reader {
+    FILE* fp = NULL;
+    FileLike* file = NULL;
+    decompressor* decomp = nullptr;
+    blobcache* blobs = nullptr;
+};
+
+/* Reads from 'file', which stays owned by the caller: close_reader() doesn't free it if 'reader.fp' is NULL.
+ */
+bool attach_reader(trace_reader& reader, FileLike* file, const vktrace_trace_file_header& fileHeader);
+
+/* Opens the trace at 'path' for the reader.
+ */
+bool open_reader(trace_reader& reader, const char* path, const vktrace_trace_file_header& fileHeader);
+
+void close_reader(trace_reader& reader);
+
+/* Reads the packet at the current position. Returns NULL at the end of the trace, or with 'ret' set on error.
+ */
+vktrace_trace_packet_header* read_packet(trace_reader& reader, int& ret);
+
+/* Parses the count of threads of "-j": a decimal number, 0 or more than the CPUs meaning one thread per CPU.
+ */
+bool parse_thread_count(const char* arg, uint32_t& threads);
+
+/* Processes the parts of a trace on several threads and writes them in the order they were added, so that the output is
+ * the same as the one of a single thread. The main thread adds the parts as it scans the trace, 'process' runs on the
+ * worker threads with their own reader, 'write' runs on the main thread and gets whether the part is the last one.
+ * At most 4 parts per thread are in memory between ready() and their write: ready() writes the parts which are done and
+ * waits while there are more, so the scan of the main thread can't run ahead of the workers.
+ */
+template <typename Part>
+class ordered_part_writer {
+public:
+    ordered_part_writer(uint32_t threads, const char* path, const vktrace_trace_file_header& fileHeader,
+                        std::function<int(trace_reader&, Part&)> process, std::function<bool(Part&, bool)> write)
+        : m_process(process), m_write(write), m_maxPending((size_t)threads * 4) {
+        for (uint32_t i = 0; i < threads; i++) {
+            m_workers.push_back(std::thread(&ordered_part_writer::work, this, path, std::cref(fileHeader)));
+        }
+    }
+
+    ~ordered_part_writer() { finish(0); }
+
+    /* A new part at the end, which the caller sets up before calling ready().
+     */
+    Part& add() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_parts.emplace_back();
+        m_done.push_back(false);
+        return m_parts.back();
+    }
+
+    Part& back() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_parts.back();
+    }
+
+    /* The last part can be processed. Writes the parts which are done, waiting for the oldest ones while too many are
+     * pending.
+     */
+    void ready() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_ready++;
+            m_changed.notify_all();
+        }
+        write_parts(false);
+        while (pending() >= m_maxPending && write_parts(true)) {
+        }
+    }
+
+    bool failed() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_failed;
+    }
+
+    /* No more parts come, 'ret' is the result of the scan. Writes the remaining parts and returns 0, or -1 if a part failed.
+     */
+    int finish(int ret) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_scanned = true;
+            m_failed = m_failed || ret != 0;
+            m_changed.notify_all();
+        }
+        while (write_parts(true)) {
+        }
+        for (std::thread& t : m_workers) {
+            t.join();
+        }
+        m_workers.clear();
+        return m_failed ? -1 : 0;
+    }
+
+    /* All the parts, once finish() returned. Those which weren't written after a failure still hold their state.
+     */
+    std::deque<Part>& parts() { return m_parts; }
+
+private:
+    void work(const char* path, const vktrace_trace_file_header& fileHeader) {
+        trace_reader reader;
+        bool opened = open_reader(reader, path, fileHeader);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_failed = m_failed || !opened;
+        while (!m_failed) {
+            m_changed.wait(lock, [&]() { return m_failed || m_next < m_ready || (m_scanned && m_next == m_ready); });
+            if (m_failed || m_next == m_ready) break;
+            size_t index = m_next++;
+            Part& part = m_parts[index];
+            lock.unlock();
+            int partRet = m_process(reader, part);
+            lock.lock();
+            m_done[index] = true;
+            m_failed = m_failed || partRet != 0;
+            m_changed.notify_all();
+        }
+        m_changed.notify_all();
+        lock.unlock();
+        close_reader(reader);
+    }
+
+    size_t pending() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_ready - m_written;
+    }
+
+    // Writes the parts which are next in order and done, with 'wait' after waiting for the next one. Returns false if
+    // nothing was written.
+    bool write_parts(bool wait) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        bool wrote = false;
+        while (m_written < m_ready) {
+            if (wait && !wrote) {
+                m_changed.wait(lock, [&]() { return m_failed || m_done[m_written]; });
+            }
+            if (m_failed || !m_done[m_written]) break;
+            Part& part = m_parts[m_written];
+            bool last = m_scanned && m_written + 1 == m_ready;
+            lock.unlock();
+            bool ok = m_write(part, last);
+            lock.lock();
+            m_failed = m_failed || !ok;
+            m_written++;
+            m_changed.notify_all();
+            wrote = true;
+        }
+        return wrote;
+    }
+
+    std::function<int(trace_reader&, Part&)> m_process;
+    std::function<bool(Part&, bool)> m_write;
+    std::deque<Part> m_parts;
+    std::deque<bool> m_done;
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    size_t m_maxPending;
+    size_t m_ready = 0;    // parts which can be processed
+    size_t m_next = 0;     // next part to process
+    size_t m_written = 0;  // parts written
+    bool m_scanned = false;
+    bool m_failed = false;
+};
@@ -251,6 +251,13 @@ static uint32_t getAHardwareBufBPP(uint32_t fmt) {
 // (e.g. when generating trace file with only 1 or small range of frames.)
 #define VKTRACE_TRIM_POST_PROCESS_ENV "VKTRACE_TRIM_POST_PROCESS"
 
+// VKTRACE_LIB_TRANSPORT env var selects how the trace layer sends packets to
+// the vktrace server: "tcp" always uses the socket, anything else (the
+// default) sends them through a shared memory ring when the server is on the
+// same Linux host. The env var is set by the vktrace program to communicate
+// the --Transport arg value to the trace layer.
+#define VKTRACE_LIB_TRANSPORT_ENV "VKTRACE_LIB_TRANSPORT"
+
 // VKTRACE_FORCE_FIFO env var force present mode in vkCreateSwapchain to VK_PRESENT_MODE_FIFO_KHR
 // if the value is 1.  Other values will keep the original present mode.
 // If this var is undefined, original present mode will be used.
@@ -28,6 +28,22 @@
 #if !defined(WIN32)
 #include <errno.h>
 #endif
+#if defined(PLATFORM_LINUX) && !defined(ANDROID)
+#define VKTRACE_SHARED_RING 1
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+#if defined(PLATFORM_LINUX)
+#include <sys/epoll.h>
+#elif defined(PLATFORM_POSIX)
+#include <sys/select.h>
+#endif
 const size_t kSendBufferSize = 1024 * 1024;
 
 MessageStream* gMessageStream = NULL;
@@ -41,9 +57,17 @@ BOOL vktrace_MessageStream_SetupClientSocket(MessageStream* pStream);
 BOOL vktrace_MessageStream_Handshake(MessageStream* pStream);
 BOOL vktrace_MessageStream_ReallySend(MessageStream* pStream, const void* _bytes, uint64_t _size, BOOL _optional);
 void vktrace_MessageStream_FlushSendBuffer(MessageStream* pStream, BOOL _optional);
+BOOL vktrace_MessageStream_NegotiateTransport(MessageStream* pStream);
+BOOL vktrace_SharedRing_Send(MessageStream* pStream, const void* _bytes, uint64_t _size);
+BOOL vktrace_SharedRing_Recv(MessageStream* pStream, void* _out, uint64_t _len);
+void vktrace_SharedRing_destroy(struct SharedRing** ppRing);
+BOOL vktrace_RecvBuffer_create(MessageStream* pStream);
+void vktrace_RecvBuffer_destroy(struct RecvBuffer** ppBuffer);
+BOOL vktrace_RecvBuffer_Recv(MessageStream* pStream, void* _out, uint64_t _len);
 
 // public functions
-MessageStream* vktrace_MessageStream_create_port_string(BOOL _isHost, const char* _address, const char* _port) {
+MessageStream* vktrace_MessageStream_create_port_string(BOOL _isHost, const char* _address, const char* _port,
+                                                       VKTRACE_TRANSPORT _transport) {
     MessageStream* pStream;
     // make sure the strings are shorter than the destination buffer we have to store them!
     assert(strlen(_address) + 1 <= 64);
@@ -61,6 +85,9 @@ MessageStream* vktrace_MessageStream_create_port_string(BOOL _isHost, const char
     pStream->mSocket = INVALID_SOCKET;
     pStream->mServerListenSocket = INVALID_SOCKET;
     pStream->mSendBuffer = NULL;
+    pStream->mTransport = _transport;
+    pStream->mRing = NULL;
+    pStream->mRecvBuffer = NULL;
 
     if (vktrace_MessageStream_SetupSocket(pStream) == FALSE) {
         VKTRACE_DELETE(pStream);
@@ -70,11 +97,11 @@ MessageStream* vktrace_MessageStream_create_port_string(BOOL _isHost, const char
     return pStream;
 }
 
-MessageStream* vktrace_MessageStream_create(BOOL _isHost, const char* _address, unsigned int _port) {
+MessageStream* vktrace_MessageStream_create(BOOL _isHost, const char* _address, unsigned int _port, VKTRACE_TRANSPORT _transport) {
     char portBuf[32];
     memset(portBuf, 0, 32 * sizeof(char));
     sprintf(portBuf, "%u", _port);
-    return vktrace_MessageStream_create_port_string(_isHost, _address, portBuf);
+    return vktrace_MessageStream_create_port_string(_isHost, _address, portBuf, _transport);
 }
 
 void vktrace_MessageStream_destroy(MessageStream** ppStream) {
@@ -84,6 +111,14 @@ void vktrace_MessageStream_destroy(MessageStream** ppStream) {
         vktrace_SimpleBuffer_destroy(&(*ppStream)->mSendBuffer);
     }
 
+    if ((*ppStream)->mRing != NULL) {
+        vktrace_SharedRing_destroy(&(*ppStream)->mRing);
+    }
+
+    if ((*ppStream)->mRecvBuffer != NULL) {
+        vktrace_RecvBuffer_destroy(&(*ppStream)->mRecvBuffer);
+    }
+
     if ((*ppStream)->mHostAddressInfo != NULL) {
         freeaddrinfo((*ppStream)->mHostAddressInfo);
         (*ppStream)->mHostAddressInfo = NULL;
@@ -127,6 +162,9 @@ BOOL vktrace_MessageStream_SetupHostSocket(MessageStream* pStream) {
 #endif
     struct addrinfo hostAddrInfo = {0};
     SOCKET listenSocket;
+    // The stream may be a copy of the one of another connection
+    pStream->mRing = NULL;
+    pStream->mRecvBuffer = NULL;
     if (pStream->mServerListenSocket == INVALID_SOCKET) {
         vktrace_create_critical_section(&gSendLock);
         hostAddrInfo.ai_family = AF_INET;
@@ -207,6 +245,9 @@ BOOL vktrace_MessageStream_SetupHostSocket(MessageStream* pStream) {
         // so disable it for now.
         // pStream->mSendBuffer = vktrace_SimpleBuffer_create(kSendBufferSize);
         pStream->mSendBuffer = NULL;
+        if (vktrace_MessageStream_NegotiateTransport(pStream) && pStream->mRing == NULL) {
+            vktrace_RecvBuffer_create(pStream);
+        }
     } else {
         vktrace_LogError("vktrace_MessageStream_SetupHostSocket failed handshake.");
     }
@@ -292,7 +333,7 @@ BOOL vktrace_MessageStream_SetupClientSocket(MessageStream* pStream) {
         vktrace_LogError("Client: Failed handshake with host.");
         return FALSE;
     }
-    return TRUE;
+    return vktrace_MessageStream_NegotiateTransport(pStream);
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -344,7 +385,9 @@ void vktrace_MessageStream_FlushSendBuffer(MessageStream* pStream, BOOL _optiona
 // ------------------------------------------------------------------------------------------------
 BOOL vktrace_MessageStream_BufferedSend(MessageStream* pStream, const void* _bytes, uint64_t _size, BOOL _optional) {
     BOOL result = TRUE;
-    if (pStream->mSendBuffer == NULL) {
+    if (pStream->mRing != NULL && !pStream->mHost) {
+        result = vktrace_SharedRing_Send(pStream, _bytes, _size);
+    } else if (pStream->mSendBuffer == NULL) {
         result = vktrace_MessageStream_ReallySend(pStream, _bytes, _size, _optional);
     } else {
         if (!vktrace_SimpleBuffer_WouldOverflow(pStream->mSendBuffer, _size)) {
@@ -409,6 +452,12 @@ BOOL vktrace_MessageStream_ReallySend(MessageStream* pStream, const void* _bytes
 BOOL vktrace_MessageStream_Recv(MessageStream* pStream, void* _out, uint64_t _len) {
     unsigned int totalDataRead = 0;
     unsigned int attempts = 0;
+    if (pStream->mRing != NULL && pStream->mHost) {
+        return vktrace_SharedRing_Recv(pStream, _out, _len);
+    }
+    if (pStream->mRecvBuffer != NULL) {
+        return vktrace_RecvBuffer_Recv(pStream, _out, _len);
+    }
     do {
         attempts++;
         int dataRead = recv(pStream->mSocket, ((char*)_out) + totalDataRead, (int)_len - totalDataRead, 0);
@@ -465,6 +514,569 @@ BOOL vktrace_MessageStream_BlockingRecv(MessageStream* pStream, void* _outBuffer
     return TRUE;
 }
 
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// Shared memory ring, see VKTRACE_TRANSPORT_AUTO.
+//
+// The layer creates a memfd holding a header page followed by the data of a single producer, single consumer byte ring
+// (the threads of the traced process take gSendLock to write to it). It sends the memfd's pid and fd number to the server
+// over the socket, and the server maps it through /proc if it is on the same host, checking a random token to be sure it
+// mapped the right file. Both map the data twice in a row, so that any range of the ring is contiguous in memory and the
+// server can use a packet where the layer wrote it. Each side only sleeps on a futex in the header when the ring is empty
+// (server) or full (layer), and the other side only wakes it up then.
+
+#define VKTRACE_RING_MAGIC 0x474e5256u  // "VRNG"
+#define VKTRACE_RING_VERSION 1
+#define VKTRACE_RING_HEADER_SIZE 4096
+#define VKTRACE_RING_DATA_SIZE (64 * 1024 * 1024)
+#define VKTRACE_RING_WAIT_MS 100
+
+typedef struct SharedRingOffer {
+    uint32_t magic;
+    uint32_t version;
+    int32_t pid;  // 0 if the layer doesn't offer a ring
+    int32_t fd;
+    uint64_t dataSize;
+    uint8_t token[16];
+} SharedRingOffer;
+
+#if defined(VKTRACE_SHARED_RING)
+
+typedef struct SharedRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t dataSize;
+    uint8_t token[16];
+    // Written by the layer
+    uint64_t head __attribute__((aligned(64)));  // bytes written since the start
+    uint32_t dataSeq;                            // futex the server waits on
+    uint32_t producerWaiting;
+    // Written by the server
+    uint64_t tail __attribute__((aligned(64)));  // bytes consumed since the start
+    uint32_t spaceSeq;                           // futex the layer waits on
+    uint32_t consumerWaiting;
+} SharedRingHeader;
+
+typedef struct SharedRing {
+    SharedRingHeader* header;
+    uint8_t* data;  // dataSize bytes mapped twice
+    uint64_t dataSize;
+    size_t mappingSize;
+    int fd;
+    uint64_t inPlaceSize;  // bytes returned by vktrace_MessageStream_PeekInPlace() and not consumed yet
+} SharedRing;
+
+static long vktrace_SharedRing_futex(uint32_t* word, int op, uint32_t value, const struct timespec* timeout) {
+    return syscall(SYS_futex, word, op, value, timeout, NULL, 0);
+}
+
+static SharedRing* vktrace_SharedRing_map(int fd, uint64_t dataSize) {
+    const size_t mappingSize = VKTRACE_RING_HEADER_SIZE + 2 * dataSize;
+    uint8_t* base = (uint8_t*)mmap(NULL, mappingSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+    if (mmap(base, VKTRACE_RING_HEADER_SIZE + dataSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        mmap(base + VKTRACE_RING_HEADER_SIZE + dataSize, dataSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd,
+             VKTRACE_RING_HEADER_SIZE) == MAP_FAILED) {
+        munmap(base, mappingSize);
+        return NULL;
+    }
+    SharedRing* pRing = VKTRACE_NEW(SharedRing);
+    pRing->header = (SharedRingHeader*)base;
+    pRing->data = base + VKTRACE_RING_HEADER_SIZE;
+    pRing->dataSize = dataSize;
+    pRing->mappingSize = mappingSize;
+    pRing->fd = fd;
+    pRing->inPlaceSize = 0;
+    return pRing;
+}
+
+// Layer side
+static SharedRing* vktrace_SharedRing_create(uint64_t dataSize) {
+#if defined(SYS_memfd_create)
+    int fd = (int)syscall(SYS_memfd_create, "vktrace-ring", 1u /* MFD_CLOEXEC */);
+#else
+    int fd = -1;
+#endif
+    if (fd < 0) {
+        return NULL;
+    }
+    if (ftruncate(fd, VKTRACE_RING_HEADER_SIZE + dataSize) != 0) {
+        close(fd);
+        return NULL;
+    }
+    SharedRing* pRing = vktrace_SharedRing_map(fd, dataSize);
+    if (pRing == NULL) {
+        close(fd);
+        return NULL;
+    }
+    pRing->header->magic = VKTRACE_RING_MAGIC;
+    pRing->header->version = VKTRACE_RING_VERSION;
+    pRing->header->dataSize = dataSize;
+    int random = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+    if (random < 0 || read(random, pRing->header->token, sizeof(pRing->header->token)) != sizeof(pRing->header->token)) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t fallback[2] = {(uint64_t)now.tv_sec * 1000000000 + now.tv_nsec, (uint64_t)getpid() << 32 | (uint64_t)fd};
+        memcpy(pRing->header->token, fallback, sizeof(fallback));
+    }
+    if (random >= 0) {
+        close(random);
+    }
+    return pRing;
+}
+
+// Server side
+static SharedRing* vktrace_SharedRing_open(const SharedRingOffer* pOffer) {
+    char path[64];
+    struct stat fileStat;
+    if (pOffer->dataSize == 0 || (pOffer->dataSize & (pOffer->dataSize - 1)) != 0 ||
+        pOffer->dataSize > 1024 * 1024 * 1024 || pOffer->dataSize % VKTRACE_RING_HEADER_SIZE != 0) {
+        return NULL;
+    }
+    snprintf(path, sizeof(path), "/proc/%d/fd/%d", pOffer->pid, pOffer->fd);
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        vktrace_LogVerbose("Host: Can't open the shared memory ring %s of the layer: %s.", path, strerror(errno));
+        return NULL;
+    }
+    if (fstat(fd, &fileStat) != 0 || (uint64_t)fileStat.st_size != VKTRACE_RING_HEADER_SIZE + pOffer->dataSize) {
+        close(fd);
+        return NULL;
+    }
+    SharedRing* pRing = vktrace_SharedRing_map(fd, pOffer->dataSize);
+    if (pRing == NULL) {
+        close(fd);
+        return NULL;
+    }
+    if (pRing->header->magic != VKTRACE_RING_MAGIC || pRing->header->version != VKTRACE_RING_VERSION ||
+        pRing->header->dataSize != pOffer->dataSize || memcmp(pRing->header->token, pOffer->token, sizeof(pOffer->token)) != 0) {
+        vktrace_SharedRing_destroy(&pRing);
+        return NULL;
+    }
+    return pRing;
+}
+
+void vktrace_SharedRing_destroy(SharedRing** ppRing) {
+    munmap((*ppRing)->header, (*ppRing)->mappingSize);
+    close((*ppRing)->fd);
+    VKTRACE_DELETE(*ppRing);
+    *ppRing = NULL;
+}
+
+// The other side only writes to the socket to close it, so anything to read means it has gone.
+static BOOL vktrace_SharedRing_PeerClosed(MessageStream* pStream) {
+    struct pollfd pfd = {pStream->mSocket, POLLIN, 0};
+    char byte;
+    if (poll(&pfd, 1, 0) <= 0) {
+        return FALSE;
+    }
+    return (pfd.revents & (POLLHUP | POLLERR)) != 0 || recv(pStream->mSocket, &byte, 1, MSG_PEEK) <= 0;
+}
+
+static void vktrace_SharedRing_Wake(uint32_t* waiting, uint32_t* seq) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(waiting, __ATOMIC_RELAXED)) {
+        __atomic_fetch_add(seq, 1, __ATOMIC_SEQ_CST);
+        vktrace_SharedRing_futex(seq, FUTEX_WAKE, 1, NULL);
+    }
+}
+
+// Waits until the other side moves position (the head for the server, the tail for the layer) to target, or closes the
+// connection. The other side wakes seq up after moving position if waiting is set.
+static BOOL vktrace_SharedRing_Wait(MessageStream* pStream, uint32_t* waiting, uint32_t* seq, uint64_t* position, uint64_t target) {
+    const struct timespec timeout = {0, VKTRACE_RING_WAIT_MS * 1000000L};
+    for (;;) {
+        const uint32_t value = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+        __atomic_store_n(waiting, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(position, __ATOMIC_SEQ_CST) < target) {
+            vktrace_SharedRing_futex(seq, FUTEX_WAIT, value, &timeout);
+        }
+        __atomic_store_n(waiting, 0, __ATOMIC_RELAXED);
+        if (__atomic_load_n(position, __ATOMIC_ACQUIRE) >= target) {
+            return TRUE;
+        }
+        if (vktrace_SharedRing_PeerClosed(pStream)) {
+            // Anything written before closing is visible by now
+            if (__atomic_load_n(position, __ATOMIC_ACQUIRE) >= target) {
+                return TRUE;
+            }
+            pStream->mErrorNum = WSAECONNRESET;
+            return FALSE;
+        }
+    }
+}
+
+BOOL vktrace_SharedRing_Send(MessageStream* pStream, const void* _bytes, uint64_t _size) {
+    SharedRing* pRing = pStream->mRing;
+    SharedRingHeader* pHeader = pRing->header;
+    const uint8_t* bytes = (const uint8_t*)_bytes;
+    BOOL result = TRUE;
+
+    vktrace_enter_critical_section(&gSendLock);
+    uint64_t head = pHeader->head;
+    while (_size > 0) {
+        uint64_t tail = __atomic_load_n(&pHeader->tail, __ATOMIC_ACQUIRE);
+        if (head - tail == pRing->dataSize) {
+            // Full, wait for the server to consume at least a quarter of the ring
+            if (!vktrace_SharedRing_Wait(pStream, &pHeader->producerWaiting, &pHeader->spaceSeq, &pHeader->tail,
+                                         head - pRing->dataSize + pRing->dataSize / 4)) {
+                result = FALSE;
+                break;
+            }
+            continue;
+        }
+        uint64_t chunk = pRing->dataSize - (head - tail);
+        if (chunk > _size) {
+            chunk = _size;
+        }
+        memcpy(pRing->data + (head & (pRing->dataSize - 1)), bytes, (size_t)chunk);
+        head += chunk;
+        bytes += chunk;
+        _size -= chunk;
+        __atomic_store_n(&pHeader->head, head, __ATOMIC_RELEASE);
+        vktrace_SharedRing_Wake(&pHeader->consumerWaiting, &pHeader->dataSeq);
+    }
+    vktrace_leave_critical_section(&gSendLock);
+    return result;
+}
+
+static BOOL vktrace_SharedRing_WaitForData(MessageStream* pStream, uint64_t _len) {
+    SharedRingHeader* pHeader = pStream->mRing->header;
+    const uint64_t target = pHeader->tail + _len;
+    if (__atomic_load_n(&pHeader->head, __ATOMIC_ACQUIRE) >= target) {
+        return TRUE;
+    }
+    return vktrace_SharedRing_Wait(pStream, &pHeader->consumerWaiting, &pHeader->dataSeq, &pHeader->head, target);
+}
+
+static void vktrace_SharedRing_Consume(SharedRing* pRing, uint64_t _len) {
+    SharedRingHeader* pHeader = pRing->header;
+    __atomic_store_n(&pHeader->tail, pHeader->tail + _len, __ATOMIC_RELEASE);
+    vktrace_SharedRing_Wake(&pHeader->producerWaiting, &pHeader->spaceSeq);
+}
+
+BOOL vktrace_SharedRing_Recv(MessageStream* pStream, void* _out, uint64_t _len) {
+    SharedRing* pRing = pStream->mRing;
+    uint8_t* out = (uint8_t*)_out;
+    // Bytes only peeked at are received again
+    pRing->inPlaceSize = 0;
+    while (_len > 0) {
+        const uint64_t chunk = _len < pRing->dataSize ? _len : pRing->dataSize;
+        if (!vktrace_SharedRing_WaitForData(pStream, chunk)) {
+            return FALSE;
+        }
+        memcpy(out, pRing->data + (pRing->header->tail & (pRing->dataSize - 1)), (size_t)chunk);
+        vktrace_SharedRing_Consume(pRing, chunk);
+        out += chunk;
+        _len -= chunk;
+    }
+    return TRUE;
+}
+
+#else
+
+BOOL vktrace_SharedRing_Send(MessageStream* pStream, const void* _bytes, uint64_t _size) { return FALSE; }
+BOOL vktrace_SharedRing_Recv(MessageStream* pStream, void* _out, uint64_t _len) { return FALSE; }
+void vktrace_SharedRing_destroy(struct SharedRing** ppRing) {}
+
+#endif  // VKTRACE_SHARED_RING
+
+// ------------------------------------------------------------------------------------------------
+// Receive buffer of the host, when the packets come through the socket.
+//
+// Each time the socket is readable, the host receives everything it holds at once into a large buffer, which usually is
+// many packets, and the packets are used in place from there. Waiting for the socket is done with epoll (select on other
+// platforms) instead of polling recv(), and an orderly shutdown of the client is seen as such instead of being guessed
+// from a number of empty reads.
+
+#define VKTRACE_RECV_BUFFER_SIZE (16 * 1024 * 1024)
+#define VKTRACE_RECV_SOCKET_BUFFER_SIZE (4 * 1024 * 1024)
+#define VKTRACE_RECV_WAIT_MS 100
+
+typedef struct RecvBuffer {
+    uint8_t* data;
+    uint64_t size;
+    uint64_t begin;        // first byte not consumed
+    uint64_t end;          // end of the received bytes
+    uint64_t inPlaceSize;  // bytes returned by vktrace_MessageStream_PeekInPlace() and not consumed yet
+    BOOL closed;           // the client shut the connection down, nothing comes after end
+#if defined(PLATFORM_LINUX)
+    int epollFd;
+#endif
+} RecvBuffer;
+
+BOOL vktrace_RecvBuffer_create(MessageStream* pStream) {
+    RecvBuffer* pBuffer = VKTRACE_NEW(RecvBuffer);
+    int socketBufferSize = VKTRACE_RECV_SOCKET_BUFFER_SIZE;
+    memset(pBuffer, 0, sizeof(RecvBuffer));
+    pBuffer->size = VKTRACE_RECV_BUFFER_SIZE;
+    pBuffer->data = (uint8_t*)vktrace_malloc((size_t)pBuffer->size);
+    if (pBuffer->data == NULL) {
+        vktrace_LogWarning("Host: Failed to allocate the receive buffer, receiving from the socket directly.");
+        VKTRACE_DELETE(pBuffer);
+        return FALSE;
+    }
+#if defined(PLATFORM_LINUX)
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | EPOLLRDHUP;
+    pBuffer->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (pBuffer->epollFd < 0 || epoll_ctl(pBuffer->epollFd, EPOLL_CTL_ADD, pStream->mSocket, &event) != 0) {
+        vktrace_LogWarning("Host: Failed to set up epoll (%d), receiving from the socket directly.", errno);
+        if (pBuffer->epollFd >= 0) {
+            close(pBuffer->epollFd);
+        }
+        vktrace_free(pBuffer->data);
+        VKTRACE_DELETE(pBuffer);
+        return FALSE;
+    }
+#endif
+    // Lets the client go on while the host writes a batch to the trace file
+    setsockopt(pStream->mSocket, SOL_SOCKET, SO_RCVBUF, (const char*)&socketBufferSize, sizeof(socketBufferSize));
+    pStream->mRecvBuffer = pBuffer;
+    return TRUE;
+}
+
+void vktrace_RecvBuffer_destroy(RecvBuffer** ppBuffer) {
+#if defined(PLATFORM_LINUX)
+    close((*ppBuffer)->epollFd);
+#endif
+    vktrace_free((*ppBuffer)->data);
+    VKTRACE_DELETE(*ppBuffer);
+    *ppBuffer = NULL;
+}
+
+// Waits until the socket is readable or has been closed. Returns FALSE on timeout.
+static BOOL vktrace_RecvBuffer_Wait(MessageStream* pStream) {
+#if defined(PLATFORM_LINUX)
+    struct epoll_event event;
+    return epoll_wait(pStream->mRecvBuffer->epollFd, &event, 1, VKTRACE_RECV_WAIT_MS) > 0;
+#else
+    fd_set readSet;
+    struct timeval timeout = {0, VKTRACE_RECV_WAIT_MS * 1000};
+    FD_ZERO(&readSet);
+    FD_SET(pStream->mSocket, &readSet);
+    return select((int)pStream->mSocket + 1, &readSet, NULL, NULL, &timeout) > 0;
+#endif
+}
+
+// Receives at least _minLen and at most _maxLen bytes to _out, waiting for the socket if needed. Returns the number of bytes
+// received, 0 if the connection was closed or failed first.
+static uint64_t vktrace_RecvBuffer_Receive(MessageStream* pStream, uint8_t* _out, uint64_t _minLen, uint64_t _maxLen) {
+    RecvBuffer* pBuffer = pStream->mRecvBuffer;
+    uint64_t received = 0;
+    while (received < _minLen) {
+        if (pBuffer->closed) {
+            pStream->mErrorNum = WSAECONNRESET;
+            vktrace_LogDebug("Connection was closed by client.");
+            return 0;
+        }
+        uint64_t len = _maxLen - received;
+        int dataRead = recv(pStream->mSocket, (char*)_out + received, len < INT_MAX ? (int)len : INT_MAX, 0);
+        if (dataRead > 0) {
+            received += dataRead;
+        } else if (dataRead == 0) {
+            pBuffer->closed = TRUE;
+        } else {
+            pStream->mErrorNum = VKTRACE_WSAGetLastError();
+            if (pStream->mErrorNum == WSAEWOULDBLOCK || pStream->mErrorNum == EAGAIN || pStream->mErrorNum == EINTR) {
+                vktrace_RecvBuffer_Wait(pStream);
+            } else if (pStream->mErrorNum == WSAECONNRESET) {
+                vktrace_LogDebug("Connection was reset by client.");
+                return 0;
+            } else {
+                vktrace_LogError("Unexpected error (%d) while receiving message stream.", pStream->mErrorNum);
+                return 0;
+            }
+        }
+    }
+    return received;
+}
+
+// Makes at least _len bytes (at most the size of the buffer) available from begin, taking all the socket holds at each
+// wakeup.
+static BOOL vktrace_RecvBuffer_Fill(MessageStream* pStream, uint64_t _len) {
+    RecvBuffer* pBuffer = pStream->mRecvBuffer;
+    assert(_len <= pBuffer->size);
+    if (pBuffer->begin == pBuffer->end) {
+        pBuffer->begin = pBuffer->end = 0;
+    } else if (pBuffer->begin + _len > pBuffer->size) {
+        // Move the partial packet at the end to the front, so that it is contiguous once received
+        memmove(pBuffer->data, pBuffer->data + pBuffer->begin, (size_t)(pBuffer->end - pBuffer->begin));
+        pBuffer->end -= pBuffer->begin;
+        pBuffer->begin = 0;
+    }
+    const uint64_t available = pBuffer->end - pBuffer->begin;
+    if (available >= _len) {
+        return TRUE;
+    }
+    const uint64_t received =
+        vktrace_RecvBuffer_Receive(pStream, pBuffer->data + pBuffer->end, _len - available, pBuffer->size - pBuffer->end);
+    pBuffer->end += received;
+    return received > 0;
+}
+
+BOOL vktrace_RecvBuffer_Recv(MessageStream* pStream, void* _out, uint64_t _len) {
+    RecvBuffer* pBuffer = pStream->mRecvBuffer;
+    uint8_t* out = (uint8_t*)_out;
+    // Bytes only peeked at are received again
+    pBuffer->inPlaceSize = 0;
+    while (_len > 0) {
+        if (pBuffer->begin == pBuffer->end) {
+            if (_len >= pBuffer->size) {
+                // Too large for the buffer, receive it where it goes
+                return vktrace_RecvBuffer_Receive(pStream, out, _len, _len) == _len;
+            }
+            if (!vktrace_RecvBuffer_Fill(pStream, 1)) {
+                return FALSE;
+            }
+        }
+        uint64_t chunk = pBuffer->end - pBuffer->begin;
+        if (chunk > _len) {
+            chunk = _len;
+        }
+        memcpy(out, pBuffer->data + pBuffer->begin, (size_t)chunk);
+        pBuffer->begin += chunk;
+        out += chunk;
+        _len -= chunk;
+    }
+    return TRUE;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Sent by the layer right after the handshake, answered by the server with 1 if it mapped the ring, 0 otherwise.
+BOOL vktrace_MessageStream_NegotiateTransport(MessageStream* pStream) {
+    SharedRingOffer offer;
+    uint32_t accepted = 0;
+    memset(&offer, 0, sizeof(offer));
+    if (pStream->mHost) {
+        if (!vktrace_MessageStream_BlockingRecv(pStream, &offer, sizeof(offer))) {
+            return FALSE;
+        }
+        if (offer.magic != VKTRACE_RING_MAGIC || offer.version != VKTRACE_RING_VERSION) {
+            vktrace_LogError("Host: Unexpected transport offer. Are vktrace and trace layer the same version?");
+            return FALSE;
+        }
+#if defined(VKTRACE_SHARED_RING)
+        if (offer.pid != 0 && pStream->mTransport == VKTRACE_TRANSPORT_AUTO) {
+            pStream->mRing = vktrace_SharedRing_open(&offer);
+        }
+#endif
+        accepted = pStream->mRing != NULL;
+        if (!vktrace_MessageStream_Send(pStream, &accepted, sizeof(accepted))) {
+            return FALSE;
+        }
+    } else {
+        offer.magic = VKTRACE_RING_MAGIC;
+        offer.version = VKTRACE_RING_VERSION;
+#if defined(VKTRACE_SHARED_RING)
+        SharedRing* pRing = pStream->mTransport == VKTRACE_TRANSPORT_AUTO ? vktrace_SharedRing_create(VKTRACE_RING_DATA_SIZE) : NULL;
+        if (pRing != NULL) {
+            offer.pid = getpid();
+            offer.fd = pRing->fd;
+            offer.dataSize = pRing->dataSize;
+            memcpy(offer.token, pRing->header->token, sizeof(offer.token));
+        }
+#endif
+        if (!vktrace_MessageStream_Send(pStream, &offer, sizeof(offer)) ||
+            !vktrace_MessageStream_BlockingRecv(pStream, &accepted, sizeof(accepted))) {
+#if defined(VKTRACE_SHARED_RING)
+            if (pRing != NULL) {
+                vktrace_SharedRing_destroy(&pRing);
+            }
+#endif
+            return FALSE;
+        }
+#if defined(VKTRACE_SHARED_RING)
+        if (accepted) {
+            pStream->mRing = pRing;
+        } else if (pRing != NULL) {
+            vktrace_SharedRing_destroy(&pRing);
+        }
+#endif
+    }
+    vktrace_LogVerbose("%s: Sending packets through %s.", pStream->mHost ? "Host" : "Client",
+                       pStream->mRing != NULL ? "a shared memory ring" : "the socket");
+    return TRUE;
+}
+
+// ------------------------------------------------------------------------------------------------
+uint64_t vktrace_MessageStream_InPlaceCapacity(MessageStream* pStream) {
+#if defined(VKTRACE_SHARED_RING)
+    if (pStream->mRing != NULL && pStream->mHost) {
+        return pStream->mRing->dataSize;
+    }
+#endif
+    return pStream->mRecvBuffer != NULL ? pStream->mRecvBuffer->size : 0;
+}
+
+const void* vktrace_MessageStream_PeekInPlace(MessageStream* pStream, uint64_t _len) {
+    RecvBuffer* pBuffer = pStream->mRecvBuffer;
+    if (pBuffer != NULL) {
+        if (!vktrace_RecvBuffer_Fill(pStream, _len)) {
+            return NULL;
+        }
+        pBuffer->inPlaceSize = _len;
+        return pBuffer->data + pBuffer->begin;
+    }
+#if defined(VKTRACE_SHARED_RING)
+    SharedRing* pRing = pStream->mRing;
+    assert(pRing != NULL && _len <= pRing->dataSize);
+    if (!vktrace_SharedRing_WaitForData(pStream, _len)) {
+        return NULL;
+    }
+    pRing->inPlaceSize = _len;
+    return pRing->data + (pRing->header->tail & (pRing->dataSize - 1));
+#else
+    return NULL;
+#endif
+}
+
+void vktrace_MessageStream_ReleaseInPlace(MessageStream* pStream) {
+    RecvBuffer* pBuffer = pStream->mRecvBuffer;
+    if (pBuffer != NULL) {
+        pBuffer->begin += pBuffer->inPlaceSize;
+        pBuffer->inPlaceSize = 0;
+    }
+#if defined(VKTRACE_SHARED_RING)
+    SharedRing* pRing = pStream->mRing;
+    if (pRing != NULL && pRing->inPlaceSize > 0) {
+        vktrace_SharedRing_Consume(pRing, pRing->inPlaceSize);
+        pRing->inPlaceSize = 0;
+    }
+#endif
+}
+
+BOOL vktrace_MessageStream_IsInPlace(MessageStream* pStream, const void* _bytes) {
+    RecvBuffer* pBuffer = pStream->mRecvBuffer;
+    if (pBuffer != NULL) {
+        return (const uint8_t*)_bytes >= pBuffer->data && (const uint8_t*)_bytes < pBuffer->data + pBuffer->size;
+    }
+#if defined(VKTRACE_SHARED_RING)
+    SharedRing* pRing = pStream->mRing;
+    return pRing != NULL && (const uint8_t*)_bytes >= pRing->data && (const uint8_t*)_bytes < pRing->data + 2 * pRing->dataSize;
+#else
+    return FALSE;
+#endif
+}
+
+BOOL vktrace_MessageStream_HasReceivedData(MessageStream* pStream) {
+    RecvBuffer* pBuffer = pStream->mRecvBuffer;
+    if (pBuffer != NULL) {
+        return pBuffer->end - pBuffer->begin > pBuffer->inPlaceSize;
+    }
+#if defined(VKTRACE_SHARED_RING)
+    SharedRing* pRing = pStream->mRing;
+    if (pRing != NULL && pStream->mHost) {
+        return __atomic_load_n(&pRing->header->head, __ATOMIC_ACQUIRE) - pRing->header->tail > pRing->inPlaceSize;
+    }
+#endif
+    return FALSE;
+}
+
 // ------------------------------------------------------------------------------------------------
 // ------------------------------------------------------------------------------------------------
 // ------------------------------------------------------------------------------------------------
@@ -49,6 +49,18 @@ static const unsigned int VKTRACE_BASE_PORT = 34199;
 struct SSerializeDataPacket;
 
 struct SimpleBuffer;
+struct SharedRing;
+struct RecvBuffer;
+
+// How the trace layer sends packets to the vktrace server.
+typedef enum VKTRACE_TRANSPORT {
+    // The layer offers a shared memory ring after connecting. The server maps it if both are on the same Linux host, so
+    // packets are copied once into the ring instead of going through the socket, which is only kept to notice the
+    // disconnection. Otherwise both keep using the socket.
+    VKTRACE_TRANSPORT_AUTO = 0,
+    // Always use the socket
+    VKTRACE_TRANSPORT_TCP = 1,
+} VKTRACE_TRANSPORT;
 
 // ------------------------------------------------------------------------------------------------
 // ------------------------------------------------------------------------------------------------
@@ -69,13 +81,20 @@ typedef struct MessageStream {
 
     BOOL mHost;
     int mErrorNum;
+
+    VKTRACE_TRANSPORT mTransport;
+    // Shared memory ring the packets go through instead of mSocket, NULL if the socket is used
+    struct SharedRing* mRing;
+    // Buffer the host receives the socket into and parses the packets from, NULL if the ring is used
+    struct RecvBuffer* mRecvBuffer;
 } MessageStream;
 
 #if defined(__cplusplus)
 extern "C" {
 #endif
-MessageStream* vktrace_MessageStream_create_port_string(BOOL _isHost, const char* _address, const char* _port);
-MessageStream* vktrace_MessageStream_create(BOOL _isHost, const char* _address, unsigned int _port);
+MessageStream* vktrace_MessageStream_create_port_string(BOOL _isHost, const char* _address, const char* _port,
+                                                       VKTRACE_TRANSPORT _transport);
+MessageStream* vktrace_MessageStream_create(BOOL _isHost, const char* _address, unsigned int _port, VKTRACE_TRANSPORT _transport);
 BOOL vktrace_MessageStream_SetupHostSocket(MessageStream* pStream);
 void vktrace_MessageStream_destroy(MessageStream** ppStream);
 BOOL vktrace_MessageStream_BufferedSend(MessageStream* pStream, const void* _bytes, uint64_t _size, BOOL _optional);
@@ -84,6 +103,19 @@ BOOL vktrace_MessageStream_Send(MessageStream* pStream, const void* _bytes, uint
 BOOL vktrace_MessageStream_Recv(MessageStream* pStream, void* _out, uint64_t _len);
 BOOL vktrace_MessageStream_BlockingRecv(MessageStream* pStream, void* _outBuffer, uint64_t _len);
 
+// Receiving in place from the shared memory ring or the receive buffer of the host, without copying. Returns the largest
+// number of bytes which can be received in place at once, 0 if the stream has neither.
+uint64_t vktrace_MessageStream_InPlaceCapacity(MessageStream* pStream);
+// Waits for the next _len bytes and returns them in the ring, without consuming them. Returns NULL if the connection was
+// closed first.
+const void* vktrace_MessageStream_PeekInPlace(MessageStream* pStream, uint64_t _len);
+// Consumes the bytes returned by the last vktrace_MessageStream_PeekInPlace()
+void vktrace_MessageStream_ReleaseInPlace(MessageStream* pStream);
+// TRUE if _bytes points into the ring or the receive buffer
+BOOL vktrace_MessageStream_IsInPlace(MessageStream* pStream, const void* _bytes);
+// TRUE if more bytes than the ones peeked at have already been received, so the next read won't wait
+BOOL vktrace_MessageStream_HasReceivedData(MessageStream* pStream);
+
 extern MessageStream* gMessageStream;
 #if defined(__cplusplus)
 }
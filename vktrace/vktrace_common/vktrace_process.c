@@ -22,6 +22,40 @@
  **************************************************************************/
 #include "vktrace_process.h"
 
+#if defined(PLATFORM_LINUX)
+// Splits 'str' in place into at most 'maxArgs' arguments at spaces and tabs, except inside double quotes, which are
+// removed, as CreateProcess() does on Windows. Returns the count of arguments.
+static unsigned int vktrace_process_split_args(char* str, char** args, unsigned int maxArgs) {
+    unsigned int count = 0;
+    char* in = str;
+    while (count < maxArgs) {
+        char* out;
+        BOOL quoted = FALSE;
+        while (*in == ' ' || *in == '\t') {
+            in++;
+        }
+        if (*in == '\0') {
+            break;
+        }
+        out = in;
+        args[count++] = out;
+        while (*in != '\0' && (quoted || (*in != ' ' && *in != '\t'))) {
+            if (*in == '"') {
+                quoted = !quoted;
+            } else {
+                *out++ = *in;
+            }
+            in++;
+        }
+        if (*in != '\0') {
+            in++;
+        }
+        *out = '\0';
+    }
+    return count;
+}
+#endif
+
 BOOL vktrace_process_spawn(vktrace_process_info* pInfo) {
     assert(pInfo != NULL);
 
@@ -62,7 +96,6 @@ BOOL vktrace_process_spawn(vktrace_process_info* pInfo) {
     } else if (pInfo->processId == 0) {
         // Inside new process
         char* args[128];
-        const char delim[] = " \t";
         unsigned int idx;
 
         realpath(pInfo->exeName, fullExePath);
@@ -78,13 +111,11 @@ BOOL vktrace_process_spawn(vktrace_process_info* pInfo) {
         }
 
         args[0] = fullExePath;
-        args[127] = NULL;
         idx = 1;
-        args[idx] = pInfo->processArgs ? strtok(pInfo->processArgs, delim) : NULL;
-        while (args[idx] != NULL && idx < 128) {
-            idx++;
-            args[idx] = strtok(NULL, delim);
+        if (pInfo->processArgs != NULL) {
+            idx += vktrace_process_split_args(pInfo->processArgs, &args[1], 126);
         }
+        args[idx] = NULL;
         vktrace_LogDebug("exec process=%s argc=%u\n", fullExePath, idx);
 #if 0  // uncoment to print out list of env vars
         char *env = environ[0];
@@ -99,6 +99,10 @@ typedef struct vkreplayer_settings {
     unsigned int instrumentationDelay;
     unsigned int preloadChunkSize;
     unsigned int skipGetFenceStatus;
+    char* cpuProfile;
+    char* screenshotEncoding;
+    unsigned int screenshotHashTile;
+    char* libcollectorConfig;
 } vkreplayer_settings;
 
 int vktrace_SettingGroup_init(vktrace_SettingGroup* pSettingGroup, FILE* pSettingsFile, int argc, char* argv[],
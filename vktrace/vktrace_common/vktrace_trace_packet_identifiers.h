@@ -47,6 +47,7 @@ typedef enum VKTRACE_TRACER_ID {
     VKTRACE_TID_GL_FPS,
     VKTRACE_TID_VULKAN,
     VKTRACE_TID_VULKAN_COMPRESSED,
+    VKTRACE_TID_VULKAN_BLOB_REF,
     // Max enum must be less than VKTRACE_MAX_TRACER_ID_ARRAY_SIZE
 } VKTRACE_TRACER_ID;
 
@@ -63,7 +64,7 @@ static const VKTRACE_TRACER_REPLAYER_INFO gs_tracerReplayerInfo[VKTRACE_MAX_TRAC
     {VKTRACE_TID_GL_FPS, FALSE, "", ""},
     {VKTRACE_TID_VULKAN, TRUE, VKTRACE_LIBRARY_NAME(vulkan_replay), VKTRACE_LIBRARY_NAME(vktraceviewer_vk)},
     {VKTRACE_TID_VULKAN_COMPRESSED, TRUE, VKTRACE_LIBRARY_NAME(vulkan_replay), VKTRACE_LIBRARY_NAME(vktraceviewer_vk)},
-    {VKTRACE_TID_RESERVED, FALSE, "", ""},  // this can be updated as new tracers are added
+    {VKTRACE_TID_VULKAN_BLOB_REF, TRUE, VKTRACE_LIBRARY_NAME(vulkan_replay), VKTRACE_LIBRARY_NAME(vktraceviewer_vk)},
     {VKTRACE_TID_RESERVED, FALSE, "", ""},  // this can be updated as new tracers are added
     {VKTRACE_TID_RESERVED, FALSE, "", ""},  // this can be updated as new tracers are added
     {VKTRACE_TID_RESERVED, FALSE, "", ""},  // this can be updated as new tracers are added
@@ -475,7 +476,7 @@ typedef enum _VKTRACE_TRACE_PACKET_ID_VK {
     VKTRACE_TPI_VK_vkCmdCopyBufferRemapAS = 0xFFEF,             // non-standard API derived from vkCmdCopyBuffer
     VKTRACE_TPI_VK_vkCmdCopyBufferRemapASandBuffer = 0xFFF0,    // non-standard API derived from vkCmdCopyBuffer
     VKTRACE_TPI_META_DATA = 0xFFF1,
-    VKTRACE_TPI_RESERVED_ID_1 = 0xFFF2,
+    VKTRACE_TPI_BLOCK_TABLE = 0xFFF2,
     VKTRACE_TPI_RESERVED_ID_2 = 0xFFF3,
     VKTRACE_TPI_RESERVED_ID_3 = 0xFFF4,
     // Reserved ID for the special packets
@@ -518,7 +519,8 @@ typedef enum VKTRACE_TRACER_FEATURE {
 } VKTRACE_TRACER_FEATURE;
 
 typedef enum VKTRACE_FILE_HEADER_FLAG {
-    VKTRACE_USE_ACCELERATION_STRUCTURE_API_BIT        = 0x1
+    VKTRACE_USE_ACCELERATION_STRUCTURE_API_BIT        = 0x1,
+    VKTRACE_USE_BLOB_REFERENCES_BIT                   = 0x2
 } VKTRACE_FILE_HEADER_FLAG;
 
 typedef struct _deviceFeatureSupport{
@@ -547,8 +549,10 @@ typedef struct {
     ALIGN8 uint64_t arch;
     ALIGN8 uint64_t os;
 
+    ALIGN8 uint64_t block_table_offset;  // file offset of the VKTRACE_TPI_BLOCK_TABLE packet, 0 if there is none
+    ALIGN8 uint64_t last_frame_offset;   // file offset of the last VKTRACE_TPI_MARKER_API_BOUNDARY packet, 0 if there is none
     // Reserve some spaece in case more fields need to be added in the future
-    ALIGN8 uint64_t reserved2[5];
+    ALIGN8 uint64_t reserved2[3];
     ALIGN8 uint64_t meta_data_offset;
     ALIGN8 uint64_t enabled_tracer_features;
     ALIGN8 uint64_t decompress_file_size;
@@ -578,6 +582,51 @@ typedef struct {
     ALIGN8 uintptr_t pBody;             // points to the compressed packet data
 } vktrace_trace_packet_header_compression_ext;
 
+// A packet with tracer_id VKTRACE_TID_VULKAN_BLOB_REF had a large payload which is byte-identical to one already
+// written earlier in the file. The payload is dropped and this structure follows the packet header instead, then the
+// packet bytes before and after the payload. Blob reference packets are never compressed.
+typedef struct {
+    ALIGN8 uint64_t original_size;         // size of the packet once the payload is restored
+    ALIGN8 uint64_t blob_offset;           // offset of the payload from the start of the restored packet
+    ALIGN8 uint64_t blob_size;
+    ALIGN8 uint64_t source_packet_offset;  // file offset of the packet holding the first occurrence of the payload
+    ALIGN8 uint64_t source_blob_offset;    // offset of the payload from the start of that (decompressed) packet
+} vktrace_trace_packet_header_blob_ext;
+
+// The body of the VKTRACE_TPI_BLOCK_TABLE packet, written before the portability table. The packets from data_offset to
+// data_offset + data_size are split in blocks of block_size bytes (the last one can be shorter), each with a CRC32C, so
+// that a reader can check them in parallel and carry on after a corrupted block. A vktrace_trace_block_entry per block
+// follows this structure.
+typedef struct {
+    ALIGN8 uint64_t block_size;
+    ALIGN8 uint64_t data_offset;  // first_packet_offset
+    ALIGN8 uint64_t data_size;    // up to the meta data, which is rewritten at the end of the capture
+    ALIGN8 uint64_t block_count;
+    uint32_t entries_crc32c;      // CRC32C of the entries
+    uint32_t reserved;
+} vktrace_trace_block_table;
+
+typedef struct {
+    ALIGN8 uint64_t packet_offset;  // file offset of the first packet which starts in the block, 0 if none does
+    ALIGN8 uint64_t packet_index;   // global_packet_index of that packet
+    uint32_t crc32c;
+    uint32_t reserved;
+} vktrace_trace_block_entry;
+
+// The body of the VKTRACE_TPI_MARKER_API_BOUNDARY packet which the layer writes after each vkQueuePresentKHR. The layer only
+// sets the frame number, vktrace fills in the rest as it writes the packets of the frame, so that the frames and what they
+// cost to capture can be listed from these packets alone. previous_offset chains them back from last_frame_offset.
+typedef struct {
+    ALIGN8 uint64_t frame_number;        // frame of the application which the present ends
+    ALIGN8 uint64_t first_packet_index;  // global_packet_index of the first packet of the frame
+    ALIGN8 uint64_t packet_count;        // packets of the frame, the present included
+    ALIGN8 uint64_t packet_bytes;        // their size as captured
+    ALIGN8 uint64_t written_bytes;       // their size in the file, after deduplication and compression
+    ALIGN8 uint64_t tracer_overhead;     // ns spent by the layer around the calls of the frame
+    ALIGN8 uint64_t frame_offset;        // file offset of the first packet of the frame
+    ALIGN8 uint64_t previous_offset;     // file offset of the previous frame boundary, 0 for the first one
+} vktrace_trace_packet_frame_boundary;
+
 typedef struct {
     vktrace_trace_packet_header* pHeader;
     VktraceLogLevel type;
@@ -591,7 +640,6 @@ typedef struct {
     char* label;
 } vktrace_trace_packet_marker_checkpoint;
 
-typedef vktrace_trace_packet_marker_checkpoint vktrace_trace_packet_marker_api_boundary;
 typedef vktrace_trace_packet_marker_checkpoint vktrace_trace_packet_marker_api_group_begin;
 typedef vktrace_trace_packet_marker_checkpoint vktrace_trace_packet_marker_api_group_end;
 
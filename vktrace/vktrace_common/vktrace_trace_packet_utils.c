@@ -613,6 +613,41 @@ vktrace_trace_packet_header* vktrace_read_trace_packet(FileLike* pFile) {
     return pHeader;
 }
 
+vktrace_trace_packet_header* vktrace_read_trace_packet_in_place(FileLike* pFile) {
+    MessageStream* pStream = pFile->mMode == Socket ? pFile->mMessageStream : NULL;
+    uint64_t capacity = pStream != NULL ? vktrace_MessageStream_InPlaceCapacity(pStream) : 0;
+    if (capacity == 0) {
+        return vktrace_read_trace_packet(pFile);
+    }
+
+    const uint64_t* pSize = (const uint64_t*)vktrace_MessageStream_PeekInPlace(pStream, sizeof(uint64_t));
+    if (pSize == NULL) {
+        return NULL;
+    }
+    uint64_t total_packet_size = *pSize;
+    if (total_packet_size < sizeof(vktrace_trace_packet_header) || total_packet_size > capacity) {
+        // Too large to be received in place at once, it is copied out in pieces
+        return vktrace_read_trace_packet(pFile);
+    }
+
+    vktrace_trace_packet_header* pHeader =
+        (vktrace_trace_packet_header*)vktrace_MessageStream_PeekInPlace(pStream, total_packet_size);
+    if (pHeader != NULL) {
+        pHeader->pBody = (uintptr_t)pHeader + sizeof(vktrace_trace_packet_header);
+    }
+    return pHeader;
+}
+
+void vktrace_release_trace_packet(FileLike* pFile, vktrace_trace_packet_header** ppHeader) {
+    if (pFile->mMode == Socket) {
+        if (*ppHeader != NULL && vktrace_MessageStream_IsInPlace(pFile->mMessageStream, *ppHeader)) {
+            *ppHeader = NULL;
+        }
+        vktrace_MessageStream_ReleaseInPlace(pFile->mMessageStream);
+    }
+    vktrace_delete_trace_packet_no_lock(ppHeader);
+}
+
 uint32_t vktrace_get_trace_packet_tag(const vktrace_trace_packet_header* pHeader) {
     const uint32_t tag_word_size = sizeof(uint32_t);
     uint64_t offset_to_tag_word = pHeader->size - tag_word_size;
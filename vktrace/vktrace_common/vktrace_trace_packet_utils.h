@@ -48,19 +48,25 @@ uint64_t get_os();
 
 char* find_available_filename(const char* originalFilename, BOOL bForceOverwrite);
 deviceFeatureSupport query_device_feature(PFN_vkGetPhysicalDeviceFeatures2KHR GetPhysicalDeviceFeatures, VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo *pCreateInfo);
-static FILE* vktrace_open_trace_file(vktrace_process_capture_trace_thread_info* trace_thread_info) {
+// 'pFileName', if not NULL, receives the name of the file opened, to be freed with vktrace_free()
+static FILE* vktrace_open_trace_file(vktrace_process_capture_trace_thread_info* trace_thread_info, char** pFileName) {
     FILE* tracefp = NULL;
     assert(trace_thread_info != NULL);
 
     // open trace file
+    char* process_trace_file_name = NULL;
     if (trace_thread_info->pProcessInfo->traceFileCriticalSectionCreated)
     {
-        char* process_trace_file_name = find_available_filename(trace_thread_info->pProcessInfo->traceFilename, true);
-        assert(process_trace_file_name != NULL);
-        tracefp = fopen(process_trace_file_name, "w+b");
-        vktrace_free(process_trace_file_name);
+        process_trace_file_name = find_available_filename(trace_thread_info->pProcessInfo->traceFilename, true);
+    } else {
+        process_trace_file_name = vktrace_allocate_and_copy(trace_thread_info->pProcessInfo->traceFilename);
+    }
+    assert(process_trace_file_name != NULL);
+    tracefp = fopen(process_trace_file_name, "w+b");
+    if (pFileName != NULL && tracefp != NULL) {
+        *pFileName = process_trace_file_name;
     } else {
-        tracefp = fopen(trace_thread_info->pProcessInfo->traceFilename, "w+b");
+        vktrace_free(process_trace_file_name);
     }
 
     if (tracefp == NULL) {
@@ -152,6 +158,15 @@ void vktrace_tag_trace_packet(vktrace_trace_packet_header* pHeader, uint32_t tag
 // Reads in the trace packet header, the body of the packet, and additional buffers
 vktrace_trace_packet_header* vktrace_read_trace_packet(FileLike* pFile);
 
+// Like vktrace_read_trace_packet(), but when reading from the socket, returns the packet where it was received (in the shared
+// memory ring or the receive buffer of the host) instead of copying it. The packet must not be freed, and must be released with
+// vktrace_release_trace_packet() before reading the next one.
+vktrace_trace_packet_header* vktrace_read_trace_packet_in_place(FileLike* pFile);
+
+// Frees a packet returned by vktrace_read_trace_packet_in_place(), or gives its space in the ring or the receive buffer back.
+// Sets the pointer to NULL.
+void vktrace_release_trace_packet(FileLike* pFile, vktrace_trace_packet_header** ppHeader);
+
 // Get the trace packet tag
 uint32_t vktrace_get_trace_packet_tag(const vktrace_trace_packet_header* pHeader);
 
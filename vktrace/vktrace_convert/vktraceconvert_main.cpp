@@ -0,0 +1,442 @@
+/*
+ * (C) COPYRIGHT 2020 ARM Limited
+ * ALL RIGHTS RESERVED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "vktrace_common.h"
+#include "vktrace_tracelog.h"
+#include "vktrace_filelike.h"
+#include "vktrace_trace_packet_utils.h"
+#include "vktrace_vk_packet_id.h"
+#include "decompressor.h"
+#include "blobstore.h"
+#include "tracereader.h"
+
+#include "vktraceconvert_main.h"
+
+using namespace std;
+
+struct vktraceconvert_params {
+    const char* inputFile = NULL;
+    const char* outputFile = NULL;
+    uint32_t threads = 1;
+} g_params;
+
+// Bytes of trace converted at once by a thread
+const uint64_t PART_SIZE = 16 * 1024 * 1024;
+
+static void print_usage() {
+    cout << "vktraceconvert available options:" << endl;
+    cout << "    -i <inputTrace>       The 32-bit trace file to convert" << endl;
+    cout << "    -o <outputTrace>      The 64-bit trace file to write" << endl;
+    cout << "    -j <threads>          (Optional) Convert on <threads> threads, at most one per CPU, 0 for one per CPU. The output is the same as with "
+            "one thread. (Default is 1)"
+         << endl;
+}
+
+static int parse_args(int argc, char** argv) {
+    for (int i = 1; i < argc;) {
+        string arg(argv[i]);
+        if (arg.compare("-i") == 0 && i + 1 < argc) {
+            g_params.inputFile = argv[i + 1];
+            i = i + 2;
+        } else if (arg.compare("-o") == 0 && i + 1 < argc) {
+            g_params.outputFile = argv[i + 1];
+            i = i + 2;
+        } else if (arg.compare("-j") == 0 && i + 1 < argc) {
+            if (!parse_thread_count(argv[i + 1], g_params.threads)) {
+                return -1;
+            }
+            i = i + 2;
+        } else if (arg.compare("-h") == 0) {
+            print_usage();
+            exit(0);
+        } else {
+            return -1;
+        }
+    }
+    if (g_params.inputFile == NULL || g_params.outputFile == NULL) {
+        return -1;
+    }
+    return 0;
+}
+
+// The packets of the tracer itself, with their 32-bit layout
+typedef struct vktrace_trace_packet_message_32 {
+    uint32_t pHeader;
+    VktraceLogLevel type;
+    uint32_t length;
+    uint32_t message;
+} vktrace_trace_packet_message_32;
+
+typedef struct vktrace_trace_packet_marker_32 {
+    uint32_t pHeader;
+    unsigned int length;
+    uint32_t label;
+} vktrace_trace_packet_marker_32;
+
+static bool convert_tracer_packet(vkconvert_packet& p) {
+    switch (p.packet_id()) {
+        case VKTRACE_TPI_MESSAGE: {
+            const vktrace_trace_packet_message_32* in = p.in<vktrace_trace_packet_message_32>(0);
+            if (in == NULL) {
+                return false;
+            }
+            uint64_t out = p.begin(sizeof(vktrace_trace_packet_message));
+            vktrace_trace_packet_message* o = p.out<vktrace_trace_packet_message>(out);
+            o->type = in->type;
+            o->length = in->length;
+            vkconvert_set(o->message, p.rebase(in->message));
+            return true;
+        }
+        case VKTRACE_TPI_MARKER_CHECKPOINT:
+        case VKTRACE_TPI_MARKER_API_GROUP_BEGIN:
+        case VKTRACE_TPI_MARKER_API_GROUP_END: {
+            const vktrace_trace_packet_marker_32* in = p.in<vktrace_trace_packet_marker_32>(0);
+            if (in == NULL) {
+                return false;
+            }
+            uint64_t out = p.begin(sizeof(vktrace_trace_packet_marker_checkpoint));
+            vktrace_trace_packet_marker_checkpoint* o = p.out<vktrace_trace_packet_marker_checkpoint>(out);
+            o->length = in->length;
+            vkconvert_set(o->label, p.rebase(in->label));
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+// A part of the trace converted by one thread: the packets from 'startOffset' to 'endOffset'
+struct convert_part {
+    uint64_t startOffset = 0;
+    uint64_t endOffset = 0;
+    vector<uint8_t> output;
+    // Where the packets which the file header or the portability table refer to are in 'output'
+    vector<pair<uint64_t, uint64_t>> offsets;
+    uint64_t packets = 0;
+    uint64_t rawPointers = 0;
+    uint64_t droppedStructs = 0;
+    set<int32_t> droppedTypes;
+    map<uint16_t, uint64_t> copied;  // packets which can't be converted and are copied as they are, by id
+};
+
+static int convert_part_packets(trace_reader& reader, convert_part& part, const vector<uint64_t>& referenced) {
+    if (!vktrace_FileLike_SetCurrentPosition(reader.file, part.startOffset)) {
+        return -1;
+    }
+    vkconvert_packet p;
+    uint64_t offset = part.startOffset;
+    int ret = 0;
+    while (offset < part.endOffset) {
+        vktrace_trace_packet_header* packet = read_packet(reader, ret);
+        if (!packet) {
+            vktrace_LogError("Failed to read the packet at %" PRIu64 ".", offset);
+            return -1;
+        }
+
+        if (binary_search(referenced.begin(), referenced.end(), offset)) {
+            part.offsets.push_back(make_pair(offset, (uint64_t)part.output.size()));
+        }
+        p.reset(packet);
+        bool converted = packet->packet_id != VKTRACE_TPI_PORTABILITY_TABLE && (convert_packet(p) || convert_tracer_packet(p));
+        if (p.failed()) {
+            vktrace_LogError("Packet %" PRIu64 " at %" PRIu64 " can't be converted, the lengths or pNext chains in it are invalid.",
+                             packet->global_packet_index, offset);
+            vktrace_delete_trace_packet_no_lock(&packet);
+            return -1;
+        }
+        if (packet->packet_id == VKTRACE_TPI_PORTABILITY_TABLE) {
+            // Written again at the end with the new offsets
+        } else if (packet->packet_id == VKTRACE_TPI_BLOCK_TABLE) {
+            // The checksums are of the 32-bit packets, the converted trace has no block table
+        } else if (packet->packet_id == VKTRACE_TPI_MARKER_API_BOUNDARY &&
+                   packet->size >= sizeof(vktrace_trace_packet_header) + sizeof(vktrace_trace_packet_frame_boundary)) {
+            // The frame boundaries have no pointers, but the offsets in them are of the 32-bit trace
+            size_t start = part.output.size();
+            part.output.insert(part.output.end(), (const uint8_t*)packet, (const uint8_t*)packet + packet->size);
+            ((vktrace_trace_packet_header*)&part.output[start])->pBody = 0;
+            vktrace_trace_packet_frame_boundary* pFrame =
+                (vktrace_trace_packet_frame_boundary*)&part.output[start + sizeof(vktrace_trace_packet_header)];
+            pFrame->frame_offset = 0;
+            pFrame->previous_offset = 0;
+        } else if (converted) {
+            p.finish(part.output);
+        } else {
+            // The meta data is JSON, the other packets have no pointers or are not known
+            if (packet->packet_id != VKTRACE_TPI_META_DATA && packet->packet_id != VKTRACE_TPI_MARKER_TERMINATE_PROCESS) {
+                part.copied[packet->packet_id]++;
+            }
+            size_t start = part.output.size();
+            part.output.insert(part.output.end(), (const uint8_t*)packet, (const uint8_t*)packet + packet->size);
+            ((vktrace_trace_packet_header*)&part.output[start])->pBody = 0;
+        }
+        part.packets++;
+        vktrace_delete_trace_packet_no_lock(&packet);
+        offset = vktrace_FileLike_GetCurrentPosition(reader.file);
+    }
+    part.rawPointers = p.rawPointers;
+    part.droppedStructs = p.droppedStructs;
+    part.droppedTypes = p.droppedTypes;
+    return ret;
+}
+
+// The file offsets of the packets the portability table refers to and the header of the table, read from the end of the
+// trace
+static bool read_portability_table(FileLike* file, vector<uint64_t>& table, vktrace_trace_packet_header& header) {
+    uint64_t tableSize = 0;
+    if (!vktrace_FileLike_SetCurrentPosition(file, file->mFileLen - sizeof(uint64_t)) ||
+        !vktrace_FileLike_ReadRaw(file, &tableSize, sizeof(uint64_t)) || tableSize >= file->mFileLen / sizeof(uint64_t)) {
+        return false;
+    }
+    table.resize((size_t)tableSize);
+    if (tableSize != 0 && (!vktrace_FileLike_SetCurrentPosition(file, file->mFileLen - (tableSize + 1) * sizeof(uint64_t)) ||
+                           !vktrace_FileLike_ReadRaw(file, &table[0], sizeof(uint64_t) * tableSize))) {
+        return false;
+    }
+    uint64_t headerOffset = (tableSize + 1) * sizeof(uint64_t) + sizeof(header);
+    return headerOffset <= file->mFileLen && vktrace_FileLike_SetCurrentPosition(file, file->mFileLen - headerOffset) &&
+           vktrace_FileLike_ReadRaw(file, &header, sizeof(header)) && header.packet_id == VKTRACE_TPI_PORTABILITY_TABLE;
+}
+
+struct convert_summary {
+    uint64_t packets = 0;
+    uint64_t rawPointers = 0;
+    uint64_t droppedStructs = 0;
+    set<int32_t> droppedTypes;
+    map<uint16_t, uint64_t> copied;
+};
+
+// Converts the packets from 'offset' to the end of the trace on g_params.threads threads and writes them to 'output'. The
+// main thread scans the packet headers to split the trace in parts of about PART_SIZE bytes, the parts are converted by
+// the other threads into buffers which are written in order. 'remap' gets the new offsets of the 'referenced' packets.
+static int convert_parallel(const char* tracePath, const vktrace_trace_file_header& fileHeader, FileLike* traceFile,
+                            uint64_t offset, FILE* output, const vector<uint64_t>& referenced,
+                            unordered_map<uint64_t, uint64_t>& remap, convert_summary& summary) {
+    auto convert = [&](trace_reader& reader, convert_part& part) { return convert_part_packets(reader, part, referenced); };
+    ordered_part_writer<convert_part> writer(g_params.threads, tracePath, fileHeader, convert, [&](convert_part& part, bool) {
+        uint64_t position = (uint64_t)Ftell(output);
+        for (const pair<uint64_t, uint64_t>& o : part.offsets) {
+            remap[o.first] = position + o.second;
+        }
+        bool ok = part.output.empty() || fwrite(part.output.data(), 1, part.output.size(), output) == part.output.size();
+        summary.packets += part.packets;
+        summary.rawPointers += part.rawPointers;
+        summary.droppedStructs += part.droppedStructs;
+        summary.droppedTypes.insert(part.droppedTypes.begin(), part.droppedTypes.end());
+        for (const pair<const uint16_t, uint64_t>& c : part.copied) {
+            summary.copied[c.first] += c.second;
+        }
+        vector<uint8_t>().swap(part.output);
+        if (!ok) {
+            vktrace_LogError("Failed to write the converted trace.");
+        }
+        return ok;
+    });
+
+    int ret = 0;
+    writer.add().startOffset = offset;
+    while (!writer.failed()) {
+        vktrace_trace_packet_header header;
+        if (!vktrace_FileLike_SetCurrentPosition(traceFile, offset) || !vktrace_FileLike_ReadRaw(traceFile, &header, sizeof(header))) {
+            break;
+        }
+        if (header.size < sizeof(header) || header.size > traceFile->mFileLen - offset) {
+            vktrace_LogError("Invalid packet size %" PRIu64 " at %" PRIu64 ".", header.size, offset);
+            ret = -1;
+            break;
+        }
+        offset += header.size;
+        if (offset - writer.back().startOffset >= PART_SIZE) {
+            writer.back().endOffset = offset;
+            writer.ready();
+            writer.add().startOffset = offset;
+        }
+    }
+    writer.back().endOffset = offset;
+    writer.ready();
+    return writer.finish(ret);
+}
+
+int main(int argc, char** argv) {
+    if (parse_args(argc, argv) < 0) {
+        cout << "Error: invalid parameters!" << endl;
+        print_usage();
+        return -1;
+    }
+
+    FILE* tracefp = fopen(g_params.inputFile, "rb");
+    if (tracefp == NULL) {
+        cout << "Error: Open trace file \"" << g_params.inputFile << "\" fail !" << endl;
+        return -1;
+    }
+
+    // Decompress trace file if it is a gz file.
+    const char* tracePath = g_params.inputFile;
+    if (vktrace_File_IsCompressed(tracefp)) {
+#if defined(ANDROID)
+        tracePath = "/sdcard/tmp.vktrace";
+#elif defined(PLATFORM_LINUX)
+        tracePath = "/tmp/tmp.vktrace";
+#else
+        tracePath = "tmp.vktrace";
+#endif
+        // Close the fp for the gz file and open the decompressed file.
+        fclose(tracefp);
+        if (!vktrace_File_Decompress(g_params.inputFile, tracePath)) {
+            return -1;
+        }
+        tracefp = fopen(tracePath, "rb");
+        if (tracefp == NULL) {
+            vktrace_LogError("Cannot open trace file: '%s'.", tracePath);
+            return -1;
+        }
+    }
+    FileLike* traceFile = vktrace_FileLike_create_file(tracefp);
+
+    vktrace_trace_file_header fileHeader;
+    if (!vktrace_FileLike_ReadRaw(traceFile, &fileHeader, sizeof(fileHeader)) || fileHeader.magic != VKTRACE_FILE_MAGIC) {
+        cout << "\"" << g_params.inputFile << "\" is not a vktrace file !" << endl;
+        fclose(tracefp);
+        vktrace_free(traceFile);
+        return -1;
+    }
+    if (fileHeader.ptrsize != sizeof(uint32_t)) {
+        cout << "Error: \"" << g_params.inputFile << "\" is a " << fileHeader.ptrsize * 8 << "bit trace file, only 32bit trace files "
+             << "can be converted!" << endl;
+        fclose(tracefp);
+        vktrace_free(traceFile);
+        return -1;
+    }
+
+    // The file header and the gpu infos are kept, with the fields below changed at the end
+    vector<uint8_t> fileStart((size_t)fileHeader.first_packet_offset);
+    vector<uint64_t> table;
+    vktrace_trace_packet_header tableHeader = {};
+    vector<uint64_t> referenced;
+    int ret = 0;
+    if (fileHeader.first_packet_offset < sizeof(fileHeader) || !vktrace_FileLike_SetCurrentPosition(traceFile, 0) ||
+        !vktrace_FileLike_ReadRaw(traceFile, fileStart.data(), fileStart.size())) {
+        vktrace_LogError("Failed to read the file header.");
+        ret = -1;
+    } else if (fileHeader.portability_table_valid && !read_portability_table(traceFile, table, tableHeader)) {
+        vktrace_LogWarning("The portability table can't be read, the converted trace won't have one.");
+        fileHeader.portability_table_valid = 0;
+    }
+    if (fileHeader.portability_table_valid) {
+        referenced = table;
+    }
+    if (fileHeader.meta_data_offset != 0) {
+        referenced.push_back(fileHeader.meta_data_offset);
+    }
+    sort(referenced.begin(), referenced.end());
+
+    FILE* output = ret == 0 ? fopen(g_params.outputFile, "wb") : NULL;
+    if (ret == 0 && output == NULL) {
+        vktrace_LogError("Cannot open output file: '%s'.", g_params.outputFile);
+        ret = -1;
+    }
+    unordered_map<uint64_t, uint64_t> remap;
+    convert_summary summary;
+    if (ret == 0) {
+        if (fwrite(fileStart.data(), 1, fileStart.size(), output) != fileStart.size()) {
+            ret = -1;
+        } else {
+            ret = convert_parallel(tracePath, fileHeader, traceFile, fileHeader.first_packet_offset, output, referenced, remap,
+                                   summary);
+        }
+    }
+
+    vktrace_trace_file_header newHeader = fileHeader;
+    if (ret == 0 && fileHeader.portability_table_valid) {
+        // The portability table has the new offsets of the packets, then their count, it is the last packet
+        vector<uint64_t> newTable;
+        for (uint64_t packetOffset : table) {
+            auto it = remap.find(packetOffset);
+            if (it == remap.end()) {
+                vktrace_LogWarning("The portability table refers to a packet at %" PRIu64 " which is not in the trace.", packetOffset);
+                newTable.clear();
+                newHeader.portability_table_valid = 0;
+                break;
+            }
+            newTable.push_back(it->second);
+        }
+        if (newHeader.portability_table_valid) {
+            newTable.push_back(newTable.size());
+            vktrace_trace_packet_header hdr = tableHeader;
+            hdr.size = sizeof(hdr) + newTable.size() * sizeof(uint64_t);
+            if (fwrite(&hdr, sizeof(hdr), 1, output) != 1 ||
+                fwrite(newTable.data(), sizeof(uint64_t), newTable.size(), output) != newTable.size()) {
+                ret = -1;
+            }
+        }
+    }
+    if (ret == 0) {
+        newHeader.ptrsize = sizeof(uint64_t);
+        newHeader.compress_type = VKTRACE_COMPRESS_TYPE_NONE;
+        newHeader.bit_flags &= ~VKTRACE_USE_BLOB_REFERENCES_BIT;
+        newHeader.block_table_offset = 0;
+        newHeader.last_frame_offset = 0;
+        for (uint32_t i = 0; i < VKTRACE_MAX_TRACER_ID_ARRAY_SIZE; i++) {
+            if (newHeader.tracer_id_array[i].id != VKTRACE_TID_RESERVED) {
+                newHeader.tracer_id_array[i].is_64_bit = 1;
+            }
+        }
+        auto meta = remap.find(fileHeader.meta_data_offset);
+        newHeader.meta_data_offset = meta != remap.end() ? meta->second : 0;
+        newHeader.decompress_file_size = (uint64_t)Ftell(output);
+        if (Fseek(output, 0, SEEK_SET) != 0 || fwrite(&newHeader, sizeof(newHeader), 1, output) != 1) {
+            ret = -1;
+        }
+    }
+    if (output != NULL && fclose(output) != 0) {
+        ret = -1;
+    }
+    fclose(tracefp);
+    vktrace_free(traceFile);
+
+    if (ret != 0) {
+        vktrace_LogError("Failed to convert \"%s\".", g_params.inputFile);
+        return -1;
+    }
+    cout << "Converted " << summary.packets << " packets to \"" << g_params.outputFile << "\"." << endl;
+    if (summary.rawPointers > 0) {
+        cout << summary.rawPointers << " pointers out of their packet were kept as they are, they are application pointers "
+             << "which the tracer didn't copy." << endl;
+    }
+    if (summary.droppedStructs > 0) {
+        cout << summary.droppedStructs << " pNext chains were cut at structs of unknown layout:";
+        for (int32_t sType : summary.droppedTypes) {
+            cout << " " << string_VkStructureType((VkStructureType)sType);
+        }
+        cout << endl;
+    }
+    for (const pair<const uint16_t, uint64_t>& c : summary.copied) {
+        const char* name = vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)c.first);
+        vktrace_LogWarning("%" PRIu64 " packets %s (%u) can't be converted, they were copied as they are.", c.second,
+                           name != NULL ? name : "", c.first);
+    }
+    return 0;
+}
@@ -0,0 +1,267 @@
+/*
+ * (C) COPYRIGHT 2020 ARM Limited
+ * ALL RIGHTS RESERVED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <set>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "vktrace_common.h"
+#include "vktrace_trace_packet_identifiers.h"
+
+/* The start of every struct with a pNext in a 32-bit trace, to tell them apart by sType.
+ */
+typedef struct vkconvert_base_32 {
+    VkStructureType sType;
+    uint32_t pNext;
+} vkconvert_base_32;
+
+/* Rewrites the body of a packet of a 32-bit trace with the 64-bit layout. The new body is the 64-bit packet struct, then
+ * the whole 32-bit body unchanged, then the arrays which had to be converted. The pointers to data which is the same in
+ * both layouts (shader code, uploads, strings, non-dispatchable handles...) are only rebased onto the unchanged copy.
+ * Pointers are offsets from the body, as in the trace file. Not thread safe, each convert thread has its own.
+ */
+class vkconvert_packet {
+public:
+    /* Starts converting 'header', a whole 32-bit packet which is decompressed and has its blobs resolved.
+     */
+    void reset(const vktrace_trace_packet_header* header) {
+        m_header = header;
+        m_inBody = (const uint8_t*)header + sizeof(vktrace_trace_packet_header);
+        // The tag word at the end of the packet is written again by finish()
+        m_inSize = header->size >= sizeof(vktrace_trace_packet_header) + sizeof(uint32_t)
+                       ? header->size - sizeof(vktrace_trace_packet_header) - sizeof(uint32_t)
+                       : 0;
+        m_copyOffset = 0;
+        m_depth = 0;
+        m_failed = false;
+        m_out.clear();
+    }
+
+    uint16_t packet_id() const { return m_header->packet_id; }
+
+    /* Starts the new body with a packet struct of 'size' bytes, followed by the copy of the 32-bit body. Returns the offset
+     * of the packet struct.
+     */
+    uint64_t begin(uint64_t size) {
+        m_copyOffset = ROUNDUP_TO_8(size);
+        m_out.assign(m_copyOffset + m_inSize, 0);
+        memcpy(&m_out[m_copyOffset], m_inBody, m_inSize);
+        return 0;
+    }
+
+    /* The 32-bit data of 'count' T at 'offset' in the body of the packet, NULL if it isn't all in the body.
+     */
+    template <typename T>
+    const T* in(uint64_t offset, uint64_t count = 1) const {
+        if (offset > m_inSize || count > (m_inSize - offset) / sizeof(T)) {
+            return NULL;
+        }
+        return (const T*)(m_inBody + offset);
+    }
+
+    /* A T read through the pointer at 'offset', zero if it is NULL or out of the packet. For the lengths of arrays which
+     * are given by another pointer.
+     */
+    template <typename T>
+    const T& value(uint32_t offset) const {
+        static const T zero = T();
+        const T* data = offset != 0 ? in<T>(offset) : NULL;
+        return data != NULL ? *data : zero;
+    }
+
+    /* The 64-bit data at 'offset' in the new body. Only valid until the next alloc().
+     */
+    template <typename T>
+    T* out(uint64_t offset) {
+        return (T*)&m_out[offset];
+    }
+
+    /* Adds 'size' zeroed bytes to the new body, aligned to 8, and returns their offset.
+     */
+    uint64_t alloc(uint64_t size) {
+        uint64_t offset = ROUNDUP_TO_8(m_out.size());
+        m_out.resize(offset + size, 0);
+        return offset;
+    }
+
+    /* The new offset of the unchanged data which was at 'offset' in the 32-bit body.
+     */
+    uint64_t rebase(uint32_t offset) {
+        if (offset == 0) {
+            return 0;
+        }
+        return offset < m_inSize ? m_copyOffset + offset : keep(offset);
+    }
+
+    /* A pointer which isn't to the packet, an application pointer the tracer left as it was. It is kept as it is.
+     */
+    uint64_t keep(uint32_t offset) {
+        rawPointers++;
+        return offset;
+    }
+
+    /* A struct of a pNext chain of which the layout is not known, the rest of the chain is left out.
+     */
+    uint64_t drop(int32_t sType) {
+        droppedStructs++;
+        droppedTypes.insert(sType);
+        return 0;
+    }
+
+    /* Around the conversion of each array of structs. Fails on pNext chains which loop or on data which would make the new
+     * body grow without bounds, then the packet is not converted.
+     */
+    bool enter() {
+        const uint32_t maxDepth = 64;
+        if (m_depth >= maxDepth || m_out.size() > 64 * (m_inSize + 4096)) {
+            m_failed = true;
+            return false;
+        }
+        m_depth++;
+        return true;
+    }
+
+    void leave() { m_depth--; }
+
+    bool failed() const { return m_failed; }
+
+    /* Appends the new packet to 'output': the header of the 32-bit packet with the new size, the new body and the tag word.
+     */
+    void finish(std::vector<uint8_t>& output) const {
+        vktrace_trace_packet_header header = *m_header;
+        header.size = ROUNDUP_TO_8(sizeof(header) + m_out.size() + sizeof(uint32_t));
+        header.next_buffers_offset = sizeof(header) + m_out.size();
+        header.pBody = 0;
+        uint32_t tag = 0;
+        if (m_header->size >= sizeof(header) + sizeof(tag)) {
+            memcpy(&tag, (const uint8_t*)m_header + m_header->size - sizeof(tag), sizeof(tag));
+        }
+        size_t start = output.size();
+        output.resize(start + header.size, 0);
+        memcpy(&output[start], &header, sizeof(header));
+        if (!m_out.empty()) {
+            memcpy(&output[start + sizeof(header)], m_out.data(), m_out.size());
+        }
+        memcpy(&output[start + header.size - sizeof(tag)], &tag, sizeof(tag));
+    }
+
+    uint64_t rawPointers = 0;
+    uint64_t droppedStructs = 0;
+    std::set<int32_t> droppedTypes;
+
+private:
+    const vktrace_trace_packet_header* m_header = NULL;
+    const uint8_t* m_inBody = NULL;
+    uint64_t m_inSize = 0;
+    uint64_t m_copyOffset = 0;  // where the copy of the 32-bit body starts in the new one
+    uint32_t m_depth = 0;
+    bool m_failed = false;
+    std::vector<uint8_t> m_out;
+};
+
+/* Sets a 64-bit pointer, handle or size_t from a 32-bit value or a new offset.
+ */
+template <typename T>
+inline void vkconvert_set(T& to, uint64_t from) {
+    to = (T)(uintptr_t)from;
+}
+
+/* Converts the array of 'count' T32 at 'offset' with 'convert', returns its offset in the new body.
+ */
+template <typename T32, typename T, typename F>
+uint64_t vkconvert_structs(vkconvert_packet& p, uint32_t offset, uint64_t count, F convert) {
+    if (offset == 0) {
+        return 0;
+    }
+    const T32* in = p.in<T32>(offset, count);
+    if (in == NULL || !p.enter()) {
+        return p.keep(offset);
+    }
+    uint64_t out = p.alloc(sizeof(T) * count);
+    for (uint64_t i = 0; i < count; i++) {
+        convert(p, &in[i], out + i * sizeof(T));
+    }
+    p.leave();
+    return out;
+}
+
+/* Widens the array of 'count' dispatchable handles, size_t or other 32-bit values at 'offset'.
+ */
+template <typename T>
+uint64_t vkconvert_scalars(vkconvert_packet& p, uint32_t offset, uint64_t count) {
+    if (offset == 0) {
+        return 0;
+    }
+    const uint32_t* in = p.in<uint32_t>(offset, count);
+    if (in == NULL) {
+        return p.keep(offset);
+    }
+    uint64_t out = p.alloc(sizeof(T) * count);
+    T* values = p.out<T>(out);
+    for (uint64_t i = 0; i < count; i++) {
+        vkconvert_set(values[i], in[i]);
+    }
+    return out;
+}
+
+/* Converts the array of 'count' pointers at 'offset' to data which is the same in both layouts, such as strings.
+ */
+inline uint64_t vkconvert_pointers(vkconvert_packet& p, uint32_t offset, uint64_t count) {
+    if (offset == 0) {
+        return 0;
+    }
+    const uint32_t* in = p.in<uint32_t>(offset, count);
+    if (in == NULL) {
+        return p.keep(offset);
+    }
+    uint64_t out = p.alloc(sizeof(uint64_t) * count);
+    for (uint64_t i = 0; i < count; i++) {
+        *p.out<uint64_t>(out + i * sizeof(uint64_t)) = p.rebase(in[i]);
+    }
+    return out;
+}
+
+/* Converts the array of 'count' pointers at 'offset' to a T32 each.
+ */
+template <typename T32, typename T, typename F>
+uint64_t vkconvert_pointer_structs(vkconvert_packet& p, uint32_t offset, uint64_t count, F convert) {
+    if (offset == 0) {
+        return 0;
+    }
+    const uint32_t* in = p.in<uint32_t>(offset, count);
+    if (in == NULL) {
+        return p.keep(offset);
+    }
+    uint64_t out = p.alloc(sizeof(uint64_t) * count);
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t value = vkconvert_structs<T32, T>(p, in[i], 1, convert);
+        *p.out<uint64_t>(out + i * sizeof(uint64_t)) = value;
+    }
+    return out;
+}
+
+/* Generated, converts the packets of the Vulkan entrypoints. Returns false for the other packets or if the packet is too
+ * small for its struct.
+ */
+bool convert_packet(vkconvert_packet& p);
+
+uint64_t vkconvert_pnext(vkconvert_packet& p, uint32_t offset);
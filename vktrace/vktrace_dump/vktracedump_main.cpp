@@ -16,11 +16,17 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <iomanip>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 
+#include <algorithm>
+#include <functional>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 #include "vktrace_common.h"
 #include "vktrace_tracelog.h"
@@ -28,6 +34,9 @@
 #include "vktrace_trace_packet_utils.h"
 #include "vktrace_vk_packet_id.h"
 #include "decompressor.h"
+#include "blobstore.h"
+#include "blockchecksum.h"
+#include "tracereader.h"
 
 #include "vktracedump_main.h"
 
@@ -38,11 +47,17 @@ struct vktracedump_params {
     const char* simpleDumpFile = NULL;
     const char* fullDumpFile = NULL;
     const char* dumpFileFrameNum = nullptr;
+    const char* timelineFile = NULL;
     bool onlyHeaderInfo = false;
     bool noAddr = false;
     bool dumpShader = false;
     bool saveAsHtml = false;
     bool saveAsJson = false;
+    bool verify = false;
+    bool frameInfo = false;
+    uint32_t threads = 1;
+    uint32_t firstFrame = 0;
+    uint32_t lastFrame = UINT32_MAX;
 } g_params;
 
 char g_dump_file_name[1024] = {0};
@@ -51,6 +66,8 @@ const char* FULL_DUMP_FILE_UNSET = "full_dump_file_unset";
 const char* SEPARATOR = " : ";
 const char* SPACES = "               ";
 const uint32_t COLUMN_WIDTH = 26;
+// Bytes of trace formatted at once by a thread of a parallel dump
+const uint64_t PART_SIZE = 16 * 1024 * 1024;
 
 static void print_usage() {
     cout << "vktracedump available options:" << endl;
@@ -79,6 +96,21 @@ static void print_usage() {
     cout << "    -na                   Dump string \"address\" in place of hex addresses. (Default is false)  Only works with \"-f "
             "<fullDumpFile>\" option."
          << endl;
+    cout << "    -tl <timelineFile>    (Optional) The file to save the captured timings as Chrome trace-event JSON, which can be "
+            "opened in chrome://tracing or ui.perfetto.dev."
+         << endl;
+    cout << "    -j <threads>          (Optional) Format the dumps on <threads> threads, at most one per CPU, 0 for one per CPU. The "
+            "output is the same as with one thread. (Default is 1)"
+         << endl;
+    cout << "    --frames <A-B>        (Optional) Only dump frames A to B. The packets before frame A are skipped over without being "
+            "formatted. Can't be used with \"-fn\"."
+         << endl;
+    cout << "    -v                    (Optional) Check the CRC32C of the blocks of the trace on the \"-j\" threads. The dumps skip "
+            "the packets in corrupted blocks. Only works with traces captured with \"vktrace -cbs\"."
+         << endl;
+    cout << "    -fi                   (Optional) List the frames of the trace with what they cost to capture, from the frame "
+            "boundary packets alone. Only lists frames A to B with \"--frames <A-B>\"."
+         << endl;
 }
 
 static int parse_args(int argc, char** argv) {
@@ -109,9 +141,29 @@ static int parse_args(int argc, char** argv) {
         } else if (arg.compare("-na") == 0) {
             g_params.noAddr = true;
             i++;
+        } else if (arg.compare("-tl") == 0) {
+            g_params.timelineFile = argv[i + 1];
+            i = i + 2;
         } else if (arg.compare("-hd") == 0) {
             g_params.onlyHeaderInfo = true;
             i++;
+        } else if (arg.compare("-v") == 0) {
+            g_params.verify = true;
+            i++;
+        } else if (arg.compare("-fi") == 0) {
+            g_params.frameInfo = true;
+            i++;
+        } else if (arg.compare("-j") == 0 && i + 1 < argc) {
+            if (!parse_thread_count(argv[i + 1], g_params.threads)) {
+                return -1;
+            }
+            i = i + 2;
+        } else if (arg.compare("--frames") == 0 && i + 1 < argc) {
+            if (sscanf(argv[i + 1], "%u-%u", &g_params.firstFrame, &g_params.lastFrame) != 2 ||
+                g_params.firstFrame > g_params.lastFrame) {
+                return -1;
+            }
+            i = i + 2;
         } else if (arg.compare("-h") == 0) {
             print_usage();
             exit(0);
@@ -127,36 +179,106 @@ static int parse_args(int argc, char** argv) {
         // traceFile option must be specified.
         return -1;
     }
+    if (g_params.dumpFileFrameNum != nullptr && (g_params.firstFrame > 0 || g_params.lastFrame != UINT32_MAX)) {
+        // The dump files are named from frame 0.
+        return -1;
+    }
 
     return 0;
 }
 
-static void dump_packet_brief(ostream& dumpFile, uint32_t frameNumber, vktrace_trace_packet_header* packet,
-                              uint64_t currentPosition) {
-    static size_t index = 0;
-    static bool skipApi = false;
-    if (index == 0) {
+// Where the dumps are at a packet, so that they can be carried on from there
+struct dump_position {
+    uint64_t offset = 0;  // file position of the packet
+    uint32_t frameNumber = 0;
+    size_t briefIndex = 0;  // index of the packet in the simple dump
+    bool briefSkipApi = false;
+    bool briefHeader = true;  // the simple dump header is still to be written
+};
+
+static bool is_get_proc_addr(uint32_t packet_id) {
+    return packet_id == VKTRACE_TPI_VK_vkGetInstanceProcAddr || packet_id == VKTRACE_TPI_VK_vkGetDeviceProcAddr;
+}
+
+static void dump_packet_brief(ostream& dumpFile, dump_position& pos, vktrace_trace_packet_header* packet) {
+    if (pos.briefHeader) {
         dumpFile << setw(COLUMN_WIDTH) << "frame" << SEPARATOR << setw(COLUMN_WIDTH) << "thread id" << SEPARATOR
                  << setw(COLUMN_WIDTH) << "packet index" << SEPARATOR << setw(COLUMN_WIDTH) << "global pack id" << SEPARATOR
                  << setw(COLUMN_WIDTH) << "pack position" << SEPARATOR << setw(COLUMN_WIDTH) << "pack byte size" << SEPARATOR
                  << "API Call" << endl;
+        pos.briefHeader = false;
     }
-    if (packet->packet_id != VKTRACE_TPI_VK_vkGetInstanceProcAddr && packet->packet_id != VKTRACE_TPI_VK_vkGetDeviceProcAddr) {
-        skipApi = false;
-        dumpFile << setw(COLUMN_WIDTH) << dec << frameNumber << SEPARATOR << setw(COLUMN_WIDTH) << dec << packet->thread_id
-                 << SEPARATOR << setw(COLUMN_WIDTH) << dec << index << SEPARATOR << setw(COLUMN_WIDTH) << dec
-                 << packet->global_packet_index << SEPARATOR << setw(COLUMN_WIDTH) << dec << currentPosition << SEPARATOR
+    if (!is_get_proc_addr(packet->packet_id)) {
+        pos.briefSkipApi = false;
+        dumpFile << setw(COLUMN_WIDTH) << dec << pos.frameNumber << SEPARATOR << setw(COLUMN_WIDTH) << dec << packet->thread_id
+                 << SEPARATOR << setw(COLUMN_WIDTH) << dec << pos.briefIndex << SEPARATOR << setw(COLUMN_WIDTH) << dec
+                 << packet->global_packet_index << SEPARATOR << setw(COLUMN_WIDTH) << dec << pos.offset << SEPARATOR
                  << setw(COLUMN_WIDTH) << dec << packet->size << SEPARATOR
                  << vktrace_stringify_vk_packet_id((VKTRACE_TRACE_PACKET_ID_VK)packet->packet_id, packet) << endl;
     } else {
-        if (!skipApi) {
-            dumpFile << setw(COLUMN_WIDTH) << dec << frameNumber << SEPARATOR << SPACES << SEPARATOR << SPACES << SEPARATOR
+        if (!pos.briefSkipApi) {
+            dumpFile << setw(COLUMN_WIDTH) << dec << pos.frameNumber << SEPARATOR << SPACES << SEPARATOR << SPACES << SEPARATOR
                      << SPACES << SEPARATOR << SPACES << SEPARATOR << SPACES << SEPARATOR << "Skip "
                      << vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)packet->packet_id) << " call(s)!" << endl;
-            skipApi = true;
+            pos.briefSkipApi = true;
+        }
+    }
+    pos.briefIndex++;
+}
+
+// Timeline export: packets are written as they are read, so the memory use doesn't depend on the trace size
+static uint64_t g_timelineBaseTime = UINT64_MAX;
+static bool g_timelineFirstEvent = true;
+static bool g_timelineFrameHasSubmit = false;
+
+static void dump_timeline_event(ostream& timelineFile, const char* name, const char* cat, const char* ph, uint32_t tid, uint64_t time,
+                                const char* extra) {
+    // Chrome trace-event timestamps are in microseconds
+    char ts[32];
+    snprintf(ts, sizeof(ts), "%.3f", (double)(int64_t)(time - g_timelineBaseTime) / 1000.0);
+    timelineFile << (g_timelineFirstEvent ? "\n" : ",\n") << "{\"name\":\"" << name << "\",\"cat\":\"" << cat << "\",\"ph\":\"" << ph
+                 << "\",\"pid\":1,\"tid\":" << dec << tid << ",\"ts\":" << ts << extra << "}";
+    g_timelineFirstEvent = false;
+}
+
+static void dump_timeline_slice(ostream& timelineFile, const char* name, const char* cat, uint32_t tid, uint64_t begin, uint64_t end) {
+    if (end <= begin) {
+        return;
+    }
+    char extra[64];
+    snprintf(extra, sizeof(extra), ",\"dur\":%.3f", (double)(end - begin) / 1000.0);
+    dump_timeline_event(timelineFile, name, cat, "X", tid, begin, extra);
+}
+
+static void dump_timeline_packet(ostream& timelineFile, uint32_t frameNumber, vktrace_trace_packet_header* packet) {
+    const char* name = vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)packet->packet_id);
+    if (name == NULL || packet->entrypoint_begin_time == 0) {
+        return;
+    }
+    if (g_timelineBaseTime == UINT64_MAX) {
+        g_timelineBaseTime = packet->vktrace_begin_time;
+    }
+    dump_timeline_slice(timelineFile, "vktrace", "overhead", packet->thread_id, packet->vktrace_begin_time, packet->entrypoint_begin_time);
+    dump_timeline_slice(timelineFile, name, "api", packet->thread_id, packet->entrypoint_begin_time, packet->entrypoint_end_time);
+    dump_timeline_slice(timelineFile, "vktrace", "overhead", packet->thread_id, packet->entrypoint_end_time, packet->vktrace_end_time);
+
+    // One flow per frame, from its first submit through the following ones to the present
+    char extra[64];
+    if (packet->packet_id == VKTRACE_TPI_VK_vkQueueSubmit) {
+        snprintf(extra, sizeof(extra), ",\"id\":%u", frameNumber);
+        dump_timeline_event(timelineFile, "submit", "flow", g_timelineFrameHasSubmit ? "t" : "s", packet->thread_id,
+                            packet->entrypoint_begin_time, extra);
+        g_timelineFrameHasSubmit = true;
+    } else if (packet->packet_id == VKTRACE_TPI_VK_vkQueuePresentKHR) {
+        if (g_timelineFrameHasSubmit) {
+            snprintf(extra, sizeof(extra), ",\"id\":%u,\"bp\":\"e\"", frameNumber);
+            dump_timeline_event(timelineFile, "submit", "flow", "f", packet->thread_id, packet->entrypoint_begin_time, extra);
+            g_timelineFrameHasSubmit = false;
         }
+        char frameName[32];
+        snprintf(frameName, sizeof(frameName), "Frame %u", frameNumber);
+        dump_timeline_event(timelineFile, frameName, "frame", "i", packet->thread_id, packet->entrypoint_end_time, ",\"s\":\"g\"");
     }
-    index++;
 }
 
 static void dump_full_setup() {
@@ -221,6 +343,11 @@ static void dump_full_setup() {
         settingFile << "lunarg_api_dump.name_size = 32" << endl;
         settingFile << "lunarg_api_dump.type_size = 0" << endl;
         settingFile << "lunarg_api_dump.use_spaces = TRUE" << endl;
+        if (g_params.firstFrame > 0 || g_params.lastFrame != UINT32_MAX) {
+            // Frame A to B is frame A and B - A following ones
+            settingFile << "lunarg_api_dump.output_range = " << g_params.firstFrame << "-"
+                        << (g_params.lastFrame == UINT32_MAX ? 0 : g_params.lastFrame - g_params.firstFrame + 1) << endl;
+        }
         if (g_params.dumpShader) {
             settingFile << "lunarg_api_dump.show_shader = TRUE" << endl;
         } else {
@@ -301,6 +428,284 @@ static string enabled_features_to_str(uint64_t enabled_features) {
     return str;
 }
 
+// Taken from the packets for the summary printed after the dumps
+struct trace_summary {
+    uint32_t deviceApiVersion = UINT32_MAX;
+    uint32_t appApiVersion = UINT32_MAX;
+    char* pApplicationName = NULL;
+    uint32_t applicationVersion = 0;
+    char* pEngineName = NULL;
+    uint32_t engineVersion = 0;
+    char deviceName[VK_MAX_PHYSICAL_DEVICE_NAME_SIZE] = "";
+};
+
+static void collect_summary(trace_summary& summary, vktrace_trace_packet_header* pInterpretedHeader) {
+    switch (pInterpretedHeader->packet_id) {
+        case VKTRACE_TPI_VK_vkGetPhysicalDeviceProperties: {
+            if (summary.deviceApiVersion == UINT32_MAX) {
+                packet_vkGetPhysicalDeviceProperties* pPacket = (packet_vkGetPhysicalDeviceProperties*)(pInterpretedHeader->pBody);
+                summary.deviceApiVersion = pPacket->pProperties->apiVersion;
+                memcpy(summary.deviceName, pPacket->pProperties->deviceName, VK_MAX_PHYSICAL_DEVICE_NAME_SIZE);
+            }
+        } break;
+        case VKTRACE_TPI_VK_vkCreateInstance: {
+            packet_vkCreateInstance* pPacket = (packet_vkCreateInstance*)(pInterpretedHeader->pBody);
+            if (pPacket->pCreateInfo->pApplicationInfo) {
+                if (summary.pApplicationName == NULL && summary.pEngineName == NULL) {
+                    if (pPacket->pCreateInfo->pApplicationInfo->pApplicationName) {
+                        size_t applicationNameLen = strlen(pPacket->pCreateInfo->pApplicationInfo->pApplicationName);
+                        summary.pApplicationName = (char*)malloc(applicationNameLen + 1);
+                        memcpy(summary.pApplicationName, pPacket->pCreateInfo->pApplicationInfo->pApplicationName, applicationNameLen);
+                        summary.pApplicationName[applicationNameLen] = '\0';
+                    }
+                    summary.applicationVersion = pPacket->pCreateInfo->pApplicationInfo->applicationVersion;
+                    if (pPacket->pCreateInfo->pApplicationInfo->pEngineName) {
+                        size_t engineNameLen = strlen(pPacket->pCreateInfo->pApplicationInfo->pEngineName);
+                        summary.pEngineName = (char*)malloc(engineNameLen + 1);
+                        memcpy(summary.pEngineName, pPacket->pCreateInfo->pApplicationInfo->pEngineName, engineNameLen);
+                        summary.pEngineName[engineNameLen] = '\0';
+                    }
+                    summary.engineVersion = pPacket->pCreateInfo->pApplicationInfo->engineVersion;
+                }
+                if (summary.appApiVersion == UINT32_MAX) {
+                    summary.appApiVersion = pPacket->pCreateInfo->pApplicationInfo->apiVersion;
+                }
+            }
+        } break;
+        default:
+            break;
+    }
+}
+
+// The blocks of the trace found corrupted by -v, NULL if there are none
+static const blocktable* g_corruptedBlocks = nullptr;
+static uint64_t g_skippedBytes = 0;
+
+// Moves 'offset' past the packets which are in corrupted blocks: the next packet is found from the block table when its
+// header is corrupted, or from the header when only the rest of the packet is. Returns false at the end of the trace.
+static bool skip_corrupted_packets(FileLike* file, uint64_t& offset) {
+    if (g_corruptedBlocks == nullptr) {
+        return true;
+    }
+    uint64_t start = offset;
+    vktrace_trace_packet_header header;
+    bool more = true;
+    while (more) {
+        if (!g_corruptedBlocks->is_good(offset, sizeof(header))) {
+            offset = g_corruptedBlocks->next_packet(offset);
+            continue;
+        }
+        more = vktrace_FileLike_SetCurrentPosition(file, offset) && vktrace_FileLike_ReadRaw(file, &header, sizeof(header));
+        if (!more || header.size < sizeof(header) || g_corruptedBlocks->is_good(offset, header.size)) {
+            break;
+        }
+        offset += header.size;
+    }
+    g_skippedBytes += offset - start;
+    return more && vktrace_FileLike_SetCurrentPosition(file, offset);
+}
+
+// Reads the frame boundary packets of the trace in order. They are found from the last one when the file header has its
+// offset, otherwise by following the packet headers through the trace. Returns true in the first case.
+static bool read_frame_boundaries(FileLike* file, const vktrace_trace_file_header& fileHeader,
+                                  vector<vktrace_trace_packet_frame_boundary>& frames) {
+    vktrace_trace_packet_header header;
+    vktrace_trace_packet_frame_boundary frame;
+    uint64_t offset = fileHeader.last_frame_offset;
+    while (offset != 0) {
+        if (!vktrace_FileLike_SetCurrentPosition(file, offset) || !vktrace_FileLike_ReadRaw(file, &header, sizeof(header)) ||
+            header.packet_id != VKTRACE_TPI_MARKER_API_BOUNDARY || header.size < sizeof(header) + sizeof(frame) ||
+            !vktrace_FileLike_ReadRaw(file, &frame, sizeof(frame)) || frame.previous_offset >= offset) {
+            vktrace_LogWarning("The frame boundary at offset %" PRIu64 " is invalid, the trace is scanned instead.", offset);
+            frames.clear();
+            break;
+        }
+        frames.push_back(frame);
+        offset = frame.previous_offset;
+    }
+    if (offset == 0 && !frames.empty()) {
+        reverse(frames.begin(), frames.end());
+        return true;
+    }
+
+    offset = fileHeader.first_packet_offset;
+    while (skip_corrupted_packets(file, offset) && vktrace_FileLike_SetCurrentPosition(file, offset) &&
+           vktrace_FileLike_ReadRaw(file, &header, sizeof(header)) && header.size >= sizeof(header)) {
+        if (header.packet_id == VKTRACE_TPI_MARKER_API_BOUNDARY && header.size >= sizeof(header) + sizeof(frame) &&
+            vktrace_FileLike_ReadRaw(file, &frame, sizeof(frame))) {
+            frames.push_back(frame);
+        }
+        offset += header.size;
+    }
+    return false;
+}
+
+static bool is_vk_packet(uint32_t packet_id) {
+    return packet_id >= VKTRACE_TPI_VK_vkApiVersion && packet_id < VKTRACE_TPI_META_DATA;
+}
+
+// The packets which the full dump state or the summary depend on, scan_packets() reads them whole
+static bool scan_reads_body(uint32_t packet_id, bool trackDump, bool collectSummary) {
+    switch (packet_id) {
+        case VKTRACE_TPI_VK_vkAllocateCommandBuffers:
+        case VKTRACE_TPI_VK_vkFreeCommandBuffers:
+        case VKTRACE_TPI_VK_vkDestroyCommandPool:
+        case VKTRACE_TPI_VK_vkSetDebugUtilsObjectNameEXT:
+        case VKTRACE_TPI_VK_vkDebugMarkerSetObjectNameEXT:
+            return trackDump;
+        case VKTRACE_TPI_VK_vkCreateInstance:
+        case VKTRACE_TPI_VK_vkGetPhysicalDeviceProperties:
+            return collectSummary;
+        default:
+            return false;
+    }
+}
+
+// Follows the packets from 'pos' to the first one of frame 'endFrame' or the end of the trace, without formatting them: only
+// the headers are read, the other packets are skipped over. 'onFrame' is called at the start of each frame.
+static int scan_packets(trace_reader& reader, dump_position& pos, ApiDumpInstance* dumpState, trace_summary* summary,
+                        ostream* timeline, uint64_t endFrame, const function<void()>& onFrame) {
+    int ret = 0;
+    while (pos.frameNumber < endFrame) {
+        vktrace_trace_packet_header header;
+        if (!skip_corrupted_packets(reader.file, pos.offset)) break;
+        if (!vktrace_FileLike_ReadRaw(reader.file, &header, sizeof(header))) break;
+        if (header.size < sizeof(header)) {
+            vktrace_LogError("Invalid packet size %" PRIu64 " at %" PRIu64 ".", header.size, pos.offset);
+            return -1;
+        }
+
+        bool isVk = is_vk_packet(header.packet_id);
+        if (isVk && scan_reads_body(header.packet_id, dumpState != nullptr, summary != nullptr)) {
+            vktrace_FileLike_SetCurrentPosition(reader.file, pos.offset);
+            vktrace_trace_packet_header* packet = read_packet(reader, ret);
+            if (!packet) break;
+            vktrace_trace_packet_header* pInterpretedHeader = interpret_trace_packet_vk(packet);
+            if (dumpState) {
+                track_packet(dumpState, pInterpretedHeader);
+            }
+            if (summary) {
+                collect_summary(*summary, pInterpretedHeader);
+            }
+            vktrace_delete_trace_packet_no_lock(&packet);
+        } else {
+            if (!vktrace_FileLike_SetCurrentPosition(reader.file, pos.offset + header.size)) break;
+            if (isVk && dumpState) {
+                track_packet(dumpState, &header);
+            }
+        }
+        pos.offset += header.size;
+
+        if (isVk) {
+            if (timeline) {
+                dump_timeline_packet(*timeline, pos.frameNumber, &header);
+            }
+            pos.briefSkipApi = is_get_proc_addr(header.packet_id);
+            pos.briefIndex++;
+            if (header.packet_id == VKTRACE_TPI_VK_vkQueuePresentKHR) {
+                pos.frameNumber++;
+                if (pos.frameNumber < endFrame && onFrame) {
+                    onFrame();
+                }
+            }
+        }
+    }
+    return ret;
+}
+
+// A part of a parallel dump: the packets from 'start' to 'endOffset', which always begin a frame
+struct dump_part {
+    dump_position start;
+    uint64_t endOffset = 0;
+    ApiDumpInstance* dumpState = nullptr;  // the full dump state at 'start', NULL without full dump
+    ostringstream brief;
+    ostringstream full;
+};
+
+static int dump_part_packets(trace_reader& reader, dump_part& part) {
+    dump_position pos = part.start;
+    if (!vktrace_FileLike_SetCurrentPosition(reader.file, pos.offset)) {
+        return -1;
+    }
+    int ret = 0;
+    set_dump_part(part.dumpState);
+    while (pos.offset < part.endOffset) {
+        vktrace_trace_packet_header* packet = read_packet(reader, ret);
+        if (!packet) break;
+
+        if (is_vk_packet(packet->packet_id)) {
+            vktrace_trace_packet_header* pInterpretedHeader = interpret_trace_packet_vk(packet);
+            if (g_params.simpleDumpFile) {
+                dump_packet_brief(part.brief, pos, pInterpretedHeader);
+            }
+            if (g_params.fullDumpFile) {
+                dump_packet(pInterpretedHeader);
+            }
+            if (pInterpretedHeader->packet_id == VKTRACE_TPI_VK_vkQueuePresentKHR) {
+                pos.frameNumber++;
+            }
+        }
+        vktrace_delete_trace_packet_no_lock(&packet);
+        pos.offset = vktrace_FileLike_GetCurrentPosition(reader.file);
+    }
+    set_dump_part(nullptr);
+    return ret;
+}
+
+// Dumps the packets from 'pos' on g_params.threads threads. The main thread scans the packets to split them in parts of
+// about PART_SIZE bytes at frame starts, each with the dump state it begins with, and the parts are formatted by the other
+// threads into buffers which are written in order, so the output is the same as the one of a serial dump.
+static int dump_parallel(const char* tracePath, const vktrace_trace_file_header& fileHeader, trace_reader& reader,
+                         dump_position& pos, ApiDumpInstance* dumpState, trace_summary* summary, ostream* simpleDump,
+                         ostream* timeline) {
+    ordered_part_writer<dump_part> writer(g_params.threads, tracePath, fileHeader, dump_part_packets, [&](dump_part& part, bool last) {
+        if (simpleDump) {
+            *simpleDump << part.brief.str();
+            part.brief.str(string());
+        }
+        if (part.dumpState) {
+            dump_output() << part.full.str() << flush;
+            part.full.str(string());
+            if (last) {
+                copy_dump_state(nullptr, part.dumpState);
+            }
+            delete_dump_part(part.dumpState);
+            part.dumpState = nullptr;
+        }
+        return true;
+    });
+
+    bool first = true;
+    auto add_part = [&]() {
+        dump_part& part = writer.add();
+        part.start = pos;
+        part.start.briefHeader = first && pos.briefHeader;
+        first = false;
+        if (dumpState) {
+            part.dumpState = create_dump_part(part.full);
+            copy_dump_state(part.dumpState, dumpState);
+        }
+    };
+
+    add_part();
+    int ret = scan_packets(reader, pos, dumpState, summary, timeline, (uint64_t)g_params.lastFrame + 1, [&]() {
+        if (pos.offset - writer.back().start.offset < PART_SIZE) return;
+        writer.back().endOffset = pos.offset;
+        writer.ready();
+        add_part();
+    });
+    writer.back().endOffset = pos.offset;
+    writer.ready();
+    ret = writer.finish(ret);
+
+    for (dump_part& part : writer.parts()) {
+        if (part.dumpState) {
+            delete_dump_part(part.dumpState);
+        }
+    }
+    return ret;
+}
+
 int main(int argc, char** argv) {
     if (parse_args(argc, argv) < 0) {
         cout << "Error: invalid parameters!" << endl;
@@ -438,139 +843,219 @@ int main(int argc, char** argv) {
                 }
                 vktrace_FileLike_SetCurrentPosition(traceFile, originalFilePos);
             }
-            if (ret > -1 && !g_params.onlyHeaderInfo) {
-                uint32_t frameNumber = 0;
-                uint32_t deviceApiVersion = UINT32_MAX;
-                uint32_t appApiVersion = UINT32_MAX;
-                char* pApplicationName = NULL;
-                uint32_t applicationVersion = 0;
-                char* pEngineName = NULL;
-                uint32_t engineVersion = 0;
-                char deviceName[VK_MAX_PHYSICAL_DEVICE_NAME_SIZE] = "";
-                decompressor* decomp = nullptr;
-                if (fileHeader.compress_type != VKTRACE_COMPRESS_TYPE_NONE) {
-                    decomp = create_decompressor((VKTRACE_COMPRESS_TYPE)fileHeader.compress_type);
-                    if (decomp == nullptr) {
-                        vktrace_LogError("Create decompressor error.");
-                        fclose(tracefp);
-                        vktrace_free(traceFile);
-                        if (tmpfile) {
-                            remove(tmpfile);
+            // Check the blocks of the trace, the dumps below skip the corrupted ones
+            blocktable blocks;
+            if (ret > -1 && g_params.verify) {
+                uint64_t originalFilePos = vktrace_FileLike_GetCurrentPosition(traceFile);
+                // A capture which didn't end properly has no block table, but it can leave the sidecar file
+                bool hasTable = blocks.read(traceFile, fileHeader.block_table_offset);
+                if (!hasTable && fileHeader.block_table_offset == 0 &&
+                    blocks.read_sidecar(vktrace_block_sidecar_path(g_params.traceFile))) {
+                    cout << "The trace has no block table, checking the complete blocks listed in "
+                         << vktrace_block_sidecar_path(g_params.traceFile) << " during the capture." << endl;
+                    hasTable = true;
+                }
+                if (!hasTable) {
+                    cout << "Error: The trace has no valid block table, it must be captured with \"vktrace -cbs\" to be checked!" << endl;
+                    ret = -1;
+                } else {
+                    uint64_t startTime = vktrace_get_time();
+                    int64_t corrupted = blocks.verify(tmpfile ? tmpfile : g_params.traceFile, g_params.threads);
+                    uint64_t endTime = vktrace_get_time();
+                    if (corrupted < 0) {
+                        cout << "Error: Cannot read the trace file to check it!" << endl;
+                        ret = -1;
+                    } else {
+                        for (uint64_t i = 0; i < blocks.block_count(); i++) {
+                            if (blocks.is_bad(i)) {
+                                uint64_t blockOffset = fileHeader.first_packet_offset + i * blocks.block_size();
+                                cout << "Corrupted block " << dec << i << " at offset " << blockOffset
+                                     << ", the packets resume at offset " << blocks.next_packet(blockOffset) << endl;
+                            }
+                        }
+                        double seconds = (double)(endTime - startTime) / NANOSEC_IN_ONE_SEC;
+                        cout << setw(COLUMN_WIDTH) << left << "Checked Blocks:" << dec << blocks.block_count() << " of "
+                             << blocks.block_size() / 1024 << " KB in " << seconds << " s" << endl;
+                        cout << setw(COLUMN_WIDTH) << left << "Corrupted Blocks:" << corrupted << endl;
+                        if (corrupted > 0) {
+                            g_corruptedBlocks = &blocks;
                         }
-                        return -1;
                     }
                 }
-                while (true) {
-                    uint64_t currentPosition = vktrace_FileLike_GetCurrentPosition(traceFile);
-                    vktrace_trace_packet_header* packet = vktrace_read_trace_packet(traceFile);
-                    if (!packet) break;
-
-                    if (packet->tracer_id == VKTRACE_TID_VULKAN_COMPRESSED) {
-                        ret = decompress_packet(decomp,packet);
-                        if (ret != 0) {
-                            vktrace_LogError("Decompress packet error.");
-                            break;
+                vktrace_FileLike_SetCurrentPosition(traceFile, originalFilePos);
+            }
+            if (ret > -1 && g_params.frameInfo) {
+                uint64_t originalFilePos = vktrace_FileLike_GetCurrentPosition(traceFile);
+                vector<vktrace_trace_packet_frame_boundary> frames;
+                bool chained = read_frame_boundaries(traceFile, fileHeader, frames);
+                if (frames.empty()) {
+                    cout << "The trace has no frame boundaries, it was captured by an older vktrace or has no present." << endl;
+                } else {
+                    cout << setw(COLUMN_WIDTH) << left << "Frame Boundaries:";
+                    if (chained) {
+                        cout << "followed back from offset " << dec << fileHeader.last_frame_offset << endl;
+                    } else {
+                        cout << "found by scanning the trace" << endl;
+                    }
+                    // The layer only sets the frame numbers, the vktrace server fills in the rest as it writes the trace
+                    bool filled = false;
+                    for (const vktrace_trace_packet_frame_boundary& frame : frames) {
+                        filled = filled || frame.packet_count != 0;
+                    }
+                    if (!filled) {
+                        cout << "The frame boundaries have no counters, the trace was not written by the vktrace server." << endl;
+                    }
+                    cout << setw(10) << right << "Frame" << setw(14) << "First Packet" << setw(10) << "Packets" << setw(16)
+                         << "Captured Bytes" << setw(16) << "Written Bytes" << setw(14) << "Capture ms" << setw(16) << "Offset"
+                         << endl;
+                    uint64_t totalOverhead = 0, listed = 0;
+                    const vktrace_trace_packet_frame_boundary* pSlowest = nullptr;
+                    for (const vktrace_trace_packet_frame_boundary& frame : frames) {
+                        if (frame.frame_number < g_params.firstFrame || frame.frame_number > g_params.lastFrame) {
+                            continue;
+                        }
+                        cout << dec << setw(10) << frame.frame_number << setw(14) << frame.first_packet_index << setw(10)
+                             << frame.packet_count << setw(16) << frame.packet_bytes << setw(16) << frame.written_bytes << setw(14)
+                             << fixed << setprecision(3) << frame.tracer_overhead / 1000000.0 << setw(16) << frame.frame_offset
+                             << endl;
+                        totalOverhead += frame.tracer_overhead;
+                        listed++;
+                        if (pSlowest == nullptr || frame.tracer_overhead > pSlowest->tracer_overhead) {
+                            pSlowest = &frame;
                         }
                     }
+                    cout << left << setw(COLUMN_WIDTH) << "Frames:" << listed << endl;
+                    if (pSlowest != nullptr) {
+                        cout << setw(COLUMN_WIDTH) << "Capture Overhead:" << totalOverhead / 1000000.0 << " ms, "
+                             << totalOverhead / 1000000.0 / listed << " ms per frame, " << pSlowest->tracer_overhead / 1000000.0
+                             << " ms at most in frame " << pSlowest->frame_number << endl;
+                    }
+                    cout.unsetf(ios::floatfield);
+                }
+                vktrace_FileLike_SetCurrentPosition(traceFile, originalFilePos);
+            }
+            if (ret > -1 && !g_params.onlyHeaderInfo) {
+                trace_summary summary;
+                trace_reader reader;
+                if (!attach_reader(reader, traceFile, fileHeader)) {
+                    fclose(tracefp);
+                    vktrace_free(traceFile);
+                    if (tmpfile) {
+                        remove(tmpfile);
+                    }
+                    return -1;
+                }
+                ofstream timelineOutput;
+                if (g_params.timelineFile) {
+                    timelineOutput.open(g_params.timelineFile);
+                    if (!timelineOutput.is_open()) {
+                        vktrace_LogError("Cannot open timeline file: '%s'.", g_params.timelineFile);
+                        g_params.timelineFile = NULL;
+                    } else {
+                        timelineOutput << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+                    }
+                }
+                // The shader files and the dump files of -fn are named in the order of the packets
+                bool parallel = g_params.threads > 1 && (g_params.simpleDumpFile || g_params.fullDumpFile) &&
+                                !g_params.dumpShader && g_params.dumpFileFrameNum == nullptr && g_corruptedBlocks == nullptr;
+                // Follows the full dump state through the packets which are not formatted here
+                ostream noOutput(nullptr);
+                ApiDumpInstance* dumpState = nullptr;
+                if (g_params.fullDumpFile && (parallel || g_params.firstFrame > 0)) {
+                    dumpState = create_dump_part(noOutput);
+                }
+                dump_position pos;
+                pos.offset = vktrace_FileLike_GetCurrentPosition(traceFile);
+                if (g_params.firstFrame > 0) {
+                    ret = scan_packets(reader, pos, dumpState, hideBriefInfo ? nullptr : &summary, nullptr, g_params.firstFrame, nullptr);
+                    if (dumpState) {
+                        copy_dump_state(nullptr, dumpState);
+                        start_dump_frame();
+                        // The parts of a parallel dump go on from the frame which was just opened
+                        copy_dump_state(dumpState, nullptr);
+                    }
+                }
+                if (ret == 0 && parallel) {
+                    ret = dump_parallel(tmpfile ? tmpfile : g_params.traceFile, fileHeader, reader, pos, dumpState,
+                                        hideBriefInfo ? nullptr : &summary, pSimpleDumpFile,
+                                        g_params.timelineFile ? &timelineOutput : nullptr);
+                }
+                while (ret == 0 && !parallel && pos.frameNumber <= g_params.lastFrame) {
+                    pos.offset = vktrace_FileLike_GetCurrentPosition(traceFile);
+                    if (!skip_corrupted_packets(traceFile, pos.offset)) break;
+                    vktrace_trace_packet_header* packet = read_packet(reader, ret);
+                    if (!packet) break;
 
-                    if (packet->packet_id >= VKTRACE_TPI_VK_vkApiVersion && packet->packet_id < VKTRACE_TPI_META_DATA) {
+                    if (is_vk_packet(packet->packet_id)) {
                         vktrace_trace_packet_header* pInterpretedHeader = interpret_trace_packet_vk(packet);
                         if (g_params.simpleDumpFile) {
-                            dump_packet_brief(*pSimpleDumpFile, frameNumber, pInterpretedHeader, currentPosition);
+                            dump_packet_brief(*pSimpleDumpFile, pos, pInterpretedHeader);
                         }
                         if (g_params.fullDumpFile) {
                             dump_packet(pInterpretedHeader);
                         }
-                        switch (pInterpretedHeader->packet_id) {
-                            case VKTRACE_TPI_VK_vkQueuePresentKHR: {
-                                frameNumber++;
-                                if (g_params.simpleDumpFile && change_dump_file_name(g_params.simpleDumpFile, frameNumber)) {
-                                    fileOutput.close();
-                                    fileOutput.open(g_dump_file_name);
-                                    buf = fileOutput.rdbuf();
-                                    pSimpleDumpFile->rdbuf(buf);
-                                }
-                                if (g_params.fullDumpFile && change_dump_file_name(g_params.fullDumpFile, frameNumber)) {
-                                    reset_dump_file_name(g_dump_file_name);
-                                }
-
-                            } break;
-                            case VKTRACE_TPI_VK_vkGetPhysicalDeviceProperties: {
-                                if (!hideBriefInfo) {
-                                    if (deviceApiVersion == UINT32_MAX) {
-                                        packet_vkGetPhysicalDeviceProperties* pPacket =
-                                            (packet_vkGetPhysicalDeviceProperties*)(pInterpretedHeader->pBody);
-                                        deviceApiVersion = pPacket->pProperties->apiVersion;
-                                        memcpy(deviceName, pPacket->pProperties->deviceName, VK_MAX_PHYSICAL_DEVICE_NAME_SIZE);
-                                    }
-                                }
-                            } break;
-                            case VKTRACE_TPI_VK_vkCreateInstance: {
-                                if (!hideBriefInfo) {
-                                    packet_vkCreateInstance* pPacket = (packet_vkCreateInstance*)(pInterpretedHeader->pBody);
-                                    if (pPacket->pCreateInfo->pApplicationInfo) {
-                                        if (pApplicationName == NULL && pEngineName == NULL) {
-                                            if (pPacket->pCreateInfo->pApplicationInfo->pApplicationName) {
-                                                size_t applicationNameLen =
-                                                    strlen(pPacket->pCreateInfo->pApplicationInfo->pApplicationName);
-                                                pApplicationName = (char*)malloc(applicationNameLen + 1);
-                                                memcpy(pApplicationName, pPacket->pCreateInfo->pApplicationInfo->pApplicationName,
-                                                   applicationNameLen);
-                                                pApplicationName[applicationNameLen] = '\0';
-                                            }
-                                            applicationVersion = pPacket->pCreateInfo->pApplicationInfo->applicationVersion;
-                                            if (pPacket->pCreateInfo->pApplicationInfo->pEngineName) {
-                                                size_t engineNameLen = strlen(pPacket->pCreateInfo->pApplicationInfo->pEngineName);
-                                                pEngineName = (char*)malloc(engineNameLen + 1);
-                                                memcpy(pEngineName, pPacket->pCreateInfo->pApplicationInfo->pEngineName, engineNameLen);
-                                                pEngineName[engineNameLen] = '\0';
-                                            }
-                                            engineVersion = pPacket->pCreateInfo->pApplicationInfo->engineVersion;
-                                        }
-                                        if (appApiVersion == UINT32_MAX) {
-                                            appApiVersion = pPacket->pCreateInfo->pApplicationInfo->apiVersion;
-                                        }
-                                    }
-                                }
-                            } break;
-                            default:
-                                break;
+                        if (g_params.timelineFile) {
+                            dump_timeline_packet(timelineOutput, pos.frameNumber, pInterpretedHeader);
+                        }
+                        if (pInterpretedHeader->packet_id == VKTRACE_TPI_VK_vkQueuePresentKHR) {
+                            pos.frameNumber++;
+                            if (g_params.simpleDumpFile && change_dump_file_name(g_params.simpleDumpFile, pos.frameNumber)) {
+                                fileOutput.close();
+                                fileOutput.open(g_dump_file_name);
+                                buf = fileOutput.rdbuf();
+                                pSimpleDumpFile->rdbuf(buf);
+                            }
+                            if (g_params.fullDumpFile && change_dump_file_name(g_params.fullDumpFile, pos.frameNumber)) {
+                                reset_dump_file_name(g_dump_file_name);
+                            }
+                        } else if (!hideBriefInfo) {
+                            collect_summary(summary, pInterpretedHeader);
                         }
                     }
                     vktrace_delete_trace_packet_no_lock(&packet);
                 }
-                if (decomp != nullptr) {
-                    delete decomp;
+                if (dumpState) {
+                    delete_dump_part(dumpState);
                 }
+                if (g_params.timelineFile) {
+                    timelineOutput << "\n]}\n";
+                    timelineOutput.close();
+                }
+                close_reader(reader);
                 if (!hideBriefInfo) {
-                    if (deviceApiVersion != UINT32_MAX) {
-                        cout << setw(COLUMN_WIDTH) << left << "Device Name:" << deviceName << endl;
-                        cout << setw(COLUMN_WIDTH) << left << "Device API Ver:" << dec << VK_VERSION_MAJOR(deviceApiVersion) << "." << dec
-                             << VK_VERSION_MINOR(deviceApiVersion) << "." << dec << VK_VERSION_PATCH(deviceApiVersion) << endl;
+                    if (summary.deviceApiVersion != UINT32_MAX) {
+                        cout << setw(COLUMN_WIDTH) << left << "Device Name:" << summary.deviceName << endl;
+                        cout << setw(COLUMN_WIDTH) << left << "Device API Ver:" << dec << VK_VERSION_MAJOR(summary.deviceApiVersion) << "."
+                             << dec << VK_VERSION_MINOR(summary.deviceApiVersion) << "." << dec
+                             << VK_VERSION_PATCH(summary.deviceApiVersion) << endl;
                     }
-                    if (appApiVersion != UINT32_MAX) {
-                        cout << setw(COLUMN_WIDTH) << left << "App API Ver:" << dec << VK_VERSION_MAJOR(appApiVersion) << "." << dec
-                             << VK_VERSION_MINOR(appApiVersion) << "." << dec << VK_VERSION_PATCH(appApiVersion) << endl;
+                    if (summary.appApiVersion != UINT32_MAX) {
+                        cout << setw(COLUMN_WIDTH) << left << "App API Ver:" << dec << VK_VERSION_MAJOR(summary.appApiVersion) << "."
+                             << dec << VK_VERSION_MINOR(summary.appApiVersion) << "." << dec
+                             << VK_VERSION_PATCH(summary.appApiVersion) << endl;
                     }
-                    if (pApplicationName) {
-                        cout << setw(COLUMN_WIDTH) << left << "App Name:" << pApplicationName << endl;
-                        free(pApplicationName);
-                        pApplicationName = NULL;
+                    if (summary.pApplicationName) {
+                        cout << setw(COLUMN_WIDTH) << left << "App Name:" << summary.pApplicationName << endl;
+                        free(summary.pApplicationName);
+                        summary.pApplicationName = NULL;
                     } else {
                         cout << setw(COLUMN_WIDTH) << left << "App Name:"
                              << "NULL" << endl;
                     }
-                    cout << setw(COLUMN_WIDTH) << left << "App Ver:" << applicationVersion << endl;
-                    if (pEngineName) {
-                        cout << setw(COLUMN_WIDTH) << left << "Engine Name:" << pEngineName << endl;
-                        free(pEngineName);
-                        pEngineName = NULL;
+                    cout << setw(COLUMN_WIDTH) << left << "App Ver:" << summary.applicationVersion << endl;
+                    if (summary.pEngineName) {
+                        cout << setw(COLUMN_WIDTH) << left << "Engine Name:" << summary.pEngineName << endl;
+                        free(summary.pEngineName);
+                        summary.pEngineName = NULL;
                     } else {
                         cout << setw(COLUMN_WIDTH) << left << "Engine Name:"
                              << "NULL" << endl;
                     }
-                    cout << setw(COLUMN_WIDTH) << left << "Engine Ver:" << engineVersion << endl;
-                    cout << setw(COLUMN_WIDTH) << left << "Frames:" << frameNumber << endl;
+                    cout << setw(COLUMN_WIDTH) << left << "Engine Ver:" << summary.engineVersion << endl;
+                    cout << setw(COLUMN_WIDTH) << left << "Frames:" << pos.frameNumber << endl;
+                }
+                if (g_skippedBytes > 0) {
+                    vktrace_LogWarning("%" PRIu64 " bytes of packets in corrupted blocks were skipped.", g_skippedBytes);
                 }
             }
             if (g_params.simpleDumpFile && strcmp(g_params.simpleDumpFile, "STDOUT") && strcmp(g_params.simpleDumpFile, "stdout")) {
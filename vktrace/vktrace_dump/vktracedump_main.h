@@ -16,5 +16,22 @@
 
 #pragma once
 
+#include <ostream>
+
+class ApiDumpInstance;
+
 void dump_packet(const vktrace_trace_packet_header* packet);
-void reset_dump_file_name(const char* dump_file_name);
\ No newline at end of file
+void reset_dump_file_name(const char* dump_file_name);
+
+// Parallel dumps: each part of the trace is formatted by its own ApiDumpInstance into 'output', with the settings of
+// the full dump. The part of the calling thread replaces the shared instance in dump_packet(), NULL restores it.
+ApiDumpInstance* create_dump_part(std::ostream& output);
+void delete_dump_part(ApiDumpInstance* part);
+void set_dump_part(ApiDumpInstance* part);
+// Carries on the dump state of 'from' in 'to', NULL is the shared instance
+void copy_dump_state(ApiDumpInstance* to, const ApiDumpInstance* from);
+// Writes the start of the current frame of the shared instance, when the dump starts after frame 0
+void start_dump_frame();
+// Follows the dump state through a packet which is not formatted
+void track_packet(ApiDumpInstance* part, const vktrace_trace_packet_header* packet);
+std::ostream& dump_output();
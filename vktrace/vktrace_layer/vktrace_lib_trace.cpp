@@ -5286,6 +5286,26 @@ VKTRACER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL __HOOKED_vkGetSwapchainImagesKHR(
     return result;
 }
 
+// Ends each frame in the trace, vktrace fills in the counters of the frame when it writes the packet
+static void send_frame_boundary_packet(uint64_t frameNumber) {
+    if (g_trimEnabled && !g_trimIsInTrim) {
+        return;
+    }
+    vktrace_trace_packet_header* pHeader = vktrace_create_trace_packet(VKTRACE_TID_VULKAN, VKTRACE_TPI_MARKER_API_BOUNDARY,
+                                                                       sizeof(vktrace_trace_packet_frame_boundary), 0);
+    vktrace_trace_packet_frame_boundary* pPacket = (vktrace_trace_packet_frame_boundary*)pHeader->pBody;
+    memset(pPacket, 0, sizeof(*pPacket));
+    pPacket->frame_number = frameNumber;
+    vktrace_set_packet_entrypoint_end_time(pHeader);
+    vktrace_finalize_trace_packet(pHeader);
+    if (g_trimEnabled) {
+        trim::write_packet(pHeader);
+    } else {
+        vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file());
+        vktrace_delete_trace_packet(&pHeader);
+    }
+}
+
 VKTRACER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL __HOOKED_vkQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* pPresentInfo) {
     trim::TraceLock<std::mutex> lock(g_mutex_trace);
     VkResult result;
@@ -5346,6 +5366,7 @@ VKTRACER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL __HOOKED_vkQueuePresentKHR(VkQueu
             vktrace_delete_trace_packet(&pHeader);
         }
     }
+    send_frame_boundary_packet(g_trimFrameCounter);
 
     g_trimFrameCounter++;
     if (g_trimEnabled) {
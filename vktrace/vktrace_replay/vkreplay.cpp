@@ -69,6 +69,10 @@ static vkreplayer_settings s_defaultVkReplaySettings = {
                                                             .instrumentationDelay = 0,
                                                             .preloadChunkSize = 200,
                                                             .skipGetFenceStatus = 0,
+                                                            .cpuProfile = NULL,
+                                                            .screenshotEncoding = NULL,
+                                                            .screenshotHashTile = 0,
+                                                            .libcollectorConfig = NULL,
 };
 
 vkReplay* g_pReplayer = NULL;
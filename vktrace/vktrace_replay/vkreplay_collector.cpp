@@ -0,0 +1,151 @@
+/*
+ * (C) COPYRIGHT 2020 ARM Limited
+ * ALL RIGHTS RESERVED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <fstream>
+#include <sstream>
+
+#include "vkreplay_collector.h"
+extern "C" {
+#include "vktrace_trace_packet_utils.h"
+}
+#include "vktrace_tracelog.h"
+#include <json/json.h>
+
+#if defined(VKREPLAY_USE_LIBCOLLECTOR)
+#include "interface.hpp"
+#endif
+
+namespace vktrace_replay {
+
+ReplayCollector* g_replayCollector = nullptr;
+
+#if defined(VKREPLAY_USE_LIBCOLLECTOR)
+
+ReplayCollector::~ReplayCollector() {
+    if (m_collection != nullptr) {
+        if (m_collection->is_running()) {
+            m_collection->stop();
+        }
+        delete m_collection;
+    }
+}
+
+bool ReplayCollector::init(const char* configPath) {
+    std::ifstream file(configPath);
+    if (!file.is_open()) {
+        vktrace_LogError("Failed to open the libcollector config %s.", configPath);
+        return false;
+    }
+    std::stringstream content;
+    content << file.rdbuf();
+    Json::Reader reader;
+    Json::Value config;
+    if (!reader.parse(content.str(), config)) {
+        vktrace_LogError("Failed to parse the libcollector config %s: %s", configPath, reader.getFormattedErrorMessages().c_str());
+        return false;
+    }
+
+    // The layer format has the collectors under "collectors", a plain Collection config is accepted too
+    m_resultPath = config.get("result_file_basename", "results.json").asString();
+    m_collection = new Collection(config.isMember("collectors") ? config["collectors"] : config);
+    if (!m_collection->initialize()) {
+        vktrace_LogError("A collector required by %s is not available.", configPath);
+        return false;
+    }
+    std::string enabled;
+    for (const std::string& name : m_collection->available()) {
+        if (config.isMember("collectors") ? config["collectors"].isMember(name) : config.isMember(name)) {
+            enabled += (enabled.empty() ? "" : ", ") + name;
+        }
+    }
+    vktrace_LogAlways("libcollector: sampling %s at each present of the frame range.", enabled.empty() ? "nothing" : enabled.c_str());
+    return true;
+}
+
+void ReplayCollector::start() {
+    if (m_started) {
+        return;
+    }
+    m_startTime = vktrace_get_time();
+    m_startCpuTime = std::clock();
+    m_collection->start();
+    m_started = true;
+}
+
+void ReplayCollector::present() {
+    if (m_started && m_collection->is_running()) {
+        m_collection->collect();
+        m_frames++;
+    }
+}
+
+bool ReplayCollector::finish(uint64_t startFrame, uint64_t endFrame, uint64_t loops) {
+    if (!m_started) {
+        vktrace_LogError("libcollector: the collectors were never started, no results written.");
+        return false;
+    }
+    m_collection->stop();
+    double wallTime = static_cast<double>(vktrace_get_time() - m_startTime) / NANOSEC_IN_ONE_SEC;
+    double cpuTime = static_cast<double>(std::clock() - m_startCpuTime) / CLOCKS_PER_SEC;
+
+    Json::Value results;
+    results["frames"] = static_cast<Json::UInt64>(m_frames);
+    results["start_frame"] = static_cast<Json::UInt64>(startFrame);
+    results["end_frame"] = static_cast<Json::UInt64>(endFrame);
+    results["loops"] = static_cast<Json::UInt64>(loops);
+    results["system_runtime_seconds"] = wallTime;
+    results["cpu_runtime_seconds"] = cpuTime;
+    results["fps"] = wallTime > 0.0 ? static_cast<double>(m_frames) / wallTime : 0.0;
+    results["frame_data"] = m_collection->results();
+
+    FILE* fp = fopen(m_resultPath.c_str(), "w");
+    if (fp == NULL) {
+        vktrace_LogError("Failed to open %s to write the libcollector results.", m_resultPath.c_str());
+        return false;
+    }
+    Json::StyledWriter writer;
+    std::string data = writer.write(results);
+    bool ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+    ok = fclose(fp) == 0 && ok;
+    if (ok) {
+        vktrace_LogAlways("libcollector results of frames %" PRIu64 "-%" PRIu64 " written to %s", startFrame, endFrame,
+                          m_resultPath.c_str());
+    } else {
+        vktrace_LogError("Failed to write the libcollector results to %s.", m_resultPath.c_str());
+    }
+    return ok;
+}
+
+#else
+
+ReplayCollector::~ReplayCollector() {}
+
+bool ReplayCollector::init(const char* configPath) {
+    vktrace_LogError("Can't load %s, vkreplay was built without libcollector.", configPath);
+    return false;
+}
+
+void ReplayCollector::start() {}
+
+void ReplayCollector::present() {}
+
+bool ReplayCollector::finish(uint64_t, uint64_t, uint64_t) { return false; }
+
+#endif  // VKREPLAY_USE_LIBCOLLECTOR
+
+}  // namespace vktrace_replay
@@ -0,0 +1,62 @@
+/*
+ * (C) COPYRIGHT 2020 ARM Limited
+ * ALL RIGHTS RESERVED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _VKREPLAY_COLLECTOR_H_
+#define _VKREPLAY_COLLECTOR_H_
+
+#include <cinttypes>
+#include <ctime>
+#include <string>
+
+class Collection;
+
+namespace vktrace_replay {
+
+/* Samples the libcollector collectors (perf, rusage, procfs, cpufreq...) of a JSON config at each present of the measured
+ * frame range, so their values line up with the replayed frames. The config is the one of the libcollector layer: the
+ * collectors are under "collectors" and the results are written to "result_file_basename" (results.json by default).
+ * None of the collectors need a display, they work with a headless replay as well. */
+class ReplayCollector {
+   public:
+    ReplayCollector() {}
+    ~ReplayCollector();
+
+    // Loads the config and initializes its collectors. Returns false if vkreplay was built without libcollector, the
+    // config can't be read or a collector marked as "required" isn't available.
+    bool init(const char* configPath);
+
+    // Starts the collectors at the beginning of the measured range
+    void start();
+    // Takes a sample of the collectors for the frame which was just presented, if they have been started
+    void present();
+    // Stops the collectors and writes the results along with the replayed frame range
+    bool finish(uint64_t startFrame, uint64_t endFrame, uint64_t loops);
+
+   private:
+    Collection* m_collection = nullptr;
+    std::string m_resultPath;
+    bool m_started = false;
+    uint64_t m_frames = 0;
+    uint64_t m_startTime = 0;
+    std::clock_t m_startCpuTime = 0;
+};
+
+extern ReplayCollector* g_replayCollector;
+
+}  // namespace vktrace_replay
+
+#endif  // _VKREPLAY_COLLECTOR_H_
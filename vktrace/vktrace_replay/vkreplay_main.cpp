@@ -43,23 +43,35 @@
 #include "vkreplay_seq.h"
 #include "vkreplay_vkdisplay.h"
 #include "vkreplay_preload.h"
+#include "vkreplay_profiler.h"
+#include "vkreplay_collector.h"
 #include "screenshot_parsing.h"
 #include "vktrace_vk_packet_id.h"
 #include "vkreplay_vkreplay.h"
 #include "decompressor.h"
+#include "blobstore.h"
 #include <json/json.h>
 
 extern vkReplay* g_replay;
 static decompressor* g_decompressor = nullptr;
+static blobcache* g_blobcache = nullptr;
+// The blob cache seeks and reads its own handle on the trace, the preload thread reads the other one
+static FILE* g_blobfp = NULL;
+static FileLike* g_blobFile = nullptr;
+static decompressor* g_blobDecompressor = nullptr;
 
 #if defined(ANDROID)
 const char* env_var_screenshot_frames = "debug.vulkan.screenshot";
 const char* env_var_screenshot_format = "debug.vulkan.screenshot.format";
 const char* env_var_screenshot_prefix = "debug.vulkan.screenshot.prefix";
+const char* env_var_screenshot_encoding = "debug.vulkan.screenshot.encoding";
+const char* env_var_screenshot_hash_tile = "debug.vulkan.screenshot.hashtile";
 #else
 const char* env_var_screenshot_frames = "VK_SCREENSHOT_FRAMES";
 const char* env_var_screenshot_format = "VK_SCREENSHOT_FORMAT";
 const char* env_var_screenshot_prefix = "VK_SCREENSHOT_PREFIX";
+const char* env_var_screenshot_encoding = "VK_SCREENSHOT_ENCODING";
+const char* env_var_screenshot_hash_tile = "VK_SCREENSHOT_HASH_TILE";
 #endif
 
 vktrace_SettingInfo g_settings_info[] = {
@@ -169,6 +181,20 @@ vktrace_SettingInfo g_settings_info[] = {
      {&replaySettings.screenshotPrefix},
      TRUE,
      "/path/to/snapshots/prefix- Must contain full path and a prefix, resulting screenshots will be named prefix-framenumber.ppm"},
+    {"se",
+     "ScreenshotEncoding",
+     VKTRACE_SETTING_STRING,
+     {&replaySettings.screenshotEncoding},
+     {&replaySettings.screenshotEncoding},
+     TRUE,
+     "Encoding of screenshot files: PPM, QOI, or HASH to only log a 128-bit hash of each screenshot to <prefix>framehash.log."},
+    {"sht",
+     "ScreenshotHashTile",
+     VKTRACE_SETTING_UINT,
+     {&replaySettings.screenshotHashTile},
+     {&replaySettings.screenshotHashTile},
+     TRUE,
+     "With -se HASH, also log the hashes of the <uint> x <uint> tiles of each screenshot, 0 for none."},
     {"pt",
      "EnablePortabilityTableSupport",
      VKTRACE_SETTING_BOOL,
@@ -336,7 +362,21 @@ vktrace_SettingInfo g_settings_info[] = {
      {&replaySettings.skipGetFenceStatus},
      {&replaySettings.skipGetFenceStatus},
      TRUE,
-     "Skip the GetFenceStatus() calls, 0 - Not skip; 1 - Skip all the unsuccess calls; 2 - Skip all calls."}
+     "Skip the GetFenceStatus() calls, 0 - Not skip; 1 - Skip all the unsuccess calls; 2 - Skip all calls."},
+    {"cpf",
+     "cpuProfile",
+     VKTRACE_SETTING_STRING,
+     {&replaySettings.cpuProfile},
+     {&replaySettings.cpuProfile},
+     TRUE,
+     "Profile the CPU time of each packet and write it to <string>.csv and <string>.folded (flame graph input)."},
+    {"lc",
+     "libcollectorConfig",
+     VKTRACE_SETTING_STRING,
+     {&replaySettings.libcollectorConfig},
+     {&replaySettings.libcollectorConfig},
+     TRUE,
+     "Load a libcollector JSON config, sample its collectors at each present of the frame range and write the results to its result_file_basename."}
 };
 
 vktrace_SettingGroup g_replaySettingGroup = {"vkreplay", sizeof(g_settings_info) / sizeof(g_settings_info[0]), &g_settings_info[0], nullptr};
@@ -366,12 +406,16 @@ void triggerScript() {
 
 unsigned int replay(vktrace_trace_packet_replay_library* replayer, vktrace_trace_packet_header* packet)
 {
+    unsigned int result;
+    profile_mark(PROFILE_POST);
     if (replaySettings.preloadTraceFile && timerStarted()) {    // the packet has already been interpreted during the preloading
-        return replayer->Replay(packet);
+        result = replayer->Replay(packet);
     }
     else {
-        return replayer->Replay(replayer->Interpret(packet));
+        result = replayer->Replay(replayer->Interpret(packet));
     }
+    profile_mark(PROFILE_REMAP);
+    return result;
 }
 
 int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_trace_packet_replay_library* replayerArray[]) {
@@ -392,6 +436,17 @@ int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_tra
     uint64_t end_time;
     uint64_t start_frame = replaySettings.loopStartFrame == UINT_MAX ? 0 : replaySettings.loopStartFrame;
     uint64_t end_frame = UINT_MAX;
+    if (replaySettings.libcollectorConfig != NULL) {
+        g_replayCollector = new ReplayCollector();
+        if (!g_replayCollector->init(replaySettings.libcollectorConfig)) {
+            delete g_replayCollector;
+            g_replayCollector = nullptr;
+            return -1;
+        }
+    }
+    if (replaySettings.cpuProfile != NULL) {
+        g_cpuProfiler = new CpuProfiler();
+    }
     if (start_frame == 0) {
         if (replaySettings.preloadTraceFile) {
             vktrace_LogAlways("Preloading trace file...");
@@ -403,6 +458,9 @@ int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_tra
         }
         timer_started = true;
         vktrace_LogAlways("================== Start timer (Frame: %llu) ==================", start_frame);
+        if (g_replayCollector != nullptr) {
+            g_replayCollector->start();
+        }
     }
     uint64_t start_time = vktrace_get_time();
     const char* screenshot_list = replaySettings.screenshotList;
@@ -420,9 +478,16 @@ int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_tra
         }
 
         while (trace_running) {
+            if (g_cpuProfiler != nullptr) {
+                g_cpuProfiler->begin_packet();
+            }
             packet = seq.get_next_packet();
             if (!packet) break;
 
+            if (g_cpuProfiler != nullptr) {
+                g_cpuProfiler->set_packet(packet->packet_id, g_replay != nullptr ? g_replay->get_frame_number() : 0);
+            }
+
             if (replaySettings.printCurrentGPI)
             {
                 vktrace_LogDebug("Replaying GPI %lu", packet->global_packet_index);
@@ -443,6 +508,10 @@ int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_tra
                 case VKTRACE_TPI_MARKER_CHECKPOINT:
                     break;
                 case VKTRACE_TPI_MARKER_API_BOUNDARY:
+                    if (g_cpuProfiler != nullptr &&
+                        packet->size >= sizeof(vktrace_trace_packet_header) + sizeof(vktrace_trace_packet_frame_boundary)) {
+                        g_cpuProfiler->add_capture_overhead(((vktrace_trace_packet_frame_boundary*)packet->pBody)->tracer_overhead);
+                    }
                     break;
                 case VKTRACE_TPI_MARKER_API_GROUP_BEGIN:
                     break;
@@ -452,6 +521,7 @@ int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_tra
                     break;
                 case VKTRACE_TPI_PORTABILITY_TABLE:
                 case VKTRACE_TPI_META_DATA:
+                case VKTRACE_TPI_BLOCK_TABLE:
                     break;
                 case VKTRACE_TPI_VK_vkQueuePresentKHR: {
                     if (replay(g_replayer_interface, packet) != VKTRACE_REPLAY_SUCCESS) {
@@ -468,6 +538,11 @@ int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_tra
                         usleep(replaySettings.instrumentationDelay);
                     }
 
+                    // Sample the collectors once per frame of the measured range, they are started below at the start frame
+                    if (g_replayCollector != nullptr) {
+                        g_replayCollector->present();
+                    }
+
                     if (g_pReplaySettings->triggerScript != UINT_MAX && g_pReplaySettings->pScriptPath != NULL && (frameNumber + 1) == g_pReplaySettings->triggerScript) {
                         triggerScript();
                     }
@@ -489,6 +564,9 @@ int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_tra
                         start_time = vktrace_get_time();
                         vktrace_LogAlways("================== Start timer (Frame: %llu) ==================", start_frame);
                         g_replayer_interface->SetInFrameRange(true);
+                        if (g_replayCollector != nullptr) {
+                            g_replayCollector->start();
+                        }
                     }
 
                     if (frameNumber == replaySettings.loopEndFrame) {
@@ -586,13 +664,40 @@ int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_tra
     } else {
         vktrace_LogError("fps error!");
     }
+    if (g_replayCollector != nullptr) {
+        g_replayCollector->finish(start_frame, end_frame, totalLoops);
+    }
 
 out:
+    if (g_cpuProfiler != nullptr) {
+        g_cpuProfiler->finish();
+        std::string csvPath = std::string(replaySettings.cpuProfile) + ".csv";
+        std::string foldedPath = std::string(replaySettings.cpuProfile) + ".folded";
+        if (g_cpuProfiler->write_csv(csvPath.c_str()) && g_cpuProfiler->write_collapsed(foldedPath.c_str())) {
+            vktrace_LogAlways("CPU profile written to %s and %s", csvPath.c_str(), foldedPath.c_str());
+        }
+        delete g_cpuProfiler;
+        g_cpuProfiler = nullptr;
+    }
+    if (g_replayCollector != nullptr) {
+        delete g_replayCollector;
+        g_replayCollector = nullptr;
+    }
     seq.clean_up();
     if (g_decompressor != nullptr) {
         delete g_decompressor;
         g_decompressor = nullptr;
     }
+    if (g_blobcache != nullptr) {
+        delete g_blobcache;
+        g_blobcache = nullptr;
+        delete g_blobDecompressor;
+        g_blobDecompressor = nullptr;
+        vktrace_free(g_blobFile);
+        g_blobFile = nullptr;
+        fclose(g_blobfp);
+        g_blobfp = NULL;
+    }
     if (replaySettings.screenshotList != NULL) {
         vktrace_free((char*)replaySettings.screenshotList);
         replaySettings.screenshotList = NULL;
@@ -681,6 +786,13 @@ static bool preloadPortabilityTablePackets() {
                 break;
             }
         }
+        if (pPacket->tracer_id == VKTRACE_TID_VULKAN_BLOB_REF) {
+            int ret = resolve_packet(g_blobcache, pPacket);
+            if (ret != 0) {
+                vktrace_LogError("Resolve blob reference packet error.");
+                break;
+            }
+        }
         pPacket = interpret_trace_packet_vk(pPacket);
         portabilityTablePackets[i] = (uintptr_t)pPacket;
         portabilityTableTotalPacketSize += pPacket->size;
@@ -883,6 +995,17 @@ int vkreplay_main(int argc, char** argv, vktrace_replay::ReplayDisplayImp* pDisp
         } else {
             vktrace_set_global_var(env_var_screenshot_prefix, "");
         }
+
+        // Set up environment for screenshot encoding, HASH logs the hashes of the screenshots instead of writing them
+        if (replaySettings.screenshotEncoding != NULL) {
+            vktrace_set_global_var(env_var_screenshot_encoding, replaySettings.screenshotEncoding);
+        } else {
+            vktrace_set_global_var(env_var_screenshot_encoding, "");
+        }
+        std::string hashTile = std::to_string(replaySettings.screenshotHashTile);
+        vktrace_set_global_var(env_var_screenshot_hash_tile, hashTile.c_str());
+    } else if (replaySettings.screenshotEncoding != NULL) {
+        vktrace_LogWarning("Screenshot encoding should be used when screenshot enabled!");
     }
 
     vktrace_LogAlways("Replaying with v%s", VKTRACE_VERSION);
@@ -1050,6 +1173,27 @@ int vkreplay_main(int argc, char** argv, vktrace_replay::ReplayDisplayImp* pDisp
         }
     }
 
+    // create the cache for payloads which were replaced by references at trace time
+    if (pFileHeader->bit_flags & VKTRACE_USE_BLOB_REFERENCES_BIT) {
+        const char* blobPath = tmpfilename.empty() ? pTraceFile : tmpfilename.c_str();
+        g_blobfp = fopen(blobPath, "rb");
+        if (g_blobfp == NULL) {
+            vktrace_LogError("Cannot open trace file: '%s'.", blobPath);
+            return -1;
+        }
+        if (g_decompressor != nullptr) {
+            g_blobDecompressor = create_decompressor((VKTRACE_COMPRESS_TYPE)pFileHeader->compress_type);
+            if (g_blobDecompressor == nullptr) {
+                vktrace_LogError("Create decompressor failed.");
+                fclose(g_blobfp);
+                g_blobfp = NULL;
+                return -1;
+            }
+        }
+        g_blobFile = vktrace_FileLike_create_file(g_blobfp);
+        g_blobcache = new blobcache(g_blobFile, g_blobDecompressor);
+    }
+
     // read the meta data json string
     if (pFileHeader->trace_file_version > VKTRACE_TRACE_FILE_VERSION_9 && pFileHeader->meta_data_offset > 0) {
         readMetaData(pFileHeader);
@@ -1202,8 +1346,8 @@ int vkreplay_main(int argc, char** argv, vktrace_replay::ReplayDisplayImp* pDisp
     }
 
     // main loop
-    uint64_t filesize = (pFileHeader->compress_type == VKTRACE_COMPRESS_TYPE_NONE) ? traceFile->mFileLen : fileHeader.decompress_file_size;
-    Sequencer sequencer(traceFile, g_decompressor, filesize);
+    uint64_t filesize = (pFileHeader->compress_type == VKTRACE_COMPRESS_TYPE_NONE && g_blobcache == nullptr) ? traceFile->mFileLen : fileHeader.decompress_file_size;
+    Sequencer sequencer(traceFile, g_decompressor, g_blobcache, filesize);
     err = vktrace_replay::main_loop(disp, sequencer, replayer);
 
     for (int i = 0; i < VKTRACE_MAX_TRACER_ID_ARRAY_SIZE; i++) {
@@ -108,7 +108,9 @@ struct preload_context {
 
 vktrace_trace_packet_header g_preload_header;
 vktrace_trace_packet_header_compression_ext g_preload_header_ext;
+vktrace_trace_packet_header_blob_ext g_preload_header_blob_ext;
 static decompressor* g_decompressor = nullptr;
+static blobcache* g_blobcache = nullptr;
 static char*        tmp_address     = nullptr;
 
 uint64_t get_preload_waiting_time_when_replaying()
@@ -198,6 +200,16 @@ static void get_packet_size(FileLike* file) {
             g_preload_context.next_pkt_size_decompressed = g_preload_header_ext.decompressed_size + sizeof(vktrace_trace_packet_header);
         }
     }
+    else if (g_preload_header.tracer_id == VKTRACE_TID_VULKAN_BLOB_REF) {      // a packet referencing an earlier payload
+        if (vktrace_FileLike_ReadRaw(file, &g_preload_header_blob_ext, sizeof(vktrace_trace_packet_header_blob_ext)) == FALSE) {
+            g_preload_context.next_pkt_size = 0;
+            g_preload_context.next_pkt_size_decompressed = 0;
+            return;
+        }
+        else {
+            g_preload_context.next_pkt_size_decompressed = g_preload_header_blob_ext.original_size;
+        }
+    }
     else {      // an uncompressed packet
         g_preload_context.next_pkt_size_decompressed = g_preload_header.size;
     }
@@ -231,6 +243,24 @@ static uint64_t load_packet(FileLike* file, void* load_addr, uint64_t packet_siz
         memcpy(pHeader, preload_mem, preload_mem->size);
         vktrace_free(preload_mem);
     }
+    else if (g_preload_header.tracer_id == VKTRACE_TID_VULKAN_BLOB_REF) {
+        vktrace_trace_packet_header* preload_mem = (vktrace_trace_packet_header*)vktrace_malloc(g_preload_header.size);
+        memcpy(preload_mem, &g_preload_header, sizeof(vktrace_trace_packet_header));
+        memcpy(preload_mem + 1, &g_preload_header_blob_ext, sizeof(vktrace_trace_packet_header_blob_ext));
+        if (vktrace_FileLike_ReadRaw(file, (char *)preload_mem + sizeof(vktrace_trace_packet_header) + sizeof(vktrace_trace_packet_header_blob_ext),
+                    (size_t)g_preload_header.size - sizeof(vktrace_trace_packet_header) - sizeof(vktrace_trace_packet_header_blob_ext)) == FALSE) {
+            vktrace_LogError("Failed to read trace packet with size of %llu.", g_preload_header.size);
+            vktrace_free(preload_mem);
+            return 0;
+        }
+        if (resolve_packet(g_blobcache, preload_mem) != 0) {
+            vktrace_LogError("Failed to resolve blob reference packet with size of %llu.", g_preload_header.size);
+            vktrace_free(preload_mem);
+            return 0;
+        }
+        memcpy(pHeader, preload_mem, preload_mem->size);
+        vktrace_free(preload_mem);
+    }
     else {
         pHeader->size = g_preload_header.size;
         memcpy(pHeader, &g_preload_header, sizeof(vktrace_trace_packet_header));
@@ -274,6 +304,7 @@ static uint64_t load_packet(FileLike* file, void* load_addr, uint64_t packet_siz
             break;
         case VKTRACE_TPI_META_DATA:
         case VKTRACE_TPI_PORTABILITY_TABLE:
+        case VKTRACE_TPI_BLOCK_TABLE:
             break;
         case VKTRACE_TPI_VK_vkQueuePresentKHR: {
             vktrace_trace_packet_header* res = replayer->Interpret(pHeader);
@@ -521,8 +552,9 @@ static void chunk_loading() {
     }
 }
 
-bool init_preload(FileLike* file, vktrace_replay::vktrace_trace_packet_replay_library *replayer_array[], decompressor* decompressor, uint64_t filesize) {
+bool init_preload(FileLike* file, vktrace_replay::vktrace_trace_packet_replay_library *replayer_array[], decompressor* decompressor, blobcache* blobs, uint64_t filesize) {
     g_decompressor = decompressor;
+    g_blobcache = blobs;
     replayerArray = replayer_array;
     bool ret = true;
     uint64_t system_free_mem_size = get_free_memory_size();
@@ -20,8 +20,9 @@
 #include <cinttypes>
 #include "vkreplay_factory.h"
 #include "decompressor.h"
+#include "blobstore.h"
 
-bool init_preload(FileLike* file, vktrace_replay::vktrace_trace_packet_replay_library *replayer_array[], decompressor* decompressor, uint64_t filesize);
+bool init_preload(FileLike* file, vktrace_replay::vktrace_trace_packet_replay_library *replayer_array[], decompressor* decompressor, blobcache* blobs, uint64_t filesize);
 vktrace_trace_packet_header* preload_get_next_packet();
 void exit_preload();
 uint64_t get_preload_waiting_time_when_replaying();
@@ -0,0 +1,126 @@
+/*
+ * (C) COPYRIGHT 2020 ARM Limited
+ * ALL RIGHTS RESERVED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include "vkreplay_profiler.h"
+#include "vktrace_tracelog.h"
+#include "vktrace_vk_packet_id.h"
+
+namespace vktrace_replay {
+
+CpuProfiler* g_cpuProfiler = nullptr;
+
+static const char* s_phaseNames[PROFILE_PHASE_COUNT] = {"fetch", "decompress", "remap", "driver", "post"};
+
+static const char* profile_packet_name(uint32_t packet_id) {
+    switch (packet_id) {
+        case VKTRACE_TPI_MESSAGE:
+            return "Message";
+        case VKTRACE_TPI_MARKER_API_BOUNDARY:
+            return "FrameBoundary";
+        case VKTRACE_TPI_MARKER_CHECKPOINT:
+        case VKTRACE_TPI_MARKER_API_GROUP_BEGIN:
+        case VKTRACE_TPI_MARKER_API_GROUP_END:
+        case VKTRACE_TPI_MARKER_TERMINATE_PROCESS:
+            return "Marker";
+        case VKTRACE_TPI_PORTABILITY_TABLE:
+            return "PortabilityTable";
+        case VKTRACE_TPI_META_DATA:
+            return "MetaData";
+        case VKTRACE_TPI_BLOCK_TABLE:
+            return "BlockTable";
+        default:
+            break;
+    }
+    const char* name = vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)packet_id);
+    return name != NULL ? name : "Unknown";
+}
+
+void CpuProfiler::begin_packet() {
+    finish();
+    for (uint32_t i = 0; i < PROFILE_PHASE_COUNT; i++) {
+        m_times[i] = 0;
+    }
+    m_captureOverhead = 0;
+    m_driverSinceMark = 0;
+    m_mark = vktrace_get_time();
+}
+
+void CpuProfiler::finish() {
+    if (!m_hasPacket) {
+        return;
+    }
+    mark(PROFILE_POST);
+    ProfileStat& stat = m_stats[std::make_pair(m_frame, m_packetId)];
+    stat.count++;
+    for (uint32_t i = 0; i < PROFILE_PHASE_COUNT; i++) {
+        stat.times[i] += m_times[i];
+    }
+    stat.captureOverhead += m_captureOverhead;
+    m_hasPacket = false;
+}
+
+bool CpuProfiler::write_csv(const char* path) const {
+    FILE* fp = fopen(path, "w");
+    if (fp == NULL) {
+        vktrace_LogError("Failed to open %s to write the CPU profile.", path);
+        return false;
+    }
+    fprintf(fp, "frame,packet_id,name,count");
+    for (uint32_t i = 0; i < PROFILE_PHASE_COUNT; i++) {
+        fprintf(fp, ",%s_ns", s_phaseNames[i]);
+    }
+    fprintf(fp, ",capture_ns\n");
+    for (auto& it : m_stats) {
+        fprintf(fp, "%" PRIu64 ",%u,%s,%" PRIu64, it.first.first, it.first.second, profile_packet_name(it.first.second),
+                it.second.count);
+        for (uint32_t i = 0; i < PROFILE_PHASE_COUNT; i++) {
+            fprintf(fp, ",%" PRIu64, it.second.times[i]);
+        }
+        fprintf(fp, ",%" PRIu64 "\n", it.second.captureOverhead);
+    }
+    fclose(fp);
+    return true;
+}
+
+bool CpuProfiler::write_collapsed(const char* path) const {
+    FILE* fp = fopen(path, "w");
+    if (fp == NULL) {
+        vktrace_LogError("Failed to open %s to write the CPU profile.", path);
+        return false;
+    }
+    // The frames are folded together, a flame graph per frame would mostly show the same stacks
+    std::map<uint32_t, ProfileStat> totals;
+    for (auto& it : m_stats) {
+        ProfileStat& total = totals[it.first.second];
+        for (uint32_t i = 0; i < PROFILE_PHASE_COUNT; i++) {
+            total.times[i] += it.second.times[i];
+        }
+    }
+    for (auto& it : totals) {
+        for (uint32_t i = 0; i < PROFILE_PHASE_COUNT; i++) {
+            if (it.second.times[i] > 0) {
+                fprintf(fp, "vkreplay;%s;%s %" PRIu64 "\n", profile_packet_name(it.first), s_phaseNames[i], it.second.times[i]);
+            }
+        }
+    }
+    fclose(fp);
+    return true;
+}
+
+}  // namespace vktrace_replay
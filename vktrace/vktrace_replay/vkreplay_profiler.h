@@ -0,0 +1,112 @@
+/*
+ * (C) COPYRIGHT 2020 ARM Limited
+ * ALL RIGHTS RESERVED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _VKREPLAY_PROFILER_H_
+#define _VKREPLAY_PROFILER_H_
+
+#include <cinttypes>
+#include <map>
+#include <utility>
+
+extern "C" {
+#include "vktrace_trace_packet_utils.h"
+}
+
+namespace vktrace_replay {
+
+enum ProfilePhase {
+    PROFILE_FETCH = 0,   // reading the packet from the file or waiting for the preload thread
+    PROFILE_DECOMPRESS,  // decompressing the packet and resolving blob references
+    PROFILE_REMAP,       // interpreting the packet and remapping its handles, everything in Replay() but the driver call
+    PROFILE_DRIVER,      // the Vulkan entrypoint itself
+    PROFILE_POST,        // frame control, screenshots, window events... after the packet has been replayed
+    PROFILE_PHASE_COUNT
+};
+
+/* Per-packet CPU profiler of the replay loop. The sequencer and main_loop mark the end of each phase, the generated
+ * replay code brackets the driver calls. Times are aggregated by (frame, packet_id) and written at the end of the replay
+ * as CSV and as collapsed stacks which can be fed to flamegraph.pl.
+ */
+class CpuProfiler {
+   public:
+    CpuProfiler() {}
+
+    // Starts a new packet, the previous one (if any) is committed first
+    void begin_packet();
+    void set_packet(uint32_t packet_id, uint64_t frame) {
+        m_packetId = packet_id;
+        m_frame = frame;
+        m_hasPacket = true;
+    }
+    // Charges the time since the last mark to 'phase'. Driver time spent in between is never charged twice.
+    void mark(ProfilePhase phase) {
+        uint64_t now = vktrace_get_time();
+        uint64_t elapsed = now - m_mark;
+        m_times[phase] += elapsed > m_driverSinceMark ? elapsed - m_driverSinceMark : 0;
+        m_driverSinceMark = 0;
+        m_mark = now;
+    }
+    void driver_begin() { m_driverStart = vktrace_get_time(); }
+    void driver_end() {
+        uint64_t elapsed = vktrace_get_time() - m_driverStart;
+        m_times[PROFILE_DRIVER] += elapsed;
+        m_driverSinceMark += elapsed;
+    }
+    // Adds the capture overhead of a frame, from its frame boundary packet, to the current packet
+    void add_capture_overhead(uint64_t overhead) { m_captureOverhead += overhead; }
+    // Commits the last packet
+    void finish();
+
+    bool write_csv(const char* path) const;
+    bool write_collapsed(const char* path) const;
+
+   private:
+    struct ProfileStat {
+        uint64_t count = 0;
+        uint64_t times[PROFILE_PHASE_COUNT] = {};
+        uint64_t captureOverhead = 0;
+    };
+
+    std::map<std::pair<uint64_t, uint32_t>, ProfileStat> m_stats;
+    uint64_t m_times[PROFILE_PHASE_COUNT] = {};
+    uint64_t m_captureOverhead = 0;
+    uint64_t m_mark = 0;
+    uint64_t m_driverStart = 0;
+    uint64_t m_driverSinceMark = 0;
+    uint64_t m_frame = 0;
+    uint32_t m_packetId = 0;
+    bool m_hasPacket = false;
+};
+
+extern CpuProfiler* g_cpuProfiler;
+
+// Called around every driver call of the generated replay code
+inline void profile_driver_begin() {
+    if (g_cpuProfiler != nullptr) g_cpuProfiler->driver_begin();
+}
+
+inline void profile_driver_end() {
+    if (g_cpuProfiler != nullptr) g_cpuProfiler->driver_end();
+}
+
+inline void profile_mark(ProfilePhase phase) {
+    if (g_cpuProfiler != nullptr) g_cpuProfiler->mark(phase);
+}
+
+}  // namespace vktrace_replay
+
+#endif /* _VKREPLAY_PROFILER_H_ */
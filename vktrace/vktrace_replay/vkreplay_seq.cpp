@@ -21,6 +21,7 @@
  **************************************************************************/
 #include "vkreplay_seq.h"
 #include "vkreplay_main.h"
+#include "vkreplay_profiler.h"
 
 extern "C" {
 #include "vktrace_trace_packet_utils.h"
@@ -36,19 +37,33 @@ vktrace_trace_packet_header *Sequencer::get_next_packet() {
         m_lastPacket = vktrace_read_trace_packet(m_pFile);
         if (!m_lastPacket)
             return 0;
+        profile_mark(PROFILE_FETCH);
         if (m_lastPacket->tracer_id == VKTRACE_TID_VULKAN_COMPRESSED) {
             int ret = decompress_packet(m_decompressor, m_lastPacket);
             if (ret != 0)
                 return 0;
         }
+        if (m_lastPacket->tracer_id == VKTRACE_TID_VULKAN_BLOB_REF) {
+            int ret = resolve_packet(m_blobcache, m_lastPacket);
+            if (ret != 0)
+                return 0;
+        }
+        profile_mark(PROFILE_DECOMPRESS);
     } else {
         if (timerStarted()) // preload, and already in the preloading range
         {
             m_lastPacket = preload_get_next_packet();
+            profile_mark(PROFILE_FETCH);
         }
         else {              // preload, but not in the preloading range
             vktrace_delete_trace_packet_no_lock(&m_lastPacket);
             m_lastPacket = vktrace_read_trace_packet(m_pFile);
+            profile_mark(PROFILE_FETCH);
+            if (m_lastPacket && m_lastPacket->tracer_id == VKTRACE_TID_VULKAN_BLOB_REF) {
+                if (resolve_packet(m_blobcache, m_lastPacket) != 0)
+                    return 0;
+            }
+            profile_mark(PROFILE_DECOMPRESS);
         }
     }
     return m_lastPacket;
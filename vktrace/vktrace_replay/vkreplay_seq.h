@@ -32,6 +32,7 @@ extern "C" {
 #include "vkreplay_preload.h"
 #include "vkreplay_factory.h"
 #include "decompressor.h"
+#include "blobstore.h"
 
 /* Class to handle fetching and sequencing packets from a tracefile.
  * Contains no knowledge of type of tracer needed to process packet.
@@ -53,7 +54,7 @@ class AbstractSequencer {
 
 class Sequencer : public AbstractSequencer {
    public:
-    Sequencer(FileLike *pFile, decompressor* decom, uint64_t filesize) : m_lastPacket(NULL), m_pFile(pFile), m_chunkEnabled(false), m_decompressor(decom), m_decompressFilesize(filesize) {}
+    Sequencer(FileLike *pFile, decompressor* decom, blobcache* blobs, uint64_t filesize) : m_lastPacket(NULL), m_pFile(pFile), m_chunkEnabled(false), m_decompressor(decom), m_blobcache(blobs), m_decompressFilesize(filesize) {}
     ~Sequencer() { this->clean_up(); }
 
     void clean_up() {
@@ -71,7 +72,7 @@ class Sequencer : public AbstractSequencer {
     void record_bookmark();
     void set_lastPacket(vktrace_trace_packet_header *newPacket);
     bool start_preload(vktrace_replay::vktrace_trace_packet_replay_library *replayer_array[], decompressor* decompressor) {
-        m_chunkEnabled = init_preload(m_pFile, replayer_array, decompressor, m_decompressFilesize);
+        m_chunkEnabled = init_preload(m_pFile, replayer_array, decompressor, m_blobcache, m_decompressFilesize);
         return m_chunkEnabled;
     };
 
@@ -81,6 +82,7 @@ class Sequencer : public AbstractSequencer {
     FileLike *m_pFile;
     bool m_chunkEnabled;
     decompressor* m_decompressor;
+    blobcache* m_blobcache;
     uint64_t m_decompressFilesize = 0;
 };
 
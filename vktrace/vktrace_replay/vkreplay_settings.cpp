@@ -65,6 +65,10 @@ static vkreplayer_settings s_defaultVkReplaySettings = {
                                                             .instrumentationDelay = 0,
                                                             .preloadChunkSize = 200,
                                                             .skipGetFenceStatus = 0,
+                                                            .cpuProfile = NULL,
+                                                            .screenshotEncoding = NULL,
+                                                            .screenshotHashTile = 0,
+                                                            .libcollectorConfig = NULL,
                                                        };
 
 vktrace_SettingInfo g_vk_settings_info[] = {
@@ -162,6 +166,20 @@ vktrace_SettingInfo g_vk_settings_info[] = {
      {&s_defaultVkReplaySettings.screenshotPrefix},
      TRUE,
      "/path/to/snapshots/prefix- Must contain full path and a prefix, resulting screenshots will be named prefix-framenumber.ppm"},
+    {"se",
+     "ScreenshotEncoding",
+     VKTRACE_SETTING_STRING,
+     {&g_vkReplaySettings.screenshotEncoding},
+     {&s_defaultVkReplaySettings.screenshotEncoding},
+     TRUE,
+     "Encoding of screenshot files: PPM, QOI, or HASH to only log a 128-bit hash of each screenshot to <prefix>framehash.log."},
+    {"sht",
+     "ScreenshotHashTile",
+     VKTRACE_SETTING_UINT,
+     {&g_vkReplaySettings.screenshotHashTile},
+     {&s_defaultVkReplaySettings.screenshotHashTile},
+     TRUE,
+     "With -se HASH, also log the hashes of the <uint> x <uint> tiles of each screenshot, 0 for none."},
     {"pt",
      "EnablePortabilityTableSupport",
      VKTRACE_SETTING_BOOL,
@@ -310,7 +328,21 @@ vktrace_SettingInfo g_vk_settings_info[] = {
      {&g_vkReplaySettings.skipGetFenceStatus},
      {&s_defaultVkReplaySettings.skipGetFenceStatus},
      TRUE,
-     "Skip the GetFenceStatus() calls, 0 - Not skip; 1 - Skip all the unsuccess calls; 2 - Skip all calls."}
+     "Skip the GetFenceStatus() calls, 0 - Not skip; 1 - Skip all the unsuccess calls; 2 - Skip all calls."},
+    {"cpf",
+     "cpuProfile",
+     VKTRACE_SETTING_STRING,
+     {&g_vkReplaySettings.cpuProfile},
+     {&s_defaultVkReplaySettings.cpuProfile},
+     TRUE,
+     "Profile the CPU time of each packet and write it to <string>.csv and <string>.folded (flame graph input)."},
+    {"lc",
+     "libcollectorConfig",
+     VKTRACE_SETTING_STRING,
+     {&g_vkReplaySettings.libcollectorConfig},
+     {&s_defaultVkReplaySettings.libcollectorConfig},
+     TRUE,
+     "Load a libcollector JSON config, sample its collectors at each present of the frame range and write the results to its result_file_basename."}
 };
 
 vktrace_SettingGroup g_vkReplaySettingGroup = {"vkreplay_vk", sizeof(g_vk_settings_info) / sizeof(g_vk_settings_info[0]),
@@ -32,6 +32,7 @@
 #include "vkreplay.h"
 #include "vkreplay_settings.h"
 #include "vkreplay_main.h"
+#include "vkreplay_profiler.h"
 #include "vktrace_vk_vk_packets.h"
 #include "vk_enum_string_helper.h"
 #include "vktrace_vk_packet_id.h"
@@ -174,6 +175,10 @@ vkreplayer_settings replaySettings = {
                                         .instrumentationDelay = 0,
                                         .preloadChunkSize = 200,
                                         .skipGetFenceStatus = 0,
+                                        .cpuProfile = NULL,
+                                        .screenshotEncoding = NULL,
+                                        .screenshotHashTile = 0,
+                                        .libcollectorConfig = NULL,
                                      };
 
 namespace vktrace_replay {
@@ -1687,7 +1692,9 @@ VkResult vkReplay::manually_replay_vkQueueSubmit(packet_vkQueueSubmit *pPacket)
             }
         }
     }
+    vktrace_replay::profile_driver_begin();
     replayResult = m_vkDeviceFuncs.QueueSubmit(remappedQueue, pPacket->submitCount, remappedSubmits, remappedFence);
+    vktrace_replay::profile_driver_end();
     return replayResult;
 }
 
@@ -2995,6 +3002,7 @@ VkResult vkReplay::manually_replay_vkWaitForFences(packet_vkWaitForFences *pPack
             return VK_ERROR_VALIDATION_FAILED_EXT;
         }
     }
+    vktrace_replay::profile_driver_begin();
     if (pPacket->result == VK_SUCCESS) {
         replayResult = m_vkDeviceFuncs.WaitForFences(remappedDevice, pPacket->fenceCount, pFence, pPacket->waitAll,
                                                      UINT64_MAX);  // mean as long as possible
@@ -3006,6 +3014,7 @@ VkResult vkReplay::manually_replay_vkWaitForFences(packet_vkWaitForFences *pPack
                 m_vkDeviceFuncs.WaitForFences(remappedDevice, pPacket->fenceCount, pFence, pPacket->waitAll, pPacket->timeout);
         }
     }
+    vktrace_replay::profile_driver_end();
     return replayResult;
 }
 
@@ -6014,7 +6023,9 @@ VkResult vkReplay::manually_replay_vkQueuePresentKHR(packet_vkQueuePresentKHR *p
             present.pResults = pResults;
         }
 
+        vktrace_replay::profile_driver_begin();
         replayResult = m_vkDeviceFuncs.QueuePresentKHR(remappedQueue, &present);
+        vktrace_replay::profile_driver_end();
 
         m_frameNumber++;
 
@@ -6111,7 +6122,9 @@ VkResult vkReplay::manually_replay_vkAcquireNextImageKHR(packet_vkAcquireNextIma
             }
         }
     } else {
+        vktrace_replay::profile_driver_begin();
         replayResult = m_vkDeviceFuncs.AcquireNextImageKHR(remappeddevice, remappedswapchain, pPacket->timeout, remappedsemaphore, remappedfence, &local_pImageIndex);
+        vktrace_replay::profile_driver_end();
     }
     if (replayResult == VK_SUCCESS) {
         m_objMapper.add_to_pImageIndex_map(*(pPacket->pImageIndex), local_pImageIndex);
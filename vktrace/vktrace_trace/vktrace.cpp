@@ -36,6 +36,7 @@ extern "C" {
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <json/json.h>
+#include <string>
 
 #include "screenshot_parsing.h"
 
@@ -168,6 +169,47 @@ vktrace_SettingInfo g_settings_info[] = {
      TRUE,
      "The compression threashold size. The package would be compressed only if they are larger than this value.\n\
                                         Default value is 1024(1KB)."},
+    {"dt",
+     "DedupThreshold",
+     VKTRACE_SETTING_UINT,
+     {&g_settings.dedupThreshold},
+     {&g_default_settings.dedupThreshold},
+     TRUE,
+     "Replace repeated vkFlushMappedMemoryRanges, vkCmdUpdateBuffer and vkCmdPushConstants payloads of at least\n\
+                                        this many bytes by a reference to their first occurrence. Default value is 0 (disabled)."},
+    {"ohr",
+     "OverheadReport",
+     VKTRACE_SETTING_UINT,
+     {&g_settings.overheadReportCount},
+     {&g_default_settings.overheadReportCount},
+     TRUE,
+     "Number of entrypoints listed in the capture overhead report printed when the trace file is closed,\n\
+                                        sorted by the time vktrace spent tracing them. Default value is 10, 0 disables the report."},
+    {"tp",
+     "Transport",
+     VKTRACE_SETTING_STRING,
+     {&g_settings.transport},
+     {&g_default_settings.transport},
+     TRUE,
+     "How the trace layer sends packets to vktrace: auto or tcp. auto uses a shared memory ring when the\n\
+                                        application runs on the same Linux host, tcp always uses the socket. Default value is auto."},
+    {"cbs",
+     "ChecksumBlockSize",
+     VKTRACE_SETTING_UINT,
+     {&g_settings.checksumBlockSize},
+     {&g_default_settings.checksumBlockSize},
+     TRUE,
+     "Size in KB of the blocks of the trace file which get a CRC32C in the block table, so that vktracedump -v can check\n\
+                                        the trace and skip corrupted blocks. Default value is 0 (no block table)."},
+    {"it",
+     "InputTrace",
+     VKTRACE_SETTING_STRING,
+     {&g_settings.input_trace},
+     {&g_default_settings.input_trace},
+     TRUE,
+     "Trim an existing trace file offline. The trace is replayed by vkreplay (or -p) with the vktrace layer\n\
+                                        enabled, and the frame range given by -tr frames-<startFrame>-<endFrame> is\n\
+                                        written to -o as a standalone trace."},
 };
 
 vktrace_SettingGroup g_settingGroup = {"vktrace", sizeof(g_settings_info) / sizeof(g_settings_info[0]), &g_settings_info[0]};
@@ -297,6 +339,32 @@ void vktrace_resetFilesize(FILE* pTraceFile, uint64_t decompressFilesize) {
     }
 }
 
+uint64_t vktrace_appendBlockTable(FILE* pTraceFile, const std::vector<uint8_t>& blockTable) {
+    vktrace_trace_packet_header hdr;
+    hdr.size = sizeof(hdr) + blockTable.size();
+    hdr.global_packet_index = lastPacketIndex++;
+    hdr.tracer_id = VKTRACE_TID_VULKAN;
+    hdr.packet_id = VKTRACE_TPI_BLOCK_TABLE;
+    hdr.thread_id = lastPacketThreadId;
+    hdr.vktrace_begin_time = hdr.entrypoint_begin_time = hdr.entrypoint_end_time = hdr.vktrace_end_time = lastPacketEndTime;
+    hdr.next_buffers_offset = 0;
+    hdr.pBody = (uintptr_t)NULL;
+
+    if (0 != Fseek(pTraceFile, 0, SEEK_END)) {
+        vktrace_LogError("File operation failed during append the block table");
+        return 0;
+    }
+    uint64_t block_table_offset = Ftell(pTraceFile);
+    if (1 != fwrite(&hdr, sizeof(hdr), 1, pTraceFile) ||
+        blockTable.size() != fwrite(blockTable.data(), 1, blockTable.size(), pTraceFile) ||
+        0 != Fseek(pTraceFile, offsetof(vktrace_trace_file_header, block_table_offset), SEEK_SET) ||
+        1 != fwrite(&block_table_offset, sizeof(uint64_t), 1, pTraceFile)) {
+        vktrace_LogError("Failed to write the block table");
+        return 0;
+    }
+    return hdr.size;
+}
+
 uint32_t vktrace_appendMetaData(FILE* pTraceFile, const std::vector<uint64_t>& injectedData, uint64_t &meta_data_offset) {
     Json::Value root;
     Json::Value injectedCallList;
@@ -423,6 +491,10 @@ int main(int argc, char* argv[]) {
     g_default_settings.enable_trim_post_processing = false;
     g_default_settings.compressType = "lz4";
     g_default_settings.compressThreshold = 1024;
+    g_default_settings.dedupThreshold = 0;
+    g_default_settings.overheadReportCount = 10;
+    g_default_settings.transport = "auto";
+    g_default_settings.checksumBlockSize = 0;
 
     // Check to see if the PAGEGUARD_PAGEGUARD_ENABLE_ENV env var is set.
     // If it is set to anything but "1", set the default to false.
@@ -476,6 +548,11 @@ int main(int argc, char* argv[]) {
         }
         vktrace_set_global_var(_VKTRACE_VERBOSITY_ENV, g_settings.verbosity);
 
+        if (strcmp(g_settings.transport, "auto") != 0 && strcmp(g_settings.transport, "tcp") != 0) {
+            vktrace_LogError("Transport must be auto or tcp.");
+            validArgs = FALSE;
+        }
+
         if (g_settings.screenshotList) {
             if (!screenshot::checkParsingFrameRange(g_settings.screenshotList)) {
                 vktrace_LogError("Screenshot range error");
@@ -498,6 +575,39 @@ int main(int argc, char* argv[]) {
             vktrace_set_global_var("VK_SCREENSHOT_FORMAT", "");
         }
 
+        // Offline trim: replay the input trace through the vktrace layer and let trim capture the requested frames
+        if (g_settings.input_trace != NULL && strlen(g_settings.input_trace) > 0) {
+            uint64_t trimStartFrame = 0, trimEndFrame = 0;
+            if (g_settings.traceTrigger == NULL ||
+                sscanf(g_settings.traceTrigger, "frames-%" PRIu64 "-%" PRIu64, &trimStartFrame, &trimEndFrame) != 2 ||
+                trimStartFrame > trimEndFrame) {
+                vktrace_LogError("InputTrace (-it) requires a frame range trigger: -tr frames-<startFrame>-<endFrame>.");
+                validArgs = FALSE;
+            } else {
+                if (g_settings.program == NULL || strlen(g_settings.program) == 0) {
+                    char* exeDir = vktrace_platform_get_current_executable_directory();
+#if defined(WIN32)
+                    g_settings.program = vktrace_copy_and_append(exeDir, "\\", "vkreplay.exe");
+#else
+                    g_settings.program = vktrace_copy_and_append(exeDir, "/", "vkreplay");
+#endif
+                    vktrace_free(exeDir);
+                }
+                // Stop replay right after the trim end frame, nothing past it ends up in the trimmed trace. The path is quoted,
+                // the arguments are split at spaces.
+                std::string replayArgs = std::string("-o \"") + g_settings.input_trace + "\" -lef " + std::to_string(trimEndFrame + 1);
+                if (g_settings.arguments != NULL && strlen(g_settings.arguments) > 0) {
+                    replayArgs += " ";
+                    replayArgs += g_settings.arguments;
+                }
+                // Freed with the other settings, like the arguments of -a which it replaces
+                vktrace_free((void*)g_settings.arguments);
+                g_settings.arguments = vktrace_allocate_and_copy(replayArgs.c_str());
+                vktrace_LogAlways("Trimming frames %" PRIu64 "-%" PRIu64 " of %s offline.", trimStartFrame, trimEndFrame,
+                                  g_settings.input_trace);
+            }
+        }
+
         if (validArgs == FALSE) {
             vktrace_SettingGroup_print(&g_settingGroup);
             return -1;
@@ -527,6 +637,7 @@ int main(int argc, char* argv[]) {
     vktrace_set_global_var(VKTRACE_PMB_ENABLE_ENV, g_settings.enable_pmb ? "1" : "0");
     vktrace_set_global_var(VKTRACE_TRIM_POST_PROCESS_ENV, g_settings.enable_trim_post_processing ? "1" : "0");
     vktrace_set_global_var(VKTRACE_ENABLE_TRACE_LOCK_ENV, g_settings.enable_trace_lock ? "1" : "0");
+    vktrace_set_global_var(VKTRACE_LIB_TRANSPORT_ENV, g_settings.transport);
 
     if (g_settings.traceTrigger) {
         // Export list to screenshot layer
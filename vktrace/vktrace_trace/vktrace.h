@@ -51,6 +51,11 @@ typedef struct vktrace_settings {
     const char* trimCmdBatchSizeStr;
     const char* compressType;
     unsigned int compressThreshold;
+    const char* input_trace;
+    unsigned int dedupThreshold;
+    unsigned int overheadReportCount;
+    const char* transport;
+    unsigned int checksumBlockSize;
 } vktrace_settings;
 
 extern vktrace_settings g_settings;
@@ -61,4 +66,5 @@ extern uint64_t lastPacketEndTime;
 void vktrace_appendPortabilityPacket(FILE* pTraceFile, std::vector<uint64_t>& portabilityTable);
 uint32_t vktrace_appendMetaData(FILE* pTraceFile, const std::vector<uint64_t>& injectedData, uint64_t &meta_data_offset);
 uint32_t vktrace_appendDeviceFeatures(FILE* pTraceFile, const std::unordered_map<VkDevice, uint32_t>& deviceToFeatures, uint64_t meta_data_offset);
-void vktrace_resetFilesize(FILE* pTraceFile, uint64_t decompressFilesize);
\ No newline at end of file
+void vktrace_resetFilesize(FILE* pTraceFile, uint64_t decompressFilesize);
+uint64_t vktrace_appendBlockTable(FILE* pTraceFile, const std::vector<uint8_t>& blockTable);
\ No newline at end of file
@@ -36,6 +36,8 @@
 
 #include <vector>
 #include <unordered_map>
+#include <algorithm>
+#include <cinttypes>
 
 #if defined(WIN32)
 #include <TlHelp32.h>
@@ -48,6 +50,8 @@ extern "C" {
 #include "vktrace_vk_packet_id.h"
 }
 #include "compressor.h"
+#include "blobstore.h"
+#include "blockchecksum.h"
 #include <cstddef>
 
 const unsigned long kWatchDogPollTime = 250;
@@ -213,6 +217,44 @@ bool CreateAdditionalRecordTraceThread(vktrace_process_info* pInfo) {
     return create_additional_record_trace_thread;
 }
 
+// Find the payload which may be replaced by a reference to an identical earlier one.
+// The payload is the last buffer added to the packet, so it runs up to next_buffers_offset.
+static bool getDedupPayload(const vktrace_trace_packet_header* pHeader, uint64_t& blobOffset, uint64_t& blobSize) {
+    uint64_t bodyOffset = 0;
+    switch (pHeader->packet_id) {
+        case VKTRACE_TPI_VK_vkFlushMappedMemoryRanges: {
+            const packet_vkFlushMappedMemoryRanges* pPacket = (const packet_vkFlushMappedMemoryRanges*)pHeader->pBody;
+            if (pPacket->ppData != NULL) {
+                // the mapped memory of all ranges follows the ppData offset array
+                bodyOffset = (uint64_t)pPacket->ppData + sizeof(void*) * pPacket->memoryRangeCount;
+            }
+            break;
+        }
+        case VKTRACE_TPI_VK_vkCmdUpdateBuffer: {
+            const packet_vkCmdUpdateBuffer* pPacket = (const packet_vkCmdUpdateBuffer*)pHeader->pBody;
+            bodyOffset = (uint64_t)pPacket->pData;
+            break;
+        }
+        case VKTRACE_TPI_VK_vkCmdPushConstants: {
+            const packet_vkCmdPushConstants* pPacket = (const packet_vkCmdPushConstants*)pHeader->pBody;
+            bodyOffset = (uint64_t)pPacket->pValues;
+            break;
+        }
+        default:
+            break;
+    }
+    if (bodyOffset == 0) {
+        return false;
+    }
+    blobOffset = sizeof(vktrace_trace_packet_header) + bodyOffset;
+    uint64_t blobEnd = std::min(pHeader->next_buffers_offset, pHeader->size - sizeof(uint32_t));
+    if (blobEnd <= blobOffset) {
+        return false;
+    }
+    blobSize = blobEnd - blobOffset;
+    return true;
+}
+
 VKTRACE_COMPRESS_TYPE compressTypeConvert(const char *name) {
     if (strcmp(name, "lz4") == 0)
         return VKTRACE_COMPRESS_TYPE_LZ4;
@@ -221,6 +263,127 @@ VKTRACE_COMPRESS_TYPE compressTypeConvert(const char *name) {
     return VKTRACE_COMPRESS_TYPE_NONE;
 }
 
+// Capture overhead of each entrypoint, i.e. the time vktrace spends around the call plus the bytes it adds to the trace.
+// Bucket i of the histogram counts the packets whose overhead is in [2^i, 2^(i+1)) ns.
+#define OVERHEAD_HISTOGRAM_BUCKETS 40
+struct OverheadStat {
+    uint64_t count = 0;
+    uint64_t overhead = 0;
+    uint64_t maxOverhead = 0;
+    uint64_t histogram[OVERHEAD_HISTOGRAM_BUCKETS] = {};
+    uint64_t bytes = 0;         // as received from the layer
+    uint64_t writtenBytes = 0;  // after deduplication and compression
+};
+
+// Time spent by the layer around the call of the packet, false if its timestamps are inconsistent
+static bool packetOverhead(const vktrace_trace_packet_header* pHeader, uint64_t& overhead) {
+    if (pHeader->entrypoint_begin_time < pHeader->vktrace_begin_time || pHeader->entrypoint_end_time < pHeader->entrypoint_begin_time ||
+        pHeader->vktrace_end_time < pHeader->entrypoint_end_time) {
+        overhead = 0;
+        return false;
+    }
+    overhead = (pHeader->entrypoint_begin_time - pHeader->vktrace_begin_time) + (pHeader->vktrace_end_time - pHeader->entrypoint_end_time);
+    return true;
+}
+
+static void recordOverhead(std::unordered_map<uint16_t, OverheadStat>& overheadStats, const vktrace_trace_packet_header* pHeader) {
+    OverheadStat& stat = overheadStats[pHeader->packet_id];
+    stat.count++;
+    stat.bytes += pHeader->size;
+    uint64_t overhead;
+    if (!packetOverhead(pHeader, overhead)) {
+        return;
+    }
+    stat.overhead += overhead;
+    stat.maxOverhead = std::max(stat.maxOverhead, overhead);
+    uint32_t bucket = 0;
+    while (bucket < OVERHEAD_HISTOGRAM_BUCKETS - 1 && (overhead >> (bucket + 1)) != 0) {
+        bucket++;
+    }
+    stat.histogram[bucket]++;
+}
+
+// Upper bound of the histogram bucket holding the given percentile, in ns
+static uint64_t overheadPercentile(const OverheadStat& stat, uint32_t percentile) {
+    uint64_t target = (stat.count * percentile + 99) / 100;
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < OVERHEAD_HISTOGRAM_BUCKETS; i++) {
+        sum += stat.histogram[i];
+        if (sum >= target) {
+            return std::min((uint64_t)2 << i, stat.maxOverhead);
+        }
+    }
+    return stat.maxOverhead;
+}
+
+static void printOverheadReport(const std::unordered_map<uint16_t, OverheadStat>& overheadStats, uint32_t maxEntries) {
+    std::vector<std::pair<uint16_t, const OverheadStat*>> sorted;
+    OverheadStat total;
+    for (auto& it : overheadStats) {
+        sorted.push_back(std::make_pair(it.first, &it.second));
+        total.count += it.second.count;
+        total.overhead += it.second.overhead;
+        total.bytes += it.second.bytes;
+        total.writtenBytes += it.second.writtenBytes;
+    }
+    if (total.count == 0) {
+        return;
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const std::pair<uint16_t, const OverheadStat*>& a,
+                                               const std::pair<uint16_t, const OverheadStat*>& b) {
+        return a.second->overhead > b.second->overhead;
+    });
+
+    vktrace_LogAlways("Capture overhead: %" PRIu64 " packets, %.3f ms in vktrace, %" PRIu64 " bytes received, %" PRIu64
+                      " bytes written (ratio %.2f)",
+                      total.count, total.overhead / 1000000.0, total.bytes, total.writtenBytes,
+                      total.writtenBytes > 0 ? (double)total.bytes / total.writtenBytes : 0.0);
+    vktrace_LogAlways("%-40s %10s %12s %10s %10s %10s %14s %8s", "Entrypoint", "Calls", "Total ms", "Avg us", "P50 us", "P99 us",
+                      "Bytes", "Ratio");
+    for (size_t i = 0; i < sorted.size() && i < maxEntries; i++) {
+        const OverheadStat& stat = *sorted[i].second;
+        const char* name = vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)sorted[i].first);
+        char idName[32];
+        if (name == NULL) {
+            snprintf(idName, sizeof(idName), "packet_id %u", sorted[i].first);
+            name = idName;
+        }
+        vktrace_LogAlways("%-40s %10" PRIu64 " %12.3f %10.3f %10.3f %10.3f %14" PRIu64 " %8.2f", name, stat.count, stat.overhead / 1000000.0,
+                          stat.overhead / 1000.0 / stat.count, overheadPercentile(stat, 50) / 1000.0, overheadPercentile(stat, 99) / 1000.0,
+                          stat.bytes, stat.writtenBytes > 0 ? (double)stat.bytes / stat.writtenBytes : 0.0);
+    }
+}
+
+// Counters of the frame being written, they fill in the VKTRACE_TPI_MARKER_API_BOUNDARY packet which ends it
+struct FrameStat {
+    uint64_t firstPacketIndex = 0;
+    uint64_t packetCount = 0;
+    uint64_t packetBytes = 0;
+    uint64_t writtenBytes = 0;
+    uint64_t overhead = 0;
+    uint64_t offset = 0;
+};
+
+// Copies the frame boundary packet from the layer to a buffer of the pool with the counters of the frame
+static vktrace_trace_packet_header* fillFrameBoundary(const vktrace_trace_packet_header* pHeader, const FrameStat& frame,
+                                                      uint64_t previousOffset, packetpool& pool) {
+    vktrace_trace_packet_header* pMarker = (vktrace_trace_packet_header*)pool.alloc(pHeader->size);
+    if (pMarker == NULL) {
+        return NULL;
+    }
+    memcpy(pMarker, pHeader, (size_t)pHeader->size);
+    pMarker->pBody = (uintptr_t)(pMarker + 1);
+    vktrace_trace_packet_frame_boundary* pFrame = (vktrace_trace_packet_frame_boundary*)pMarker->pBody;
+    pFrame->first_packet_index = frame.firstPacketIndex;
+    pFrame->packet_count = frame.packetCount;
+    pFrame->packet_bytes = frame.packetBytes;
+    pFrame->written_bytes = frame.writtenBytes;
+    pFrame->tracer_overhead = frame.overhead;
+    pFrame->frame_offset = frame.offset;
+    pFrame->previous_offset = previousOffset;
+    return pMarker;
+}
+
 // ------------------------------------------------------------------------------------------------
 VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunRecordTraceThread(LPVOID _threadInfo) {
     vktrace_process_capture_trace_thread_info* pInfo = (vktrace_process_capture_trace_thread_info*)_threadInfo;
@@ -241,7 +404,9 @@ VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunRecordTraceThread(LPVOID _threadIn
 
     MessageStream* pMessageStream = nullptr;
     if (pInfo->pProcessInfo->messageStream == nullptr) {
-        pMessageStream = vktrace_MessageStream_create(TRUE, "", VKTRACE_BASE_PORT + pInfo->tracerId);
+        pMessageStream = vktrace_MessageStream_create(TRUE, "", VKTRACE_BASE_PORT + pInfo->tracerId,
+                                                      strcmp(g_settings.transport, "tcp") == 0 ? VKTRACE_TRANSPORT_TCP
+                                                                                               : VKTRACE_TRANSPORT_AUTO);
 
         // listen socket is shared by all recording threads. So except
         // this thread, other thread just need to reuse it.
@@ -277,13 +442,16 @@ VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunRecordTraceThread(LPVOID _threadIn
     }
 
     // create trace file
-    pInfo->pTraceFile = vktrace_open_trace_file(pInfo);
+    char* traceFileName = NULL;
+    pInfo->pTraceFile = vktrace_open_trace_file(pInfo, &traceFileName);
 
     if (pInfo->pTraceFile == NULL) {
         // open of trace file generated an error, no sense in continuing.
         vktrace_LogError("Error cannot create trace file.");
         return 1;
     }
+    const std::string blockSidecarPath = vktrace_block_sidecar_path(traceFileName);
+    vktrace_free(traceFileName);
 
     // Open the socket
     fileLikeSocket = vktrace_FileLike_create_msg(pMessageStream);
@@ -334,16 +502,35 @@ VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunRecordTraceThread(LPVOID _threadIn
     assert(rval != SIG_ERR);
 #endif
 
+    // Payloads are located through the packet structs, so only deduplicate traces of the same pointer size
+    blobstore* g_blobstore = NULL;
+    if (g_settings.dedupThreshold > 0 && file_header.ptrsize == sizeof(void*)) {
+        g_blobstore = new blobstore(g_settings.dedupThreshold);
+    }
+    packetpool pool;
+    // The checksums are computed on the bytes as they are written, after deduplication and compression
+    blockchecksum* checksums = NULL;
+    if (g_settings.checksumBlockSize > 0) {
+        checksums = new blockchecksum((uint64_t)g_settings.checksumBlockSize * 1024, fileOffset);
+        if (!checksums->open_sidecar(blockSidecarPath)) {
+            vktrace_LogWarning("Cannot write the block checksums to %s during the capture.", blockSidecarPath.c_str());
+        }
+    }
+
     std::vector<uint64_t> portabilityTable;
     std::vector<uint64_t> injectedCalls;
     std::unordered_map<VkDevice, uint32_t> deviceToFeatures;
+    std::unordered_map<uint16_t, OverheadStat> overheadStats;
+    FrameStat frame;
+    uint64_t lastFrameOffset = 0;
     uint64_t decompress_file_size = fileOffset;
     while (!terminationSignalArrived && pInfo->serverRequestsTermination == FALSE) {
         // get a packet
         // vktrace_LogDebug("Waiting for a packet...");
 
-        // read entire packet in
-        pHeader = vktrace_read_trace_packet(fileLikeSocket);
+        // use the packet where it was received, in the shared memory ring or the receive buffer
+        pHeader = vktrace_read_trace_packet_in_place(fileLikeSocket);
+        vktrace_trace_packet_header* pReceived = pHeader;
 
         if (pHeader == NULL) {
             if (pMessageStream->mErrorNum == WSAECONNRESET) {
@@ -371,7 +558,7 @@ VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunRecordTraceThread(LPVOID _threadIn
 
             if (pHeader->packet_id == VKTRACE_TPI_MARKER_TERMINATE_PROCESS) {
                 pInfo->serverRequestsTermination = true;
-                vktrace_delete_trace_packet_no_lock(&pHeader);
+                vktrace_release_trace_packet(fileLikeSocket, &pHeader);
                 vktrace_LogVerbose("Thread_CaptureTrace is exiting.");
                 break;
             }
@@ -410,19 +597,55 @@ VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunRecordTraceThread(LPVOID _threadIn
 
             if (pInfo->pTraceFile != NULL) {
                 decompress_file_size += pHeader->size;
+                uint16_t packetId = pHeader->packet_id;
+                if (g_settings.overheadReportCount > 0) {
+                    recordOverhead(overheadStats, pHeader);
+                }
+                uint64_t receivedBytes = pHeader->size;
+                uint64_t overhead = 0;
+                bool isFrameBoundary = pHeader->packet_id == VKTRACE_TPI_MARKER_API_BOUNDARY &&
+                                       pHeader->size >= sizeof(vktrace_trace_packet_header) + sizeof(vktrace_trace_packet_frame_boundary);
+                if (isFrameBoundary) {
+                    vktrace_trace_packet_header* pMarker = fillFrameBoundary(pHeader, frame, lastFrameOffset, pool);
+                    if (pMarker != NULL) {
+                        pHeader = pMarker;
+                    } else {
+                        vktrace_LogError("Failed to fill in the frame boundary packet.");
+                    }
+                } else {
+                    packetOverhead(pHeader, overhead);
+                }
                 vktrace_enter_critical_section(&pInfo->pProcessInfo->traceFileCriticalSection);
+                uint64_t blobOffset = 0, blobSize = 0;
+                // Deduplication and compression write the packet to replace it with to a buffer of the pool
+                if (g_blobstore != NULL && getDedupPayload(pHeader, blobOffset, blobSize)) {
+                    if (dedup_packet(g_blobstore, pHeader, blobOffset, blobSize, fileOffset, pool) != 0) {
+                        vktrace_LogError("Failed to deduplicate the packet for packet_id = %hu", pHeader->packet_id);
+                    }
+                }
+                // blob reference and frame boundary packets are small and must stay uncompressed
                 if ((strcmp(g_settings.compressType, "lz4") == 0 || strcmp(g_settings.compressType, "snappy") == 0) &&
+                        pHeader->tracer_id != VKTRACE_TID_VULKAN_BLOB_REF && !isFrameBoundary &&
                         pHeader->size - sizeof(vktrace_trace_packet_header) > g_settings.compressThreshold) {
-                    if (compress_packet(g_compressor, pHeader) != 0) {
+                    if (compress_packet(g_compressor, pHeader, pool) != 0) {
                         vktrace_LogError("Failed to compress the packet for packet_id = %hu", pHeader->packet_id);
                     }
                 }
                 bytes_written = fwrite(pHeader, 1, (size_t)pHeader->size, pInfo->pTraceFile);
-                fflush(pInfo->pTraceFile);
+                // Flush once the packets received together are written
+                if (!vktrace_MessageStream_HasReceivedData(pMessageStream)) {
+                    fflush(pInfo->pTraceFile);
+                }
                 vktrace_leave_critical_section(&pInfo->pProcessInfo->traceFileCriticalSection);
                 if (bytes_written != pHeader->size) {
                     vktrace_LogError("Failed to write the packet for packet_id = %hu", pHeader->packet_id);
                 }
+                if (checksums != NULL) {
+                    checksums->add_packet(pHeader, bytes_written);
+                }
+                if (g_settings.overheadReportCount > 0) {
+                    overheadStats[packetId].writtenBytes += bytes_written;
+                }
                 if (pHeader->packet_id == VKTRACE_TPI_VK_vkBuildAccelerationStructuresKHR || pHeader->packet_id == VKTRACE_TPI_VK_vkCreateAccelerationStructureKHR ||
                     pHeader->packet_id == VKTRACE_TPI_VK_vkGetAccelerationStructureBuildSizesKHR || pHeader->packet_id == VKTRACE_TPI_VK_vkCmdBuildAccelerationStructuresKHR) {
                     useAsApi = true;
@@ -433,15 +656,32 @@ VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunRecordTraceThread(LPVOID _threadIn
                                      vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)pHeader->packet_id));
                     portabilityTable.push_back(fileOffset);
                 }
+                if (isFrameBoundary) {
+                    lastFrameOffset = fileOffset;
+                    frame = FrameStat();
+                } else {
+                    if (frame.packetCount == 0) {
+                        frame.firstPacketIndex = pHeader->global_packet_index;
+                        frame.offset = fileOffset;
+                    }
+                    frame.packetCount++;
+                    frame.packetBytes += receivedBytes;
+                    frame.writtenBytes += bytes_written;
+                    frame.overhead += overhead;
+                }
                 lastPacketIndex = pHeader->global_packet_index;
                 lastPacketThreadId = pHeader->thread_id;
                 lastPacketEndTime = pHeader->vktrace_end_time;
                 fileOffset += bytes_written;
+                if (pHeader != pReceived) {
+                    pool.release(pHeader);
+                    pHeader = pReceived;
+                }
             }
         }
 
         // clean up
-        vktrace_delete_trace_packet_no_lock(&pHeader);
+        vktrace_release_trace_packet(fileLikeSocket, &pHeader);
     }
     decompress_file_size += (sizeof(vktrace_trace_packet_header) + (portabilityTable.size() + 1)* sizeof(uint64_t));
     uint64_t meta_data_offset = 0;
@@ -453,6 +693,14 @@ VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunRecordTraceThread(LPVOID _threadIn
         uint32_t device_features_str_size = vktrace_appendDeviceFeatures(pInfo->pTraceFile, deviceToFeatures, meta_data_offset);
         decompress_file_size += device_features_str_size;
     }
+    // After the meta data, which can still grow above, and before the portability table, which must be last
+    if (checksums != NULL) {
+        decompress_file_size += vktrace_appendBlockTable(pInfo->pTraceFile, checksums->finish());
+        fflush(pInfo->pTraceFile);
+        checksums->remove_sidecar();
+        vktrace_LogVerbose("Wrote the CRC32C of %" PRIu64 " blocks of %u KB.", checksums->block_count(), g_settings.checksumBlockSize);
+        delete checksums;
+    }
 
     vktrace_appendPortabilityPacket(pInfo->pTraceFile, portabilityTable);
     vktrace_resetFilesize(pInfo->pTraceFile, decompress_file_size);
@@ -466,6 +714,17 @@ VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunRecordTraceThread(LPVOID _threadIn
         fwrite(&file_header.bit_flags, sizeof(uint16_t), 1, pInfo->pTraceFile);
         vktrace_LogAlways("There are AS related functions in the trace file.");
     }
+    if (g_blobstore && g_blobstore->dedup_packet_counter > 0) {
+        file_header.bit_flags = file_header.bit_flags | VKTRACE_USE_BLOB_REFERENCES_BIT;
+        fseek(pInfo->pTraceFile, offsetof(vktrace_trace_file_header, bit_flags), SEEK_SET);
+        fwrite(&file_header.bit_flags, sizeof(uint16_t), 1, pInfo->pTraceFile);
+        vktrace_LogAlways("Replaced %" PRIu64 " repeated payloads by references, saving %" PRIu64 " bytes.",
+                          g_blobstore->dedup_packet_counter, g_blobstore->dedup_saved_bytes);
+    }
+    if (lastFrameOffset != 0) {
+        fseek(pInfo->pTraceFile, offsetof(vktrace_trace_file_header, last_frame_offset), SEEK_SET);
+        fwrite(&lastFrameOffset, sizeof(uint64_t), 1, pInfo->pTraceFile);
+    }
     if (g_compressor && g_compressor->compress_packet_counter > 0) {
         fseek(pInfo->pTraceFile, offsetof(vktrace_trace_file_header, compress_type), SEEK_SET);
         VKTRACE_COMPRESS_TYPE type = compressTypeConvert(g_settings.compressType);
@@ -473,6 +732,10 @@ VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunRecordTraceThread(LPVOID _threadIn
     }
     fclose(pInfo->pTraceFile);
     delete g_compressor;
+    delete g_blobstore;
+    if (g_settings.overheadReportCount > 0) {
+        printOverheadReport(overheadStats, g_settings.overheadReportCount);
+    }
 
     VKTRACE_DELETE(fileLikeSocket);
     vktrace_MessageStream_destroy(&pMessageStream);
@@ -457,14 +457,14 @@ void vktraceviewer::GenerateTraceFileStats() {
     uint64_t totalTraceTime = 0;
 
     if (m_traceFileInfo.packetCount > 0) {
-        uint64_t start = m_traceFileInfo.pPacketOffsets[0].pHeader->entrypoint_begin_time;
-        uint64_t end = m_traceFileInfo.pPacketOffsets[m_traceFileInfo.packetCount - 1].pHeader->entrypoint_end_time;
+        uint64_t start = m_traceFileInfo.pPacketOffsets[0].header.entrypoint_begin_time;
+        uint64_t end = m_traceFileInfo.pPacketOffsets[m_traceFileInfo.packetCount - 1].header.entrypoint_end_time;
         totalTraceTime = end - start;
     }
 
     QMap<uint16_t, vtvApiUsageStats> statMap;
     for (uint64_t i = 0; i < m_traceFileInfo.packetCount; i++) {
-        vktrace_trace_packet_header* pHeader = m_traceFileInfo.pPacketOffsets[i].pHeader;
+        vktrace_trace_packet_header* pHeader = &m_traceFileInfo.pPacketOffsets[i].header;
         if (pHeader->packet_id >= VKTRACE_TPI_VK_vkApiVersion) {
             totalStats.totalCallCount++;
             totalStats.totalCpuExecutionTime += (pHeader->entrypoint_end_time - pHeader->entrypoint_begin_time);
@@ -584,6 +584,12 @@ void vktraceviewer::onTraceFileLoaded(bool bSuccess, const vktraceviewer_trace_f
 #endif
 
         if (m_pController != NULL) {
+            // Packets are interpreted by the controller when the views first request them
+            vktraceviewer_QController* pController = m_pController;
+            vktraceviewer_set_packet_interpreter(&m_traceFileInfo, [pController](vktrace_trace_packet_header* pHeader) {
+                return pController->InterpretTracePacket(pHeader);
+            });
+
             connect(m_pController, SIGNAL(OutputMessage(VktraceLogLevel, const QString&)), this,
                     SLOT(OnOutputMessage(VktraceLogLevel, const QString&)));
             connect(m_pController, SIGNAL(OutputMessage(VktraceLogLevel, uint64_t, const QString&)), this,
@@ -644,18 +650,7 @@ void vktraceviewer::close_trace_file() {
         m_pTimeline->repaint();
     }
 
-    if (m_traceFileInfo.packetCount > 0) {
-        for (unsigned int i = 0; i < m_traceFileInfo.packetCount; i++) {
-            if (m_traceFileInfo.pPacketOffsets[i].pHeader != NULL) {
-                vktrace_free(m_traceFileInfo.pPacketOffsets[i].pHeader);
-                m_traceFileInfo.pPacketOffsets[i].pHeader = NULL;
-            }
-        }
-
-        VKTRACE_DELETE(m_traceFileInfo.pPacketOffsets);
-        m_traceFileInfo.pPacketOffsets = NULL;
-        m_traceFileInfo.packetCount = 0;
-    }
+    vktraceviewer_free_packets(&m_traceFileInfo);
 
     if (m_traceFileInfo.pFile != NULL) {
         fclose(m_traceFileInfo.pFile);
@@ -702,9 +697,11 @@ void vktraceviewer::on_actionExport_API_Calls_triggered() {
 
         // iterate through every packet
         for (unsigned int i = 0; i < m_traceFileInfo.packetCount; i++) {
-            vktraceviewer_trace_file_packet_offsets* pOffsets = &m_traceFileInfo.pPacketOffsets[i];
-            vktrace_trace_packet_header* pHeader = pOffsets->pHeader;
-            assert(pHeader != NULL);
+            const vktrace_trace_packet_header* pHeader = vktraceviewer_get_packet(&m_traceFileInfo, i);
+            if (pHeader == NULL) {
+                LogError(QString("Failed to read packet %1, the exported API calls are incomplete.").arg(i));
+                break;
+            }
             QString string = m_pTraceFileModel->get_packet_string(pHeader);
 
             // output packet string
@@ -42,13 +42,24 @@ class vktraceviewer_QTraceFileModel : public QAbstractItemModel {
             case VKTRACE_TPI_MESSAGE: {
                 return QString("This is a message packet");
             }
+            case VKTRACE_TPI_MARKER_API_BOUNDARY: {
+                if (pHeader->size < sizeof(vktrace_trace_packet_header) + sizeof(vktrace_trace_packet_frame_boundary)) {
+                    return QString("Frame boundary");
+                }
+                const vktrace_trace_packet_frame_boundary* pFrame = (const vktrace_trace_packet_frame_boundary*)pHeader->pBody;
+                return QString("End of frame %1: %2 packets, %3 bytes, %4 ms to capture")
+                    .arg(pFrame->frame_number)
+                    .arg(pFrame->packet_count)
+                    .arg(pFrame->packet_bytes)
+                    .arg(pFrame->tracer_overhead / 1000000.0, 0, 'f', 3);
+            }
             case VKTRACE_TPI_MARKER_CHECKPOINT:
-            case VKTRACE_TPI_MARKER_API_BOUNDARY:
             case VKTRACE_TPI_MARKER_API_GROUP_BEGIN:
             case VKTRACE_TPI_MARKER_API_GROUP_END:
             case VKTRACE_TPI_MARKER_TERMINATE_PROCESS:
             case VKTRACE_TPI_PORTABILITY_TABLE:
             case VKTRACE_TPI_META_DATA:
+            case VKTRACE_TPI_BLOCK_TABLE:
             default: { return QString("%1").arg(pHeader->packet_id); }
         }
     }
@@ -120,8 +131,11 @@ class vktraceviewer_QTraceFileModel : public QAbstractItemModel {
         if (role == Qt::DisplayRole) {
             switch (index.column()) {
                 case Column_EntrypointName: {
-                    vktrace_trace_packet_header* pHeader = (vktrace_trace_packet_header*)index.internalPointer();
-                    QString apiStr = this->get_packet_string(pHeader);
+                    const vktrace_trace_packet_header* pPacket = vktraceviewer_get_packet(m_pTraceFileInfo, index.row());
+                    if (pPacket == NULL) {
+                        return QString("<unreadable packet>");
+                    }
+                    QString apiStr = this->get_packet_string(pPacket);
                     return apiStr;
                 }
                 case Column_TracerId:
@@ -164,8 +178,12 @@ class vktraceviewer_QTraceFileModel : public QAbstractItemModel {
             tip += QString("<tr><td>pBody</td><td>= %1</td></tr>").arg(pHeader->pBody);
             tip += "<br>";
 #endif
+            const vktrace_trace_packet_header* pPacket = vktraceviewer_get_packet(m_pTraceFileInfo, index.row());
+            if (pPacket == NULL) {
+                return QVariant();
+            }
             tip += "<tr><td><b>";
-            QString multiline = this->get_packet_string_multiline(pHeader);
+            QString multiline = this->get_packet_string_multiline(pPacket);
             // only replaces the first '('
             multiline.replace(multiline.indexOf("("), 1, "</b>(</td><td/></tr><tr><td>");
             multiline.replace(", ", ", </td></tr><tr><td>");
@@ -191,7 +209,7 @@ class vktraceviewer_QTraceFileModel : public QAbstractItemModel {
             return QModelIndex();
         }
 
-        vktrace_trace_packet_header* pHeader = m_pTraceFileInfo->pPacketOffsets[row].pHeader;
+        vktrace_trace_packet_header* pHeader = &m_pTraceFileInfo->pPacketOffsets[row].header;
         void* pData = NULL;
         switch (column) {
             case Column_EntrypointName:
@@ -253,6 +271,8 @@ class vktraceviewer_QTraceFileModel : public QAbstractItemModel {
 
     void set_highlight_search_string(const QString searchString) { m_searchString = searchString; }
 
+    const vktraceviewer_trace_file_info* get_trace_file_info() const { return m_pTraceFileInfo; }
+
    private:
     vktraceviewer_trace_file_info* m_pTraceFileInfo;
     QString m_searchString;
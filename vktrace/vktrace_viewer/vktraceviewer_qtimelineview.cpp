@@ -28,9 +28,16 @@
 #define _USE_MATH_DEFINES
 #endif
 #include <math.h>
+#include <algorithm>
 #include "vktraceviewer_qtimelineview.h"
 #include "vktraceviewer_QTraceFileModel.h"
 
+// Calls are drawn one by one when a thread has at most this many visible per pixel, otherwise from the summary
+#define TIMELINE_MAX_ITEMS_PER_PIXEL 4
+
+// Number of buckets of the finest level of the summary over the whole trace
+#define TIMELINE_BASE_BUCKET_COUNT (1 << 20)
+
 // helper
 float u64ToFloat(uint64_t value) {
     // taken from: http://stackoverflow.com/questions/4400747/converting-from-unsigned-long-long-to-float-with-round-to-nearest-even
@@ -144,7 +151,12 @@ vktraceviewer_QTimelineView::vktraceviewer_QTimelineView(QWidget *parent)
       m_hashIsDirty(true),
       m_margin(10),
       m_pPixmap(NULL),
-      m_itemDelegate(this) {
+      m_itemDelegate(this),
+      m_pTraceFileInfo(NULL),
+      m_pSummary(NULL),
+      m_pPendingSummary(NULL),
+      m_cancelSummary(false),
+      m_summaryGeneration(0) {
     horizontalScrollBar()->setRange(0, 0);
     verticalScrollBar()->setRange(0, 0);
 
@@ -164,7 +176,11 @@ vktraceviewer_QTimelineView::vktraceviewer_QTimelineView(QWidget *parent)
 }
 
 //-----------------------------------------------------------------------------
-vktraceviewer_QTimelineView::~vktraceviewer_QTimelineView() { m_threadIdList.clear(); }
+vktraceviewer_QTimelineView::~vktraceviewer_QTimelineView() {
+    cancelSummary();
+    delete m_pSummary;
+    m_threadIdList.clear();
+}
 
 //-----------------------------------------------------------------------------
 void vktraceviewer_QTimelineView::setModel(QAbstractItemModel *pModel) {
@@ -172,8 +188,14 @@ void vktraceviewer_QTimelineView::setModel(QAbstractItemModel *pModel) {
     m_hashIsDirty = true;
     setItemDelegate(&m_itemDelegate);
 
+    cancelSummary();
+    delete m_pSummary;
+    m_pSummary = NULL;
+    m_pTraceFileInfo = NULL;
+
     m_threadIdList.clear();
     m_threadMask.clear();
+    m_threadArea.clear();
     m_maxItemDuration = 0;
     m_rawStartTime = 0;
     m_rawEndTime = 0;
@@ -181,34 +203,14 @@ void vktraceviewer_QTimelineView::setModel(QAbstractItemModel *pModel) {
     deletePixmap();
 
     // Gather some stats from the model
-    if (model() == NULL) {
+    vktraceviewer_QTraceFileModel *pFileModel = dynamic_cast<vktraceviewer_QTraceFileModel *>(model());
+    if (pFileModel == NULL || pFileModel->rowCount() == 0) {
         horizontalScrollBar()->setRange(0, 0);
         verticalScrollBar()->setRange(0, 0);
         return;
     }
-
+    m_pTraceFileInfo = pFileModel->get_trace_file_info();
     int numRows = model()->rowCount();
-    for (int i = 0; i < numRows; i++) {
-        // Count number of unique thread Ids
-        QModelIndex item = model()->index(i, vktraceviewer_QTraceFileModel::Column_ThreadId);
-        if (item.isValid()) {
-            uint32_t threadId = item.data().toUInt();
-            if (!m_threadIdList.contains(threadId)) {
-                m_threadIdList.append(threadId);
-                m_threadMask.insert(threadId, QVector<int>());
-                m_threadArea.append(QRect());
-            }
-        }
-
-        // Find duration of longest item
-        item = model()->index(i, vktraceviewer_QTraceFileModel::Column_CpuDuration);
-        if (item.isValid()) {
-            float duration = item.data().toFloat();
-            if (m_maxItemDuration < duration) {
-                m_maxItemDuration = duration;
-            }
-        }
-    }
 
     // Get start time
     QModelIndex start = model()->index(0, vktraceviewer_QTraceFileModel::Column_BeginTime);
@@ -234,6 +236,174 @@ void vktraceviewer_QTimelineView::setModel(QAbstractItemModel *pModel) {
     verticalScrollBar()->setValue(0);
     verticalScrollBar()->setPageStep(1);
     verticalScrollBar()->setSingleStep(1);
+
+    // The threads, the longest call and the summary need a pass over every packet, do it in the background
+    int generation = ++m_summaryGeneration;
+    const vktraceviewer_trace_file_info *pTraceFileInfo = m_pTraceFileInfo;
+    uint64_t startTime = m_rawStartTime;
+    uint64_t lineLength = m_lineLength;
+    m_cancelSummary = false;
+    m_summaryThread = std::thread([this, generation, pTraceFileInfo, startTime, lineLength]() {
+        timeline_summary *pSummary = new timeline_summary();
+        buildSummary(pSummary, pTraceFileInfo, startTime, lineLength, m_cancelSummary);
+        m_pPendingSummary = pSummary;
+        QMetaObject::invokeMethod(this, "onSummaryReady", Qt::QueuedConnection, Q_ARG(int, generation));
+    });
+}
+
+//-----------------------------------------------------------------------------
+void vktraceviewer_QTimelineView::cancelSummary() {
+    if (m_summaryThread.joinable()) {
+        m_cancelSummary = true;
+        m_summaryThread.join();
+    }
+    delete m_pPendingSummary;
+    m_pPendingSummary = NULL;
+}
+
+//-----------------------------------------------------------------------------
+void vktraceviewer_QTimelineView::onSummaryReady(int generation) {
+    // A summary which was cancelled by a later setModel() can still notify
+    if (generation != m_summaryGeneration || !m_summaryThread.joinable()) {
+        return;
+    }
+    m_summaryThread.join();
+    m_pSummary = m_pPendingSummary;
+    m_pPendingSummary = NULL;
+
+    for (int t = 0; t < m_pSummary->threads.size(); t++) {
+        uint32_t threadId = m_pSummary->threads[t].threadId;
+        m_threadIdList.append(threadId);
+        m_threadMask.insert(threadId, QVector<int>());
+        m_threadArea.append(QRect());
+    }
+    m_maxItemDuration = u64ToFloat(m_pSummary->maxDuration);
+
+    m_hashIsDirty = true;
+    deletePixmap();
+    viewport()->update();
+}
+
+//-----------------------------------------------------------------------------
+void vktraceviewer_QTimelineView::buildSummary(timeline_summary *pSummary, const vktraceviewer_trace_file_info *pTraceFileInfo,
+                                               uint64_t startTime, uint64_t lineLength, const std::atomic<bool> &cancel) {
+    pSummary->maxDuration = 0;
+    pSummary->baseShift = 0;
+    while (pSummary->baseShift < 63 && (lineLength >> pSummary->baseShift) >= TIMELINE_BASE_BUCKET_COUNT) {
+        pSummary->baseShift++;
+    }
+
+    // The packet headers stay in memory while the trace is open, the packets themselves are not needed
+    QHash<uint32_t, int> threadIndices;
+    for (uint64_t row = 0; row < pTraceFileInfo->packetCount && !cancel; row++) {
+        const vktrace_trace_packet_header &header = pTraceFileInfo->pPacketOffsets[row].header;
+        QHash<uint32_t, int>::const_iterator it = threadIndices.constFind(header.thread_id);
+        if (it == threadIndices.constEnd()) {
+            it = threadIndices.insert(header.thread_id, pSummary->threads.size());
+            pSummary->threads.append(timeline_thread());
+            pSummary->threads.last().threadId = header.thread_id;
+        }
+
+        // make sure item is valid size
+        if (header.entrypoint_end_time > header.entrypoint_begin_time) {
+            timeline_item item;
+            item.begin = header.entrypoint_begin_time;
+            item.end = header.entrypoint_end_time;
+            item.maxEnd = 0;
+            item.row = (int)row;
+            pSummary->threads[it.value()].items.append(item);
+            pSummary->maxDuration = std::max(pSummary->maxDuration, item.end - item.begin);
+        }
+    }
+
+    for (int t = 0; t < pSummary->threads.size() && !cancel; t++) {
+        timeline_thread &thread = pSummary->threads[t];
+        std::stable_sort(thread.items.begin(), thread.items.end(),
+                         [](const timeline_item &a, const timeline_item &b) { return a.begin < b.begin; });
+        uint64_t maxEnd = 0;
+        for (timeline_item &item : thread.items) {
+            maxEnd = std::max(maxEnd, item.end);
+            item.maxEnd = maxEnd;
+        }
+
+        // Finest level from the calls, then merge pairs of buckets until a level has a single one
+        QVector<timeline_bucket> level;
+        for (const timeline_item &item : thread.items) {
+            uint64_t index = (item.begin > startTime ? item.begin - startTime : 0) >> pSummary->baseShift;
+            uint64_t duration = item.end - item.begin;
+            if (level.isEmpty() || level.last().index != index) {
+                timeline_bucket bucket = {index, item.begin, item.end, item.maxEnd, duration, 1, item.row};
+                level.append(bucket);
+            } else {
+                timeline_bucket &bucket = level.last();
+                bucket.end = std::max(bucket.end, item.end);
+                bucket.maxEnd = item.maxEnd;
+                bucket.count++;
+                if (duration > bucket.maxDuration) {
+                    bucket.maxDuration = duration;
+                    bucket.longestRow = item.row;
+                }
+            }
+        }
+        thread.levels.append(level);
+
+        while (thread.levels.last().size() > 1 && pSummary->baseShift + thread.levels.size() < 64 && !cancel) {
+            const QVector<timeline_bucket> &finer = thread.levels.last();
+            QVector<timeline_bucket> coarser;
+            coarser.reserve(finer.size() / 2 + 1);
+            for (const timeline_bucket &fine : finer) {
+                uint64_t index = fine.index >> 1;
+                if (coarser.isEmpty() || coarser.last().index != index) {
+                    timeline_bucket bucket = fine;
+                    bucket.index = index;
+                    coarser.append(bucket);
+                } else {
+                    timeline_bucket &bucket = coarser.last();
+                    bucket.end = std::max(bucket.end, fine.end);
+                    bucket.maxEnd = fine.maxEnd;
+                    bucket.count += fine.count;
+                    if (fine.maxDuration > bucket.maxDuration) {
+                        bucket.maxDuration = fine.maxDuration;
+                        bucket.longestRow = fine.longestRow;
+                    }
+                }
+            }
+            thread.levels.append(coarser);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+int vktraceviewer_QTimelineView::summaryLevel(const timeline_thread &thread, double viewStart, double viewEnd) const {
+    // Count the calls which may be visible, see drawThread()
+    uint64_t first = (uint64_t)std::max(0.0, viewStart) + m_rawStartTime;
+    uint64_t last = (uint64_t)std::max(0.0, viewEnd) + m_rawStartTime;
+    QVector<timeline_item>::const_iterator begin =
+        std::lower_bound(thread.items.begin(), thread.items.end(), first,
+                         [](const timeline_item &item, uint64_t time) { return item.maxEnd < time; });
+    QVector<timeline_item>::const_iterator end = std::upper_bound(
+        begin, thread.items.end(), last, [](uint64_t time, const timeline_item &item) { return time < item.begin; });
+    if (end - begin <= TIMELINE_MAX_ITEMS_PER_PIXEL * std::max(1, viewport()->width())) {
+        return -1;
+    }
+
+    // The finest level whose buckets are at least a pixel wide
+    int level = 0;
+    while (level + 1 < thread.levels.size() && ldexp(1.0, m_pSummary->baseShift + level) * m_zoomFactor < 1.0) {
+        level++;
+    }
+    return level;
+}
+
+//-----------------------------------------------------------------------------
+double vktraceviewer_QTimelineView::timeToViewport(uint64_t time) const {
+    double offset = time >= m_rawStartTime ? (double)(time - m_rawStartTime) : -(double)(m_rawStartTime - time);
+    return offset * m_zoomFactor - horizontalScrollBar()->value() + m_margin;
+}
+
+//-----------------------------------------------------------------------------
+double vktraceviewer_QTimelineView::viewportToTime(int x) const {
+    return (double)(x - m_margin + horizontalScrollBar()->value()) / m_zoomFactor;
 }
 
 //-----------------------------------------------------------------------------
@@ -253,16 +423,20 @@ void vktraceviewer_QTimelineView::calculateRectsIfNecessary() {
         this->m_threadArea[threadIndex] = QRect(0, top, viewport()->width(), itemHeight);
     }
 
-    int numRows = model()->rowCount();
-    for (int row = 0; row < numRows; row++) {
-        QRectF rect;
-        QModelIndex item = model()->index(row, vktraceviewer_QTraceFileModel::Column_EntrypointName);
+    m_hashIsDirty = false;
+    viewport()->update();
+}
 
-        vktrace_trace_packet_header *pHeader = (vktrace_trace_packet_header *)item.internalPointer();
+//-----------------------------------------------------------------------------
+QRectF vktraceviewer_QTimelineView::itemRect(const QModelIndex &item) const {
+    QRectF rect;
+    if (item.isValid() && m_pTraceFileInfo != NULL && (uint64_t)item.row() < m_pTraceFileInfo->packetCount) {
+        const vktrace_trace_packet_header *pHeader = &m_pTraceFileInfo->pPacketOffsets[item.row()].header;
+        int threadIndex = m_threadIdList.indexOf(pHeader->thread_id);
 
         // make sure item is valid size
-        if (pHeader->entrypoint_end_time > pHeader->entrypoint_begin_time) {
-            int threadIndex = m_threadIdList.indexOf(pHeader->thread_id);
+        if (threadIndex >= 0 && pHeader->entrypoint_end_time > pHeader->entrypoint_begin_time) {
+            int itemHeight = m_threadHeight * 0.4;
             int topOffset = (m_threadHeight * threadIndex) + (m_threadHeight * 0.5);
 
             uint64_t duration = pHeader->entrypoint_end_time - pHeader->entrypoint_begin_time;
@@ -276,19 +450,6 @@ void vktraceviewer_QTimelineView::calculateRectsIfNecessary() {
             rect.setWidth(Width);
             rect.setHeight(itemHeight);
         }
-
-        m_rowToRectMap[row] = rect;
-    }
-
-    m_hashIsDirty = false;
-    viewport()->update();
-}
-
-//-----------------------------------------------------------------------------
-QRectF vktraceviewer_QTimelineView::itemRect(const QModelIndex &item) const {
-    QRectF rect;
-    if (item.isValid()) {
-        rect = m_rowToRectMap.value(item.row());
     }
     return rect;
 }
@@ -456,9 +617,11 @@ QModelIndex vktraceviewer_QTimelineView::indexAt(const QPoint &point) const {
 
     // Early out if the point is not in the areas covered by timeline items
     bool inThreadArea = false;
+    int threadIndex = 0;
     for (int i = 0; i < m_threadArea.size(); i++) {
         if (wy >= m_threadArea[i].top() && wy <= m_threadArea[i].bottom()) {
             inThreadArea = true;
+            threadIndex = i;
             break;
         }
     }
@@ -468,16 +631,39 @@ QModelIndex vktraceviewer_QTimelineView::indexAt(const QPoint &point) const {
         return QModelIndex();
     }
 
-    // Transform the view coordinates into content widget coordinates.
-    int x = point.x() - m_margin + horizontalScrollBar()->value();
-    float wx = (float)x / m_zoomFactor;
+    if (m_pSummary == NULL || threadIndex >= m_pSummary->threads.size()) {
+        return QModelIndex();
+    }
+    const timeline_thread &thread = m_pSummary->threads[threadIndex];
 
-    QHashIterator<int, QRectF> iter(m_rowToRectMap);
-    while (iter.hasNext()) {
-        iter.next();
-        QRectF value = iter.value();
-        if (value.contains(wx, wy)) {
-            return model()->index(iter.key(), vktraceviewer_QTraceFileModel::Column_EntrypointName);
+    // Transform the view coordinates into a time from the start of the trace, the item under the point is the one
+    // drawn there: a call, or the longest call of a bucket of the summary.
+    double wx = viewportToTime(point.x());
+    if (wx < 0) {
+        return QModelIndex();
+    }
+    uint64_t time = (uint64_t)wx + m_rawStartTime;
+    int level = summaryLevel(thread, viewportToTime(0), viewportToTime(viewport()->width()));
+    if (level < 0) {
+        QVector<timeline_item>::const_iterator it =
+            std::lower_bound(thread.items.begin(), thread.items.end(), time,
+                             [](const timeline_item &item, uint64_t t) { return item.maxEnd < t; });
+        for (; it != thread.items.end() && it->begin <= time; ++it) {
+            if (it->end >= time) {
+                return model()->index(it->row, vktraceviewer_QTraceFileModel::Column_EntrypointName);
+            }
+        }
+    } else {
+        // Buckets are at least a pixel wide, accept the pixels around them
+        double tolerance = 1.0 / m_zoomFactor;
+        const QVector<timeline_bucket> &buckets = thread.levels[level];
+        QVector<timeline_bucket>::const_iterator it =
+            std::lower_bound(buckets.begin(), buckets.end(), wx - tolerance + m_rawStartTime,
+                             [](const timeline_bucket &bucket, double t) { return (double)bucket.maxEnd < t; });
+        for (; it != buckets.end() && (double)it->begin <= wx + tolerance + m_rawStartTime; ++it) {
+            if ((double)it->end >= wx - tolerance + m_rawStartTime) {
+                return model()->index(it->longestRow, vktraceviewer_QTraceFileModel::Column_EntrypointName);
+            }
         }
     }
 
@@ -560,13 +746,11 @@ void vktraceviewer_QTimelineView::paint(QPainter *painter, QPaintEvent *event) {
         pixmapPainter.fillRect(event->rect(), m_background);
         drawBaseTimelines(&pixmapPainter, event->rect(), threadList);
 
-        if (model() != NULL) {
-            int numRows = model()->rowCount();
-
-            for (int r = 0; r < numRows; r++) {
-                QModelIndex index = model()->index(r, vktraceviewer_QTraceFileModel::Column_EntrypointName);
-
-                drawTimelineItem(&pixmapPainter, index);
+        if (model() != NULL && m_pSummary == NULL) {
+            pixmapPainter.drawText(event->rect(), Qt::AlignCenter, "Building timeline...");
+        } else if (model() != NULL) {
+            for (int t = 0; t < m_pSummary->threads.size(); t++) {
+                drawThread(&pixmapPainter, t);
             }
         }
     }
@@ -658,3 +842,40 @@ void vktraceviewer_QTimelineView::drawTimelineItem(QPainter *painter, const QMod
         itemDelegate()->paint(painter, option, index);
     }
 }
+
+//-----------------------------------------------------------------------------
+void vktraceviewer_QTimelineView::drawThread(QPainter *painter, int threadIndex) {
+    const timeline_thread &thread = m_pSummary->threads[threadIndex];
+    double viewStart = viewportToTime(0);
+    double viewEnd = viewportToTime(viewport()->width());
+    uint64_t first = (uint64_t)std::max(0.0, viewStart) + m_rawStartTime;
+    uint64_t last = (uint64_t)std::max(0.0, viewEnd) + m_rawStartTime;
+
+    int level = summaryLevel(thread, viewStart, viewEnd);
+    if (level < 0) {
+        // Few enough calls are visible to draw them one by one: from the first which ends in the view to the last
+        // which begins in it
+        QVector<timeline_item>::const_iterator it =
+            std::lower_bound(thread.items.begin(), thread.items.end(), first,
+                             [](const timeline_item &item, uint64_t time) { return item.maxEnd < time; });
+        for (; it != thread.items.end() && it->begin <= last; ++it) {
+            drawTimelineItem(painter, model()->index(it->row, vktraceviewer_QTraceFileModel::Column_EntrypointName));
+        }
+        return;
+    }
+
+    // Draw each bucket as one flat rect over the calls in it, colored by the longest one
+    int itemHeight = m_threadHeight * 0.4;
+    int top = (m_threadHeight * threadIndex) + (m_threadHeight * 0.5) - itemHeight / 2;
+    const QVector<timeline_bucket> &buckets = thread.levels[level];
+    QVector<timeline_bucket>::const_iterator it =
+        std::lower_bound(buckets.begin(), buckets.end(), first,
+                         [](const timeline_bucket &bucket, uint64_t time) { return bucket.maxEnd < time; });
+    for (; it != buckets.end() && it->begin <= last; ++it) {
+        double left = timeToViewport(it->begin);
+        double right = std::max(left + 1.0, timeToViewport(it->end));
+        float durationRatio = u64ToFloat(it->maxDuration) / std::max(1.0f, getMaxItemDuration());
+        int intensity = std::min(255, (int)(durationRatio * 255.0f));
+        painter->fillRect(QRectF(left, top, right - left, itemHeight), QColor(intensity, 255 - intensity, 0));
+    }
+}
@@ -23,7 +23,10 @@
 #define VKTRACEVIEWER_QTIMELINEVIEW_H
 
 #include <stdint.h>
+#include <atomic>
+#include <thread>
 #include "vktrace_trace_packet_identifiers.h"
+#include "vktraceviewer_trace_file_utils.h"
 
 #include <QWidget>
 
@@ -76,6 +79,42 @@ class vktraceviewer_QTimelineView : public QAbstractItemView {
     }
 
    private:
+    // A call of one thread, with the latest end time of the calls of the thread up to it so that the calls visible in
+    // a time range can be found with a binary search.
+    struct timeline_item {
+        uint64_t begin;
+        uint64_t end;
+        uint64_t maxEnd;
+        int row;
+    };
+
+    // The calls of one thread starting in the same time bucket, bucket 'index' covers the times [index << shift,
+    // (index + 1) << shift) from the start of the trace.
+    struct timeline_bucket {
+        uint64_t index;
+        uint64_t begin;
+        uint64_t end;
+        uint64_t maxEnd;
+        uint64_t maxDuration;
+        uint32_t count;
+        int longestRow;
+    };
+
+    struct timeline_thread {
+        uint32_t threadId;
+        QVector<timeline_item> items;
+        // levels[0] has buckets of (1 << baseShift) nanoseconds, each next level merges pairs of buckets of the previous
+        QVector<QVector<timeline_bucket> > levels;
+    };
+
+    // Level of detail summary of the trace, built in the background when the model is set. The timeline draws the
+    // calls themselves when few are visible, and otherwise the buckets of the level closest to one pixel wide.
+    struct timeline_summary {
+        QVector<timeline_thread> threads;
+        uint64_t maxDuration;
+        int baseShift;
+    };
+
     QBrush m_background;
     QPen m_trianglePen;
     QPen m_textPen;
@@ -93,7 +132,6 @@ class vktraceviewer_QTimelineView : public QAbstractItemView {
     float m_zoomFactor;
     float m_maxZoom;
     int m_threadHeight;
-    QHash<int, QRectF> m_rowToRectMap;
     bool m_hashIsDirty;
     int m_margin;
     int m_scrollBarWidth;
@@ -102,9 +140,24 @@ class vktraceviewer_QTimelineView : public QAbstractItemView {
     QPixmap *m_pPixmap;
     vktraceviewer_QTimelineItemDelegate m_itemDelegate;
 
+    const vktraceviewer_trace_file_info *m_pTraceFileInfo;
+    timeline_summary *m_pSummary;
+    timeline_summary *m_pPendingSummary;
+    std::thread m_summaryThread;
+    std::atomic<bool> m_cancelSummary;
+    int m_summaryGeneration;
+
+    static void buildSummary(timeline_summary *pSummary, const vktraceviewer_trace_file_info *pTraceFileInfo,
+                             uint64_t startTime, uint64_t lineLength, const std::atomic<bool> &cancel);
+    void cancelSummary();
+    int summaryLevel(const timeline_thread &thread, double viewStart, double viewEnd) const;
+    double timeToViewport(uint64_t time) const;
+    double viewportToTime(int x) const;
+
     void calculateRectsIfNecessary();
     void drawBaseTimelines(QPainter *painter, const QRect &rect, const QList<uint32_t> &threadList);
     void drawTimelineItem(QPainter *painter, const QModelIndex &index);
+    void drawThread(QPainter *painter, int threadIndex);
 
     QRectF viewportRect(const QModelIndex &index) const;
     float scaleDurationHorizontally(uint64_t value) const;
@@ -139,6 +192,9 @@ class vktraceviewer_QTimelineView : public QAbstractItemView {
    protected slots:
     virtual void updateGeometries();
 
+   private slots:
+    void onSummaryReady(int generation);
+
    signals:
 
    public slots:
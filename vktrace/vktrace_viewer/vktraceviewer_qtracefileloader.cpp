@@ -21,7 +21,6 @@
 
 #include "vktraceviewer_qtracefileloader.h"
 #include "vktraceviewer_controller_factory.h"
-#include "decompressor.h"
 extern "C" {
 #include "vktrace_trace_packet_utils.h"
 }
@@ -78,14 +77,15 @@ void vktraceviewer_QTraceFileLoader::loadTraceFile(const QString& filename) {
 #else
         m_controllerFactory.Unload(&m_pController);
 #endif
-        // TODO: We don't really want to close the trace file yet.
-        // I think we want to keep it open so that we can dynamically read from it.
-        // BUT we definitely don't want it to get locked open, so we need a smart
-        // way to open / close from it when reading.
+        // The packets are read through the mapping made by vktraceviewer_scan_trace_file(), which has its own handle
         fclose(m_traceFileInfo.pFile);
         m_traceFileInfo.pFile = NULL;
     }
 
+    if (!bOpened) {
+        vktraceviewer_free_packets(&m_traceFileInfo);
+    }
+
     // populate the UI based on trace file info
     emit TraceFileLoaded(bOpened, m_traceFileInfo, m_controllerFilename);
 
@@ -166,138 +166,8 @@ bool vktraceviewer_QTraceFileLoader::populate_trace_file_info(vktraceviewer_trac
     // Set global version num
     vktrace_set_trace_version(pTraceFileInfo->pHeader->trace_file_version);
 
-    // Find out how many trace packets there are.
-
-    // Seek to first packet
-    long first_offset = pTraceFileInfo->pHeader->first_packet_offset;
-    int seekResult = Fseek(pTraceFileInfo->pFile, first_offset, SEEK_SET);
-    if (seekResult != 0) {
-        emit OutputMessage(VKTRACE_LOG_WARNING, "Failed to seek to the first packet offset in the trace file.");
-    }
-    decompressor* pDecompressor = nullptr;
-    if (header.trace_file_version > VKTRACE_TRACE_FILE_VERSION_8 && header.compress_type != VKTRACE_COMPRESS_TYPE_NONE) {
-        pDecompressor = create_decompressor((VKTRACE_COMPRESS_TYPE)header.compress_type);
-    }
-    // "Walk" through each packet based on the packet size (which is the first 64-bits of the packet header)
-    uint64_t fileOffset = pTraceFileInfo->pHeader->first_packet_offset;
-    uint64_t packetSize = 0;
-    while (1 == fread(&packetSize, sizeof(uint64_t), 1, pTraceFileInfo->pFile)) {
-        // success!
-        pTraceFileInfo->packetCount++;
-        fileOffset += packetSize;
-
-        seekResult = Fseek(pTraceFileInfo->pFile, packetSize - sizeof(uint64_t), SEEK_CUR);
-        if (seekResult != 0) {
-            emit OutputMessage(VKTRACE_LOG_ERROR, "Error while seeking through trace file.");
-            break;
-        }
-
-        if (ferror(pTraceFileInfo->pFile) != 0) {
-            emit OutputMessage(VKTRACE_LOG_ERROR, "Error while reading trace file.");
-            break;
-        }
-    }
-
-    if (pTraceFileInfo->packetCount == 0) {
-        if (ferror(pTraceFileInfo->pFile) != 0) {
-            perror("File Read error:");
-            emit OutputMessage(VKTRACE_LOG_ERROR, "There was an error reading the trace file.");
-            return false;
-        } else if (feof(pTraceFileInfo->pFile) != 0) {
-            emit OutputMessage(VKTRACE_LOG_WARNING, "Reached the end of the file.");
-        }
-        emit OutputMessage(VKTRACE_LOG_WARNING, "There are no trace packets in this trace file.");
-        pTraceFileInfo->pPacketOffsets = NULL;
-    } else {
-        pTraceFileInfo->pPacketOffsets = VKTRACE_NEW_ARRAY(vktraceviewer_trace_file_packet_offsets, pTraceFileInfo->packetCount);
-
-        // rewind to first packet and this time, populate the packet offsets
-        if (Fseek(pTraceFileInfo->pFile, first_offset, SEEK_SET) != 0) {
-            vktrace_free(pTraceFileInfo->pHeader);
-            emit OutputMessage(VKTRACE_LOG_ERROR, "Unable to rewind trace file to gather packet offsets.");
-            return false;
-        }
-
-        unsigned int packetIndex = 0;
-        fileOffset = first_offset;
-        while (1 == fread(&packetSize, sizeof(uint64_t), 1, pTraceFileInfo->pFile)) {
-            // the fread confirms that this packet exists
-            // NOTE: We do not actually read the entire packet into memory right now.
-            pTraceFileInfo->pPacketOffsets[packetIndex].fileOffset = fileOffset;
-
-            // rewind slightly
-            seekResult = Fseek(pTraceFileInfo->pFile, -1 * (long)sizeof(uint64_t), SEEK_CUR);
-
-            if (seekResult != 0) {
-                emit OutputMessage(VKTRACE_LOG_ERROR, "Error while seeking between packets.");
-                break;
-            }
-
-            // allocate space for the packet and read it in
-            pTraceFileInfo->pPacketOffsets[packetIndex].pHeader = (vktrace_trace_packet_header*)vktrace_malloc(packetSize);
-            if (1 != fread(pTraceFileInfo->pPacketOffsets[packetIndex].pHeader, packetSize, 1, pTraceFileInfo->pFile)) {
-                vktrace_free(pTraceFileInfo->pHeader);
-                emit OutputMessage(VKTRACE_LOG_ERROR, "Unable to read in a trace packet.");
-                return false;
-            }
-
-            // adjust pointer to body of the packet
-            pTraceFileInfo->pPacketOffsets[packetIndex].pHeader->pBody =
-                (uintptr_t)pTraceFileInfo->pPacketOffsets[packetIndex].pHeader + sizeof(vktrace_trace_packet_header);
-
-            if (pDecompressor != nullptr && pTraceFileInfo->pPacketOffsets[packetIndex].pHeader->tracer_id == VKTRACE_TID_VULKAN_COMPRESSED) {
-                int res = decompress_packet(pDecompressor, pTraceFileInfo->pPacketOffsets[packetIndex].pHeader);
-                if (res < 0) {
-                    emit OutputMessage(VKTRACE_LOG_ERROR, "Packet decompress failed.");
-                    return false;
-                }
-            }
-
-            switch (pTraceFileInfo->pPacketOffsets[packetIndex].pHeader->packet_id) {
-                case VKTRACE_TPI_MESSAGE:
-                    break;
-                case VKTRACE_TPI_MARKER_CHECKPOINT:
-                    break;
-                case VKTRACE_TPI_MARKER_API_BOUNDARY:
-                    break;
-                case VKTRACE_TPI_MARKER_API_GROUP_BEGIN:
-                    break;
-                case VKTRACE_TPI_MARKER_API_GROUP_END:
-                    break;
-                case VKTRACE_TPI_MARKER_TERMINATE_PROCESS:
-                    break;
-                case VKTRACE_TPI_PORTABILITY_TABLE:
-                case VKTRACE_TPI_META_DATA:
-                    break;
-                // TODO processing code for all the above cases
-                default: {
-                    vktrace_trace_packet_header* pHeader = m_pController->InterpretTracePacket(pTraceFileInfo->pPacketOffsets[packetIndex].pHeader);
-                    pTraceFileInfo->pPacketOffsets[packetIndex].pHeader = pHeader;
-                    break;
-                }
-
-            }
-
-            // now seek to what should be the next packet
-            fileOffset += packetSize;
-            packetIndex++;
-        }
-        if (pDecompressor != nullptr) {
-             delete pDecompressor;
-        }
-        // If the last packet is the portability table, remove it
-        if (pTraceFileInfo->pPacketOffsets[pTraceFileInfo->packetCount - 1].pHeader->packet_id == VKTRACE_TPI_PORTABILITY_TABLE ||
-            pTraceFileInfo->pPacketOffsets[pTraceFileInfo->packetCount - 1].pHeader->packet_id == VKTRACE_TPI_META_DATA) {
-            vktrace_free(pTraceFileInfo->pPacketOffsets[pTraceFileInfo->packetCount - 1].pHeader);
-            pTraceFileInfo->packetCount--;
-        }
-
-        if (Fseek(pTraceFileInfo->pFile, first_offset, SEEK_SET) != 0) {
-            vktrace_free(pTraceFileInfo->pHeader);
-            emit OutputMessage(VKTRACE_LOG_ERROR, "Unable to rewind trace file to restore position.");
-            return false;
-        }
-    }
-
-    return true;
+    // Record where each packet is, they are read on demand when the views request them
+    return vktraceviewer_scan_trace_file(pTraceFileInfo, [this](VktraceLogLevel level, const QString& message) {
+        emit OutputMessage(level, message);
+    }) == TRUE;
 }
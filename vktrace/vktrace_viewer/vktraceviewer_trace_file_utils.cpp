@@ -18,8 +18,222 @@
  *
  * Author: Peter Lohrmann <peterl@valvesoftware.com> <plohrmann@gmail.com>
  **************************************************************************/
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#if defined(WIN32)
+#include <io.h>
+#endif
+
 #include "vktraceviewer_trace_file_utils.h"
 #include "vktrace_memory.h"
+#include "decompressor.h"
+#include "blobstore.h"
+extern "C" {
+#include "vktrace_trace_packet_utils.h"
+}
+
+// Decoded packets kept by the viewer, the most recently used one is always kept even if it is larger
+#define VKTRACEVIEWER_PACKET_CACHE_SIZE (64 * 1024 * 1024)
+
+// Reads packets straight from a memory mapping of the trace file, or with fread when the file can't be mapped (e.g. a
+// trace larger than the address space of a 32-bit build). Packets are decompressed, resolved and interpreted when
+// they are first requested and the recently used ones are kept in an LRU of at most 'max_size' bytes.
+class vktraceviewer_packet_cache {
+   public:
+    explicit vktraceviewer_packet_cache(uint64_t max_size) : m_maxSize(max_size) {}
+
+    ~vktraceviewer_packet_cache() {
+        for (auto& entry : m_lru) {
+            vktrace_free(entry.second);
+        }
+        if (m_pBlobCache != nullptr) {
+            delete m_pBlobCache;
+            VKTRACE_DELETE(m_pBlobFile);
+        }
+        if (m_pDecompressor != nullptr) {
+            delete m_pDecompressor;
+        }
+        if (m_pMapping != nullptr) {
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_OSX)
+            munmap((void*)m_pMapping, (size_t)m_fileSize);
+#elif defined(WIN32)
+            UnmapViewOfFile(m_pMapping);
+            CloseHandle(m_hMapping);
+#endif
+        }
+        if (m_pFile != nullptr) {
+            fclose(m_pFile);
+        }
+    }
+
+    bool open(const char* filename, const vktrace_trace_file_header* pFileHeader) {
+        m_pFile = fopen(filename, "rb");
+        if (m_pFile == nullptr || Fseek(m_pFile, 0, SEEK_END) != 0) {
+            return false;
+        }
+        m_fileSize = (uint64_t)Ftell(m_pFile);
+        map_file();
+
+        if (pFileHeader->trace_file_version > VKTRACE_TRACE_FILE_VERSION_8 && pFileHeader->compress_type != VKTRACE_COMPRESS_TYPE_NONE) {
+            m_pDecompressor = create_decompressor((VKTRACE_COMPRESS_TYPE)pFileHeader->compress_type);
+        }
+        if (pFileHeader->bit_flags & VKTRACE_USE_BLOB_REFERENCES_BIT) {
+            // Blob payloads are read back through the FILE, it is only used with the lock held
+            m_pBlobFile = vktrace_FileLike_create_file(m_pFile);
+            m_pBlobCache = new blobcache(m_pBlobFile, m_pDecompressor);
+        }
+        return true;
+    }
+
+    bool is_mapped() const { return m_pMapping != nullptr; }
+
+    uint64_t file_size() const { return m_fileSize; }
+
+    void set_interpreter(const vktraceviewer_interpret_func& interpret) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_interpret = interpret;
+    }
+
+    bool read_header(uint64_t offset, vktrace_trace_packet_header* pHeader) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return read_raw(offset, pHeader, sizeof(vktrace_trace_packet_header));
+    }
+
+    vktrace_trace_packet_header* read_packet(uint64_t offset) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return decode_packet(offset);
+    }
+
+    const vktrace_trace_packet_header* get_packet(uint64_t offset) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_index.find(offset);
+        if (it != m_index.end()) {
+            m_lru.splice(m_lru.begin(), m_lru, it->second);
+            return it->second->second;
+        }
+
+        vktrace_trace_packet_header* pPacket = decode_packet(offset);
+        if (pPacket == nullptr) {
+            return nullptr;
+        }
+        m_lru.emplace_front(offset, pPacket);
+        m_index[offset] = m_lru.begin();
+        m_size += pPacket->size;
+
+        // Evict the least recently used packets, but always keep the one just added
+        while (m_size > m_maxSize && m_lru.size() > 1) {
+            m_size -= m_lru.back().second->size;
+            vktrace_free(m_lru.back().second);
+            m_index.erase(m_lru.back().first);
+            m_lru.pop_back();
+        }
+        return pPacket;
+    }
+
+   private:
+    typedef std::list<std::pair<uint64_t, vktrace_trace_packet_header*>> packet_list;
+
+    void map_file() {
+        if (m_fileSize == 0 || m_fileSize > (uint64_t)SIZE_MAX) {
+            return;
+        }
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_OSX)
+        void* pMapping = mmap(NULL, (size_t)m_fileSize, PROT_READ, MAP_PRIVATE, fileno(m_pFile), 0);
+        if (pMapping != MAP_FAILED) {
+            m_pMapping = (const char*)pMapping;
+        }
+#elif defined(WIN32)
+        HANDLE hFile = (HANDLE)_get_osfhandle(_fileno(m_pFile));
+        m_hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (m_hMapping != NULL) {
+            m_pMapping = (const char*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+            if (m_pMapping == nullptr) {
+                CloseHandle(m_hMapping);
+                m_hMapping = NULL;
+            }
+        }
+#endif
+    }
+
+    bool read_raw(uint64_t offset, void* pData, uint64_t size) {
+        if (offset > m_fileSize || size > m_fileSize - offset) {
+            return false;
+        }
+        if (m_pMapping != nullptr) {
+            memcpy(pData, m_pMapping + offset, (size_t)size);
+            return true;
+        }
+        return Fseek(m_pFile, offset, SEEK_SET) == 0 && fread(pData, (size_t)size, 1, m_pFile) == 1;
+    }
+
+    vktrace_trace_packet_header* decode_packet(uint64_t offset) {
+        vktrace_trace_packet_header header;
+        if (!read_raw(offset, &header, sizeof(header)) || header.size < sizeof(header)) {
+            vktrace_LogError("Failed to read the trace packet at offset %llu.", offset);
+            return nullptr;
+        }
+        vktrace_trace_packet_header* pPacket = (vktrace_trace_packet_header*)vktrace_malloc((size_t)header.size);
+        if (pPacket == nullptr || !read_raw(offset, pPacket, header.size)) {
+            vktrace_free(pPacket);
+            vktrace_LogError("Failed to read the trace packet at offset %llu.", offset);
+            return nullptr;
+        }
+        pPacket->pBody = (uintptr_t)(pPacket + 1);
+
+        if (pPacket->tracer_id == VKTRACE_TID_VULKAN_COMPRESSED) {
+            if (m_pDecompressor == nullptr || decompress_packet(m_pDecompressor, pPacket) != 0) {
+                vktrace_free(pPacket);
+                vktrace_LogError("Packet decompress failed.");
+                return nullptr;
+            }
+        }
+        if (pPacket->tracer_id == VKTRACE_TID_VULKAN_BLOB_REF) {
+            if (resolve_packet(m_pBlobCache, pPacket) != 0) {
+                vktrace_free(pPacket);
+                vktrace_LogError("Packet blob reference resolve failed.");
+                return nullptr;
+            }
+        }
+
+        switch (pPacket->packet_id) {
+            case VKTRACE_TPI_MESSAGE:
+            case VKTRACE_TPI_MARKER_CHECKPOINT:
+            case VKTRACE_TPI_MARKER_API_BOUNDARY:
+            case VKTRACE_TPI_MARKER_API_GROUP_BEGIN:
+            case VKTRACE_TPI_MARKER_API_GROUP_END:
+            case VKTRACE_TPI_MARKER_TERMINATE_PROCESS:
+            case VKTRACE_TPI_PORTABILITY_TABLE:
+            case VKTRACE_TPI_META_DATA:
+            case VKTRACE_TPI_BLOCK_TABLE:
+                break;
+            default:
+                if (m_interpret) {
+                    pPacket = m_interpret(pPacket);
+                }
+                break;
+        }
+        return pPacket;
+    }
+
+    std::mutex m_mutex;
+    FILE* m_pFile = nullptr;
+    uint64_t m_fileSize = 0;
+    const char* m_pMapping = nullptr;
+#if defined(WIN32)
+    HANDLE m_hMapping = NULL;
+#endif
+    decompressor* m_pDecompressor = nullptr;
+    FileLike* m_pBlobFile = nullptr;
+    blobcache* m_pBlobCache = nullptr;
+    vktraceviewer_interpret_func m_interpret;
+
+    uint64_t m_maxSize;
+    uint64_t m_size = 0;
+    packet_list m_lru;
+    std::unordered_map<uint64_t, packet_list::iterator> m_index;
+};
 
 BOOL vktraceviewer_populate_trace_file_info(vktraceviewer_trace_file_info* pTraceFileInfo) {
     vktrace_trace_file_header header;
@@ -59,79 +273,99 @@ BOOL vktraceviewer_populate_trace_file_info(vktraceviewer_trace_file_info* pTrac
     // Set global version num
     vktrace_set_trace_version(pTraceFileInfo->pHeader->trace_file_version);
 
-    // Find out how many trace packets there are.
+    return vktraceviewer_scan_trace_file(pTraceFileInfo, [](VktraceLogLevel level, const QString& message) {
+        if (level == VKTRACE_LOG_ERROR) {
+            vktraceviewer_output_error(message);
+        } else {
+            vktraceviewer_output_warning(message);
+        }
+    });
+}
 
-    // Seek to first packet
-    long first_offset = pTraceFileInfo->pHeader->first_packet_offset;
-    int seekResult = Fseek(pTraceFileInfo->pFile, first_offset, SEEK_SET);
-    if (seekResult != 0) {
-        vktraceviewer_output_warning("Failed to seek to the first packet offset in the trace file.");
+BOOL vktraceviewer_scan_trace_file(vktraceviewer_trace_file_info* pTraceFileInfo, const vktraceviewer_report_func& report) {
+    assert(pTraceFileInfo != NULL);
+    assert(pTraceFileInfo->pHeader != NULL);
+
+    vktraceviewer_packet_cache* pCache = new vktraceviewer_packet_cache(VKTRACEVIEWER_PACKET_CACHE_SIZE);
+    if (!pCache->open(pTraceFileInfo->filename, pTraceFileInfo->pHeader)) {
+        delete pCache;
+        report(VKTRACE_LOG_ERROR, "Unable to open the trace file to read packets.");
+        return FALSE;
+    }
+    if (!pCache->is_mapped()) {
+        report(VKTRACE_LOG_WARNING, "Unable to memory-map the trace file, packets will be read from disk.");
     }
 
+    // "Walk" through each packet based on the packet size (which is the first 64-bits of the packet header), only the
+    // headers are read
+    std::vector<vktraceviewer_trace_file_packet_offsets> packets;
+    vktraceviewer_trace_file_packet_offsets packet;
     uint64_t fileOffset = pTraceFileInfo->pHeader->first_packet_offset;
-    uint64_t packetSize = 0;
-    while (1 == fread(&packetSize, sizeof(uint64_t), 1, pTraceFileInfo->pFile)) {
-        // success!
-        pTraceFileInfo->packetCount++;
-        fileOffset += packetSize;
+    while (fileOffset < pCache->file_size()) {
+        if (!pCache->read_header(fileOffset, &packet.header) || packet.header.size < sizeof(vktrace_trace_packet_header) ||
+            packet.header.size > pCache->file_size() - fileOffset) {
+            report(VKTRACE_LOG_WARNING,
+                   QString("The trace packet at offset %1 is truncated, the rest of the file is ignored.").arg(fileOffset));
+            break;
+        }
+        packet.fileOffset = fileOffset;
+        if (packet.header.tracer_id == VKTRACE_TID_VULKAN_COMPRESSED || packet.header.tracer_id == VKTRACE_TID_VULKAN_BLOB_REF) {
+            packet.header.tracer_id = VKTRACE_TID_VULKAN;
+        }
+        packet.header.pBody = 0;
+        packets.push_back(packet);
+        fileOffset += packet.header.size;
+    }
 
-        Fseek(pTraceFileInfo->pFile, fileOffset, SEEK_SET);
+    // Remove the portability table, the block table and the meta data at the end
+    while (!packets.empty() && (packets.back().header.packet_id == VKTRACE_TPI_PORTABILITY_TABLE ||
+                                packets.back().header.packet_id == VKTRACE_TPI_BLOCK_TABLE ||
+                                packets.back().header.packet_id == VKTRACE_TPI_META_DATA)) {
+        packets.pop_back();
     }
 
+    pTraceFileInfo->pPacketCache = pCache;
+    pTraceFileInfo->packetCount = packets.size();
     if (pTraceFileInfo->packetCount == 0) {
-        if (ferror(pTraceFileInfo->pFile) != 0) {
-            perror("File Read error:");
-            vktraceviewer_output_warning("There was an error reading the trace file.");
-            vktrace_free(pTraceFileInfo->pHeader);
-            return FALSE;
-        } else if (feof(pTraceFileInfo->pFile) != 0) {
-            vktraceviewer_output_warning("Reached the end of the file.");
-        }
-        vktraceviewer_output_warning("There are no trace packets in this trace file.");
+        report(VKTRACE_LOG_WARNING, "There are no trace packets in this trace file.");
         pTraceFileInfo->pPacketOffsets = NULL;
     } else {
         pTraceFileInfo->pPacketOffsets = VKTRACE_NEW_ARRAY(vktraceviewer_trace_file_packet_offsets, pTraceFileInfo->packetCount);
+        memcpy(pTraceFileInfo->pPacketOffsets, packets.data(), packets.size() * sizeof(vktraceviewer_trace_file_packet_offsets));
+    }
 
-        // rewind to first packet and this time, populate the packet offsets
-        if (Fseek(pTraceFileInfo->pFile, first_offset, SEEK_SET) != 0) {
-            vktraceviewer_output_error("Unable to rewind trace file to gather packet offsets.");
-            vktrace_free(pTraceFileInfo->pHeader);
-            return FALSE;
-        }
-
-        unsigned int packetIndex = 0;
-        fileOffset = first_offset;
-        while (1 == fread(&packetSize, sizeof(uint64_t), 1, pTraceFileInfo->pFile)) {
-            // the fread confirms that this packet exists
-            // NOTE: We do not actually read the entire packet into memory right now.
-            pTraceFileInfo->pPacketOffsets[packetIndex].fileOffset = fileOffset;
-
-            // rewind slightly
-            Fseek(pTraceFileInfo->pFile, -1 * (long)sizeof(uint64_t), SEEK_CUR);
-
-            // allocate space for the packet and read it in
-            pTraceFileInfo->pPacketOffsets[packetIndex].pHeader = (vktrace_trace_packet_header*)vktrace_malloc(packetSize);
-            if (1 != fread(pTraceFileInfo->pPacketOffsets[packetIndex].pHeader, packetSize, 1, pTraceFileInfo->pFile)) {
-                vktraceviewer_output_error("Unable to read in a trace packet.");
-                vktrace_free(pTraceFileInfo->pHeader);
-                return FALSE;
-            }
+    return TRUE;
+}
+
+void vktraceviewer_set_packet_interpreter(vktraceviewer_trace_file_info* pTraceFileInfo, const vktraceviewer_interpret_func& interpret) {
+    if (pTraceFileInfo->pPacketCache != NULL) {
+        pTraceFileInfo->pPacketCache->set_interpreter(interpret);
+    }
+}
 
-            // adjust pointer to body of the packet
-            pTraceFileInfo->pPacketOffsets[packetIndex].pHeader->pBody =
-                (uintptr_t)pTraceFileInfo->pPacketOffsets[packetIndex].pHeader + sizeof(vktrace_trace_packet_header);
+const vktrace_trace_packet_header* vktraceviewer_get_packet(vktraceviewer_trace_file_info* pTraceFileInfo, uint64_t packetIndex) {
+    if (pTraceFileInfo->pPacketCache == NULL || packetIndex >= pTraceFileInfo->packetCount) {
+        return NULL;
+    }
+    return pTraceFileInfo->pPacketCache->get_packet(pTraceFileInfo->pPacketOffsets[packetIndex].fileOffset);
+}
 
-            // now seek to what should be the next packet
-            fileOffset += packetSize;
-            packetIndex++;
-        }
+vktrace_trace_packet_header* vktraceviewer_read_packet(vktraceviewer_trace_file_info* pTraceFileInfo, uint64_t packetIndex) {
+    if (pTraceFileInfo->pPacketCache == NULL || packetIndex >= pTraceFileInfo->packetCount) {
+        return NULL;
+    }
+    return pTraceFileInfo->pPacketCache->read_packet(pTraceFileInfo->pPacketOffsets[packetIndex].fileOffset);
+}
 
-        if (Fseek(pTraceFileInfo->pFile, first_offset, SEEK_SET) != 0) {
-            vktraceviewer_output_error("Unable to rewind trace file to restore position.");
-            vktrace_free(pTraceFileInfo->pHeader);
-            return FALSE;
-        }
+void vktraceviewer_free_packets(vktraceviewer_trace_file_info* pTraceFileInfo) {
+    if (pTraceFileInfo->pPacketOffsets != NULL) {
+        VKTRACE_DELETE(pTraceFileInfo->pPacketOffsets);
+        pTraceFileInfo->pPacketOffsets = NULL;
     }
+    pTraceFileInfo->packetCount = 0;
 
-    return TRUE;
+    if (pTraceFileInfo->pPacketCache != NULL) {
+        delete pTraceFileInfo->pPacketCache;
+        pTraceFileInfo->pPacketCache = NULL;
+    }
 }
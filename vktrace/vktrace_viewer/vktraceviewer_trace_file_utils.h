@@ -22,6 +22,7 @@
 #define VKTRACEVIEWER_TRACE_FILE_UTILS_H_
 
 //#include <string>
+#include <functional>
 #include <QString>
 
 extern "C" {
@@ -31,12 +32,15 @@ extern "C" {
 
 struct vktraceviewer_trace_file_packet_offsets {
     // the file offset to this particular packet
-    unsigned int fileOffset;
+    uint64_t fileOffset;
 
-    // Pointer to the packet header if it's been read from disk
-    vktrace_trace_packet_header* pHeader;
+    // Copy of the packet header, the body is not read until the packet is requested with vktraceviewer_get_packet().
+    // 'size' is the size of the packet in the file and 'tracer_id' that of the packet once decompressed and resolved.
+    vktrace_trace_packet_header header;
 };
 
+class vktraceviewer_packet_cache;
+
 struct vktraceviewer_trace_file_info {
     // the trace file name & path
     char* filename;
@@ -53,8 +57,32 @@ struct vktraceviewer_trace_file_info {
 
     // array of packet offsets
     vktraceviewer_trace_file_packet_offsets* pPacketOffsets;
+
+    // maps the trace file and keeps the recently used packets decoded
+    vktraceviewer_packet_cache* pPacketCache;
 };
 
+typedef std::function<void(VktraceLogLevel level, const QString& message)> vktraceviewer_report_func;
+typedef std::function<vktrace_trace_packet_header*(vktrace_trace_packet_header* pHeader)> vktraceviewer_interpret_func;
+
 BOOL vktraceviewer_populate_trace_file_info(vktraceviewer_trace_file_info* pTraceFileInfo);
 
+// Maps the trace file (pTraceFileInfo->pHeader must already be read) and fills pPacketOffsets in a single pass over
+// the packet headers. The packets themselves are only read when they are requested.
+BOOL vktraceviewer_scan_trace_file(vktraceviewer_trace_file_info* pTraceFileInfo, const vktraceviewer_report_func& report);
+
+// Sets how API packets are interpreted once read, usually with the controller's InterpretTracePacket().
+void vktraceviewer_set_packet_interpreter(vktraceviewer_trace_file_info* pTraceFileInfo, const vktraceviewer_interpret_func& interpret);
+
+// Returns packet 'packetIndex' decompressed, resolved and interpreted, or NULL if it can't be read. The packet is owned
+// by a bounded LRU cache and may be evicted by the next call, so it must not be kept.
+const vktrace_trace_packet_header* vktraceviewer_get_packet(vktraceviewer_trace_file_info* pTraceFileInfo, uint64_t packetIndex);
+
+// Same as vktraceviewer_get_packet() but bypasses the cache, the caller frees the packet with vktrace_free().
+// Can be called from any thread.
+vktrace_trace_packet_header* vktraceviewer_read_packet(vktraceviewer_trace_file_info* pTraceFileInfo, uint64_t packetIndex);
+
+// Frees pPacketOffsets and the packet cache, and unmaps the trace file.
+void vktraceviewer_free_packets(vktraceviewer_trace_file_info* pTraceFileInfo);
+
 #endif  // VKTRACEVIEWER_TRACE_FILE_UTILS_H_
@@ -23,12 +23,25 @@ extern "C" {
 #include "vktrace_vk_packet_id.h"
 }
 
+// The packets which the layer writes after each present, newer traces have them
+static bool isFrameBoundary(const vktrace_trace_packet_header* pHeader) {
+    return pHeader != NULL && pHeader->tracer_id == VKTRACE_TID_VULKAN && pHeader->packet_id == VKTRACE_TPI_MARKER_API_BOUNDARY &&
+           pHeader->size >= sizeof(vktrace_trace_packet_header) + sizeof(vktrace_trace_packet_frame_boundary);
+}
+
 void vktraceviewer_vk_QGroupFramesProxyModel::buildGroups() {
     m_mapSourceRowToProxyGroupRow.clear();
     m_frameList.clear();
     m_curFrameCount = 0;
 
     if (sourceModel() != NULL) {
+        // Frames end at the frame boundary packets if the trace has any, or at the presents in older traces
+        bool hasFrameBoundaries = false;
+        for (int srcRow = 0; srcRow < sourceModel()->rowCount() && !hasFrameBoundaries; srcRow++) {
+            QModelIndex tmpIndex = sourceModel()->index(srcRow, 0);
+            hasFrameBoundaries = isFrameBoundary((vktrace_trace_packet_header*)tmpIndex.internalPointer());
+        }
+
         FrameInfo* pCurFrame = addNewFrame();
         m_mapSourceRowToProxyGroupRow.reserve(sourceModel()->rowCount());
         for (int srcRow = 0; srcRow < sourceModel()->rowCount(); srcRow++) {
@@ -45,8 +58,9 @@ void vktraceviewer_vk_QGroupFramesProxyModel::buildGroups() {
             QModelIndex tmpIndex = sourceModel()->index(srcRow, 0);
             assert(tmpIndex.isValid());
             vktrace_trace_packet_header* pHeader = (vktrace_trace_packet_header*)tmpIndex.internalPointer();
-            if (pHeader != NULL && pHeader->tracer_id == VKTRACE_TID_VULKAN &&
-                pHeader->packet_id == VKTRACE_TPI_VK_vkQueuePresentKHR) {
+            if (hasFrameBoundaries ? isFrameBoundary(pHeader)
+                                   : (pHeader != NULL && pHeader->tracer_id == VKTRACE_TID_VULKAN &&
+                                      pHeader->packet_id == VKTRACE_TPI_VK_vkQueuePresentKHR)) {
                 pCurFrame = addNewFrame();
             }
         }  // end for each source row